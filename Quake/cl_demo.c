@@ -22,6 +22,11 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "quakedef.h"
 
 static void CL_FinishTimeDemo (void);
+static void CL_FinishBenchmark (void);
+static void CL_FinishDemoRender (void);
+static void CL_InitDemoKeyframes (void);
+static void CL_UpdateDemoKeyframes (qfileofs_t fileofs);
+static void CL_ShutdownDemoKeyframes (void);
 
 /*
 ==============================================================================
@@ -80,6 +85,8 @@ static struct
 	}				prev;
 }					demo_rewind;
 
+static qboolean		demo_seeking;	// reading ahead for demoseek
+
 /*
 ==============
 CL_ClearSignons
@@ -92,6 +99,18 @@ void CL_ClearSignons (void)
 	cls.signon = 0;
 }
 
+/*
+==============
+CL_DemoSeeking
+
+True while demoseek reads ahead, commands and sounds on the way are skipped
+==============
+*/
+qboolean CL_DemoSeeking (void)
+{
+	return demo_seeking;
+}
+
 /*
 ==============
 CL_StopPlayback
@@ -104,6 +123,8 @@ void CL_StopPlayback (void)
 	if (!cls.demoplayback)
 		return;
 
+	CL_ShutdownDemoKeyframes ();
+
 	fclose (cls.demofile);
 	cls.demoplayback = false;
 	cls.demopaused = false;
@@ -121,6 +142,8 @@ void CL_StopPlayback (void)
 
 	if (cls.timedemo)
 		CL_FinishTimeDemo ();
+	if (cls.demorender)
+		CL_FinishDemoRender ();
 }
 
 /*
@@ -220,7 +243,8 @@ void CL_AdvanceTime (void)
 
 	if (cls.demoplayback)
 	{
-		CL_UpdateDemoSpeed ();
+		if (!cls.demorender)
+			CL_UpdateDemoSpeed ();
 		cl.time += cls.demospeed * host_frametime;
 		if (demo_rewind.backstop)
 			cl.time = cl.mtime[0];
@@ -247,6 +271,8 @@ static qboolean CL_NextDemoFrame (void)
 	// Forward playback
 	if (cls.demospeed > 0.f)
 	{
+		CL_UpdateDemoKeyframes (Sys_ftell (cls.demofile));
+
 		if (cls.signon < SIGNONS)
 		{
 			VEC_CLEAR (demo_rewind.frames);
@@ -426,7 +452,7 @@ static int CL_GetDemoMessage (void)
 		return 0;
 
 	// decide if it is time to grab the next message
-	if (cls.signon == SIGNONS)	// always grab until fully connected
+	if (cls.signon == SIGNONS && !demo_seeking)	// always grab until fully connected
 	{
 		if (cls.timedemo)
 		{
@@ -779,6 +805,7 @@ void CL_PlayDemo_f (void)
 
 	Con_Printf ("Playing demo from %s.\n", name);
 
+	COM_InvalidateFileCache ();	// the demo may have just been recorded
 	COM_FOpenFile (name, &cls.demofile, NULL);
 	if (!cls.demofile)
 	{
@@ -812,11 +839,1111 @@ void CL_PlayDemo_f (void)
 	cls.demoloop = Cmd_Argc () >= 3 ? Q_atoi (Cmd_Argv (2)) != 0 : false;
 	cls.demofilestart = Sys_ftell (cls.demofile);
 	cls.demofilesize = com_filesize;
+	CL_InitDemoKeyframes ();
 
 // get rid of the menu and/or console
 	key_dest = key_game;
 }
 
+/*
+==============================================================================
+
+DEMO KEYFRAMES
+
+While a demo is read, a snapshot of the client state is taken every
+cl_demokeyframes seconds of demo time: the client state and stats, the
+entities, scores, lightstyles, and any static entities or sounds spawned
+after the signon. demoseek restores the nearest keyframe at or before the
+target time and parses the few messages left, so a seek costs about the
+same anywhere in the demo. Seeking past the indexed part parses through
+without rendering, indexing as it goes.
+
+Pointers are stored as precache/scoreboard indices, so with
+cl_demokeyframecache the index is saved to <demo>.dki in the game
+directory when playback stops and reused the next time the demo plays.
+
+==============================================================================
+*/
+
+cvar_t	cl_demokeyframes = {"cl_demokeyframes", "10", CVAR_ARCHIVE};
+cvar_t	cl_demokeyframecache = {"cl_demokeyframecache", "0", CVAR_ARCHIVE};
+
+#define DEMOKEY_IDENT		(('F'<<24)+('K'<<16)+('D'<<8)+'Q')
+#define DEMOKEY_VERSION		2
+#define DEMOKEY_HASHBYTES	0x10000		// demo bytes hashed to match the cache
+
+typedef struct
+{
+	double		time;		// cl.mtime[0] when taken
+	qfileofs_t	fileofs;	// next demo message
+	int			segment;	// map within the demo
+	int			dataofs;	// in demo_keyframes.data
+	int			datasize;
+} demokeyframe_t;
+
+// just enough of an entity_t to rebuild it, lerping restarts on restore
+typedef struct
+{
+	int				index;		// cl_entities or cl_static_entities slot
+	int				model;		// cl.model_precache index, 0 = none
+	int				colormap;	// 0 = vid.colormap, else 1 + scoreboard slot
+	int				lerpflags;
+	double			msgtime;
+	float			syncbase;
+	vec3_t			msg_origin;	// newest update
+	vec3_t			msg_angles;
+	entity_state_t	state;		// origin, angles, frame, skin, alpha, scale, effects
+	entity_state_t	baseline;
+} demokeyentity_t;
+
+typedef struct
+{
+	char		name[MAX_SCOREBOARDNAME];
+	float		entertime;
+	int			frags;
+	int			colors;
+} demokeyscore_t;
+
+typedef struct
+{
+	int			sound;		// cl.sound_precache index
+	vec3_t		origin;
+	int			volume;
+	int			attenuation;
+} demostaticsound_t;
+
+// fixed part of a keyframe, followed by the scores, entities,
+// statics and static sounds
+typedef struct
+{
+	byte			cl[offsetof (client_state_t, model_precache)];	// the per-frame part
+	int				viewentity;
+	int				maxclients;
+	int				num_entities;
+	int				num_records;		// entities actually stored
+	int				num_statics;
+	int				first_static;		// statics from the signon aren't stored
+	int				num_staticsounds;
+	int				first_staticsound;
+	int				cdtrack, looptrack;
+	float			zoom, zoomdir;
+	qboolean		forceunderwater;
+	cshift_t		cshift_empty;
+	demokeyentity_t	viewent;
+	lightstyle_t	lightstyles[MAX_LIGHTSTYLES];
+} demokeystate_t;
+
+typedef struct
+{
+	int			ident;
+	int			version;
+	int			framesize;	// structure sizes, to reject caches from other builds
+	int			statesize;
+	int			entitysize;
+	qfileofs_t	demosize;
+	unsigned	demohash;
+	int			numframes;
+	int			datasize;
+} demokeyheader_t;
+
+static struct
+{
+	demokeyframe_t		*frames;		// VEC, in file order
+	byte				*data;			// VEC
+	demostaticsound_t	*staticsounds;	// VEC, spawned on the current map
+	int					numloaded;		// frames read from the cache
+	int					segment;
+	qboolean			insegment;
+	int					first_static;
+	int					first_staticsound;
+	unsigned			demohash;
+}						demo_keyframes;
+
+/*
+===============
+CL_AddDemoStaticSound
+===============
+*/
+void CL_AddDemoStaticSound (int sound_num, vec3_t origin, int vol, int atten)
+{
+	demostaticsound_t snd;
+
+	if (!cls.demoplayback)
+		return;
+
+	snd.sound = sound_num;
+	VectorCopy (origin, snd.origin);
+	snd.volume = vol;
+	snd.attenuation = atten;
+	VEC_PUSH (demo_keyframes.staticsounds, snd);
+}
+
+/*
+===============
+CL_DemoKeyframeModel
+===============
+*/
+static int CL_DemoKeyframeModel (const qmodel_t *mod, int hint)
+{
+	int i;
+
+	if (!mod)
+		return 0;
+	if (hint > 0 && hint < MAX_MODELS && cl.model_precache[hint] == mod)
+		return hint;
+	for (i = 1; i < MAX_MODELS && cl.model_precache[i]; i++)
+		if (cl.model_precache[i] == mod)
+			return i;
+	return 0;
+}
+
+/*
+===============
+CL_PackDemoKeyframeEntity
+===============
+*/
+static void CL_PackDemoKeyframeEntity (demokeyentity_t *dst, int index, const entity_t *ent)
+{
+	int i;
+
+	memset (dst, 0, sizeof (*dst));
+	dst->index = index;
+	dst->model = CL_DemoKeyframeModel (ent->model, ent->baseline.modelindex);
+	for (i = 0; i < cl.maxclients; i++)
+	{
+		if (ent->colormap == cl.scores[i].translations)
+		{
+			dst->colormap = i + 1;
+			break;
+		}
+	}
+
+	dst->lerpflags = ent->lerpflags & LERP_MOVESTEP;
+	dst->msgtime = ent->msgtime;
+	dst->syncbase = ent->syncbase;
+	VectorCopy (ent->msg_origins[0], dst->msg_origin);
+	VectorCopy (ent->msg_angles[0], dst->msg_angles);
+
+	VectorCopy (ent->origin, dst->state.origin);
+	VectorCopy (ent->angles, dst->state.angles);
+	dst->state.modelindex = dst->model;
+	dst->state.frame = ent->frame;
+	dst->state.skin = ent->skinnum;
+	dst->state.alpha = ent->alpha;
+	dst->state.scale = ent->scale;
+	dst->state.effects = ent->effects;
+	dst->baseline = ent->baseline;
+}
+
+/*
+===============
+CL_UnpackDemoKeyframeEntity
+===============
+*/
+static qboolean CL_UnpackDemoKeyframeEntity (entity_t *dst, const demokeyentity_t *src)
+{
+	if (src->model < 0 || src->model >= MAX_MODELS || src->colormap < 0 || src->colormap > cl.maxclients)
+		return false;
+
+	memset (dst, 0, sizeof (*dst));
+	dst->baseline = src->baseline;
+	dst->msgtime = src->msgtime;
+	dst->syncbase = src->syncbase;
+	VectorCopy (src->msg_origin, dst->msg_origins[0]);
+	VectorCopy (src->msg_origin, dst->msg_origins[1]);
+	VectorCopy (src->msg_angles, dst->msg_angles[0]);
+	VectorCopy (src->msg_angles, dst->msg_angles[1]);
+	VectorCopy (src->state.origin, dst->origin);
+	VectorCopy (src->state.angles, dst->angles);
+	dst->model = cl.model_precache[src->model];
+	dst->frame = src->state.frame;
+	dst->skinnum = src->state.skin;
+	dst->alpha = src->state.alpha;
+	dst->scale = src->state.scale;
+	dst->effects = src->state.effects;
+	dst->colormap = src->colormap ? cl.scores[src->colormap - 1].translations : vid.colormap;
+	dst->forcelink = true;
+	dst->lerpflags = src->lerpflags | LERP_RESETANIM | LERP_RESETMOVE;
+	return true;
+}
+
+/*
+===============
+CL_CaptureDemoKeyframe
+===============
+*/
+static void CL_CaptureDemoKeyframe (qfileofs_t fileofs)
+{
+	static demokeystate_t	st;
+	demokeyframe_t			kf;
+	demokeyentity_t			rec;
+	demokeyscore_t			score;
+	entity_t				*ent;
+	int						i;
+
+	memset (&st, 0, sizeof (st));
+	memcpy (st.cl, &cl, sizeof (st.cl));
+	memset (st.cl + offsetof (client_state_t, statss), 0, sizeof (cl.statss));
+	st.viewentity = cl.viewentity;
+	st.maxclients = cl.maxclients;
+	st.num_entities = cl.num_entities;
+	st.num_statics = cl.num_statics;
+	st.first_static = q_min (demo_keyframes.first_static, cl.num_statics);
+	st.num_staticsounds = VEC_SIZE (demo_keyframes.staticsounds);
+	st.first_staticsound = q_min (demo_keyframes.first_staticsound, st.num_staticsounds);
+	st.cdtrack = cl.cdtrack;
+	st.looptrack = cl.looptrack;
+	st.zoom = cl.zoom;
+	st.zoomdir = cl.zoomdir;
+	st.forceunderwater = cl.forceunderwater;
+	st.cshift_empty = cshift_empty;
+	CL_PackDemoKeyframeEntity (&st.viewent, -1, &cl.viewent);
+	memcpy (st.lightstyles, cl_lightstyle, sizeof (st.lightstyles));
+
+	// entities dropped from the last message are unlinked anyway,
+	// the rest are reset to their baselines on restore
+	for (i = 0, ent = cl_entities; i < cl.num_entities; i++, ent++)
+		if (i == 0 || ent->model || ent->msgtime == cl.mtime[0])
+			st.num_records++;
+
+	kf.time = cl.mtime[0];
+	kf.fileofs = fileofs;
+	kf.segment = demo_keyframes.segment;
+	kf.dataofs = VEC_SIZE (demo_keyframes.data);
+
+	Vec_Append ((void**)&demo_keyframes.data, 1, &st, sizeof (st));
+
+	for (i = 0; i < cl.maxclients; i++)
+	{
+		memcpy (score.name, cl.scores[i].name, sizeof (score.name));
+		score.entertime = cl.scores[i].entertime;
+		score.frags = cl.scores[i].frags;
+		score.colors = cl.scores[i].colors;
+		Vec_Append ((void**)&demo_keyframes.data, 1, &score, sizeof (score));
+	}
+
+	for (i = 0, ent = cl_entities; i < cl.num_entities; i++, ent++)
+	{
+		if (i == 0 || ent->model || ent->msgtime == cl.mtime[0])
+		{
+			CL_PackDemoKeyframeEntity (&rec, i, ent);
+			Vec_Append ((void**)&demo_keyframes.data, 1, &rec, sizeof (rec));
+		}
+	}
+
+	for (i = st.first_static; i < cl.num_statics; i++)
+	{
+		CL_PackDemoKeyframeEntity (&rec, i, &cl_static_entities[i]);
+		Vec_Append ((void**)&demo_keyframes.data, 1, &rec, sizeof (rec));
+	}
+
+	Vec_Append ((void**)&demo_keyframes.data, 1, demo_keyframes.staticsounds + st.first_staticsound,
+		sizeof (demostaticsound_t) * (st.num_staticsounds - st.first_staticsound));
+
+	kf.datasize = VEC_SIZE (demo_keyframes.data) - kf.dataofs;
+	VEC_PUSH (demo_keyframes.frames, kf);
+}
+
+/*
+===============
+CL_UpdateDemoKeyframes
+
+Called before each demo message is read during forward playback
+===============
+*/
+static void CL_UpdateDemoKeyframes (qfileofs_t fileofs)
+{
+	size_t			count;
+	demokeyframe_t	*last;
+
+	if (cls.signon < SIGNONS)
+	{
+		if (demo_keyframes.insegment)
+		{
+			// a new map, its static sounds are on the way
+			demo_keyframes.insegment = false;
+			VEC_CLEAR (demo_keyframes.staticsounds);
+		}
+		return;
+	}
+
+	if (!demo_keyframes.insegment)
+	{
+		demo_keyframes.insegment = true;
+		demo_keyframes.segment++;
+		demo_keyframes.first_static = cl.num_statics;
+		demo_keyframes.first_staticsound = VEC_SIZE (demo_keyframes.staticsounds);
+	}
+
+	if (cl_demokeyframes.value <= 0.f || cls.timedemo)
+		return;
+
+	count = VEC_SIZE (demo_keyframes.frames);
+	if (count)
+	{
+		last = &demo_keyframes.frames[count - 1];
+		if (fileofs <= last->fileofs)
+			return;		// already indexed
+		if (last->segment == demo_keyframes.segment && cl.mtime[0] < last->time + cl_demokeyframes.value)
+			return;
+	}
+
+	CL_CaptureDemoKeyframe (fileofs);
+}
+
+/*
+===============
+CL_RestoreDemoKeyframe
+===============
+*/
+static qboolean CL_RestoreDemoKeyframe (const demokeyframe_t *kf)
+{
+	static demokeystate_t	st;
+	demokeyentity_t			rec;
+	demokeyscore_t			score;
+	entity_state_t			baseline;
+	char					*statss[MAX_CL_STATS];
+	float					last_received_message;
+	const byte				*data, *end;
+	int						i, numents;
+
+	data = demo_keyframes.data + kf->dataofs;
+	end = data + kf->datasize;
+	if (kf->datasize < (int) sizeof (st))
+		return false;
+	memcpy (&st, data, sizeof (st));
+	data += sizeof (st);
+
+	if (st.maxclients != cl.maxclients || st.num_entities < 0 || st.num_entities > cl_max_edicts ||
+		st.num_records < 0 || st.num_records > st.num_entities ||
+		st.first_static < 0 || st.first_static > st.num_statics || st.num_statics > MAX_STATIC_ENTITIES ||
+		st.first_static > cl.num_statics ||
+		st.first_staticsound < 0 || st.first_staticsound > st.num_staticsounds ||
+		st.first_staticsound > (int) VEC_SIZE (demo_keyframes.staticsounds) ||
+		end - data != (ptrdiff_t) (st.maxclients * sizeof (score) +
+			(st.num_records + st.num_statics - st.first_static) * sizeof (rec) +
+			(st.num_staticsounds - st.first_staticsound) * sizeof (demostaticsound_t)))
+		return false;
+
+	Sys_fseek (cls.demofile, kf->fileofs, SEEK_SET);
+
+	memcpy (statss, cl.statss, sizeof (statss));
+	last_received_message = cl.last_received_message;
+	memcpy (&cl, st.cl, sizeof (st.cl));
+	memcpy (cl.statss, statss, sizeof (statss));
+	cl.last_received_message = last_received_message;
+
+	cl.viewentity = st.viewentity;
+	cl.cdtrack = st.cdtrack;
+	cl.looptrack = st.looptrack;
+	cl.zoom = st.zoom;
+	cl.zoomdir = st.zoomdir;
+	cl.forceunderwater = st.forceunderwater;
+	cshift_empty = st.cshift_empty;
+	CL_UnpackDemoKeyframeEntity (&cl.viewent, &st.viewent);
+	memcpy (cl_lightstyle, st.lightstyles, sizeof (cl_lightstyle));
+
+	for (i = 0; i < cl.maxclients; i++)
+	{
+		memcpy (&score, data, sizeof (score));
+		data += sizeof (score);
+		memcpy (cl.scores[i].name, score.name, sizeof (score.name));
+		cl.scores[i].name[MAX_SCOREBOARDNAME - 1] = '\0';
+		cl.scores[i].entertime = score.entertime;
+		cl.scores[i].frags = score.frags;
+		if (cl.scores[i].colors != score.colors)
+		{
+			cl.scores[i].colors = score.colors;
+			CL_NewTranslation (i);
+		}
+	}
+
+	// everything not in the keyframe goes back to its baseline
+	numents = q_max (cl.num_entities, st.num_entities);
+	for (i = 0; i < numents; i++)
+	{
+		baseline = cl_entities[i].baseline;
+		memset (&cl_entities[i], 0, sizeof (cl_entities[i]));
+		cl_entities[i].baseline = baseline;
+	}
+	cl.num_entities = st.num_entities;
+	for (i = 0; i < st.num_records; i++)
+	{
+		memcpy (&rec, data, sizeof (rec));
+		data += sizeof (rec);
+		if (rec.index >= 0 && rec.index < st.num_entities)
+			CL_UnpackDemoKeyframeEntity (&cl_entities[rec.index], &rec);
+	}
+
+	R_RemoveStaticEfrags (st.first_static);
+	for (i = st.first_static; i < st.num_statics; i++)
+	{
+		memcpy (&rec, data, sizeof (rec));
+		data += sizeof (rec);
+		if (!CL_UnpackDemoKeyframeEntity (&cl_static_entities[i], &rec))
+			memset (&cl_static_entities[i], 0, sizeof (cl_static_entities[i]));
+	}
+	cl.num_statics = st.num_statics;
+	for (i = st.first_static; i < st.num_statics; i++)
+		R_AddEfrags (&cl_static_entities[i]);
+
+	if ((int) VEC_SIZE (demo_keyframes.staticsounds) > st.first_staticsound)
+		VEC_POP_N (demo_keyframes.staticsounds, VEC_SIZE (demo_keyframes.staticsounds) - st.first_staticsound);
+	for (i = st.first_staticsound; i < st.num_staticsounds; i++)
+	{
+		demostaticsound_t snd;
+		memcpy (&snd, data, sizeof (snd));
+		data += sizeof (snd);
+		VEC_PUSH (demo_keyframes.staticsounds, snd);
+	}
+
+	return true;
+}
+
+/*
+===============
+CL_FindDemoKeyframe
+
+Latest keyframe on the current map at or before time,
+or the first one on the map if they are all later
+===============
+*/
+static const demokeyframe_t *CL_FindDemoKeyframe (double time)
+{
+	const demokeyframe_t	*frames = demo_keyframes.frames;
+	int						count = VEC_SIZE (frames);
+	int						lo, hi, mid;
+
+	// keyframes are in file order, so each map is a contiguous run
+	lo = 0;
+	hi = count - 1;
+	while (lo <= hi)
+	{
+		mid = (lo + hi) / 2;
+		if (frames[mid].segment < demo_keyframes.segment ||
+			(frames[mid].segment == demo_keyframes.segment && frames[mid].time <= time))
+			lo = mid + 1;
+		else
+			hi = mid - 1;
+	}
+
+	if (lo > 0 && frames[lo - 1].segment == demo_keyframes.segment)
+		return &frames[lo - 1];
+	if (lo < count && frames[lo].segment == demo_keyframes.segment)
+		return &frames[lo];
+	return NULL;
+}
+
+/*
+===============
+CL_FinishDemoSeek
+===============
+*/
+static void CL_FinishDemoSeek (void)
+{
+	extern int		num_temp_entities;
+	extern vec3_t	v_punchangles[2];
+	int				i;
+
+	cl.time = cl.oldtime = cl.mtime[0];
+
+	VEC_CLEAR (demo_rewind.frames);
+	VEC_CLEAR (demo_rewind.frame_events);
+	VEC_CLEAR (demo_rewind.pending_sounds);
+	demo_rewind.backstop = false;
+
+	// drop the effects spawned along the way
+	memset (cl_dlights, 0, sizeof (cl_dlights));
+	memset (cl_temp_entities, 0, sizeof (cl_temp_entities));
+	memset (cl_beams, 0, sizeof (cl_beams));
+	num_temp_entities = 0;
+	R_ClearParticles ();
+	memset (v_punchangles, 0, sizeof (v_punchangles));
+
+	for (i = 0; i < cl.num_entities; i++)
+		cl_entities[i].lerpflags |= LERP_RESETANIM | LERP_RESETMOVE;
+
+	S_StopAllSounds (true);
+	for (i = 0; i < (int) VEC_SIZE (demo_keyframes.staticsounds); i++)
+	{
+		demostaticsound_t *snd = &demo_keyframes.staticsounds[i];
+		if (snd->sound > 0 && snd->sound < MAX_SOUNDS)
+			S_StaticSound (cl.sound_precache[snd->sound], snd->origin, snd->volume, snd->attenuation);
+	}
+}
+
+/*
+===============
+CL_DemoSeek
+
+Jumps to the given demo time on the current map
+===============
+*/
+static void CL_DemoSeek (double time)
+{
+	const demokeyframe_t	*kf;
+	float					demospeed;
+	double					start;
+	int						messages;
+
+	start = Sys_DoubleTime ();
+
+	kf = CL_FindDemoKeyframe (time);
+	if (kf && (time < cl.mtime[0] || kf->time > cl.mtime[0]))
+	{
+		if (!CL_RestoreDemoKeyframe (kf))
+		{
+			Con_Printf ("Bad demo keyframe, dropping the index\n");
+			VEC_CLEAR (demo_keyframes.frames);
+			VEC_CLEAR (demo_keyframes.data);
+			return;
+		}
+	}
+	else if (time < cl.mtime[0])
+	{
+		Con_Printf ("No demo keyframe to seek back to\n");
+		return;
+	}
+
+	// read ahead without rendering, indexing as we go
+	demospeed = cls.demospeed;
+	cls.demospeed = 1.f;
+	demo_rewind.backstop = false;
+	demo_seeking = true;
+	for (messages = 0; cls.signon == SIGNONS && cl.mtime[0] < time; messages++)
+	{
+		if (!CL_GetDemoMessage ())
+			break;
+		cl.last_received_message = realtime;
+		CL_ParseServerMessage ();
+		if (!cls.demoplayback)
+			break;
+	}
+	demo_seeking = false;
+
+	if (!cls.demoplayback)
+		return;		// ran off the end
+
+	cls.demospeed = demospeed;
+	CL_FinishDemoSeek ();
+
+	Con_DPrintf ("demoseek: %.1f (keyframe %.1f, %i messages) in %.1f ms\n",
+		cl.mtime[0], kf ? kf->time : -1.0, messages, (Sys_DoubleTime () - start) * 1000.0);
+}
+
+/*
+====================
+CL_DemoSeek_f
+
+demoseek <seconds|m:ss|+seconds|-seconds>
+====================
+*/
+void CL_DemoSeek_f (void)
+{
+	const char	*arg, *colon;
+	double		time;
+
+	if (cmd_source != src_command)
+		return;
+
+	if (Cmd_Argc () != 2)
+	{
+		Con_Printf ("demoseek <time> : jump to a map time in the demo (seconds or m:ss, +/- for relative)\n");
+		return;
+	}
+
+	if (!cls.demoplayback || cls.timedemo || cls.signon != SIGNONS)
+	{
+		Con_Printf ("Not playing back a demo\n");
+		return;
+	}
+
+	arg = Cmd_Argv (1);
+	colon = strchr (arg, ':');
+	time = colon ? Q_atoi (arg + (*arg == '+' || *arg == '-')) * 60.0 + Q_atof (colon + 1) : fabs (Q_atof (arg));
+	if (*arg == '+')
+		time = cl.mtime[0] + time;
+	else if (*arg == '-')
+		time = cl.mtime[0] - time;
+
+	CL_DemoSeek (q_max (time, 0.0));
+}
+
+/*
+===============
+CL_HashDemoStart
+===============
+*/
+static unsigned CL_HashDemoStart (void)
+{
+	byte		*buf;
+	size_t		len;
+	qfileofs_t	ofs;
+	unsigned	hash;
+
+	buf = (byte *) malloc (DEMOKEY_HASHBYTES);
+	if (!buf)
+		return 0;
+	ofs = Sys_ftell (cls.demofile);
+	len = fread (buf, 1, q_min (DEMOKEY_HASHBYTES, cls.demofilesize), cls.demofile);
+	Sys_fseek (cls.demofile, ofs, SEEK_SET);
+	hash = COM_HashBlock (buf, len);
+	free (buf);
+
+	return hash;
+}
+
+/*
+===============
+CL_DemoKeyframeCachePath
+===============
+*/
+static void CL_DemoKeyframeCachePath (char *relname, size_t relsize, char *path, size_t pathsize)
+{
+	char base[MAX_OSPATH];
+
+	COM_StripExtension (cls.demofilename, base, sizeof (base));
+	q_snprintf (relname, relsize, "%s.dki", base);
+	q_snprintf (path, pathsize, "%s/%s", com_gamedir, relname);
+}
+
+/*
+===============
+CL_InitDemoKeyframes
+
+Called when playback starts, reads the cached index if there is one
+===============
+*/
+static void CL_InitDemoKeyframes (void)
+{
+	char			relname[MAX_OSPATH], path[MAX_OSPATH];
+	demokeyheader_t	header;
+	FILE			*f;
+	int				i;
+
+	VEC_CLEAR (demo_keyframes.frames);
+	VEC_CLEAR (demo_keyframes.data);
+	VEC_CLEAR (demo_keyframes.staticsounds);
+	demo_keyframes.numloaded = 0;
+	demo_keyframes.segment = 0;
+	demo_keyframes.insegment = false;
+	demo_keyframes.demohash = 0;
+
+	if (!cl_demokeyframecache.value)
+		return;
+
+	demo_keyframes.demohash = CL_HashDemoStart ();
+
+	CL_DemoKeyframeCachePath (relname, sizeof (relname), path, sizeof (path));
+	f = Sys_fopen (path, "rb");
+	if (!f)
+		return;
+
+	if (fread (&header, sizeof (header), 1, f) != 1 ||
+		header.ident != DEMOKEY_IDENT || header.version != DEMOKEY_VERSION ||
+		header.framesize != sizeof (demokeyframe_t) || header.statesize != sizeof (demokeystate_t) ||
+		header.entitysize != sizeof (demokeyentity_t) ||
+		header.demosize != cls.demofilesize || header.demohash != demo_keyframes.demohash ||
+		header.numframes <= 0 || header.datasize <= 0)
+	{
+		fclose (f);
+		return;
+	}
+
+	Vec_Grow ((void**)&demo_keyframes.frames, sizeof (demokeyframe_t), header.numframes);
+	Vec_Grow ((void**)&demo_keyframes.data, 1, header.datasize);
+	if (fread (demo_keyframes.frames, sizeof (demokeyframe_t), header.numframes, f) != (size_t) header.numframes ||
+		fread (demo_keyframes.data, 1, header.datasize, f) != (size_t) header.datasize)
+	{
+		fclose (f);
+		return;
+	}
+	fclose (f);
+
+	for (i = 0; i < header.numframes; i++)
+	{
+		const demokeyframe_t *kf = &demo_keyframes.frames[i];
+		int num_entities;
+		if (kf->dataofs < 0 || kf->datasize < (int) sizeof (demokeystate_t) || kf->dataofs > header.datasize - kf->datasize ||
+			(i > 0 && kf->fileofs <= kf[-1].fileofs))
+			return;
+		memcpy (&num_entities, demo_keyframes.data + kf->dataofs + offsetof (demokeystate_t, num_entities), sizeof (num_entities));
+		if (num_entities < 0 || num_entities > cl_max_edicts)
+			return;
+	}
+
+	VEC_HEADER (demo_keyframes.frames).size = header.numframes;
+	VEC_HEADER (demo_keyframes.data).size = header.datasize;
+	demo_keyframes.numloaded = header.numframes;
+	Con_DPrintf ("Loaded %i demo keyframes from %s\n", header.numframes, relname);
+}
+
+/*
+===============
+CL_ShutdownDemoKeyframes
+
+Called when playback stops, saves the index if it grew
+===============
+*/
+static void CL_ShutdownDemoKeyframes (void)
+{
+	char			relname[MAX_OSPATH], path[MAX_OSPATH];
+	demokeyheader_t	header;
+	FILE			*f;
+
+	if (cl_demokeyframecache.value && (int) VEC_SIZE (demo_keyframes.frames) > demo_keyframes.numloaded)
+	{
+		memset (&header, 0, sizeof (header));
+		header.ident = DEMOKEY_IDENT;
+		header.version = DEMOKEY_VERSION;
+		header.framesize = sizeof (demokeyframe_t);
+		header.statesize = sizeof (demokeystate_t);
+		header.entitysize = sizeof (demokeyentity_t);
+		header.demosize = cls.demofilesize;
+		header.demohash = demo_keyframes.demohash;
+		header.numframes = VEC_SIZE (demo_keyframes.frames);
+		header.datasize = VEC_SIZE (demo_keyframes.data);
+
+		CL_DemoKeyframeCachePath (relname, sizeof (relname), path, sizeof (path));
+		COM_CreatePath (path);
+		f = Sys_fopen (path, "wb");
+		if (!f)
+			Con_Printf ("ERROR: couldn't open file %s.\n", relname);
+		else
+		{
+			fwrite (&header, sizeof (header), 1, f);
+			fwrite (demo_keyframes.frames, sizeof (demokeyframe_t), header.numframes, f);
+			fwrite (demo_keyframes.data, 1, header.datasize, f);
+			fclose (f);
+			Con_DPrintf ("Wrote %i demo keyframes to %s\n", header.numframes, relname);
+		}
+	}
+
+	VEC_FREE (demo_keyframes.frames);
+	VEC_FREE (demo_keyframes.data);
+	VEC_FREE (demo_keyframes.staticsounds);
+	demo_keyframes.numloaded = 0;
+}
+
+/*
+==============================================================================
+
+TIMEDEMO REPORT
+
+Every frame of a timedemo is timed, along with the host_speeds phases and
+the r_speeds counters. When the demo ends a summary is printed and, with
+cl_timedemoreport, the frames are written to <demo>_timedemo.csv and the
+summary to <demo>_timedemo.json in the game directory.
+
+The benchmark command times a running map the same way for a number of
+seconds and writes <map>_benchmark.csv/json. Headless runs quit once the
+report is written.
+
+==============================================================================
+*/
+
+cvar_t	cl_timedemoreport = {"cl_timedemoreport", "1", CVAR_ARCHIVE};
+
+typedef struct
+{
+	float	total, server, gfx, snd;	// milliseconds
+	int		brushpolys, aliaspolys, skypolys, dynamiclightmaps;
+} tdframe_t;
+
+typedef struct
+{
+	float	min, avg, p50, p95, p99, max;
+} tdstats_t;
+
+static	tdframe_t	*td_frames;		// VEC
+static	double		td_lastframetime;
+
+#define TD_WORST_FRAMES	5
+
+/*
+====================
+CL_TimeDemoFrame
+
+Called at the end of each host frame with the host_speeds phase times
+====================
+*/
+void CL_TimeDemoFrame (double server, double gfx, double snd)
+{
+	tdframe_t	frame;
+	double		now;
+
+	if (!cls.timedemo && !cls.benchmark)
+		return;
+
+	now = Sys_DoubleTime ();
+	if (cls.benchmark)
+	{
+		if (cls.signon != SIGNONS)
+		{
+			cls.td_startframe = -1;	// start over once the map is in
+			td_lastframetime = now;
+			return;
+		}
+		if (cls.td_startframe < 0)
+			cls.td_startframe = host_framecount;
+		if (host_framecount == cls.td_startframe + 1)
+			cls.td_starttime = realtime;
+	}
+	if (host_framecount <= cls.td_startframe + 1)
+	{
+		td_lastframetime = now;	// the loading frames don't count
+		return;
+	}
+
+	frame.total = (now - td_lastframetime) * 1000.0;
+	frame.server = server * 1000.0;
+	frame.gfx = gfx * 1000.0;
+	frame.snd = snd * 1000.0;
+	frame.brushpolys = rs_brushpolys;
+	frame.aliaspolys = rs_aliaspolys;
+	frame.skypolys = rs_skypolys;
+	frame.dynamiclightmaps = rs_dynamiclightmaps;
+	VEC_PUSH (td_frames, frame);
+
+	td_lastframetime = now;
+
+	if (cls.benchmark && realtime - cls.td_starttime >= cls.td_benchtime)
+		CL_FinishBenchmark ();
+}
+
+/*
+====================
+CL_TimeDemoCompareFloats
+====================
+*/
+static int CL_TimeDemoCompareFloats (const void *a, const void *b)
+{
+	float fa = *(const float *) a;
+	float fb = *(const float *) b;
+	return (fa > fb) - (fa < fb);
+}
+
+/*
+====================
+CL_TimeDemoPercentile
+
+Nearest rank on a sorted list
+====================
+*/
+static float CL_TimeDemoPercentile (const float *sorted, int count, float percent)
+{
+	int rank = (int) ceil (percent / 100.f * count) - 1;
+	return sorted[CLAMP (0, rank, count - 1)];
+}
+
+/*
+====================
+CL_TimeDemoStats
+
+Stats of the float at ofs in each frame, scratch has room for every frame
+====================
+*/
+static void CL_TimeDemoStats (size_t ofs, float *scratch, tdstats_t *stats)
+{
+	int		i, count = VEC_SIZE (td_frames);
+	double	sum = 0.0;
+
+	for (i = 0; i < count; i++)
+	{
+		scratch[i] = *(const float *) ((const byte *) &td_frames[i] + ofs);
+		sum += scratch[i];
+	}
+	qsort (scratch, count, sizeof (scratch[0]), CL_TimeDemoCompareFloats);
+
+	stats->min = scratch[0];
+	stats->avg = sum / count;
+	stats->p50 = CL_TimeDemoPercentile (scratch, count, 50.f);
+	stats->p95 = CL_TimeDemoPercentile (scratch, count, 95.f);
+	stats->p99 = CL_TimeDemoPercentile (scratch, count, 99.f);
+	stats->max = scratch[count - 1];
+}
+
+/*
+====================
+CL_TimeDemoWriteStats
+====================
+*/
+static void CL_TimeDemoWriteStats (FILE *f, const char *name, const tdstats_t *stats, qboolean last)
+{
+	fprintf (f, "\t\t\"%s\": {\"min\": %.3f, \"avg\": %.3f, \"p50\": %.3f, \"p95\": %.3f, \"p99\": %.3f, \"max\": %.3f}%s\n",
+		name, stats->min, stats->avg, stats->p50, stats->p95, stats->p99, stats->max, last ? "" : ",");
+}
+
+/*
+====================
+CL_TimeDemoWriteJSONString
+
+Paths are already UTF-8, only quotes, backslashes and control characters need escaping
+====================
+*/
+static void CL_TimeDemoWriteJSONString (FILE *f, const char *str)
+{
+	fputc ('"', f);
+	for (; *str; str++)
+	{
+		byte c = (byte) *str;
+		if (c == '"' || c == '\\')
+			fprintf (f, "\\%c", c);
+		else if (c < 0x20 || c == 0x7f)
+			fprintf (f, "\\u%04x", c);
+		else
+			fputc (c, f);
+	}
+	fputc ('"', f);
+}
+
+/*
+====================
+CL_TimeDemoReport
+
+Writes <stem>.csv and <stem>.json, source is the demo or map that was timed
+====================
+*/
+static void CL_TimeDemoReport (const char *kind, const char *source, const char *stem, int frames, float time)
+{
+	static const struct
+	{
+		const char	*name;
+		size_t		ofs;
+	} phases[] =
+	{
+		{"frame",	offsetof (tdframe_t, total)},
+		{"server",	offsetof (tdframe_t, server)},
+		{"gfx",		offsetof (tdframe_t, gfx)},
+		{"snd",		offsetof (tdframe_t, snd)},
+	};
+	tdstats_t	stats[countof (phases)];
+	int			worst[TD_WORST_FRAMES];
+	int			i, j, k, count, numworst, stutters, severe;
+	double		sums[4];
+	int			maxs[4];
+	float		*scratch;
+	char		relname[MAX_OSPATH], path[MAX_OSPATH];
+	FILE		*f;
+
+	count = VEC_SIZE (td_frames);
+	if (!count)
+		return;
+
+	scratch = (float *) malloc (sizeof (*scratch) * count);
+	if (!scratch)
+		Sys_Error ("CL_TimeDemoReport: out of memory (%d frames)", count);
+	for (i = 0; i < (int) countof (phases); i++)
+		CL_TimeDemoStats (phases[i].ofs, scratch, &stats[i]);
+	free (scratch);
+
+// hitches are frames well above the median
+	stutters = severe = 0;
+	numworst = 0;
+	memset (sums, 0, sizeof (sums));
+	memset (maxs, 0, sizeof (maxs));
+	for (i = 0; i < count; i++)
+	{
+		const tdframe_t *fr = &td_frames[i];
+		if (fr->total > 2.f * stats[0].p50)
+			stutters++;
+		if (fr->total > 4.f * stats[0].p50)
+			severe++;
+
+		for (j = 0; j < numworst && td_frames[worst[j]].total >= fr->total; j++)
+			;
+		if (j < TD_WORST_FRAMES)
+		{
+			numworst = q_min (numworst + 1, TD_WORST_FRAMES);
+			for (k = numworst - 1; k > j; k--)
+				worst[k] = worst[k - 1];
+			worst[j] = i;
+		}
+
+		sums[0] += fr->brushpolys;			maxs[0] = q_max (maxs[0], fr->brushpolys);
+		sums[1] += fr->aliaspolys;			maxs[1] = q_max (maxs[1], fr->aliaspolys);
+		sums[2] += fr->skypolys;			maxs[2] = q_max (maxs[2], fr->skypolys);
+		sums[3] += fr->dynamiclightmaps;	maxs[3] = q_max (maxs[3], fr->dynamiclightmaps);
+	}
+
+	Con_Printf ("frame ms: min %.2f avg %.2f p50 %.2f p95 %.2f p99 %.2f max %.2f\n",
+		stats[0].min, stats[0].avg, stats[0].p50, stats[0].p95, stats[0].p99, stats[0].max);
+	Con_Printf ("%i stutters (> 2x median), %i severe (> 4x median)\n", stutters, severe);
+	for (i = 1; i < (int) countof (phases); i++)
+		Con_Printf ("%-6s ms: avg %.2f p95 %.2f p99 %.2f max %.2f\n",
+			phases[i].name, stats[i].avg, stats[i].p95, stats[i].p99, stats[i].max);
+
+	if (!cl_timedemoreport.value)
+		return;
+
+	q_snprintf (relname, sizeof (relname), "%s.csv", stem);
+	q_snprintf (path, sizeof (path), "%s/%s", com_gamedir, relname);
+	COM_CreatePath (path);
+	f = Sys_fopen (path, "w");
+	if (!f)
+		Con_Printf ("ERROR: couldn't open file %s.\n", relname);
+	else
+	{
+		fprintf (f, "frame,ms,server_ms,gfx_ms,snd_ms,wpoly,epoly,skypoly,lmap\n");
+		for (i = 0; i < count; i++)
+		{
+			const tdframe_t *fr = &td_frames[i];
+			fprintf (f, "%i,%.3f,%.3f,%.3f,%.3f,%i,%i,%i,%i\n", i, fr->total, fr->server, fr->gfx, fr->snd,
+				fr->brushpolys, fr->aliaspolys, fr->skypolys, fr->dynamiclightmaps);
+		}
+		fclose (f);
+		Con_Printf ("Wrote %s\n", relname);
+	}
+
+	q_snprintf (relname, sizeof (relname), "%s.json", stem);
+	q_snprintf (path, sizeof (path), "%s/%s", com_gamedir, relname);
+	f = Sys_fopen (path, "w");
+	if (!f)
+	{
+		Con_Printf ("ERROR: couldn't open file %s.\n", relname);
+		return;
+	}
+	fprintf (f, "{\n");
+	fprintf (f, "\t\"%s\": ", kind);
+	CL_TimeDemoWriteJSONString (f, source);
+	fprintf (f, ",\n");
+	fprintf (f, "\t\"frames\": %i,\n", frames);
+	fprintf (f, "\t\"seconds\": %.3f,\n", time);
+	fprintf (f, "\t\"fps\": %.3f,\n", frames / time);
+	fprintf (f, "\t\"stutters\": %i,\n", stutters);
+	fprintf (f, "\t\"severe_stutters\": %i,\n", severe);
+	fprintf (f, "\t\"worst_frames\": [");
+	for (i = 0; i < numworst; i++)
+		fprintf (f, "%s{\"frame\": %i, \"ms\": %.3f}", i ? ", " : "", worst[i], td_frames[worst[i]].total);
+	fprintf (f, "],\n");
+	fprintf (f, "\t\"ms\": {\n");
+	for (i = 0; i < (int) countof (phases); i++)
+		CL_TimeDemoWriteStats (f, phases[i].name, &stats[i], i + 1 == (int) countof (phases));
+	fprintf (f, "\t},\n");
+	fprintf (f, "\t\"r_speeds\": {\n");
+	fprintf (f, "\t\t\"wpoly\": {\"avg\": %.1f, \"max\": %i},\n", sums[0] / count, maxs[0]);
+	fprintf (f, "\t\t\"epoly\": {\"avg\": %.1f, \"max\": %i},\n", sums[1] / count, maxs[1]);
+	fprintf (f, "\t\t\"skypoly\": {\"avg\": %.1f, \"max\": %i},\n", sums[2] / count, maxs[2]);
+	fprintf (f, "\t\t\"lmap\": {\"avg\": %.1f, \"max\": %i}\n", sums[3] / count, maxs[3]);
+	fprintf (f, "\t}\n");
+	fprintf (f, "}\n");
+	fclose (f);
+	Con_Printf ("Wrote %s\n", relname);
+}
+
+/*
+====================
+CL_QuitHeadless
+
+quit only skips the confirmation menu from the console
+====================
+*/
+static void CL_QuitHeadless (void)
+{
+	key_dest = key_console;
+	Cbuf_AddText ("quit\n");
+}
+
 /*
 ====================
 CL_FinishTimeDemo
@@ -827,6 +1954,7 @@ static void CL_FinishTimeDemo (void)
 {
 	int	frames;
 	float	time;
+	char	stem[MAX_OSPATH];
 
 	cls.timedemo = false;
 
@@ -836,6 +1964,14 @@ static void CL_FinishTimeDemo (void)
 	if (!time)
 		time = 1;
 	Con_Printf ("%i frames %5.1f seconds %5.1f fps\n", frames, time, frames/time);
+
+	COM_StripExtension (cls.demofilename, stem, sizeof (stem));
+	q_strlcat (stem, "_timedemo", sizeof (stem));
+	CL_TimeDemoReport ("demo", cls.demofilename, stem, frames, time);
+	VEC_CLEAR (td_frames);
+
+	if (isHeadless)
+		CL_QuitHeadless ();
 }
 
 /*
@@ -858,13 +1994,148 @@ void CL_TimeDemo_f (void)
 
 	CL_PlayDemo_f ();
 	if (!cls.demofile)
+	{
+		if (isHeadless)	// nothing else will end the run
+			Sys_Error ("timedemo: couldn't play %s", Cmd_Argv (1));
 		return;
+	}
 
 // cls.td_starttime will be grabbed at the second frame of the demo, so
 // all the loading time doesn't get counted
 
 	cls.timedemo = true;
+	VEC_CLEAR (td_frames);
 	cls.td_startframe = host_framecount;
 	cls.td_lastframe = -1;	// get a new message this frame
 }
 
+/*
+====================
+CL_FinishBenchmark
+====================
+*/
+static void CL_FinishBenchmark (void)
+{
+	int	frames;
+	float	time;
+	char	stem[MAX_OSPATH];
+
+	cls.benchmark = false;
+
+	frames = VEC_SIZE (td_frames);
+	time = realtime - cls.td_starttime;
+	if (!time)
+		time = 1;
+	Con_Printf ("%s: %i frames %5.1f seconds %5.1f fps\n", cl.mapname, frames, time, frames/time);
+
+	q_snprintf (stem, sizeof (stem), "%s_benchmark", cl.mapname);
+	CL_TimeDemoReport ("map", cl.mapname, stem, frames, time);
+	VEC_CLEAR (td_frames);
+
+	if (isHeadless)
+		CL_QuitHeadless ();
+}
+
+/*
+====================
+CL_Benchmark_f
+
+benchmark <seconds>
+====================
+*/
+void CL_Benchmark_f (void)
+{
+	float	seconds;
+
+	if (cmd_source != src_command)
+		return;
+
+	if (Cmd_Argc() != 2)
+	{
+		Con_Printf ("benchmark <seconds> : gets map speeds, starts when the map is in\n");
+		return;
+	}
+
+	seconds = Q_atof (Cmd_Argv (1));
+	if (seconds <= 0.f)
+	{
+		cls.benchmark = false;
+		VEC_CLEAR (td_frames);
+		return;
+	}
+
+	cls.benchmark = true;
+	cls.td_benchtime = seconds;
+	cls.td_startframe = -1;
+	VEC_CLEAR (td_frames);
+}
+
+/*
+==============================================================================
+
+DEMO RENDERING
+
+==============================================================================
+*/
+
+/*
+====================
+CL_FinishDemoRender
+====================
+*/
+static void CL_FinishDemoRender (void)
+{
+	cls.demorender = false;
+	SCR_EndDemoRender ();
+}
+
+/*
+====================
+CL_DemoRender_f
+
+demorender <demoname> [fps]
+====================
+*/
+void CL_DemoRender_f (void)
+{
+	char	name[MAX_OSPATH];
+	float	fps;
+
+	if (cmd_source != src_command)
+		return;
+
+	if (Cmd_Argc() < 2 || Cmd_Argc() > 3)
+	{
+		Con_Printf ("demorender <demoname> [fps] : renders a demo to video frames at a fixed frame rate\n");
+		return;
+	}
+
+	if (isHeadless)
+	{
+		Con_Printf ("demorender: nothing is rendered in headless mode\n");
+		return;
+	}
+
+	fps = Cmd_Argc() >= 3 ? Q_atof (Cmd_Argv (2)) : 60.f;
+	if (fps < 1.f || fps > 1000.f)
+	{
+		Con_Printf ("demorender: fps must be between 1 and 1000\n");
+		return;
+	}
+
+	CL_PlayDemo_f ();
+	if (!cls.demofile)
+		return;
+
+	cls.demoloop = false;	// the fps argument isn't a loop flag
+
+	COM_StripExtension (COM_SkipPath (cls.demofilename), name, sizeof (name));
+	if (!SCR_BeginDemoRender (name, fps))
+	{
+		CL_StopPlayback ();
+		return;
+	}
+
+	cls.demorender = true;
+	cls.dr_frametime = 1.0 / fps;
+}
@@ -1020,6 +1020,9 @@ void CL_Init (void)
 	Cvar_RegisterVariable (&cl_mwheelpitch);
 
 	Cvar_RegisterVariable (&cl_startdemos);
+	Cvar_RegisterVariable (&cl_timedemoreport);
+	Cvar_RegisterVariable (&cl_demokeyframes);
+	Cvar_RegisterVariable (&cl_demokeyframecache);
 	Cvar_RegisterVariable (&cl_confirmquit);
 
 	Cmd_AddCommand ("entities", CL_PrintEntities_f);
@@ -1028,6 +1031,9 @@ void CL_Init (void)
 	Cmd_AddCommand ("stop", CL_Stop_f);
 	Cmd_AddCommand ("playdemo", CL_PlayDemo_f);
 	Cmd_AddCommand ("timedemo", CL_TimeDemo_f);
+	Cmd_AddCommand ("benchmark", CL_Benchmark_f);
+	Cmd_AddCommand ("demorender", CL_DemoRender_f);
+	Cmd_AddCommand ("demoseek", CL_DemoSeek_f);
 
 	Cmd_AddCommand ("tracepos", CL_Tracepos_f); //johnfitz
 	cmd = Cmd_AddCommand ("viewpos", CL_Viewpos_f); //johnfitz
@@ -193,6 +193,9 @@ void CL_ParseStartSoundPacket(void)
 	for (i = 0; i < 3; i++)
 		pos[i] = MSG_ReadCoord (cl.protocolflags);
 
+	if (CL_DemoSeeking ())
+		return;
+
 	S_StartSound (ent, channel, cl.sound_precache[sound_num], pos, volume/255.0, attenuation);
 }
 
@@ -209,6 +212,8 @@ void CL_ParseLocalSound(void)
 	sound_num = (field_mask&SND_LARGESOUND) ? MSG_ReadShort() : MSG_ReadByte();
 	if (sound_num >= MAX_SOUNDS)
 		Host_Error ("CL_ParseLocalSound: %i > MAX_SOUNDS", sound_num);
+	if (CL_DemoSeeking ())
+		return;
 
 	S_LocalSound (cl.sound_precache[sound_num]->name);
 }
@@ -420,6 +425,7 @@ void CL_ParseServerInfo (void)
 
 // local state
 	cl_entities[0].model = cl.worldmodel = cl.model_precache[1];
+	StrIndex_PrintStats ("client precache");
 
 	R_NewMap ();
 
@@ -982,6 +988,7 @@ void CL_ParseStaticSound (int version) //johnfitz -- added argument
 	vol = MSG_ReadByte ();
 	atten = MSG_ReadByte ();
 
+	CL_AddDemoStaticSound (sound_num, org, vol, atten);
 	S_StaticSound (cl.sound_precache[sound_num], org, vol, atten);
 }
 
@@ -1165,7 +1172,9 @@ void CL_ParseServerMessage (void)
 			break;
 
 		case svc_stufftext:
-			CL_ParseStuffText (MSG_ReadString ());
+			str = MSG_ReadString ();
+			if (!CL_DemoSeeking ())	// don't replay commands skipped over
+				CL_ParseStuffText (str);
 			break;
 
 		case svc_damage:
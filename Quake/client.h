@@ -140,6 +140,10 @@ typedef struct
 	int		td_lastframe;		// to meter out one message a frame
 	int		td_startframe;		// host_framecount at start
 	float		td_starttime;		// realtime at second frame of timedemo
+	qboolean	benchmark;			// timing a map instead of a demo
+	float		td_benchtime;		// seconds to run the benchmark for
+	qboolean	demorender;			// rendering a demo to video frames
+	double		dr_frametime;		// fixed timestep while rendering
 
 // connection information
 	int		signon;			// 0 to SIGNONS
@@ -299,6 +303,9 @@ extern	cvar_t	m_forward;
 extern	cvar_t	m_side;
 
 extern	cvar_t	cl_startdemos;
+extern	cvar_t	cl_timedemoreport;
+extern	cvar_t	cl_demokeyframes;
+extern	cvar_t	cl_demokeyframecache;
 extern	cvar_t	cl_confirmquit;
 
 
@@ -371,14 +378,20 @@ void CL_ClearState (void);
 void CL_StopPlayback (void);
 int CL_GetMessage (void);
 void CL_ClearSignons (void);
+qboolean CL_DemoSeeking (void);
 void CL_AdvanceTime (void);
 void CL_FinishDemoFrame (void);
 void CL_AddDemoRewindSound (int entnum, int channel, sfx_t *sfx, vec3_t pos, int vol, float atten);
+void CL_AddDemoStaticSound (int sound_num, vec3_t origin, int vol, int atten);
 
 void CL_Stop_f (void);
 void CL_Record_f (void);
 void CL_PlayDemo_f (void);
 void CL_TimeDemo_f (void);
+void CL_Benchmark_f (void);
+void CL_DemoRender_f (void);
+void CL_DemoSeek_f (void);
+void CL_TimeDemoFrame (double server, double gfx, double snd);
 
 //
 // cl_parse.c
@@ -298,6 +298,9 @@ void Cmd_Exec_f (void)
 	mark = Hunk_LowMark ();
 	path = Cmd_Argv (1);
 
+	// pick up configs written since the last lookup
+	COM_InvalidateFileCache ();
+
 	// HACK:
 	// "exec config.cfg" will execute ironwail.cfg
 	// "exec config.cfg pls" will execute config.cfg
@@ -215,6 +215,83 @@ void MultiString_Append (char **pvec, const char *str)
 	Vec_Append ((void **)pvec, 1, str, strlen (str) + 1);
 }
 
+/*
+============================================================================
+
+					STRING INDEX
+
+============================================================================
+*/
+
+strindexstats_t strindex_stats;
+
+void StrIndex_Init (strindex_t *index, int capacity)
+{
+	for (index->size = 16; index->size < capacity * 2; index->size <<= 1) // at most 50% load
+		;
+	index->keys = (const char **) calloc (index->size, sizeof (*index->keys));
+	index->values = (int *) calloc (index->size, sizeof (*index->values));
+	if (!index->keys || !index->values)
+		Sys_Error ("StrIndex_Init: out of memory");
+	index->count = 0;
+}
+
+void StrIndex_Clear (strindex_t *index)
+{
+	if (!index->count)
+		return;
+	memset (index->keys, 0, sizeof (*index->keys) * index->size);
+	index->count = 0;
+}
+
+int StrIndex_Find (strindex_t *index, const char *key)
+{
+	unsigned	pos, mask = index->size - 1;
+	const char	*k;
+
+	strindex_stats.lookups++;
+	for (pos = COM_HashString (key) & mask; (k = index->keys[pos]) != NULL; pos = (pos + 1) & mask)
+	{
+		strindex_stats.compares++;
+		if (!strcmp (k, key))
+		{
+			// values are registry positions, so a scan would have stopped here
+			strindex_stats.linear += index->values[pos] + 1;
+			return index->values[pos];
+		}
+	}
+	strindex_stats.linear += index->count;
+	return -1;
+}
+
+void StrIndex_Add (strindex_t *index, const char *key, int value)
+{
+	unsigned pos, mask = index->size - 1;
+
+	if (index->count * 2 >= index->size)
+		Sys_Error ("StrIndex_Add: index full");
+	for (pos = COM_HashString (key) & mask; index->keys[pos]; pos = (pos + 1) & mask)
+		;
+	index->keys[pos] = key;
+	index->values[pos] = value;
+	index->count++;
+}
+
+/*
+================
+StrIndex_PrintStats
+
+Reports and resets the lookup counters, e.g. after a map load
+================
+*/
+void StrIndex_PrintStats (const char *label)
+{
+	if (strindex_stats.lookups)
+		Con_DPrintf ("%s: %d name lookups, %d string compares (%d with a linear search)\n",
+			label, strindex_stats.lookups, strindex_stats.compares, strindex_stats.linear);
+	memset (&strindex_stats, 0, sizeof (strindex_stats));
+}
+
 /*
 ============================================================================
 
@@ -1436,13 +1513,12 @@ being registered.
 */
 static void COM_CheckRegistered (void)
 {
-	int		h;
+	fileview_t	view;
 	unsigned short	check[128];
 	int		i;
 
-	COM_OpenFile("gfx/pop.lmp", &h, NULL);
-
-	if (h == -1)
+	// a view also works for compressed entries, which have no handle
+	if (!COM_OpenFileView ("gfx/pop.lmp", &view, NULL))
 	{
 		Cvar_SetROM ("registered", "0");
 		Con_Printf ("Playing shareware version.\n");
@@ -1455,9 +1531,11 @@ static void COM_CheckRegistered (void)
 		return;
 	}
 
-	i = Sys_FileRead (h, check, sizeof(check));
-	COM_CloseFile (h);
-	if (i != (int) sizeof(check))
+	i = view.size;
+	if (i >= (int) sizeof(check))
+		memcpy (check, view.data, sizeof(check));
+	COM_CloseFileView (&view);
+	if (i < (int) sizeof(check))
 		goto corrupt;
 
 	for (i = 0; i < 128; i++)
@@ -1633,6 +1711,7 @@ int		com_numbasedirs;
 char	com_nightdivedir[MAX_OSPATH];
 char	com_userprefdir[MAX_OSPATH];
 THREAD_LOCAL int	file_from_pak;		// ZOID: global indicating that file came from a pak
+static qboolean	com_mappaks;		// map pak files into memory instead of reading them (-mmap)
 
 searchpath_t	*com_searchpaths;
 searchpath_t	*com_base_searchpaths;
@@ -1651,7 +1730,7 @@ static void COM_Path_f (void)
 	{
 		if (s->pack)
 		{
-			Con_Printf ("%s (%i files)\n", s->pack->filename, s->pack->numfiles);
+			Con_Printf ("%s (%i files%s)\n", s->pack->filename, s->pack->numfiles, s->pack->mapping ? ", mapped" : "");
 		}
 		else
 			Con_Printf ("%s\n", s->filename);
@@ -1682,6 +1761,8 @@ void COM_WriteFile (const char *filename, const void *data, int len)
 	Sys_Printf ("COM_WriteFile: %s\n", name);
 	Sys_FileWrite (handle, data, len);
 	Sys_FileClose (handle);
+
+	COM_InvalidateFileCache ();
 }
 
 /*
@@ -1817,217 +1898,1127 @@ qfileofs_t COM_filelength (FILE *f)
 }
 
 /*
-===========
-COM_FindFile
+=============================================================================
 
-Finds the file in the search path.
-Sets com_filesize and one of handle or file
-If neither of file or handle is set, this
-can be used for detecting a file's presence.
-===========
+FILE LOOKUP INDEX
+
+Pak directories are hashed once when the pak is loaded. Loose files are
+looked up in a per-searchpath cache of directory listings, filled in one
+directory at a time on first access, so that failed lookups (e.g. probing
+for external textures and .lit files) no longer hit the disk.
+
+=============================================================================
 */
-static int COM_FindFile (const char *filename, int *handle, FILE **file,
-							unsigned int *path_id)
+
+typedef struct fsdircache_s
 {
-	searchpath_t	*search;
-	char		netpath[MAX_OSPATH];
-	pack_t		*pak;
-	int			i;
+	int			numentries;
+	int			capacity;
+	qboolean	nocase;		// keys are lowercased on case-insensitive file systems
+	char		**entries;	// "dir/" = directory was scanned, "dir/name" = entry
+} fsdircache_t;
 
-	if (file && handle)
-		Sys_Error ("COM_FindFile: both handle and file set");
+static SDL_mutex	*com_filecache_mutex;
 
-	file_from_pak = 0;
+static struct
+{
+	SDL_atomic_t	lookups;
+	SDL_atomic_t	misses;
+	SDL_atomic_t	dirscans;
+	SDL_atomic_t	inflates;
+	SDL_atomic_t	inflatehits;
+	SDL_SpinLock	timelock;
+	double			seconds;	// spent in lookups, guarded by timelock
+} fs_stats;
 
-//
-// search through the path, one element at a time
-//
-	for (search = com_searchpaths; search; search = search->next)
+/*
+============
+COM_HashPackFiles
+
+Builds the file name index for a pack (50% load factor).
+Only the first occurrence of a duplicate name is indexed,
+matching the order of a linear search.
+============
+*/
+static void COM_HashPackFiles (pack_t *pack)
+{
+	int i;
+
+	pack->numhashindices = pack->numfiles * 2;
+	pack->hashindices = (int *) Z_Malloc (pack->numhashindices * sizeof (*pack->hashindices));
+
+	for (i = 0; i < pack->numfiles; i++)
 	{
-		if (search->pack)	/* look through all the pak file elements */
+		unsigned pos = COM_HashString (pack->files[i].name) % pack->numhashindices;
+
+		for (;;)
 		{
-			pak = search->pack;
-			for (i = 0; i < pak->numfiles; i++)
+			int idx = pack->hashindices[pos];
+			if (!idx)
 			{
-				if (strcmp(pak->files[i].name, filename) != 0)
-					continue;
-				// found it!
-				com_filesize = pak->files[i].filelen;
-				file_from_pak = 1;
-				if (path_id)
-					*path_id = search->path_id;
-				if (handle)
-				{
-					*handle = pak->handle;
-					Sys_FileSeek (pak->handle, pak->files[i].filepos);
-					return com_filesize;
-				}
-				else if (file)
-				{ /* open a new file on the pakfile */
-					*file = Sys_fopen (pak->filename, "rb");
-					if (*file)
-						fseek (*file, pak->files[i].filepos, SEEK_SET);
-					return com_filesize;
-				}
-				else /* for COM_FileExists() */
-				{
-					return com_filesize;
-				}
+				pack->hashindices[pos] = i + 1;
+				break;
 			}
+			if (!strcmp (pack->files[idx - 1].name, pack->files[i].name))
+				break;
+			if (++pos == (unsigned) pack->numhashindices)
+				pos = 0;
 		}
-		else	/* check a file in the directory tree */
-		{
-			if (!registered.value)
-			{ /* if not a registered version, don't ever go beyond base */
-				if ( strchr (filename, '/') || strchr (filename,'\\'))
-					continue;
-			}
+	}
+}
 
-			q_snprintf (netpath, sizeof(netpath), "%s/%s",search->filename, filename);
-			if (! (Sys_FileType(netpath) & FS_ENT_FILE))
-				continue;
+/*
+============
+COM_FindPackFile
 
-			if (path_id)
-				*path_id = search->path_id;
-			if (handle)
-			{
-				com_filesize = Sys_FileOpenRead (netpath, &i);
-				*handle = i;
-				return com_filesize;
-			}
-			else if (file)
-			{
-				*file = Sys_fopen (netpath, "rb");
-				com_filesize = (*file == NULL) ? -1 : COM_filelength (*file);
-				return com_filesize;
-			}
-			else
-			{
-				return 0; /* dummy valid value for COM_FileExists() */
-			}
-		}
-	}
+Returns the index of filename in pack, or -1 if not present
+============
+*/
+static int COM_FindPackFile (const pack_t *pack, const char *filename)
+{
+	unsigned pos = COM_HashString (filename) % pack->numhashindices;
 
-	if (developer.value)
+	for (;;)
 	{
-		const char *ext = COM_FileGetExtension (filename);
-
-		if (strcmp(ext, "pcx") != 0 &&
-			strcmp(ext, "tga") != 0 &&
-			strcmp(ext, "lit") != 0 &&
-			strcmp(ext, "vis") != 0 &&
-			strcmp(ext, "ent") != 0)
-			Con_DPrintf ("FindFile: can't find %s\n", filename);
-		else
-			Con_DPrintf2 ("FindFile: can't find %s\n", filename);
+		int idx = pack->hashindices[pos];
+		if (!idx)
+			return -1;
+		if (!strcmp (pack->files[idx - 1].name, filename))
+			return idx - 1;
+		if (++pos == (unsigned) pack->numhashindices)
+			pos = 0;
 	}
-
-	if (handle)
-		*handle = -1;
-	if (file)
-		*file = NULL;
-	com_filesize = -1;
-	return com_filesize;
 }
 
-
 /*
-===========
-COM_FileExists
+============
+COM_IsCacheablePath
 
-Returns whether the file is found in the quake filesystem.
-===========
+Only plain relative paths are looked up in the directory cache,
+anything else is left to the OS
+============
 */
-qboolean COM_FileExists (const char *filename, unsigned int *path_id)
+static qboolean COM_IsCacheablePath (const char *path)
 {
-	int ret = COM_FindFile (filename, NULL, NULL, path_id);
-	return (ret == -1) ? false : true;
+	const char *p;
+
+	if (!*path || *path == '/')
+		return false;
+
+	for (p = path; *p; p++)
+	{
+		if (*p == '\\' || *p == ':')
+			return false;
+		if (*p == '.' && (p == path || p[-1] == '/') && (p[1] == '/' || p[1] == '.'))
+			return false;
+		if (*p == '/' && (p[1] == '/' || p[1] == '\0'))
+			return false;
+	}
+
+	return true;
 }
 
 /*
-===========
-COM_OpenFile
-
-filename never has a leading slash, but may contain directory walks
-returns a handle and a length
-it may actually be inside a pak file
-===========
+============
+COM_DirCacheKey
+============
 */
-int COM_OpenFile (const char *filename, int *handle, unsigned int *path_id)
+static unsigned COM_DirCacheKey (const fsdircache_t *cache, const char *in, char *out, size_t outsize)
 {
-	return COM_FindFile (filename, handle, NULL, path_id);
+	q_strlcpy (out, in, outsize);
+	if (cache->nocase)
+		q_strlwr (out);
+	return COM_HashString (out);
 }
 
 /*
-===========
-COM_FOpenFile
+============
+COM_IsCaseInsensitiveDir
 
-If the requested file is inside a packfile, a new FILE * will be opened
-into the file.
-===========
+Checks whether path can also be reached with the case of its letters swapped.
+Lowercased keys only cost a few extra confirmed misses on a case-sensitive
+file system, so that's what is assumed when the path has no letters.
+============
 */
-int COM_FOpenFile (const char *filename, FILE **file, unsigned int *path_id)
+static qboolean COM_IsCaseInsensitiveDir (const char *path)
 {
-	return COM_FindFile (filename, NULL, file, path_id);
+	char	swapped[MAX_OSPATH];
+	char	*p;
+
+	q_strlcpy (swapped, path, sizeof (swapped));
+	for (p = swapped; *p; p++)
+	{
+		if (q_islower (*p))
+			*p = q_toupper (*p);
+		else if (q_isupper (*p))
+			*p = q_tolower (*p);
+	}
+
+	if (!strcmp (swapped, path))
+		return true;
+
+	return Sys_FileType (swapped) == FS_ENT_DIRECTORY;
 }
 
 /*
 ============
-COM_CloseFile
-
-If it is a pak file handle, don't really close it
+COM_DirCacheFind
 ============
 */
-void COM_CloseFile (int h)
+static qboolean COM_DirCacheFind (const fsdircache_t *cache, const char *key, unsigned hash)
 {
-	searchpath_t	*s;
+	unsigned pos;
 
-	for (s = com_searchpaths; s; s = s->next)
-		if (s->pack && s->pack->handle == h)
-			return;
+	if (!cache->capacity)
+		return false;
 
-	Sys_FileClose (h);
-}
+	for (pos = hash % cache->capacity; cache->entries[pos]; )
+	{
+		if (!strcmp (cache->entries[pos], key))
+			return true;
+		if (++pos == (unsigned) cache->capacity)
+			pos = 0;
+	}
 
+	return false;
+}
 
 /*
 ============
-COM_LoadFile
-
-Filename are reletive to the quake directory.
-Allways appends a 0 byte.
+COM_DirCacheAdd
 ============
 */
-#define	LOADFILE_HUNK		0
-#define	LOADFILE_MALLOC		1
-
-byte *COM_LoadFile (const char *path, int usehunk, unsigned int *path_id)
+static void COM_DirCacheAdd (fsdircache_t *cache, const char *key, unsigned hash)
 {
-	int		h;
-	byte	*buf;
-	char	base[32];
-	int	len, nread;
+	unsigned pos;
 
-	buf = NULL;	// quiet compiler warning
+	if ((cache->numentries + 1) * 2 > cache->capacity)
+	{
+		int		i, oldcapacity = cache->capacity;
+		char	**oldentries = cache->entries;
 
-// look for it in the filesystem or pack files
-	len = COM_OpenFile (path, &h, path_id);
-	if (h == -1)
-		return NULL;
+		cache->capacity = q_max (oldcapacity * 2, 256);
+		cache->entries = (char **) calloc (cache->capacity, sizeof (*cache->entries));
+		if (!cache->entries)
+			Sys_Error ("COM_DirCacheAdd: out of memory on %d entries", cache->capacity);
 
-// extract the filename base name for hunk tag
-	COM_FileBase (path, base, sizeof(base));
+		for (i = 0; i < oldcapacity; i++)
+		{
+			if (!oldentries[i])
+				continue;
+			for (pos = COM_HashString (oldentries[i]) % cache->capacity; cache->entries[pos]; )
+				if (++pos == (unsigned) cache->capacity)
+					pos = 0;
+			cache->entries[pos] = oldentries[i];
+		}
+		free (oldentries);
+	}
 
-	switch (usehunk)
+	for (pos = hash % cache->capacity; cache->entries[pos]; )
 	{
-	case LOADFILE_HUNK:
-		buf = (byte *) Hunk_AllocNameNoFill (len+1, base);
-		break;
-	case LOADFILE_MALLOC:
-		buf = (byte *) malloc (len+1);
-		break;
-	default:
-		Sys_Error ("COM_LoadFile: bad usehunk");
+		if (!strcmp (cache->entries[pos], key))
+			return;
+		if (++pos == (unsigned) cache->capacity)
+			pos = 0;
+	}
+
+	cache->entries[pos] = strdup (key);
+	if (!cache->entries[pos])
+		Sys_Error ("COM_DirCacheAdd: out of memory");
+	cache->numentries++;
+}
+
+/*
+============
+COM_DirCacheFree
+============
+*/
+static void COM_DirCacheFree (fsdircache_t *cache)
+{
+	int i;
+
+	if (!cache)
+		return;
+	for (i = 0; i < cache->capacity; i++)
+		free (cache->entries[i]);
+	free (cache->entries);
+	free (cache);
+}
+
+/*
+============
+COM_DirCacheScan
+
+Adds a marker for dir (relative, with trailing slash)
+and an entry for everything it contains
+============
+*/
+static void COM_DirCacheScan (fsdircache_t *cache, const char *basepath, const char *dir, size_t dirlen)
+{
+	char		path[MAX_OSPATH];
+	char		key[MAX_OSPATH];
+	findfile_t	*find;
+
+	if ((size_t) q_snprintf (path, sizeof (path), "%s/%.*s", basepath, (int) dirlen, dir) >= sizeof (path))
+		return;
+
+	SDL_AtomicAdd (&fs_stats.dirscans, 1);
+
+	for (find = Sys_FindFirst (path, NULL); find; find = Sys_FindNext (find))
+	{
+		if (!strcmp (find->name, ".") || !strcmp (find->name, ".."))
+			continue;
+		if ((size_t) q_snprintf (path, sizeof (path), "%.*s%s", (int) dirlen, dir, find->name) >= sizeof (path))
+			continue;
+		COM_DirCacheAdd (cache, key, COM_DirCacheKey (cache, path, key, sizeof (key)));
+	}
+
+	q_snprintf (path, sizeof (path), "%.*s", (int) dirlen, dir);
+	COM_DirCacheAdd (cache, key, COM_DirCacheKey (cache, path, key, sizeof (key)));
+}
+
+/*
+============
+COM_DirCacheMayContain
+
+Returns false if filename is known not to exist in the search directory.
+A true result still needs to be confirmed, since the name could belong
+to a directory or to a file that has been deleted since the last scan.
+============
+*/
+static qboolean COM_DirCacheMayContain (searchpath_t *search, const char *filename)
+{
+	char		key[MAX_OSPATH];
+	char		dir[MAX_OSPATH];
+	const char	*slash;
+	size_t		dirlen;
+	unsigned	hash;
+	qboolean	ret;
+
+	if (!COM_IsCacheablePath (filename) || strlen (filename) >= sizeof (key))
+		return true;
+
+	slash = strrchr (filename, '/');
+	dirlen = slash ? slash - filename + 1 : 0;
+
+	SDL_LockMutex (com_filecache_mutex);
+
+	if (!search->dircache)
+	{
+		search->dircache = (fsdircache_t *) calloc (1, sizeof (fsdircache_t));
+		if (!search->dircache)
+			Sys_Error ("COM_DirCacheMayContain: out of memory");
+		search->dircache->nocase = COM_IsCaseInsensitiveDir (search->filename);
+	}
+
+	q_snprintf (dir, sizeof (dir), "%.*s", (int) dirlen, filename);
+	hash = COM_DirCacheKey (search->dircache, dir, key, sizeof (key));
+	if (!COM_DirCacheFind (search->dircache, key, hash))
+		COM_DirCacheScan (search->dircache, search->filename, filename, dirlen);
+
+	hash = COM_DirCacheKey (search->dircache, filename, key, sizeof (key));
+	ret = COM_DirCacheFind (search->dircache, key, hash);
+
+	SDL_UnlockMutex (com_filecache_mutex);
+
+	return ret;
+}
+
+/*
+============
+COM_InvalidateFileCache
+============
+*/
+void COM_InvalidateFileCache (void)
+{
+	searchpath_t *search;
+
+	if (!com_filecache_mutex)
+		return;
+
+	SDL_LockMutex (com_filecache_mutex);
+	for (search = com_searchpaths; search; search = search->next)
+	{
+		COM_DirCacheFree (search->dircache);
+		search->dircache = NULL;
+	}
+	SDL_UnlockMutex (com_filecache_mutex);
+}
+
+/*
+============
+COM_FileStats_f
+============
+*/
+static void COM_FileStats_f (void)
+{
+	searchpath_t	*search;
+	int				lookups, misses, entries = 0;
+	double			seconds;
+
+	if (Cmd_Argc () >= 2 && !q_strcasecmp (Cmd_Argv (1), "reset"))
+	{
+		SDL_AtomicSet (&fs_stats.lookups, 0);
+		SDL_AtomicSet (&fs_stats.misses, 0);
+		SDL_AtomicSet (&fs_stats.dirscans, 0);
+		SDL_AtomicSet (&fs_stats.inflates, 0);
+		SDL_AtomicSet (&fs_stats.inflatehits, 0);
+		SDL_AtomicLock (&fs_stats.timelock);
+		fs_stats.seconds = 0.0;
+		SDL_AtomicUnlock (&fs_stats.timelock);
+		Con_Printf ("File system stats reset\n");
+		return;
+	}
+
+	SDL_LockMutex (com_filecache_mutex);
+	for (search = com_searchpaths; search; search = search->next)
+		if (search->dircache)
+			entries += search->dircache->numentries;
+	SDL_UnlockMutex (com_filecache_mutex);
+
+	lookups = SDL_AtomicGet (&fs_stats.lookups);
+	misses = SDL_AtomicGet (&fs_stats.misses);
+
+	Con_Printf ("%i lookups, %i misses (%.1f%%)\n", lookups, misses, lookups ? 100.0 * misses / lookups : 0.0);
+	Con_Printf ("%i directory scans, %i cached entries\n", SDL_AtomicGet (&fs_stats.dirscans), entries);
+	Con_Printf ("%i zip entries inflated, %i cache hits\n", SDL_AtomicGet (&fs_stats.inflates), SDL_AtomicGet (&fs_stats.inflatehits));
+	SDL_AtomicLock (&fs_stats.timelock);
+	seconds = fs_stats.seconds;
+	SDL_AtomicUnlock (&fs_stats.timelock);
+	Con_Printf ("%.1f ms spent in lookups\n", seconds * 1000.0);
+}
+
+/*
+==============================================================================
+
+ZIP ARCHIVES
+
+.pk3/.zip archives in a game directory are mounted like pak files.
+Stored entries get a regular pack file position and are served exactly
+like pak contents (zero-copy with -mmap). Deflated entries are inflated
+on first use and kept in a small LRU cache shared by all threads.
+
+The zip reader has its own stdio file, so an archive only takes one slot
+in the sys handle table, and its own lock, so entries from different
+archives inflate in parallel. com_inflate_mutex only guards the cache.
+
+==============================================================================
+*/
+
+#define MAX_INFLATED_FILES	16
+#define MAX_INFLATED_SIZE	(32 * 1024 * 1024)
+
+#define ZIP_LOCAL_HEADER_SIZE	30
+
+typedef struct zipreader_s
+{
+	mz_zip_archive	archive;
+	FILE			*file;		// private file used for inflating
+	SDL_mutex		*mutex;		// serializes reads of archive and file
+} zipreader_t;
+
+typedef struct inflatedfile_s
+{
+	const pack_t	*pack;		// NULL if the archive was closed while in use
+	int				index;
+	byte			*data;
+	int				size;
+	int				refcount;
+	struct inflatedfile_s	*next;	// most recently used first
+} inflatedfile_t;
+
+static SDL_mutex		*com_inflate_mutex;
+static inflatedfile_t	*com_inflated;
+
+/*
+============
+COM_ZipRead
+============
+*/
+static size_t COM_ZipRead (void *opaque, mz_uint64 ofs, void *buf, size_t n)
+{
+	zipreader_t *zip = (zipreader_t *) opaque;
+
+	if (ofs > INT_MAX || n > INT_MAX)
+		return 0;
+	if (fseek (zip->file, (long) ofs, SEEK_SET) != 0)
+		return 0;
+	return fread (buf, 1, n, zip->file);
+}
+
+/*
+============
+COM_ZipDataOffset
+
+Returns the position of an entry's data, following its local header
+============
+*/
+static qboolean COM_ZipDataOffset (pack_t *pack, mz_uint64 headerofs, int *ofs)
+{
+	byte		buf[ZIP_LOCAL_HEADER_SIZE];
+	const byte	*header;
+	mz_uint64	pos;
+
+	if (pack->mapping)
+	{
+		if (headerofs + ZIP_LOCAL_HEADER_SIZE > pack->mappingsize)
+			return false;
+		header = pack->mapping + headerofs;
+	}
+	else
+	{
+		if (COM_ZipRead (pack->zip, headerofs, buf, sizeof (buf)) != sizeof (buf))
+			return false;
+		header = buf;
+	}
+
+	if (header[0] != 'P' || header[1] != 'K' || header[2] != 3 || header[3] != 4)
+		return false;
+
+	pos = headerofs + ZIP_LOCAL_HEADER_SIZE + (header[26] | header[27] << 8) + (header[28] | header[29] << 8);
+	if (pos > INT_MAX)
+		return false;
+
+	*ofs = (int) pos;
+	return true;
+}
+
+/*
+============
+COM_FreeZip
+============
+*/
+static void COM_FreeZip (pack_t *pack)
+{
+	inflatedfile_t	**link, *entry;
+
+	if (!pack->zip)
+		return;
+
+	// drop cached files, or orphan them if someone is still using them
+	SDL_LockMutex (com_inflate_mutex);
+	for (link = &com_inflated; (entry = *link) != NULL; )
+	{
+		if (entry->pack != pack)
+		{
+			link = &entry->next;
+			continue;
+		}
+		if (entry->refcount)
+		{
+			entry->pack = NULL;
+			link = &entry->next;
+			continue;
+		}
+		*link = entry->next;
+		free (entry->data);
+		free (entry);
+	}
+	SDL_UnlockMutex (com_inflate_mutex);
+
+	SDL_LockMutex (pack->zip->mutex);
+	mz_zip_reader_end (&pack->zip->archive);
+	SDL_UnlockMutex (pack->zip->mutex);
+	SDL_DestroyMutex (pack->zip->mutex);
+	fclose (pack->zip->file);
+	free (pack->zip);
+	pack->zip = NULL;
+}
+
+/*
+============
+COM_FreePackFile
+
+Closes a pak or zip archive and frees its directory
+============
+*/
+static void COM_FreePackFile (pack_t *pack)
+{
+	Sys_FileClose (pack->handle);
+	Sys_UnmapFile (pack->mapping, pack->mappingsize);
+	if (pack->hashindices)
+		Z_Free (pack->hashindices);
+	if (pack->zip)
+	{
+		COM_FreeZip (pack);
+		free (pack->files);
+	}
+	else
+		Z_Free (pack->files);
+	Z_Free (pack);
+}
+
+/*
+============
+COM_LoadZipFile
+
+Takes an explicit path to a .pk3/.zip archive and
+builds a pack directory from its central directory.
+============
+*/
+static pack_t *COM_LoadZipFile (const char *zipfile)
+{
+	mz_zip_archive_file_stat	stat;
+	zipreader_t	*zip;
+	pack_t		*pack;
+	qfileofs_t	length;
+	int			i, count, numentries, packhandle;
+
+	length = Sys_FileOpenRead (zipfile, &packhandle);
+	if (length == -1)
+		return NULL;
+	if (length > INT_MAX)
+	{
+		Sys_Printf ("WARNING: %s is too large, ignored\n", zipfile);
+		Sys_FileClose (packhandle);
+		return NULL;
+	}
+
+	zip = (zipreader_t *) calloc (1, sizeof (*zip));
+	if (!zip)
+		Sys_Error ("COM_LoadZipFile: out of memory");
+	zip->file = Sys_fopen (zipfile, "rb");
+	if (!zip->file)
+	{
+		free (zip);
+		Sys_FileClose (packhandle);
+		return NULL;
+	}
+	zip->mutex = SDL_CreateMutex ();
+	if (!zip->mutex)
+		Sys_Error ("COM_LoadZipFile: could not create mutex");
+
+	zip->archive.m_pRead = COM_ZipRead;
+	zip->archive.m_pIO_opaque = zip;
+	if (!mz_zip_reader_init (&zip->archive, length, 0))
+	{
+		Sys_Printf ("WARNING: %s is not a valid zip archive, ignored\n", zipfile);
+		SDL_DestroyMutex (zip->mutex);
+		fclose (zip->file);
+		Sys_FileClose (packhandle);
+		free (zip);
+		return NULL;
+	}
+
+	pack = (pack_t *) Z_Malloc (sizeof (pack_t));
+	q_strlcpy (pack->filename, zipfile, sizeof(pack->filename));
+	pack->handle = packhandle;
+	pack->zip = zip;
+	if (com_mappaks)
+		pack->mapping = (const byte *) Sys_MapFile (zipfile, &pack->mappingsize);
+
+	// archives can hold far more files than a pak, so the directory isn't kept in the zone
+	numentries = (int) zip->archive.m_total_files;
+	pack->files = (packfile_t *) calloc (q_max (numentries, 1), sizeof(packfile_t));
+	if (!pack->files)
+		Sys_Error ("COM_LoadZipFile: out of memory on %d files", numentries);
+
+	// parse the central directory
+	for (i = count = 0; i < numentries; i++)
+	{
+		packfile_t *file = &pack->files[count];
+
+		if (!mz_zip_reader_file_stat (&zip->archive, i, &stat) || stat.m_is_directory)
+			continue;
+		if (!stat.m_is_supported || stat.m_uncomp_size > INT_MAX || strlen (stat.m_filename) >= sizeof (file->name))
+		{
+			Con_DPrintf ("%s: skipping unsupported entry %s\n", zipfile, stat.m_filename);
+			continue;
+		}
+
+		q_strlcpy (file->name, stat.m_filename, sizeof (file->name));
+		file->filelen = (int) stat.m_uncomp_size;
+		if (stat.m_method == 0)
+		{
+			if (!COM_ZipDataOffset (pack, stat.m_local_header_ofs, &file->filepos) ||
+				(mz_uint64) file->filepos + file->filelen > (mz_uint64) length)
+			{
+				Con_DPrintf ("%s: bad local header for %s\n", zipfile, stat.m_filename);
+				continue;
+			}
+		}
+		else
+		{
+			file->filepos = -1;
+			file->zipindex = i + 1;
+		}
+		count++;
+	}
+
+	if (!count)
+	{
+		Sys_Printf ("WARNING: %s has no files, ignored\n", zipfile);
+		COM_FreePackFile (pack);
+		return NULL;
+	}
+
+	pack->numfiles = count;
+	COM_HashPackFiles (pack);
+	com_modified = true;	// not the original game data
+
+	return pack;
+}
+
+/*
+============
+COM_TrimInflatedFiles
+
+Frees unused entries beyond the cache limits.
+Must be called with com_inflate_mutex held.
+============
+*/
+static void COM_TrimInflatedFiles (void)
+{
+	inflatedfile_t	**link, *entry;
+	int				count = 0, size = 0;
+
+	for (link = &com_inflated; (entry = *link) != NULL; )
+	{
+		if (entry->refcount ||
+			(entry->pack && count < MAX_INFLATED_FILES && (!count || size + entry->size <= MAX_INFLATED_SIZE)))
+		{
+			count++;
+			size += entry->size;
+			link = &entry->next;
+			continue;
+		}
+		*link = entry->next;
+		free (entry->data);
+		free (entry);
+	}
+}
+
+/*
+============
+COM_AcquireInflatedFile
+
+Returns a reference to the decompressed contents of a zip entry,
+or NULL on failure. Release with COM_ReleaseInflatedFile.
+============
+*/
+static inflatedfile_t *COM_AcquireInflatedFile (const pack_t *pack, int fileindex)
+{
+	const packfile_t	*file = &pack->files[fileindex];
+	inflatedfile_t		**link, *entry;
+	byte				*data;
+	size_t				size = 0;
+
+	SDL_LockMutex (com_inflate_mutex);
+
+	for (link = &com_inflated; (entry = *link) != NULL; link = &entry->next)
+	{
+		if (entry->pack == pack && entry->index == fileindex)
+		{
+			// move to the front of the list
+			*link = entry->next;
+			entry->next = com_inflated;
+			com_inflated = entry;
+			entry->refcount++;
+			SDL_UnlockMutex (com_inflate_mutex);
+			SDL_AtomicAdd (&fs_stats.inflatehits, 1);
+			return entry;
+		}
+	}
+
+	SDL_UnlockMutex (com_inflate_mutex);
+
+	SDL_LockMutex (pack->zip->mutex);
+	data = (byte *) mz_zip_reader_extract_to_heap (&pack->zip->archive, file->zipindex - 1, &size, 0);
+	SDL_UnlockMutex (pack->zip->mutex);
+	if (!data || size != (size_t) file->filelen)
+	{
+		Con_Printf ("Error decompressing %s from %s\n", file->name, pack->filename);
+		free (data);
+		return NULL;
+	}
+
+	SDL_LockMutex (com_inflate_mutex);
+
+	// another thread may have inflated the same entry meanwhile
+	for (entry = com_inflated; entry; entry = entry->next)
+	{
+		if (entry->pack == pack && entry->index == fileindex)
+		{
+			entry->refcount++;
+			SDL_UnlockMutex (com_inflate_mutex);
+			free (data);
+			return entry;
+		}
+	}
+
+	entry = (inflatedfile_t *) calloc (1, sizeof (*entry));
+	if (!entry)
+		Sys_Error ("COM_AcquireInflatedFile: out of memory");
+
+	entry->data = data;
+	entry->pack = pack;
+	entry->index = fileindex;
+	entry->size = file->filelen;
+	entry->refcount = 1;
+	entry->next = com_inflated;
+	com_inflated = entry;
+	COM_TrimInflatedFiles ();
+
+	SDL_UnlockMutex (com_inflate_mutex);
+	SDL_AtomicAdd (&fs_stats.inflates, 1);
+
+	return entry;
+}
+
+/*
+============
+COM_ReleaseInflatedFile
+============
+*/
+static void COM_ReleaseInflatedFile (inflatedfile_t *entry)
+{
+	SDL_LockMutex (com_inflate_mutex);
+	if (--entry->refcount == 0)
+		COM_TrimInflatedFiles ();
+	SDL_UnlockMutex (com_inflate_mutex);
+}
+
+/*
+============
+COM_OpenInflatedFile
+
+Decompresses a zip entry to a temporary file, for stdio consumers
+============
+*/
+static FILE *COM_OpenInflatedFile (const pack_t *pack, int fileindex)
+{
+	inflatedfile_t	*entry;
+	FILE			*f;
+
+	entry = COM_AcquireInflatedFile (pack, fileindex);
+	if (!entry)
+		return NULL;
+
+	f = tmpfile ();
+	if (f && (fwrite (entry->data, 1, entry->size, f) != (size_t) entry->size || fseek (f, 0, SEEK_SET) != 0))
+	{
+		fclose (f);
+		f = NULL;
+	}
+	if (!f)
+		Con_Printf ("Couldn't create temporary file for %s\n", pack->files[fileindex].name);
+
+	COM_ReleaseInflatedFile (entry);
+
+	return f;
+}
+
+/*
+===========
+COM_FindFileInPaths
+
+Finds the file in the search path.
+Sets com_filesize and one of handle or file
+If neither of file or handle is set, this
+can be used for detecting a file's presence.
+If view is set, files that are already in memory
+(mapped paks, inflated zip entries) are returned
+there instead of opening a handle.
+===========
+*/
+static int COM_FindFileInPaths (const char *filename, int *handle, FILE **file,
+							fileview_t *view, unsigned int *path_id)
+{
+	searchpath_t	*search;
+	char		netpath[MAX_OSPATH];
+	pack_t		*pak;
+	int			i;
+
+	if (file && handle)
+		Sys_Error ("COM_FindFile: both handle and file set");
+
+	file_from_pak = 0;
+
+//
+// search through the path, one element at a time
+//
+	for (search = com_searchpaths; search; search = search->next)
+	{
+		if (search->pack)	/* look through all the pak file elements */
+		{
+			pak = search->pack;
+			i = COM_FindPackFile (pak, filename);
+			if (i >= 0)
+			{
+				// found it!
+				com_filesize = pak->files[i].filelen;
+				file_from_pak = 1;
+				if (path_id)
+					*path_id = search->path_id;
+				if (pak->files[i].zipindex)
+				{ /* compressed zip entry */
+					if (handle)
+						*handle = -1;
+					if (view)
+					{
+						view->inflated = COM_AcquireInflatedFile (pak, i);
+						if (!view->inflated)
+							return com_filesize = -1;
+						view->data = view->inflated->data;
+					}
+					else if (file)
+						*file = COM_OpenInflatedFile (pak, i);
+					else if (handle)
+					{
+						Con_Printf ("COM_OpenFile: can't read compressed file %s from %s\n", filename, pak->filename);
+						return com_filesize = -1;
+					}
+					return com_filesize;
+				}
+				if (view && pak->mapping && pak->files[i].filepos >= 0 && pak->files[i].filelen >= 0 &&
+					(size_t) pak->files[i].filepos + pak->files[i].filelen <= pak->mappingsize)
+				{
+					view->data = pak->mapping + pak->files[i].filepos;
+					if (handle)
+						*handle = -1;
+					return com_filesize;
+				}
+				if (handle)
+				{
+					*handle = pak->handle;
+					Sys_FileSeek (pak->handle, pak->files[i].filepos);
+					return com_filesize;
+				}
+				else if (file)
+				{ /* open a new file on the pakfile */
+					*file = Sys_fopen (pak->filename, "rb");
+					if (*file)
+						fseek (*file, pak->files[i].filepos, SEEK_SET);
+					return com_filesize;
+				}
+				else /* for COM_FileExists() */
+				{
+					return com_filesize;
+				}
+			}
+		}
+		else	/* check a file in the directory tree */
+		{
+			if (!registered.value)
+			{ /* if not a registered version, don't ever go beyond base */
+				if ( strchr (filename, '/') || strchr (filename,'\\'))
+					continue;
+			}
+
+			if (!COM_DirCacheMayContain (search, filename))
+				continue;
+
+			q_snprintf (netpath, sizeof(netpath), "%s/%s",search->filename, filename);
+			if (! (Sys_FileType(netpath) & FS_ENT_FILE))
+				continue;
+
+			if (path_id)
+				*path_id = search->path_id;
+			if (handle)
+			{
+				com_filesize = Sys_FileOpenRead (netpath, &i);
+				*handle = i;
+				return com_filesize;
+			}
+			else if (file)
+			{
+				*file = Sys_fopen (netpath, "rb");
+				com_filesize = (*file == NULL) ? -1 : COM_filelength (*file);
+				return com_filesize;
+			}
+			else
+			{
+				return 0; /* dummy valid value for COM_FileExists() */
+			}
+		}
+	}
+
+	if (developer.value)
+	{
+		const char *ext = COM_FileGetExtension (filename);
+
+		if (strcmp(ext, "pcx") != 0 &&
+			strcmp(ext, "tga") != 0 &&
+			strcmp(ext, "lit") != 0 &&
+			strcmp(ext, "vis") != 0 &&
+			strcmp(ext, "ent") != 0)
+			Con_DPrintf ("FindFile: can't find %s\n", filename);
+		else
+			Con_DPrintf2 ("FindFile: can't find %s\n", filename);
+	}
+
+	if (handle)
+		*handle = -1;
+	if (file)
+		*file = NULL;
+	com_filesize = -1;
+	return com_filesize;
+}
+
+/*
+===========
+COM_FindFile
+===========
+*/
+static int COM_FindFile (const char *filename, int *handle, FILE **file,
+							fileview_t *view, unsigned int *path_id)
+{
+	double	time = Sys_DoubleTime ();
+	int		ret = COM_FindFileInPaths (filename, handle, file, view, path_id);
+
+	SDL_AtomicAdd (&fs_stats.lookups, 1);
+	if (ret == -1)
+		SDL_AtomicAdd (&fs_stats.misses, 1);
+	time = Sys_DoubleTime () - time;
+	SDL_AtomicLock (&fs_stats.timelock);
+	fs_stats.seconds += time;
+	SDL_AtomicUnlock (&fs_stats.timelock);
+
+	return ret;
+}
+
+
+/*
+===========
+COM_FileExists
+
+Returns whether the file is found in the quake filesystem.
+===========
+*/
+qboolean COM_FileExists (const char *filename, unsigned int *path_id)
+{
+	int ret = COM_FindFile (filename, NULL, NULL, NULL, path_id);
+	return (ret == -1) ? false : true;
+}
+
+/*
+===========
+COM_OpenFile
+
+filename never has a leading slash, but may contain directory walks
+returns a handle and a length
+it may actually be inside a pak file
+===========
+*/
+int COM_OpenFile (const char *filename, int *handle, unsigned int *path_id)
+{
+	return COM_FindFile (filename, handle, NULL, NULL, path_id);
+}
+
+/*
+===========
+COM_FOpenFile
+
+If the requested file is inside a packfile, a new FILE * will be opened
+into the file.
+===========
+*/
+int COM_FOpenFile (const char *filename, FILE **file, unsigned int *path_id)
+{
+	return COM_FindFile (filename, NULL, file, NULL, path_id);
+}
+
+/*
+===========
+COM_ReadFileRange
+
+Reads size bytes at offset into a file, returns the number of bytes read
+or -1 if the file wasn't found. Files that are already in memory (mapped
+paks, cached inflated zip entries) are read from there, so reading many
+lumps from the same compressed entry only inflates it once.
+===========
+*/
+int COM_ReadFileRange (const char *filename, int offset, void *dest, int size, unsigned int *path_id)
+{
+	fileview_t	view;
+	FILE		*f = NULL;
+	int			len;
+
+	memset (&view, 0, sizeof (view));
+	len = COM_FindFile (filename, NULL, &f, &view, path_id);
+	if (len < 0 || (!f && !view.data))
+		return -1;
+
+	if (offset < 0 || offset > len)
+		size = 0;
+	else
+		size = q_min (size, len - offset);
+
+	if (view.data)
+	{
+		memcpy (dest, view.data + offset, size);
+		COM_CloseFileView (&view);
+		return size;
+	}
+
+	if (fseek (f, offset, SEEK_CUR) != 0)
+		size = 0;
+	else
+		size = (int) fread (dest, 1, size, f);
+	fclose (f);
+
+	return size;
+}
+
+/*
+============
+COM_CloseFile
+
+If it is a pak file handle, don't really close it
+============
+*/
+void COM_CloseFile (int h)
+{
+	searchpath_t	*s;
+
+	for (s = com_searchpaths; s; s = s->next)
+		if (s->pack && s->pack->handle == h)
+			return;
+
+	Sys_FileClose (h);
+}
+
+
+/*
+============
+COM_LoadFile
+
+Filename are reletive to the quake directory.
+Allways appends a 0 byte.
+============
+*/
+#define	LOADFILE_HUNK		0
+#define	LOADFILE_MALLOC		1
+
+byte *COM_LoadFile (const char *path, int usehunk, unsigned int *path_id)
+{
+	int		h;
+	byte	*buf;
+	fileview_t	view;
+	char	base[32];
+	int	len, nread;
+
+	buf = NULL;	// quiet compiler warning
+
+// look for it in the filesystem or pack files
+	memset (&view, 0, sizeof (view));
+	len = COM_FindFile (path, &h, NULL, &view, path_id);
+	if (h == -1 && !view.data)
+		return NULL;
+
+// extract the filename base name for hunk tag
+	COM_FileBase (path, base, sizeof(base));
+
+	switch (usehunk)
+	{
+	case LOADFILE_HUNK:
+		buf = (byte *) Hunk_AllocNameNoFill (len+1, base);
+		break;
+	case LOADFILE_MALLOC:
+		buf = (byte *) malloc (len+1);
+		break;
+	default:
+		Sys_Error ("COM_LoadFile: bad usehunk");
 	}
 
 	if (!buf)
@@ -2035,6 +3026,13 @@ byte *COM_LoadFile (const char *path, int usehunk, unsigned int *path_id)
 
 	((byte *)buf)[len] = 0;
 
+	if (view.data)
+	{
+		memcpy (buf, view.data, len);
+		COM_CloseFileView (&view);
+		return buf;
+	}
+
 	nread = Sys_FileRead (h, buf, len);
 	COM_CloseFile (h);
 	if (nread != len)
@@ -2054,6 +3052,80 @@ byte *COM_LoadMallocFile (const char *path, unsigned int *path_id)
 	return COM_LoadFile (path, LOADFILE_MALLOC, path_id);
 }
 
+/*
+============
+COM_OpenFileView
+============
+*/
+qboolean COM_OpenFileView (const char *path, fileview_t *view, unsigned int *path_id)
+{
+	int		h, len, nread;
+
+	memset (view, 0, sizeof (*view));
+
+	len = COM_FindFile (path, &h, NULL, view, path_id);
+	if (view->data)
+	{
+		view->size = len;
+		return true;
+	}
+	if (h == -1)
+		return false;
+
+	view->copy = (byte *) malloc (len + 1);
+	if (!view->copy)
+		Sys_Error ("COM_OpenFileView: not enough space for %s", path);
+	view->copy[len] = 0;
+
+	nread = Sys_FileRead (h, view->copy, len);
+	COM_CloseFile (h);
+	if (nread != len)
+		Sys_Error ("COM_OpenFileView: Error reading %s", path);
+
+	view->data = view->copy;
+	view->size = len;
+
+	return true;
+}
+
+/*
+============
+COM_GetWritableFileView
+============
+*/
+byte *COM_GetWritableFileView (fileview_t *view)
+{
+	if (!view->copy)
+	{
+		view->copy = (byte *) malloc (view->size + 1);
+		if (!view->copy)
+			Sys_Error ("COM_GetWritableFileView: out of memory on %d bytes", view->size + 1);
+		memcpy (view->copy, view->data, view->size);
+		view->copy[view->size] = 0;
+		view->data = view->copy;
+		if (view->inflated)
+		{
+			COM_ReleaseInflatedFile (view->inflated);
+			view->inflated = NULL;
+		}
+	}
+
+	return view->copy;
+}
+
+/*
+============
+COM_CloseFileView
+============
+*/
+void COM_CloseFileView (fileview_t *view)
+{
+	if (view->inflated)
+		COM_ReleaseInflatedFile (view->inflated);
+	free (view->copy);
+	memset (view, 0, sizeof (*view));
+}
+
 byte *COM_LoadMallocFile_TextMode_OSPath (const char *path, long *len_out)
 {
 	FILE	*f;
@@ -2238,6 +3310,9 @@ static pack_t *COM_LoadPackFile (const char *packfile)
 	pack->handle = packhandle;
 	pack->numfiles = numpackfiles;
 	pack->files = newfiles;
+	COM_HashPackFiles (pack);
+	if (com_mappaks)
+		pack->mapping = (const byte *) Sys_MapFile (packfile, &pack->mappingsize);
 
 	//Sys_Printf ("Added packfile %s (%i files)\n", packfile, numpackfiles);
 	return pack;
@@ -2303,6 +3378,70 @@ static void COM_AddEnginePak (void)
 	com_modified = modified;
 }
 
+/*
+=================
+COM_CompareArchiveNames
+=================
+*/
+static int COM_CompareArchiveNames (const void *a, const void *b)
+{
+	return q_strcasecmp (*(const char *const *) a, *(const char *const *) b);
+}
+
+/*
+=================
+COM_AddZipFiles
+
+Mounts all .pk3/.zip archives in dir, in alphabetical order
+so that later archives override earlier ones
+=================
+*/
+static void COM_AddZipFiles (const char *dir, unsigned int path_id)
+{
+	findfile_t	*find;
+	char		**names = NULL;
+	char		zipfile[MAX_OSPATH];
+	int			i, count = 0, capacity = 0;
+
+	for (find = Sys_FindFirst (dir, NULL); find; find = Sys_FindNext (find))
+	{
+		const char *ext = COM_FileGetExtension (find->name);
+		if ((find->attribs & FA_DIRECTORY) || (q_strcasecmp (ext, "pk3") != 0 && q_strcasecmp (ext, "zip") != 0))
+			continue;
+		if (count == capacity)
+		{
+			capacity = q_max (capacity * 2, 16);
+			names = (char **) realloc (names, capacity * sizeof (*names));
+			if (!names)
+				Sys_Error ("COM_AddZipFiles: out of memory");
+		}
+		names[count] = strdup (find->name);
+		if (!names[count++])
+			Sys_Error ("COM_AddZipFiles: out of memory");
+	}
+
+	if (count > 1)
+		qsort (names, count, sizeof (*names), COM_CompareArchiveNames);
+
+	for (i = 0; i < count; i++)
+	{
+		pack_t *pak;
+
+		q_snprintf (zipfile, sizeof (zipfile), "%s/%s", dir, names[i]);
+		pak = COM_LoadZipFile (zipfile);
+		if (pak)
+		{
+			searchpath_t *search = (searchpath_t *) Z_Malloc(sizeof(searchpath_t));
+			search->path_id = path_id;
+			search->pack = pak;
+			search->next = com_searchpaths;
+			com_searchpaths = search;
+		}
+		free (names[i]);
+	}
+	free (names);
+}
+
 /*
 =================
 COM_AddGameDirectory -- johnfitz -- modified based on topaz's tutorial
@@ -2371,6 +3510,9 @@ void COM_AddGameDirectory (const char *dir)
 			if (i == 0 && j == 0 && path_id == 1u && !fitzmode)
 				COM_AddEnginePak ();
 		}
+
+		// archives override pak files from the same directory
+		COM_AddZipFiles (com_gamedir, path_id);
 	}
 }
 
@@ -2379,14 +3521,11 @@ void COM_ResetGameDirectories(const char *newgamedirs)
 	const char *newpath, *path;
 	searchpath_t *search;
 	//Kill the extra game if it is loaded
+	COM_InvalidateFileCache ();
 	while (com_searchpaths != com_base_searchpaths)
 	{
 		if (com_searchpaths->pack)
-		{
-			Sys_FileClose (com_searchpaths->pack->handle);
-			Z_Free (com_searchpaths->pack->files);
-			Z_Free (com_searchpaths->pack);
-		}
+			COM_FreePackFile (com_searchpaths->pack);
 		search = com_searchpaths->next;
 		Z_Free (com_searchpaths);
 		com_searchpaths = search;
@@ -2510,7 +3649,7 @@ void COM_SwitchGame (const char *paths)
 	Cache_Flush ();
 	Mod_ResetAll();
 	Sky_ClearAll();
-	if (!isDedicated)
+	if (!isDedicated && !isHeadless)
 	{
 		TexMgr_NewGame ();
 		Draw_NewGame ();
@@ -3204,6 +4343,16 @@ void COM_InitFilesystem (void) //johnfitz -- modified based on topaz's tutorial
 	Cvar_RegisterVariable (&cmdline);
 	Cmd_AddCommand ("path", COM_Path_f);
 	Cmd_AddCommand ("game", COM_Game_f); //johnfitz
+	Cmd_AddCommand ("fs_stats", COM_FileStats_f);
+
+	com_filecache_mutex = SDL_CreateMutex ();
+	if (!com_filecache_mutex)
+		Sys_Error ("COM_InitFilesystem: could not create mutex");
+	com_inflate_mutex = SDL_CreateMutex ();
+	if (!com_inflate_mutex)
+		Sys_Error ("COM_InitFilesystem: could not create mutex");
+
+	com_mappaks = COM_CheckParm ("-mmap") != 0;
 
 	startarg = (com_argc == 2 && Sys_FileType (com_argv[1]) != FS_ENT_NONE) ? com_argv[1] : NULL;
 	if (startarg)
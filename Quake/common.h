@@ -174,6 +174,31 @@ void MultiString_Append (char **pvec, const char *str);
 
 //============================================================================
 
+// Maps names to their position in a fixed-size registry (mod_known, known_sfx,
+// precache lists). The keys are not copied and must stay valid until cleared.
+typedef struct strindex_s {
+	const char	**keys;
+	int			*values;
+	int			size;		// power of two
+	int			count;
+} strindex_t;
+
+typedef struct strindexstats_s {
+	int			lookups;
+	int			compares;	// strcmp calls actually made
+	int			linear;		// strcmp calls a linear scan would have made
+} strindexstats_t;
+
+extern strindexstats_t strindex_stats;
+
+void StrIndex_Init (strindex_t *index, int capacity);
+void StrIndex_Clear (strindex_t *index);
+int StrIndex_Find (strindex_t *index, const char *key);	// -1 if not found
+void StrIndex_Add (strindex_t *index, const char *key, int value);
+void StrIndex_PrintStats (const char *label);
+
+//============================================================================
+
 #define BITARRAY_DWORDS(bits)		(((bits)+31)/32)
 #define BITARRAY_MEM_SIZE(bits)		(BITARRAY_DWORDS (bits) * sizeof (uint32_t))
 
@@ -362,16 +387,26 @@ typedef struct
 {
 	char	name[MAX_QPATH];
 	int		filepos, filelen;
+	int		zipindex;		// 1 + entry index for compressed zip entries, 0 if stored
 } packfile_t;
 
+struct zipreader_s;
+
 typedef struct pack_s
 {
 	char	filename[MAX_OSPATH];
 	int		handle;
 	int		numfiles;
 	packfile_t	*files;
+	int		numhashindices;
+	int		*hashindices;	// open-addressing index into files (1-based, 0 = empty)
+	const byte	*mapping;		// whole pak mapped into memory (-mmap), or NULL
+	size_t	mappingsize;
+	struct zipreader_s	*zip;	// central directory of .pk3/.zip archives, NULL for paks
 } pack_t;
 
+struct fsdircache_s;
+
 typedef struct searchpath_s
 {
 	unsigned int path_id;	// identifier assigned to the game directory
@@ -379,6 +414,7 @@ typedef struct searchpath_s
 					// <userdir>/game1 have the same id.
 	char	filename[MAX_OSPATH];
 	pack_t	*pack;			// only one of filename / pack will be used
+	struct fsdircache_s	*dircache;	// lazily-built listing of loose files (directories only)
 	struct searchpath_s	*next;
 } searchpath_t;
 
@@ -402,6 +438,11 @@ int COM_OpenFile (const char *filename, int *handle, unsigned int *path_id);
 int COM_FOpenFile (const char *filename, FILE **file, unsigned int *path_id);
 qboolean COM_FileExists (const char *filename, unsigned int *path_id);
 void COM_CloseFile (int h);
+qfileofs_t COM_filelength (FILE *f);
+
+// drops the cached listings of loose files so that files created
+// since the last lookup (demos, configs, freshly compiled maps) are seen
+void COM_InvalidateFileCache (void);
 
 // these procedures open a file using COM_FindFile and loads it into a proper
 // buffer. the buffer is allocated with a total size of com_filesize + 1. the
@@ -411,6 +452,26 @@ byte *COM_LoadHunkFile (const char *path, unsigned int *path_id);
 byte *COM_LoadMallocFile (const char *path, unsigned int *path_id);
 	// allocates the buffer on the system mem (malloc).
 
+// Read-only view of a file's contents. Files stored in memory-mapped paks
+// (-mmap) are returned in place, without making a copy, and compressed zip
+// entries are shared with the cache of inflated files; anything else is
+// loaded into a malloc'ed buffer. Mapped data is not '\0'-terminated.
+struct inflatedfile_s;
+typedef struct
+{
+	const byte	*data;
+	int			size;
+	byte		*copy;		// malloc'ed buffer, if the file wasn't mapped
+	struct inflatedfile_s	*inflated;	// reference to a cached inflated zip entry
+} fileview_t;
+
+qboolean COM_OpenFileView (const char *path, fileview_t *view, unsigned int *path_id);
+byte *COM_GetWritableFileView (fileview_t *view);
+	// for consumers that modify the data in place (copied on demand)
+void COM_CloseFileView (fileview_t *view);
+int COM_ReadFileRange (const char *filename, int offset, void *dest, int size, unsigned int *path_id);
+	// reads part of a file, from memory if it's already there
+
 // Opens the given path directly, ignoring search paths.
 // Returns NULL on failure, or else a '\0'-terminated malloc'ed buffer.
 // Loads in "t" mode so CRLF to LF translation is performed on Windows.
@@ -129,6 +129,8 @@ int			con_vislines;
 
 qboolean	con_initialized;
 
+static SDL_threadID	con_mainthread;
+
 
 /*
 ================
@@ -1069,6 +1071,8 @@ void Con_Init (void)
 {
 	int i;
 
+	con_mainthread = SDL_ThreadID ();
+
 	//johnfitz -- user settable console buffer size
 	i = COM_CheckParm("-consize");
 	if (i && i < com_argc-1) {
@@ -1275,6 +1279,44 @@ static const char *Con_StripControlPrefixes (const char *txt)
 }
 
 
+/*
+================
+Con_PrintDeferred
+================
+*/
+static void Con_PrintDeferred (void *param)
+{
+	Con_SafePrintf ("%s", (const char *) param);
+	free (param);
+}
+
+/*
+================
+Con_ForwardToMainThread
+
+The console can only be updated by the main thread.
+Text printed by other threads is queued and printed on the next frame.
+Returns false if the caller is on the main thread.
+================
+*/
+static qboolean Con_ForwardToMainThread (const char *msg)
+{
+	size_t	len;
+	char	*copy;
+
+	if (!con_mainthread || SDL_ThreadID () == con_mainthread)
+		return false;
+
+	len = strlen (msg) + 1;
+	copy = (char *) malloc (len);
+	if (!copy)
+		Sys_Error ("Con_ForwardToMainThread: out of memory on %" SDL_PRIu64 " bytes", (uint64_t) len);
+	memcpy (copy, msg, len);
+	Host_InvokeOnMainThread (Con_PrintDeferred, copy);
+
+	return true;
+}
+
 /*
 ================
 Con_Printf
@@ -1293,6 +1335,9 @@ void Con_Printf (const char *fmt, ...)
 	q_vsnprintf (msg, sizeof(msg), fmt, argptr);
 	va_end (argptr);
 
+	if (Con_ForwardToMainThread (msg))
+		return;
+
 // also echo to debugging console
 	Sys_Printf ("%s", Con_StripControlPrefixes (msg));
 
@@ -1475,6 +1520,9 @@ void Con_SafePrintf (const char *fmt, ...)
 	q_vsnprintf (msg, sizeof(msg), fmt, argptr);
 	va_end (argptr);
 
+	if (Con_ForwardToMainThread (msg))
+		return;
+
 	temp = scr_disabled_for_loading;
 	scr_disabled_for_loading = true;
 	Con_Printf ("%s", msg);
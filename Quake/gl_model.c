@@ -30,26 +30,30 @@ static qmodel_t*	loadmodel;
 static char	loadname[32];	// for hunk tags
 
 static void Mod_LoadSpriteModel (qmodel_t *mod, void *buffer);
-static void Mod_LoadBrushModel (qmodel_t *mod, void *buffer);
+static void Mod_LoadBrushModel (qmodel_t *mod, const void *buffer);
 static void Mod_LoadAliasModel (qmodel_t *mod, void *buffer);
 static void Mod_LoadMD5MeshModel (qmodel_t *mod, const char *buffer);
 static qmodel_t *Mod_LoadModel (qmodel_t *mod, qboolean crash);
+static void Mod_CancelPendingTextures (void);
 
 static void Mod_Print (void);
 
 static cvar_t	external_ents = {"external_ents", "1", CVAR_ARCHIVE};
 static cvar_t	external_vis = {"external_vis", "1", CVAR_ARCHIVE};
+static cvar_t	mod_loadthreads = {"mod_loadthreads", "0", CVAR_ARCHIVE};	// 1 = main thread only, otherwise decode lumps as jobs
 cvar_t			r_md5 = {"r_md5", "1", CVAR_ARCHIVE};
 
-static byte	*mod_novis;
-static int	mod_novis_capacity;
+// per thread, so that PVS lookups can be made from jobs
+static THREAD_LOCAL byte	*mod_novis;
+static THREAD_LOCAL int		mod_novis_capacity;
 
-static byte	*mod_decompressed;
-static int	mod_decompressed_capacity;
+static THREAD_LOCAL byte	*mod_decompressed;
+static THREAD_LOCAL int		mod_decompressed_capacity;
 
 #define	MAX_MOD_KNOWN	4096 /*johnfitz -- was 512 */
 static qmodel_t	mod_known[MAX_MOD_KNOWN];
 static int		mod_numknown;
+static strindex_t	mod_index;
 
 texture_t	*r_notexture_mip; //johnfitz -- moved here from r_main.c
 texture_t	*r_notexture_mip2; //johnfitz -- used for non-lightmapped surfs with a missing texture
@@ -91,11 +95,14 @@ void Mod_Init (void)
 {
 	Cvar_RegisterVariable (&external_vis);
 	Cvar_RegisterVariable (&external_ents);
+	Cvar_RegisterVariable (&mod_loadthreads);
 	Cvar_RegisterVariable (&r_md5);
 	Cvar_SetCallback (&r_md5, R_MD5_f);
 
 	Cmd_AddCommand ("mcache", Mod_Print);
 
+	StrIndex_Init (&mod_index, MAX_MOD_KNOWN);
+
 	//johnfitz -- create notexture miptex
 	r_notexture_mip = (texture_t *) Hunk_AllocName (sizeof(texture_t), "r_notexture_mip");
 	strcpy (r_notexture_mip->name, "notexture");
@@ -283,6 +290,7 @@ void Mod_ResetAll (void)
 		memset(mod, 0, sizeof(qmodel_t));
 	}
 	mod_numknown = 0;
+	StrIndex_Clear (&mod_index);
 }
 
 /*
@@ -302,20 +310,17 @@ static qmodel_t *Mod_FindName (const char *name)
 //
 // search the currently loaded models
 //
-	for (i=0 , mod=mod_known ; i<mod_numknown ; i++, mod++)
-	{
-		if (!strcmp (mod->name, name) )
-			break;
-	}
-
-	if (i == mod_numknown)
-	{
-		if (mod_numknown == MAX_MOD_KNOWN)
-			Sys_Error ("mod_numknown == MAX_MOD_KNOWN");
-		q_strlcpy (mod->name, name, MAX_QPATH);
-		mod->needload = true;
-		mod_numknown++;
-	}
+	i = StrIndex_Find (&mod_index, name);
+	if (i >= 0)
+		return &mod_known[i];
+
+	if (mod_numknown == MAX_MOD_KNOWN)
+		Sys_Error ("mod_numknown == MAX_MOD_KNOWN");
+	mod = &mod_known[mod_numknown];
+	q_strlcpy (mod->name, name, MAX_QPATH);
+	mod->needload = true;
+	StrIndex_Add (&mod_index, mod->name, mod_numknown);
+	mod_numknown++;
 
 	return mod;
 }
@@ -348,8 +353,9 @@ Loads a model into the cache
 */
 static qmodel_t *Mod_LoadModel (qmodel_t *mod, qboolean crash)
 {
-	byte	*buf;
-	int		mod_type;
+	fileview_t	view;
+	const byte	*buf;
+	int			mod_type;
 
 	if (!mod->needload)
 	{
@@ -373,8 +379,7 @@ static qmodel_t *Mod_LoadModel (qmodel_t *mod, qboolean crash)
 //
 // load the file
 //
-	buf = COM_LoadMallocFile (mod->name, &mod->path_id);
-	if (!buf)
+	if (!COM_OpenFileView (mod->name, &view, &mod->path_id))
 	{
 		if (crash)
 			Host_Error ("Mod_LoadModel: %s not found", mod->name); //johnfitz -- was "Mod_NumForName"
@@ -395,23 +400,27 @@ static qmodel_t *Mod_LoadModel (qmodel_t *mod, qboolean crash)
 // call the apropriate loader
 	mod->needload = false;
 
-	mod_type = (buf[0] | (buf[1] << 8) | (buf[2] << 16) | (buf[3] << 24));
+	buf = view.data;
+	mod_type = view.size < 4 ? 0 : (buf[0] | (buf[1] << 8) | (buf[2] << 16) | (buf[3] << 24));
 	switch (mod_type)
 	{
 	case IDPOLYHEADER:
-		Mod_LoadAliasModel (mod, buf);
+		// skins are flood-filled in place
+		Mod_LoadAliasModel (mod, COM_GetWritableFileView (&view));
 		break;
 
 	case IDSPRITEHEADER:
-		Mod_LoadSpriteModel (mod, buf);
+		Mod_LoadSpriteModel (mod, COM_GetWritableFileView (&view));
 		break;
 
 	default:
+		// the brush model loader only reads from the buffer,
+		// so it can work directly on a memory-mapped pak
 		Mod_LoadBrushModel (mod, buf);
 		break;
 	}
 
-	free (buf);
+	COM_CloseFileView (&view);
 
 	return mod;
 }
@@ -441,7 +450,251 @@ qmodel_t *Mod_ForName (const char *name, qboolean crash)
 ===============================================================================
 */
 
-static byte	*mod_base;
+static const byte	*mod_base;
+
+/*
+===============================================================================
+
+					PARALLEL LUMP DECODING
+
+Lumps that don't depend on GL state are decoded as jobs while the main
+thread uploads textures. Steps that have to run on the main thread get a
+placeholder job, submitted when the step completes, so that the tasks
+depending on them can wait on it like on any other job. Hunk memory is
+allocated by the lump loaders on the main thread, tasks only fill it in.
+Tasks must not call Host_Error/Con_Printf: they return an error message
+instead, which is raised on the main thread once all tasks have finished.
+
+===============================================================================
+*/
+
+#define MAX_LOADTASKS		16
+
+typedef struct loadtask_s
+{
+	const char			*name;
+	const char			*(*func) (struct loadtask_s *task);	// NULL for steps run by the main thread
+	const void			*in;
+	void				*out;
+	int					count;
+	int					bsp2;
+	int					result;			// task-specific output
+	const char			*error;
+	double				time;
+	job_t				*job;
+	qboolean			submitted;
+	qboolean			skip;			// already run on the main thread, or aborted
+} loadtask_t;
+
+static struct
+{
+	loadtask_t		tasks[MAX_LOADTASKS];
+	int				numtasks;
+	qboolean		parallel;
+} mod_loadgraph;
+
+/*
+=================
+Mod_RunLoadTask
+=================
+*/
+static void Mod_RunLoadTask (void *param)
+{
+	loadtask_t	*task = (loadtask_t *) param;
+	double		time;
+
+	if (!task->func || task->skip)
+		return;
+
+	time = Sys_DoubleTime ();
+	task->error = task->func (task);
+	task->time = Sys_DoubleTime () - time;
+}
+
+/*
+=================
+Mod_AddLoadTask
+=================
+*/
+static loadtask_t *Mod_AddLoadTask (const char *name, const char *(*func) (loadtask_t *), const void *in, void *out, int count, int bsp2)
+{
+	loadtask_t *task;
+
+	if (mod_loadgraph.numtasks == MAX_LOADTASKS)
+		Sys_Error ("Mod_AddLoadTask: too many tasks");
+
+	task = &mod_loadgraph.tasks[mod_loadgraph.numtasks++];
+	memset (task, 0, sizeof (*task));
+	task->name = name;
+	task->func = func;
+	task->in = in;
+	task->out = out;
+	task->count = count;
+	task->bsp2 = bsp2;
+	task->job = Job_Create (Mod_RunLoadTask, task);
+
+	return task;
+}
+
+/*
+=================
+Mod_AddLoadDependency
+
+task won't start before dep has finished
+=================
+*/
+static void Mod_AddLoadDependency (loadtask_t *task, loadtask_t *dep)
+{
+	Job_AddDependency (task->job, dep->job);
+}
+
+/*
+=================
+Mod_SubmitLoadTask
+=================
+*/
+static void Mod_SubmitLoadTask (loadtask_t *task)
+{
+	if (!task->submitted)
+	{
+		task->submitted = true;
+		Job_Submit (task->job);
+	}
+}
+
+/*
+=================
+Mod_StartLoadTasks
+
+Submits the decoding tasks. With mod_loadthreads 1 they are
+run by the main thread in Mod_WaitLoadTasks instead.
+=================
+*/
+static void Mod_StartLoadTasks (void)
+{
+	int i;
+
+	mod_loadgraph.parallel = mod_loadthreads.value != 1.f && Jobs_NumWorkers () > 0;
+	if (!mod_loadgraph.parallel)
+		return;
+
+	for (i = 0; i < mod_loadgraph.numtasks; i++)
+		if (mod_loadgraph.tasks[i].func)
+			Mod_SubmitLoadTask (&mod_loadgraph.tasks[i]);
+}
+
+/*
+=================
+Mod_CompleteLoadStep
+
+Finishes a step run by the main thread, releasing the tasks waiting on it
+=================
+*/
+static void Mod_CompleteLoadStep (loadtask_t *step, double starttime)
+{
+	step->time = Sys_DoubleTime () - starttime;
+	Mod_SubmitLoadTask (step);
+}
+
+/*
+=================
+Mod_ReleaseLoadTasks
+
+Waits for all the tasks and resets the graph
+=================
+*/
+static void Mod_ReleaseLoadTasks (void)
+{
+	int i;
+
+	for (i = 0; i < mod_loadgraph.numtasks; i++)
+		Mod_SubmitLoadTask (&mod_loadgraph.tasks[i]);
+
+	for (i = 0; i < mod_loadgraph.numtasks; i++)
+	{
+		loadtask_t *task = &mod_loadgraph.tasks[i];
+		Job_Wait (task->job);
+		Job_Release (task->job);
+		task->job = NULL;
+	}
+
+	mod_loadgraph.numtasks = 0;
+}
+
+/*
+=================
+Mod_WaitLoadTasks
+
+Helps with the remaining tasks, prints per-lump
+timings and raises the first task error
+=================
+*/
+static void Mod_WaitLoadTasks (void)
+{
+	const char	*error = NULL;
+	int			i;
+
+	// tasks were added in dependency order
+	if (!mod_loadgraph.parallel)
+	{
+		for (i = 0; i < mod_loadgraph.numtasks; i++)
+		{
+			Mod_RunLoadTask (&mod_loadgraph.tasks[i]);
+			mod_loadgraph.tasks[i].skip = true;
+		}
+	}
+
+	Con_DPrintf ("%s: %d lump tasks%s\n", loadmodel->name,
+		mod_loadgraph.numtasks, mod_loadgraph.parallel ? "" : " (main thread)");
+	for (i = 0; i < mod_loadgraph.numtasks; i++)
+	{
+		loadtask_t *task = &mod_loadgraph.tasks[i];
+		Mod_SubmitLoadTask (task);
+		Job_Wait (task->job);
+		Con_DPrintf ("  %-12s %7.2f ms%s\n", task->name, task->time * 1000.0, task->func ? "" : " (main thread)");
+		if (task->error && !error)
+			error = task->error;
+	}
+
+	Mod_ReleaseLoadTasks ();
+
+	if (error)
+		Host_Error ("%s", error);
+}
+
+/*
+=================
+Mod_AbortLoadTasks
+
+Called on Host_Error, so that no task is left writing to the hunk
+=================
+*/
+void Mod_AbortLoadTasks (void)
+{
+	int i;
+
+	// tasks that haven't started yet don't need to run anymore
+	for (i = 0; i < mod_loadgraph.numtasks; i++)
+		if (!mod_loadgraph.tasks[i].submitted)
+			mod_loadgraph.tasks[i].skip = true;
+
+	Mod_ReleaseLoadTasks ();
+	Mod_CancelPendingTextures ();
+}
+
+/*
+=================
+Mod_LogLoadStep
+
+Timing output for the lumps loaded by the main thread after the parallel phase
+=================
+*/
+static void Mod_LogLoadStep (const char *name, double *time)
+{
+	double now = Sys_DoubleTime ();
+	Con_DPrintf ("  %-12s %7.2f ms (main thread)\n", name, (now - *time) * 1000.0);
+	*time = now;
+}
 
 /*
 =================
@@ -504,6 +757,113 @@ static textype_t Mod_TextureTypeFromName (const char *texname)
 	return TEXTYPE_DEFAULT;
 }
 
+#define MAX_QUEUED_TEXTURES		16	// external textures being decoded ahead of the one being uploaded
+
+typedef struct {
+	texture_t		*tx;
+	const miptex_t	*mt;
+	int				pixels;
+	texjob_t		*job;
+} pendingtex_t;
+
+// textures of the bsp being loaded, so that an error can clean up after Mod_LoadTextures
+static struct
+{
+	pendingtex_t	*list;
+	int				numfinished;	// jobs before this have been collected
+	int				numqueued;		// jobs from here on haven't been started
+} mod_pendingtex;
+
+/*
+=================
+Mod_CancelPendingTextures
+=================
+*/
+static void Mod_CancelPendingTextures (void)
+{
+	int i;
+
+	for (i = mod_pendingtex.numfinished; i < mod_pendingtex.numqueued; i++)
+		TexMgr_CancelExternalImage (mod_pendingtex.list[i].job);
+	free (mod_pendingtex.list);
+	memset (&mod_pendingtex, 0, sizeof (mod_pendingtex));
+}
+
+/*
+=================
+Mod_QueueExternalTexture
+
+external textures -- first look in "textures/mapname/" then look in "textures/"
+=================
+*/
+static texjob_t *Mod_QueueExternalTexture (const texture_t *tx, const char *mapname)
+{
+	char	filename[MAX_OSPATH], altname[MAX_OSPATH];
+	int		extraflags = TEXPREF_BINDLESS;
+
+	if (TEXTYPE_ISLIQUID (tx->type))
+	{
+		q_snprintf (filename, sizeof(filename), "textures/%s/#%s", mapname, tx->name+1); //this also replaces the '*' with a '#'
+		q_snprintf (altname, sizeof(altname), "textures/#%s", tx->name+1);
+		return TexMgr_QueueExternalImage (filename, altname, TEXPREF_MIPMAP | extraflags, false);
+	}
+
+	if (tx->type == TEXTYPE_CUTOUT)
+		extraflags |= TEXPREF_ALPHA;
+	q_snprintf (filename, sizeof(filename), "textures/%s/%s", mapname, tx->name);
+	q_snprintf (altname, sizeof(altname), "textures/%s", tx->name);
+	return TexMgr_QueueExternalImage (filename, altname, TEXPREF_MIPMAP | extraflags, true);
+}
+
+/*
+=================
+Mod_LoadBspTexture
+
+uploads the texture from the bsp file when no external image was found
+=================
+*/
+static void Mod_LoadBspTexture (texture_t *tx, const miptex_t *mt, int pixels)
+{
+	char			texturename[64];
+	src_offset_t	offset;
+	int				extraflags = TEXPREF_BINDLESS;
+
+	q_snprintf (texturename, sizeof(texturename), "%s:%s", loadmodel->name, tx->name);
+	offset = (src_offset_t)(mt+1) - (src_offset_t)mod_base;
+
+	if (TEXTYPE_ISLIQUID (tx->type))
+	{
+		tx->gltexture = TexMgr_LoadImage (loadmodel, texturename, tx->width, tx->height,
+			SRC_INDEXED, (byte *)(tx+1), loadmodel->name, offset, TEXPREF_MIPMAP | extraflags);
+		return;
+	}
+
+	if (tx->type == TEXTYPE_CUTOUT)
+		extraflags |= TEXPREF_ALPHA;
+
+	if (Mod_CheckFullbrights ((byte *)(tx+1), pixels))
+	{
+		if (tx->type != TEXTYPE_CUTOUT)
+		{
+			tx->gltexture = TexMgr_LoadImage (loadmodel, texturename, tx->width, tx->height,
+				SRC_INDEXED, (byte *)(tx+1), loadmodel->name, offset, TEXPREF_MIPMAP | TEXPREF_ALPHABRIGHT | extraflags);
+		}
+		else
+		{
+			tx->gltexture = TexMgr_LoadImage (loadmodel, texturename, tx->width, tx->height,
+				SRC_INDEXED, (byte *)(tx+1), loadmodel->name, offset, TEXPREF_MIPMAP | TEXPREF_NOBRIGHT | extraflags);
+			q_snprintf (texturename, sizeof(texturename), "%s:%s_glow", loadmodel->name, tx->name);
+			tx->fullbright = TexMgr_LoadImage (loadmodel, texturename, tx->width, tx->height,
+				SRC_INDEXED, (byte *)(tx+1), loadmodel->name, offset, TEXPREF_MIPMAP | TEXPREF_FULLBRIGHT | extraflags);
+		}
+	}
+	else
+	{
+		tx->gltexture = TexMgr_LoadImage (loadmodel, texturename, tx->width, tx->height,
+			SRC_INDEXED, (byte *)(tx+1), loadmodel->name, offset, TEXPREF_MIPMAP | extraflags);
+	}
+}
+
 /*
 =================
 Mod_LoadTextures
@@ -512,20 +872,19 @@ Mod_LoadTextures
 static void Mod_LoadTextures (lump_t *l)
 {
 	int		i, j, pixels, num, maxanim, altmax;
-	miptex_t	*mt;
+	int		dataofs, mtwidth, mtheight;
+	const miptex_t	*mt;
 	texture_t	*tx, *tx2;
 	texture_t	*anims[10];
 	texture_t	*altanims[10];
-	dmiptexlump_t	*m;
+	const dmiptexlump_t	*m;
 //johnfitz -- more variables
-	char		texturename[64];
 	int			nummiptex;
-	src_offset_t		offset;
-	int			mark, fwidth, fheight;
-	char		filename[MAX_OSPATH], mapname[MAX_OSPATH];
-	byte		*data;
-	enum srcformat fmt;
+	char		mapname[MAX_OSPATH];
 //johnfitz
+	pendingtex_t	*pending;
+	int			numpending;
+	qboolean	found;
 
 	//johnfitz -- don't return early if no textures; still need to create dummy texture
 	if (!l->filelen)
@@ -536,39 +895,45 @@ static void Mod_LoadTextures (lump_t *l)
 	}
 	else
 	{
-		m = (dmiptexlump_t *)(mod_base + l->fileofs);
-		m->nummiptex = LittleLong (m->nummiptex);
-		nummiptex = m->nummiptex;
+		m = (const dmiptexlump_t *)(mod_base + l->fileofs);
+		nummiptex = LittleLong (m->nummiptex);
 	}
 	//johnfitz
 
 	loadmodel->numtextures = nummiptex + 2; //johnfitz -- need 2 dummy texture chains for missing textures
 	loadmodel->textures = (texture_t **) Hunk_AllocName (loadmodel->numtextures * sizeof(*loadmodel->textures) , loadname);
 
+	Mod_CancelPendingTextures ();
+	pending = nummiptex ? (pendingtex_t *) malloc (nummiptex * sizeof (*pending)) : NULL;
+	if (nummiptex && !pending)
+		Sys_Error ("Mod_LoadTextures: out of memory on %d textures", nummiptex);
+	mod_pendingtex.list = pending;
+	numpending = 0;
+
 	for (i=0 ; i<nummiptex ; i++)
 	{
-		m->dataofs[i] = LittleLong(m->dataofs[i]);
-		if (m->dataofs[i] == -1)
+		// the lump is only read, never swapped in place,
+		// so that the file can be a read-only mapped view
+		dataofs = LittleLong (m->dataofs[i]);
+		if (dataofs == -1)
 			continue;
-		mt = (miptex_t *)((byte *)m + m->dataofs[i]);
-		mt->width = LittleLong (mt->width);
-		mt->height = LittleLong (mt->height);
-		for (j=0 ; j<MIPLEVELS ; j++)
-			mt->offsets[j] = LittleLong (mt->offsets[j]);
+		mt = (const miptex_t *)((const byte *)m + dataofs);
+		mtwidth = LittleLong (mt->width);
+		mtheight = LittleLong (mt->height);
 
-		if (mt->width == 0 || mt->height == 0)
+		if (mtwidth == 0 || mtheight == 0)
 		{
 			Con_Warning ("Zero sized texture %s in %s!\n", mt->name, loadmodel->name);
 			continue;
 		}
 
-		if ( (mt->width & 15) || (mt->height & 15) )
+		if ( (mtwidth & 15) || (mtheight & 15) )
 		{
 			if (loadmodel->bspversion != BSPVERSION_QUAKE64)
-				Con_Warning ("Texture %s (%d x %d) is not 16 aligned\n", mt->name, mt->width, mt->height);
+				Con_Warning ("Texture %s (%d x %d) is not 16 aligned\n", mt->name, mtwidth, mtheight);
 		}
 
-		pixels = mt->width*mt->height; // only copy the first mip, the rest are auto-generated
+		pixels = mtwidth*mtheight; // only copy the first mip, the rest are auto-generated
 		tx = (texture_t *) Hunk_AllocNameNoFill (sizeof(texture_t) +pixels, loadname );
 		// only clear the texture struct, not the pixel buffer following it
 		memset (tx, 0, sizeof (*tx));
@@ -580,18 +945,18 @@ static void Mod_LoadTextures (lump_t *l)
 			q_snprintf (tx->name, sizeof(tx->name), "unnamed%d", i);
 			Con_Warning ("unnamed texture in %s, renaming to %s\n", loadmodel->name, tx->name);
 		}
-		tx->width = mt->width;
-		tx->height = mt->height;
+		tx->width = mtwidth;
+		tx->height = mtheight;
 		// the pixels immediately follow the structures
 
 		// ericw -- check for pixels extending past the end of the lump.
 		// appears in the wild; e.g. jam2_tronyn.bsp (func_mapjam2),
 		// kellbase1.bsp (quoth), and can lead to a segfault if we read past
 		// the end of the .bsp file buffer
-		if (((byte*)(mt+1) + pixels) > (mod_base + l->fileofs + l->filelen))
+		if (((const byte*)(mt+1) + pixels) > (mod_base + l->fileofs + l->filelen))
 		{
 			Con_DPrintf("Texture %s extends past end of lump\n", mt->name);
-			pixels = q_max(0L, (long)((mod_base + l->fileofs + l->filelen) - (byte*)(mt+1)));
+			pixels = q_max(0L, (long)((mod_base + l->fileofs + l->filelen) - (const byte*)(mt+1)));
 		}
 
 		tx->fullbright = NULL; //johnfitz
@@ -604,12 +969,12 @@ static void Mod_LoadTextures (lump_t *l)
 		}
 		else
 		{ // Q64 bsp
-			miptex64_t *mt64 = (miptex64_t *)mt;
+			const miptex64_t *mt64 = (const miptex64_t *)mt;
 			tx->shift = LittleLong (mt64->shift);
 			memcpy ( tx+1, mt64+1, pixels);
 		}
 
-		if (!isDedicated) //no texture uploading for dedicated server
+		if (!isDedicated && !isHeadless) //no texture uploading for dedicated server or headless runs
 		{
 			if (tx->type == TEXTYPE_SKY)
 			{
@@ -618,103 +983,35 @@ static void Mod_LoadTextures (lump_t *l)
 				else
 					Sky_LoadTexture (loadmodel, tx);
 			}
-			else if (TEXTYPE_ISLIQUID (tx->type))
+			else
 			{
-				//external textures -- first look in "textures/mapname/" then look in "textures/"
-				mark = Hunk_LowMark();
-				COM_StripExtension (loadmodel->name + 5, mapname, sizeof(mapname));
-				q_snprintf (filename, sizeof(filename), "textures/%s/#%s", mapname, tx->name+1); //this also replaces the '*' with a '#'
-				data = Image_LoadImage (filename, &fwidth, &fheight, &fmt);
-				if (!data)
-				{
-					q_snprintf (filename, sizeof(filename), "textures/#%s", tx->name+1);
-					data = Image_LoadImage (filename, &fwidth, &fheight, &fmt);
-				}
-
-				//now load whatever we found
-				if (data) //load external image
-				{
-					q_strlcpy (texturename, filename, sizeof(texturename));
-					tx->gltexture = TexMgr_LoadImage (loadmodel, texturename, fwidth, fheight,
-						fmt, data, filename, 0, TEXPREF_MIPMAP | TEXPREF_BINDLESS);
-				}
-				else //use the texture from the bsp file
-				{
-					q_snprintf (texturename, sizeof(texturename), "%s:%s", loadmodel->name, tx->name);
-					offset = (src_offset_t)(mt+1) - (src_offset_t)mod_base;
-					tx->gltexture = TexMgr_LoadImage (loadmodel, texturename, tx->width, tx->height,
-						SRC_INDEXED, (byte *)(tx+1), loadmodel->name, offset, TEXPREF_MIPMAP | TEXPREF_BINDLESS);
-				}
+				pending[numpending].tx = tx;
+				pending[numpending].mt = mt;
+				pending[numpending].pixels = pixels;
+				pending[numpending].job = NULL;
+				numpending++;
 			}
-			else //regular texture
-			{
-				int	extraflags = TEXPREF_BINDLESS;
-				if (tx->type == TEXTYPE_CUTOUT)
-					extraflags |= TEXPREF_ALPHA;
-
-				//external textures -- first look in "textures/mapname/" then look in "textures/"
-				mark = Hunk_LowMark ();
-				COM_StripExtension (loadmodel->name + 5, mapname, sizeof(mapname));
-				q_snprintf (filename, sizeof(filename), "textures/%s/%s", mapname, tx->name);
-				data = Image_LoadImage (filename, &fwidth, &fheight, &fmt);
-				if (!data)
-				{
-					q_snprintf (filename, sizeof(filename), "textures/%s", tx->name);
-					data = Image_LoadImage (filename, &fwidth, &fheight, &fmt);
-				}
+		}
+		//johnfitz
+	}
 
-				//now load whatever we found
-				if (data) //load external image
-				{
-					char filename2[MAX_OSPATH];
-					tx->gltexture = TexMgr_LoadImage (loadmodel, filename, fwidth, fheight,
-						fmt, data, filename, 0, TEXPREF_MIPMAP | extraflags );
+	// external images are decoded in the background, a few textures ahead of the one being uploaded
+	// an error on the way is cleaned up by Mod_AbortLoadTasks
+	COM_StripExtension (loadmodel->name + 5, mapname, sizeof(mapname));
+	for (i = 0; i < numpending; i++)
+	{
+		pendingtex_t *p = &pending[i];
 
-					//now try to load glow/luma image from the same place
-					Hunk_FreeToLowMark (mark);
-					q_snprintf (filename2, sizeof(filename2), "%s_glow", filename);
-					data = Image_LoadImage (filename2, &fwidth, &fheight, &fmt);
-					if (!data)
-					{
-						q_snprintf (filename2, sizeof(filename2), "%s_luma", filename);
-						data = Image_LoadImage (filename2, &fwidth, &fheight, &fmt);
-					}
+		for (; mod_pendingtex.numqueued < numpending && mod_pendingtex.numqueued < i + MAX_QUEUED_TEXTURES; mod_pendingtex.numqueued++)
+			pending[mod_pendingtex.numqueued].job = Mod_QueueExternalTexture (pending[mod_pendingtex.numqueued].tx, mapname);
 
-					if (data)
-						tx->fullbright = TexMgr_LoadImage (loadmodel, filename2, fwidth, fheight,
-							fmt, data, filename2, 0, TEXPREF_MIPMAP | extraflags );
-				}
-				else //use the texture from the bsp file
-				{
-					q_snprintf (texturename, sizeof(texturename), "%s:%s", loadmodel->name, tx->name);
-					offset = (src_offset_t)(mt+1) - (src_offset_t)mod_base;
-					if (Mod_CheckFullbrights ((byte *)(tx+1), pixels))
-					{
-						if (tx->type != TEXTYPE_CUTOUT)
-						{
-							tx->gltexture = TexMgr_LoadImage (loadmodel, texturename, tx->width, tx->height,
-								SRC_INDEXED, (byte *)(tx+1), loadmodel->name, offset, TEXPREF_MIPMAP | TEXPREF_ALPHABRIGHT | extraflags);
-						}
-						else
-						{
-							tx->gltexture = TexMgr_LoadImage (loadmodel, texturename, tx->width, tx->height,
-								SRC_INDEXED, (byte *)(tx+1), loadmodel->name, offset, TEXPREF_MIPMAP | TEXPREF_NOBRIGHT | extraflags);
-							q_snprintf (texturename, sizeof(texturename), "%s:%s_glow", loadmodel->name, tx->name);
-							tx->fullbright = TexMgr_LoadImage (loadmodel, texturename, tx->width, tx->height,
-								SRC_INDEXED, (byte *)(tx+1), loadmodel->name, offset, TEXPREF_MIPMAP | TEXPREF_FULLBRIGHT | extraflags);
-						}
-					}
-					else
-					{
-						tx->gltexture = TexMgr_LoadImage (loadmodel, texturename, tx->width, tx->height,
-							SRC_INDEXED, (byte *)(tx+1), loadmodel->name, offset, TEXPREF_MIPMAP | extraflags);
-					}
-				}
-				Hunk_FreeToLowMark (mark);
-			}
-		}
-		//johnfitz
+		tx = p->tx;
+		found = TexMgr_FinishExternalImage (p->job, loadmodel, &tx->gltexture, TEXTYPE_ISLIQUID (tx->type) ? NULL : &tx->fullbright);
+		mod_pendingtex.numfinished++;
+		if (!found)
+			Mod_LoadBspTexture (tx, p->mt, p->pixels);
 	}
+	Mod_CancelPendingTextures ();
 
 	//johnfitz -- last 2 slots in array should be filled with dummy textures
 	loadmodel->textures[loadmodel->numtextures-2] = r_notexture_mip; //for lightmapped surfs
@@ -822,11 +1119,51 @@ static void Mod_LoadTextures (lump_t *l)
 Mod_LoadLighting -- johnfitz -- replaced with lit support code via lordhavoc
 =================
 */
-static void Mod_LoadLighting (lump_t *l)
+static const char *Mod_ExpandLighting (loadtask_t *task)
+{
+	const byte *in = (const byte *) task->in;
+	byte *out = (byte *) task->out;
+	byte d;
+	int i;
+
+	for (i = 0;i < task->count;i++)
+	{
+		d = *in++;
+		*out++ = d;
+		*out++ = d;
+		*out++ = d;
+	}
+
+	return NULL;
+}
+
+static const char *Mod_ExpandLightingQ64 (loadtask_t *task)
+{
+	const byte *src = (const byte *) task->in;
+	byte *out = (byte *) task->out;
+	byte q64_b0, q64_b1;
+	int i;
+
+	// RGB lightmap samples are packed in 16bits.
+	// RRRRR GGGGG BBBBBB
+
+	for (i = 0;i < task->count;i++)
+	{
+		q64_b0 = *src++;
+		q64_b1 = *src++;
+
+		*out++ = q64_b0 & 0xf8;/* 0b11111000 */
+		*out++ = ((q64_b0 & 0x07) << 5) + ((q64_b1 & 0xc0) >> 5);/* 0b00000111, 0b11000000 */
+		*out++ = (q64_b1 & 0x3f) << 2;/* 0b00111111 */
+	}
+
+	return NULL;
+}
+
+static loadtask_t *Mod_LoadLighting (lump_t *l)
 {
 	int i, mark;
-	byte *in, *out, *data;
-	byte d, q64_b0, q64_b1;
+	byte *data;
 	char litfilename[MAX_OSPATH];
 	unsigned int path_id;
 
@@ -858,7 +1195,7 @@ static void Mod_LoadLighting (lump_t *l)
 					Con_DPrintf2("%s loaded\n", litfilename);
 					loadmodel->lightdata = data + 8;
 					loadmodel->litfile = true;
-					return;
+					return NULL;
 				}
 				Hunk_FreeToLowMark(mark);
 				Con_Printf("Outdated .lit file (%s should be %u bytes, not %" SDL_PRIs64 "\n", litfilename, 8+l->filelen*3, com_filesize);
@@ -877,59 +1214,46 @@ static void Mod_LoadLighting (lump_t *l)
 	}
 	// LordHavoc: no .lit found, expand the white lighting data to color
 	if (!l->filelen)
-		return;
+		return NULL;
 
 	// Quake64 bsp lighmap data
 	if (loadmodel->bspversion == BSPVERSION_QUAKE64)
 	{
-		// RGB lightmap samples are packed in 16bits.
-		// RRRRR GGGGG BBBBBB
-
 		loadmodel->lightdata = (byte *) Hunk_AllocNameNoFill ( (l->filelen / 2)*3, litfilename);
-		in = mod_base + l->fileofs;
-		out = loadmodel->lightdata;
-
-		for (i = 0;i < (l->filelen / 2) ;i++)
-		{
-			q64_b0 = *in++;
-			q64_b1 = *in++;
-
-			*out++ = q64_b0 & 0xf8;/* 0b11111000 */
-			*out++ = ((q64_b0 & 0x07) << 5) + ((q64_b1 & 0xc0) >> 5);/* 0b00000111, 0b11000000 */
-			*out++ = (q64_b1 & 0x3f) << 2;/* 0b00111111 */
-		}
-		return;
+		return Mod_AddLoadTask ("lighting", Mod_ExpandLightingQ64, mod_base + l->fileofs, loadmodel->lightdata, l->filelen / 2, 0);
 	}
 
 	loadmodel->lightdata = (byte *) Hunk_AllocNameNoFill ( l->filelen*3, litfilename);
-	in = loadmodel->lightdata + l->filelen*2; // place the file at the end, so it will not be overwritten until the very last write
-	out = loadmodel->lightdata;
-	memcpy (in, mod_base + l->fileofs, l->filelen);
-	for (i = 0;i < l->filelen;i++)
-	{
-		d = *in++;
-		*out++ = d;
-		*out++ = d;
-		*out++ = d;
-	}
+	return Mod_AddLoadTask ("lighting", Mod_ExpandLighting, mod_base + l->fileofs, loadmodel->lightdata, l->filelen, 0);
 }
 
 
+/*
+=================
+Mod_CopyLump
+=================
+*/
+static const char *Mod_CopyLump (loadtask_t *task)
+{
+	memcpy (task->out, task->in, task->count);
+	return NULL;
+}
+
 /*
 =================
 Mod_LoadVisibility
 =================
 */
-static void Mod_LoadVisibility (lump_t *l)
+static loadtask_t *Mod_LoadVisibility (lump_t *l)
 {
 	loadmodel->viswarn = false;
 	if (!l->filelen)
 	{
 		loadmodel->visdata = NULL;
-		return;
+		return NULL;
 	}
 	loadmodel->visdata = (byte *) Hunk_AllocNameNoFill ( l->filelen, loadname);
-	memcpy (loadmodel->visdata, mod_base + l->fileofs, l->filelen);
+	return Mod_AddLoadTask ("visibility", Mod_CopyLump, mod_base + l->fileofs, loadmodel->visdata, l->filelen, 0);
 }
 
 
@@ -997,18 +1321,39 @@ _load_embedded:
 }
 
 
+/*
+=================
+Mod_DecodeVertexes
+=================
+*/
+static const char *Mod_DecodeVertexes (loadtask_t *task)
+{
+	const dvertex_t	*in = (const dvertex_t *) task->in;
+	mvertex_t	*out = (mvertex_t *) task->out;
+	int			i;
+
+	for (i=0 ; i<task->count ; i++, in++, out++)
+	{
+		out->position[0] = LittleFloat (in->point[0]);
+		out->position[1] = LittleFloat (in->point[1]);
+		out->position[2] = LittleFloat (in->point[2]);
+	}
+
+	return NULL;
+}
+
 /*
 =================
 Mod_LoadVertexes
 =================
 */
-static void Mod_LoadVertexes (lump_t *l)
+static loadtask_t *Mod_LoadVertexes (lump_t *l)
 {
-	dvertex_t	*in;
+	const dvertex_t	*in;
 	mvertex_t	*out;
-	int			i, count;
+	int			count;
 
-	in = (dvertex_t *)(mod_base + l->fileofs);
+	in = (const dvertex_t *)(mod_base + l->fileofs);
 	if (l->filelen % sizeof(*in))
 		Sys_Error ("MOD_LoadBmodel: funny lump size in %s",loadmodel->name);
 	count = l->filelen / sizeof(*in);
@@ -1017,38 +1362,24 @@ static void Mod_LoadVertexes (lump_t *l)
 	loadmodel->vertexes = out;
 	loadmodel->numvertexes = count;
 
-	for (i=0 ; i<count ; i++, in++, out++)
-	{
-		out->position[0] = LittleFloat (in->point[0]);
-		out->position[1] = LittleFloat (in->point[1]);
-		out->position[2] = LittleFloat (in->point[2]);
-	}
+	return Mod_AddLoadTask ("vertexes", Mod_DecodeVertexes, in, out, count, 0);
 }
 
 /*
 =================
-Mod_LoadEdges
+Mod_DecodeEdges
 =================
 */
-static void Mod_LoadEdges (lump_t *l, int bsp2)
+static const char *Mod_DecodeEdges (loadtask_t *task)
 {
-	medge_t *out;
-	int 	i, count;
+	medge_t *out = (medge_t *) task->out;
+	int 	i;
 
-	if (bsp2)
+	if (task->bsp2)
 	{
-		dledge_t *in = (dledge_t *)(mod_base + l->fileofs);
-
-		if (l->filelen % sizeof(*in))
-			Sys_Error ("MOD_LoadBmodel: funny lump size in %s",loadmodel->name);
+		const dledge_t *in = (const dledge_t *) task->in;
 
-		count = l->filelen / sizeof(*in);
-		out = (medge_t *) Hunk_AllocNameNoFill ( (count + 1) * sizeof(*out), loadname);
-
-		loadmodel->edges = out;
-		loadmodel->numedges = count;
-
-		for (i=0 ; i<count ; i++, in++, out++)
+		for (i=0 ; i<task->count ; i++, in++, out++)
 		{
 			out->v[0] = LittleLong(in->v[0]);
 			out->v[1] = LittleLong(in->v[1]);
@@ -1056,47 +1387,56 @@ static void Mod_LoadEdges (lump_t *l, int bsp2)
 	}
 	else
 	{
-		dsedge_t *in = (dsedge_t *)(mod_base + l->fileofs);
+		const dsedge_t *in = (const dsedge_t *) task->in;
 
-		if (l->filelen % sizeof(*in))
-			Sys_Error ("MOD_LoadBmodel: funny lump size in %s",loadmodel->name);
-
-		count = l->filelen / sizeof(*in);
-		out = (medge_t *) Hunk_AllocNameNoFill ( (count + 1) * sizeof(*out), loadname);
-
-		loadmodel->edges = out;
-		loadmodel->numedges = count;
-
-		for (i=0 ; i<count ; i++, in++, out++)
+		for (i=0 ; i<task->count ; i++, in++, out++)
 		{
 			out->v[0] = (unsigned short)LittleShort(in->v[0]);
 			out->v[1] = (unsigned short)LittleShort(in->v[1]);
 		}
 	}
+
+	return NULL;
 }
 
 /*
 =================
-Mod_LoadTexinfo
+Mod_LoadEdges
 =================
 */
-static void Mod_LoadTexinfo (lump_t *l)
+static loadtask_t *Mod_LoadEdges (lump_t *l, int bsp2)
 {
-	texinfo_t *in;
-	mtexinfo_t *out;
-	int	i, j, count, miptex;
-	int missing = 0; //johnfitz
+	size_t	size = bsp2 ? sizeof(dledge_t) : sizeof(dsedge_t);
+	medge_t *out;
+	int 	count;
 
-	in = (texinfo_t *)(mod_base + l->fileofs);
-	if (l->filelen % sizeof(*in))
+	if (l->filelen % size)
 		Sys_Error ("MOD_LoadBmodel: funny lump size in %s",loadmodel->name);
-	count = l->filelen / sizeof(*in);
-	out = (mtexinfo_t *) Hunk_AllocNameNoFill ( count*sizeof(*out), loadname);
 
-	loadmodel->texinfo = out;
-	loadmodel->numtexinfo = count;
+	count = l->filelen / size;
+	out = (medge_t *) Hunk_AllocNameNoFill ( (count + 1) * sizeof(*out), loadname);
 
-	for (i=0 ; i<count ; i++, in++, out++)
+	loadmodel->edges = out;
+	loadmodel->numedges = count;
+
+	return Mod_AddLoadTask ("edges", Mod_DecodeEdges, mod_base + l->fileofs, out, count, bsp2);
+}
+
+/*
+=================
+Mod_DecodeTexinfo
+
+Needs the textures to be loaded, task->result is set to the number of missing textures
+=================
+*/
+static const char *Mod_DecodeTexinfo (loadtask_t *task)
+{
+	const texinfo_t *in = (const texinfo_t *) task->in;
+	mtexinfo_t *out = (mtexinfo_t *) task->out;
+	int	i, j, miptex;
+	int missing = 0; //johnfitz
+
+	for (i=0 ; i<task->count ; i++, in++, out++)
 	{
 		for (j=0 ; j<4 ; j++)
 		{
@@ -1124,10 +1464,31 @@ static void Mod_LoadTexinfo (lump_t *l)
 		//johnfitz
 	}
 
-	//johnfitz: report missing textures
-	if (missing && loadmodel->numtextures > 1)
-		Con_Printf ("Mod_LoadTexinfo: %d texture(s) missing from BSP file\n", missing);
-	//johnfitz
+	task->result = missing;
+	return NULL;
+}
+
+/*
+=================
+Mod_LoadTexinfo
+=================
+*/
+static loadtask_t *Mod_LoadTexinfo (lump_t *l)
+{
+	const texinfo_t *in;
+	mtexinfo_t *out;
+	int	count;
+
+	in = (const texinfo_t *)(mod_base + l->fileofs);
+	if (l->filelen % sizeof(*in))
+		Sys_Error ("MOD_LoadBmodel: funny lump size in %s",loadmodel->name);
+	count = l->filelen / sizeof(*in);
+	out = (mtexinfo_t *) Hunk_AllocNameNoFill ( count*sizeof(*out), loadname);
+
+	loadmodel->texinfo = out;
+	loadmodel->numtexinfo = count;
+
+	return Mod_AddLoadTask ("texinfo", Mod_DecodeTexinfo, in, out, count, 0);
 }
 
 /*
@@ -1207,8 +1568,8 @@ Mod_LoadFaces
 */
 static void Mod_LoadFaces (lump_t *l, qboolean bsp2)
 {
-	dsface_t	*ins;
-	dlface_t	*inl;
+	const dsface_t	*ins;
+	const dlface_t	*inl;
 	msurface_t 	*out;
 	int			i, count, surfnum, lofs;
 	int			planenum, side, texinfon;
@@ -1216,14 +1577,14 @@ static void Mod_LoadFaces (lump_t *l, qboolean bsp2)
 	if (bsp2)
 	{
 		ins = NULL;
-		inl = (dlface_t *)(mod_base + l->fileofs);
+		inl = (const dlface_t *)(mod_base + l->fileofs);
 		if (l->filelen % sizeof(*inl))
 			Sys_Error ("MOD_LoadBmodel: funny lump size in %s",loadmodel->name);
 		count = l->filelen / sizeof(*inl);
 	}
 	else
 	{
-		ins = (dsface_t *)(mod_base + l->fileofs);
+		ins = (const dsface_t *)(mod_base + l->fileofs);
 		inl = NULL;
 		if (l->filelen % sizeof(*ins))
 			Sys_Error ("MOD_LoadBmodel: funny lump size in %s",loadmodel->name);
@@ -1357,10 +1718,10 @@ Mod_LoadNodes
 static void Mod_LoadNodes_S (lump_t *l)
 {
 	int			i, j, count, p;
-	dsnode_t	*in;
+	const dsnode_t	*in;
 	mnode_t		*out;
 
-	in = (dsnode_t *)(mod_base + l->fileofs);
+	in = (const dsnode_t *)(mod_base + l->fileofs);
 	if (l->filelen % sizeof(*in))
 		Sys_Error ("MOD_LoadBmodel: funny lump size in %s",loadmodel->name);
 	count = l->filelen / sizeof(*in);
@@ -1413,10 +1774,10 @@ static void Mod_LoadNodes_S (lump_t *l)
 static void Mod_LoadNodes_L1 (lump_t *l)
 {
 	int			i, j, count, p;
-	dl1node_t	*in;
+	const dl1node_t	*in;
 	mnode_t		*out;
 
-	in = (dl1node_t *)(mod_base + l->fileofs);
+	in = (const dl1node_t *)(mod_base + l->fileofs);
 	if (l->filelen % sizeof(*in))
 		Sys_Error ("Mod_LoadNodes: funny lump size in %s",loadmodel->name);
 
@@ -1465,10 +1826,10 @@ static void Mod_LoadNodes_L1 (lump_t *l)
 static void Mod_LoadNodes_L2 (lump_t *l)
 {
 	int			i, j, count, p;
-	dl2node_t	*in;
+	const dl2node_t	*in;
 	mnode_t		*out;
 
-	in = (dl2node_t *)(mod_base + l->fileofs);
+	in = (const dl2node_t *)(mod_base + l->fileofs);
 	if (l->filelen % sizeof(*in))
 		Sys_Error ("Mod_LoadNodes: funny lump size in %s",loadmodel->name);
 
@@ -1526,7 +1887,7 @@ static void Mod_LoadNodes (lump_t *l, int bsp2)
 	Mod_SetParent (loadmodel->nodes, NULL);	// sets nodes and leafs
 }
 
-static void Mod_ProcessLeafs_S (dsleaf_t *in, int filelen)
+static void Mod_ProcessLeafs_S (const dsleaf_t *in, int filelen)
 {
 	mleaf_t		*out;
 	int			i, j, count, p;
@@ -1571,7 +1932,7 @@ static void Mod_ProcessLeafs_S (dsleaf_t *in, int filelen)
 	}
 }
 
-static void Mod_ProcessLeafs_L1 (dl1leaf_t *in, int filelen)
+static void Mod_ProcessLeafs_L1 (const dl1leaf_t *in, int filelen)
 {
 	mleaf_t		*out;
 	int			i, j, count, p;
@@ -1613,7 +1974,7 @@ static void Mod_ProcessLeafs_L1 (dl1leaf_t *in, int filelen)
 	}
 }
 
-static void Mod_ProcessLeafs_L2 (dl2leaf_t *in, int filelen)
+static void Mod_ProcessLeafs_L2 (const dl2leaf_t *in, int filelen)
 {
 	mleaf_t		*out;
 	int			i, j, count, p;
@@ -1662,14 +2023,14 @@ Mod_LoadLeafs
 */
 static void Mod_LoadLeafs (lump_t *l, int bsp2)
 {
-	void *in = (void *)(mod_base + l->fileofs);
+	const void *in = (const void *)(mod_base + l->fileofs);
 
 	if (bsp2 == 2)
-		Mod_ProcessLeafs_L2 ((dl2leaf_t *)in, l->filelen);
+		Mod_ProcessLeafs_L2 ((const dl2leaf_t *)in, l->filelen);
 	else if (bsp2)
-		Mod_ProcessLeafs_L1 ((dl1leaf_t *)in, l->filelen);
+		Mod_ProcessLeafs_L1 ((const dl1leaf_t *)in, l->filelen);
 	else
-		Mod_ProcessLeafs_S  ((dsleaf_t *) in, l->filelen);
+		Mod_ProcessLeafs_S  ((const dsleaf_t *) in, l->filelen);
 }
 
 /*
@@ -1831,24 +2192,78 @@ static void Mod_FindUsedTextures (qmodel_t *mod)
 	//Con_Printf("%s: %d/%d textures\n", mod->name, count, mod->numtextures);
 }
 
+/*
+=================
+Mod_DecodeClipnodes
+=================
+*/
+static const char *Mod_DecodeClipnodes (loadtask_t *task)
+{
+	const dsclipnode_t *ins = (const dsclipnode_t *) task->in;
+	const dlclipnode_t *inl = (const dlclipnode_t *) task->in;
+	mclipnode_t *out = (mclipnode_t *) task->out;
+	int			i, count = task->count;
+
+	if (task->bsp2)
+	{
+		for (i=0 ; i<count ; i++, out++, inl++)
+		{
+			out->planenum = LittleLong(inl->planenum);
+
+			//johnfitz -- bounds check
+			if (out->planenum < 0 || out->planenum >= loadmodel->numplanes)
+				return "Mod_LoadClipnodes: planenum out of bounds";
+			//johnfitz
+
+			out->children[0] = LittleLong(inl->children[0]);
+			out->children[1] = LittleLong(inl->children[1]);
+			//Spike: FIXME: bounds check
+		}
+	}
+	else
+	{
+		for (i=0 ; i<count ; i++, out++, ins++)
+		{
+			out->planenum = LittleLong(ins->planenum);
+
+			//johnfitz -- bounds check
+			if (out->planenum < 0 || out->planenum >= loadmodel->numplanes)
+				return "Mod_LoadClipnodes: planenum out of bounds";
+			//johnfitz
+
+			//johnfitz -- support clipnodes > 32k
+			out->children[0] = (unsigned short)LittleShort(ins->children[0]);
+			out->children[1] = (unsigned short)LittleShort(ins->children[1]);
+
+			if (out->children[0] >= count)
+				out->children[0] -= 65536;
+			if (out->children[1] >= count)
+				out->children[1] -= 65536;
+			//johnfitz
+		}
+	}
+
+	return NULL;
+}
+
 /*
 =================
 Mod_LoadClipnodes
 =================
 */
-static void Mod_LoadClipnodes (lump_t *l, qboolean bsp2)
+static loadtask_t *Mod_LoadClipnodes (lump_t *l, qboolean bsp2)
 {
-	dsclipnode_t *ins;
-	dlclipnode_t *inl;
+	const dsclipnode_t *ins;
+	const dlclipnode_t *inl;
 
 	mclipnode_t *out; //johnfitz -- was dclipnode_t
-	int			i, count;
+	int			count;
 	hull_t		*hull;
 
 	if (bsp2)
 	{
 		ins = NULL;
-		inl = (dlclipnode_t *)(mod_base + l->fileofs);
+		inl = (const dlclipnode_t *)(mod_base + l->fileofs);
 		if (l->filelen % sizeof(*inl))
 			Sys_Error ("Mod_LoadClipnodes: funny lump size in %s",loadmodel->name);
 
@@ -1856,7 +2271,7 @@ static void Mod_LoadClipnodes (lump_t *l, qboolean bsp2)
 	}
 	else
 	{
-		ins = (dsclipnode_t *)(mod_base + l->fileofs);
+		ins = (const dsclipnode_t *)(mod_base + l->fileofs);
 		inl = NULL;
 		if (l->filelen % sizeof(*ins))
 			Sys_Error ("Mod_LoadClipnodes: funny lump size in %s",loadmodel->name);
@@ -1897,44 +2312,7 @@ static void Mod_LoadClipnodes (lump_t *l, qboolean bsp2)
 	hull->clip_maxs[1] = 32;
 	hull->clip_maxs[2] = 64;
 
-	if (bsp2)
-	{
-		for (i=0 ; i<count ; i++, out++, inl++)
-		{
-			out->planenum = LittleLong(inl->planenum);
-
-			//johnfitz -- bounds check
-			if (out->planenum < 0 || out->planenum >= loadmodel->numplanes)
-				Host_Error ("Mod_LoadClipnodes: planenum out of bounds");
-			//johnfitz
-
-			out->children[0] = LittleLong(inl->children[0]);
-			out->children[1] = LittleLong(inl->children[1]);
-			//Spike: FIXME: bounds check
-		}
-	}
-	else
-	{
-		for (i=0 ; i<count ; i++, out++, ins++)
-		{
-			out->planenum = LittleLong(ins->planenum);
-
-			//johnfitz -- bounds check
-			if (out->planenum < 0 || out->planenum >= loadmodel->numplanes)
-				Host_Error ("Mod_LoadClipnodes: planenum out of bounds");
-			//johnfitz
-
-			//johnfitz -- support clipnodes > 32k
-			out->children[0] = (unsigned short)LittleShort(ins->children[0]);
-			out->children[1] = (unsigned short)LittleShort(ins->children[1]);
-
-			if (out->children[0] >= count)
-				out->children[0] -= 65536;
-			if (out->children[1] >= count)
-				out->children[1] -= 65536;
-			//johnfitz
-		}
-	}
+	return Mod_AddLoadTask ("clipnodes", Mod_DecodeClipnodes, bsp2 ? (const void *) inl : (const void *) ins, out, count, bsp2);
 }
 
 /*
@@ -1987,7 +2365,7 @@ static void Mod_LoadMarksurfaces (lump_t *l, int bsp2)
 	int		*out;
 	if (bsp2)
 	{
-		unsigned int *in = (unsigned int *)(mod_base + l->fileofs);
+		const unsigned int *in = (const unsigned int *)(mod_base + l->fileofs);
 
 		if (l->filelen % sizeof(*in))
 			Host_Error ("Mod_LoadMarksurfaces: funny lump size in %s",loadmodel->name);
@@ -2008,7 +2386,7 @@ static void Mod_LoadMarksurfaces (lump_t *l, int bsp2)
 	}
 	else
 	{
-		short *in = (short *)(mod_base + l->fileofs);
+		const short *in = (const short *)(mod_base + l->fileofs);
 
 		if (l->filelen % sizeof(*in))
 			Host_Error ("Mod_LoadMarksurfaces: funny lump size in %s",loadmodel->name);
@@ -2034,17 +2412,35 @@ static void Mod_LoadMarksurfaces (lump_t *l, int bsp2)
 	}
 }
 
+/*
+=================
+Mod_DecodeLongs
+=================
+*/
+static const char *Mod_DecodeLongs (loadtask_t *task)
+{
+	const int	*in = (const int *) task->in;
+	int			*out = (int *) task->out;
+	int			i;
+
+	for (i=0 ; i<task->count ; i++)
+		out[i] = LittleLong (in[i]);
+
+	return NULL;
+}
+
 /*
 =================
 Mod_LoadSurfedges
 =================
 */
-static void Mod_LoadSurfedges (lump_t *l)
+static loadtask_t *Mod_LoadSurfedges (lump_t *l)
 {
-	int		i, count;
-	int		*in, *out;
+	int		count;
+	const int	*in;
+	int		*out;
 
-	in = (int *)(mod_base + l->fileofs);
+	in = (const int *)(mod_base + l->fileofs);
 	if (l->filelen % sizeof(*in))
 		Sys_Error ("MOD_LoadBmodel: funny lump size in %s",loadmodel->name);
 	count = l->filelen / sizeof(*in);
@@ -2053,34 +2449,23 @@ static void Mod_LoadSurfedges (lump_t *l)
 	loadmodel->surfedges = out;
 	loadmodel->numsurfedges = count;
 
-	for (i=0 ; i<count ; i++)
-		out[i] = LittleLong (in[i]);
+	return Mod_AddLoadTask ("surfedges", Mod_DecodeLongs, in, out, count, 0);
 }
 
 
 /*
 =================
-Mod_LoadPlanes
+Mod_DecodePlanes
 =================
 */
-static void Mod_LoadPlanes (lump_t *l)
+static const char *Mod_DecodePlanes (loadtask_t *task)
 {
 	int			i, j;
-	mplane_t	*out;
-	dplane_t 	*in;
-	int			count;
+	mplane_t	*out = (mplane_t *) task->out;
+	const dplane_t 	*in = (const dplane_t *) task->in;
 	int			bits;
 
-	in = (dplane_t *)(mod_base + l->fileofs);
-	if (l->filelen % sizeof(*in))
-		Sys_Error ("MOD_LoadBmodel: funny lump size in %s",loadmodel->name);
-	count = l->filelen / sizeof(*in);
-	out = (mplane_t *) Hunk_AllocNameNoFill ( count*sizeof(*out), loadname);
-
-	loadmodel->planes = out;
-	loadmodel->numplanes = count;
-
-	for (i=0 ; i<count ; i++, in++, out++)
+	for (i=0 ; i<task->count ; i++, in++, out++)
 	{
 		bits = 0;
 		for (j=0 ; j<3 ; j++)
@@ -2095,6 +2480,31 @@ static void Mod_LoadPlanes (lump_t *l)
 		out->signbits = bits;
 		out->pad[0] = out->pad[1] = 0;
 	}
+
+	return NULL;
+}
+
+/*
+=================
+Mod_LoadPlanes
+=================
+*/
+static loadtask_t *Mod_LoadPlanes (lump_t *l)
+{
+	mplane_t	*out;
+	const dplane_t 	*in;
+	int			count;
+
+	in = (const dplane_t *)(mod_base + l->fileofs);
+	if (l->filelen % sizeof(*in))
+		Sys_Error ("MOD_LoadBmodel: funny lump size in %s",loadmodel->name);
+	count = l->filelen / sizeof(*in);
+	out = (mplane_t *) Hunk_AllocNameNoFill ( count*sizeof(*out), loadname);
+
+	loadmodel->planes = out;
+	loadmodel->numplanes = count;
+
+	return Mod_AddLoadTask ("planes", Mod_DecodePlanes, in, out, count, 0);
 }
 
 /*
@@ -2122,11 +2532,11 @@ Mod_LoadSubmodels
 */
 static void Mod_LoadSubmodels (lump_t *l)
 {
-	dmodel_t	*in;
+	const dmodel_t	*in;
 	dmodel_t	*out;
 	int			i, j, count;
 
-	in = (dmodel_t *)(mod_base + l->fileofs);
+	in = (const dmodel_t *)(mod_base + l->fileofs);
 	if (l->filelen % sizeof(*in))
 		Sys_Error ("MOD_LoadBmodel: funny lump size in %s",loadmodel->name);
 	count = l->filelen / sizeof(*in);
@@ -2325,19 +2735,26 @@ static void Mod_LoadLeafsExternal(FILE* f)
 Mod_LoadBrushModel
 =================
 */
-static void Mod_LoadBrushModel (qmodel_t *mod, void *buffer)
+static void Mod_LoadBrushModel (qmodel_t *mod, const void *buffer)
 {
 	int			i, j;
 	int			bsp2;
-	dheader_t	*header;
+	dheader_t	hdr;
+	dheader_t	*header = &hdr;
 	dmodel_t 	*bm;
 	float		radius; //johnfitz
+	double		time;
+	qboolean	tryvis;
+	loadtask_t	*textures, *texinfo;
 
 	loadmodel->type = mod_brush;
 
-	header = (dheader_t *)buffer;
+// swap all the lumps (into a local copy, the buffer itself is read-only)
+	memcpy (&hdr, buffer, sizeof (hdr));
+	for (i = 0; i < (int) sizeof(dheader_t) / 4; i++)
+		((int *)&hdr)[i] = LittleLong ( ((int *)&hdr)[i]);
 
-	mod->bspversion = LittleLong (header->version);
+	mod->bspversion = header->version;
 
 	switch(mod->bspversion)
 	{
@@ -2358,25 +2775,44 @@ static void Mod_LoadBrushModel (qmodel_t *mod, void *buffer)
 		break;
 	}
 
-// swap all the lumps
-	mod_base = (byte *)header;
-
-	for (i = 0; i < (int) sizeof(dheader_t) / 4; i++)
-		((int *)header)[i] = LittleLong ( ((int *)header)[i]);
+	mod_base = (const byte *)buffer;
 
 // load into heap
 
+	time = Sys_DoubleTime ();
+	tryvis = mod->bspversion == BSPVERSION && external_vis.value && sv.modelname[0] && !q_strcasecmp(loadname, sv.name);
+
+	// allocate the lumps that don't need GL state and decode them in the background
 	Mod_LoadVertexes (&header->lumps[LUMP_VERTEXES]);
 	Mod_LoadEdges (&header->lumps[LUMP_EDGES], bsp2);
 	Mod_LoadSurfedges (&header->lumps[LUMP_SURFEDGES]);
-	Mod_LoadTextures (&header->lumps[LUMP_TEXTURES]);
 	Mod_LoadLighting (&header->lumps[LUMP_LIGHTING]);
 	Mod_LoadPlanes (&header->lumps[LUMP_PLANES]);
-	Mod_LoadTexinfo (&header->lumps[LUMP_TEXINFO]);
+	Mod_LoadClipnodes (&header->lumps[LUMP_CLIPNODES], bsp2);
+	if (!tryvis)
+		Mod_LoadVisibility (&header->lumps[LUMP_VISIBILITY]);
+	textures = Mod_AddLoadTask ("textures", NULL, NULL, NULL, 0, 0);
+	texinfo = Mod_LoadTexinfo (&header->lumps[LUMP_TEXINFO]);
+	Mod_AddLoadDependency (texinfo, textures);
+	Mod_StartLoadTasks ();
+
+	// texture uploads stay on the main thread
+	Mod_LoadTextures (&header->lumps[LUMP_TEXTURES]);
+	Mod_CompleteLoadStep (textures, time);
+	Mod_WaitLoadTasks ();
+
+	//johnfitz: report missing textures
+	if (texinfo->result && loadmodel->numtextures > 1)
+		Con_Printf ("Mod_LoadTexinfo: %d texture(s) missing from BSP file\n", texinfo->result);
+	//johnfitz
+
+	time = Sys_DoubleTime ();
 	Mod_LoadFaces (&header->lumps[LUMP_FACES], bsp2);
+	Mod_LogLoadStep ("faces", &time);
 	Mod_LoadMarksurfaces (&header->lumps[LUMP_MARKSURFACES], bsp2);
+	Mod_LogLoadStep ("marksurfaces", &time);
 
-	if (mod->bspversion == BSPVERSION && external_vis.value && sv.modelname[0] && !q_strcasecmp(loadname, sv.name))
+	if (tryvis)
 	{
 		FILE* fvis;
 		Con_DPrintf("trying to open external vis file\n");
@@ -2399,13 +2835,17 @@ static void Mod_LoadBrushModel (qmodel_t *mod, void *buffer)
 		}
 	}
 
-	Mod_LoadVisibility (&header->lumps[LUMP_VISIBILITY]);
+	if (tryvis && Mod_LoadVisibility (&header->lumps[LUMP_VISIBILITY]))
+		Mod_WaitLoadTasks ();
 	Mod_LoadLeafs (&header->lumps[LUMP_LEAFS], bsp2);
 visdone:
+	Mod_LogLoadStep ("leafs", &time);
 	Mod_LoadNodes (&header->lumps[LUMP_NODES], bsp2);
-	Mod_LoadClipnodes (&header->lumps[LUMP_CLIPNODES], bsp2);
+	Mod_LogLoadStep ("nodes", &time);
 	Mod_LoadEntities (&header->lumps[LUMP_ENTITIES]);
+	Mod_LogLoadStep ("entities", &time);
 	Mod_LoadSubmodels (&header->lumps[LUMP_MODELS]);
+	Mod_LogLoadStep ("submodels", &time);
 
 	Mod_MakeHull0 ();
 
@@ -149,6 +149,29 @@ void R_AddEfrags (entity_t *ent)
 	R_CheckEfrags (); //johnfitz
 }
 
+/*
+===========
+R_RemoveStaticEfrags
+
+Drops the efrags of cl_static_entities[first] onwards, so the statics
+can be cut back (or replaced and re-added) when a demo seeks
+===========
+*/
+void R_RemoveStaticEfrags (int first)
+{
+	int		i, ofs, size;
+
+	size = VEC_SIZE (cl_efrags);
+	for (i = ofs = 0; i < first && i < cl.num_statics && ofs < size; i++)
+		if (cl_static_entities[i].model)
+			ofs += 1 + cl_efrags[ofs];
+
+	for (i = ofs; i < size; i += 1 + cl_efrags[i])
+		cl.num_efrags -= cl_efrags[i];
+	if (size > ofs)
+		VEC_POP_N (cl_efrags, size - ofs);
+}
+
 /*
 ===============
 R_AddStaticModels
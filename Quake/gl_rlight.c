@@ -181,6 +181,9 @@ void R_PushDlights (void)
 		}
 	}
 
+	if (isHeadless)
+		return;
+
 	GL_BeginGroup ("Light clustering");
 
 	R_UploadFrameData ();
@@ -1823,19 +1823,23 @@ void R_RenderView (void)
 	time1 = 0; /* avoid compiler warning */
 	if (r_speeds.value)
 	{
-		glFinish ();
+		if (!isHeadless)
+			glFinish ();
 		time1 = Sys_DoubleTime ();
-
-		//johnfitz -- rendering statistics
-		rs_brushpolys = rs_aliaspolys = rs_skypolys =
-		rs_dynamiclightmaps = rs_aliaspasses = rs_skypasses = rs_brushpasses = 0;
 	}
-	else if (gl_finish.value)
+	else if (gl_finish.value && !isHeadless)
 		glFinish ();
 
+	//johnfitz -- rendering statistics, also kept for the timedemo report
+	rs_brushpolys = rs_aliaspolys = rs_skypolys =
+	rs_dynamiclightmaps = rs_aliaspasses = rs_skypasses = rs_brushpasses = 0;
+
 	R_SetupView (); //johnfitz -- this does everything that should be done once per frame
-	R_RenderScene ();
-	R_WarpScaleView ();
+	if (!isHeadless)
+	{
+		R_RenderScene ();
+		R_WarpScaleView ();
+	}
 
 	//johnfitz -- modified r_speeds output
 	time2 = Sys_DoubleTime ();
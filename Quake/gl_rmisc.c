@@ -54,6 +54,7 @@ extern cvar_t r_oit;
 extern cvar_t r_simd;
 #endif
 qboolean use_simd;
+qboolean use_avx2;
 
 extern gltexture_t *playertextures[MAX_SCOREBOARD]; //johnfitz
 
@@ -120,6 +121,9 @@ static void R_SetClearColor_f (cvar_t *var)
 	byte	*rgb;
 	int		s;
 
+	if (isHeadless)
+		return;
+
 	s = (int)r_clearcolor.value & 0xFF;
 	rgb = (byte*)(d_8to24table + s);
 	glClearColor (rgb[0]/255.0,rgb[1]/255.0,rgb[2]/255.0,0);
@@ -147,6 +151,9 @@ static void R_SIMD_f (cvar_t *var)
 {
 #if defined(USE_SSE2)
 	use_simd = SDL_HasSSE() && SDL_HasSSE2() && (var->value != 0.0f);
+#if defined(USE_AVX2)
+	use_avx2 = use_simd && SDL_HasAVX2();
+#endif
 #else
 	#error not implemented
 #endif
@@ -338,7 +345,7 @@ void R_TranslateNewPlayerSkin (int playernum)
 //get correct texture pixels
 	e = &cl_entities[1+playernum];
 
-	if (!e->model || e->model->type != mod_alias)
+	if (!e->model || e->model->type != mod_alias || isHeadless)
 		return;
 
 	paliashdr = (aliashdr_t *)Mod_Extradata (e->model);
@@ -450,9 +457,12 @@ void R_NewMap (void)
 	r_viewleaf = NULL;
 	R_ClearParticles ();
 
-	GL_BuildLightmaps ();
-	GL_BuildBModelVertexBuffer ();
-	GL_BuildBModelMarkBuffers ();
+	if (!isHeadless)
+	{
+		GL_BuildLightmaps ();
+		GL_BuildBModelVertexBuffer ();
+		GL_BuildBModelMarkBuffers ();
+	}
 	//ericw -- no longer load alias models into a VBO here, it's done in Mod_LoadAliasModel
 
 	r_framecount = 0; //johnfitz -- paranoid?
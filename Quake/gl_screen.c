@@ -25,6 +25,9 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "quakedef.h"
 #include <time.h>
+#ifndef _WIN32
+#include <signal.h>
+#endif
 
 /*
 
@@ -96,6 +99,9 @@ cvar_t		scr_usekfont = {"scr_usekfont", "0", CVAR_NONE}; // 2021 re-release
 cvar_t		scr_hudstyle = {"hudstyle", "2", CVAR_ARCHIVE};
 cvar_t		cl_screenshotname = {"cl_screenshotname", "screenshots/%map%_%date%_%time%", CVAR_ARCHIVE};
 cvar_t		scr_demobar_timeout = {"scr_demobar_timeout", "1", CVAR_ARCHIVE};
+cvar_t		scr_demorender_format = {"scr_demorender_format", "png", CVAR_ARCHIVE};
+cvar_t		scr_demorender_quality = {"scr_demorender_quality", "90", CVAR_ARCHIVE};
+cvar_t		scr_demorender_command = {"scr_demorender_command", "ffmpeg -y -loglevel error -f rawvideo -pixel_format rgb24 -video_size %wx%h -framerate %r -i - -c:v libx264 -pix_fmt yuv420p \"%o.mp4\"", CVAR_ARCHIVE};
 
 cvar_t		scr_viewsize = {"viewsize","100", CVAR_ARCHIVE};
 cvar_t		scr_fov = {"fov","90",CVAR_ARCHIVE};	// 10 - 170
@@ -571,6 +577,9 @@ void SCR_Init (void)
 	Cvar_RegisterVariable (&scr_printspeed);
 	Cvar_RegisterVariable (&gl_triplebuffer);
 	Cvar_RegisterVariable (&cl_gun_fovscale);
+	Cvar_RegisterVariable (&scr_demorender_format);
+	Cvar_RegisterVariable (&scr_demorender_quality);
+	Cvar_RegisterVariable (&scr_demorender_command);
 
 	Cmd_AddCommand ("scr_autoscale",SCR_AutoScale_f);
 
@@ -582,7 +591,8 @@ void SCR_Init (void)
 	Cmd_AddCommand ("+zoom", SCR_ZoomDown_f);
 	Cmd_AddCommand ("-zoom", SCR_ZoomUp_f);
 
-	SCR_LoadPics (); //johnfitz
+	if (!isHeadless)
+		SCR_LoadPics (); //johnfitz
 
 	scr_initialized = true;
 }
@@ -1598,20 +1608,119 @@ static void SCR_ScreenShot_Usage (void)
 	Con_Printf ("   quality must be 1-100\n");
 }
 
+typedef struct
+{
+	char		imagename[MAX_OSPATH];	// relative to com_gamedir, reserved up front
+	char		ext[4];
+	int			quality;
+	byte		*pixels;
+	int			width;
+	int			height;
+	qboolean	ok;
+} scrshot_t;
+
+static scrshot_t	**scr_pendingshots;	// read back at the end of the frame
+
+/*
+==================
+SCR_ScreenShotDone
+
+Reports the result on the main thread
+==================
+*/
+static void SCR_ScreenShotDone (void *param)
+{
+	scrshot_t	*shot = (scrshot_t *) param;
+	char		basename[MAX_OSPATH];
+
+	UTF8_ToQuake (basename, sizeof (basename), shot->imagename);
+	if (shot->ok)
+	{
+		Con_SafePrintf ("Wrote ");
+		Con_LinkPrintf (va("%s/%s", com_gamedir, shot->imagename), "%s", basename);
+		Con_SafePrintf ("\n");
+	}
+	else
+	{
+		Sys_remove (va("%s/%s", com_gamedir, shot->imagename));
+		Con_Printf ("SCR_ScreenShot_f: Couldn't create %s\n", basename);
+	}
+
+	free (shot);
+}
+
+/*
+==================
+SCR_WriteScreenShot
+
+Worker job, encodes the captured image
+==================
+*/
+static void SCR_WriteScreenShot (void *param)
+{
+	scrshot_t	*shot = (scrshot_t *) param;
+
+	if (!q_strncasecmp (shot->ext, "png", sizeof(shot->ext)))
+		shot->ok = Image_WritePNG (shot->imagename, shot->pixels, shot->width, shot->height, 24, true);
+	else if (!q_strncasecmp (shot->ext, "tga", sizeof(shot->ext)))
+		shot->ok = Image_WriteTGA (shot->imagename, shot->pixels, shot->width, shot->height, 24, true);
+	else if (!q_strncasecmp (shot->ext, "jpg", sizeof(shot->ext)))
+		shot->ok = Image_WriteJPG (shot->imagename, shot->pixels, shot->width, shot->height, 24, shot->quality, true);
+	else
+		shot->ok = false;
+
+	free (shot->pixels);
+	shot->pixels = NULL;
+	Host_InvokeOnMainThread (SCR_ScreenShotDone, shot);
+}
+
+/*
+==================
+SCR_ScreenShotCaptured
+
+Capture callback, moves the encoding off the main thread
+==================
+*/
+static void SCR_ScreenShotCaptured (byte *pixels, int width, int height, void *param)
+{
+	scrshot_t	*shot = (scrshot_t *) param;
+
+	if (!pixels)
+	{
+		SCR_ScreenShotDone (shot);
+		return;
+	}
+
+	shot->pixels = pixels;
+	shot->width = width;
+	shot->height = height;
+	Jobs_Dispatch (SCR_WriteScreenShot, shot);
+}
+
 /*
 ==================
 SCR_ScreenShot_f -- johnfitz -- rewritten to use Image_WriteTGA
+
+The back buffer is captured at the end of the frame and encoded on a
+worker a few frames later, so screenshots don't stall the game
 ==================
 */
 void SCR_ScreenShot_f (void)
 {
-	byte	*buffer;
+	scrshot_t	*shot;
+	FILE	*f;
 	char	ext[4];
 	char	basename[MAX_OSPATH];
 	char	imagename[MAX_OSPATH];
 	char	checkname[MAX_OSPATH];
 	int		i, quality;
-	qboolean	ok, has_vars;
+	qboolean	has_vars;
+
+	if (isHeadless)
+	{
+		Con_Printf ("SCR_ScreenShot_f: nothing is rendered in headless mode\n");
+		return;
+	}
 
 	Q_strncpy (ext, "png", sizeof(ext));
 
@@ -1675,47 +1784,707 @@ void SCR_ScreenShot_f (void)
 		}
 	}
 
-//get data
-	if (!(buffer = (byte *) malloc(glwidth*glheight*3)))
+// reserve the name, so that a burst of screenshots doesn't pick it again before it's written
+	if (!(shot = (scrshot_t *) calloc (1, sizeof (*shot))))
 	{
 		Con_Printf ("SCR_ScreenShot_f: Couldn't allocate memory\n");
 		return;
 	}
 
+	COM_CreatePath (checkname);
+	f = Sys_fopen (checkname, "wb");
+	if (!f)
+	{
+		UTF8_ToQuake (basename, sizeof (basename), imagename);
+		Con_Printf ("SCR_ScreenShot_f: Couldn't create %s\n", basename);
+		free (shot);
+		return;
+	}
+	fclose (f);
+
+	q_strlcpy (shot->imagename, imagename, sizeof (shot->imagename));
+	q_strlcpy (shot->ext, ext, sizeof (shot->ext));
+	shot->quality = quality;
+
 	if (scr_viewsize.value >= 130)
 	{
-		qboolean oldskip = scr_skipupdate;
 		Con_ClearNotify ();
 		SCR_ClearCenterString ();
-		scr_skipupdate = 1; // don't swap buffers at end of frame
-		SCR_UpdateScreen ();
-		scr_skipupdate = oldskip;
 	}
 
-	glPixelStorei (GL_PACK_ALIGNMENT, 1);/* for widths that aren't a multiple of 4 */
-	glReadPixels (glx, gly, glwidth, glheight, GL_RGB, GL_UNSIGNED_BYTE, buffer);
-
-// now write the file
-	if (!q_strncasecmp (ext, "png", sizeof(ext)))
-		ok = Image_WritePNG (imagename, buffer, glwidth, glheight, 24, false);
-	else if (!q_strncasecmp (ext, "tga", sizeof(ext)))
-		ok = Image_WriteTGA (imagename, buffer, glwidth, glheight, 24, false);
-	else if (!q_strncasecmp (ext, "jpg", sizeof(ext)))
-		ok = Image_WriteJPG (imagename, buffer, glwidth, glheight, 24, quality, false);
+	VEC_PUSH (scr_pendingshots, shot);
+}
+
+/*
+==============================================================================
+
+FRAME CAPTURE
+
+The back buffer is read into a small ring of pixel pack buffers, so that
+glReadPixels returns right away instead of waiting for the GPU to finish
+the frame. A frame or two later, once a capture's fence has signaled, its
+buffer is mapped and a worker copies the rows out top-down; the image is
+then passed to the capture's callback on the main thread, which owns it
+from there on. Captures always complete in the order they were taken.
+
+==============================================================================
+*/
+
+#define MAX_CAPTURES	3
+
+typedef struct
+{
+	GLuint				pbo;
+	GLsizeiptr			pbosize;
+	GLsync				fence;
+	job_t				*job;
+	const byte			*mapped;
+	byte				*pixels;
+	int					width;
+	int					height;
+	scrcapturefunc_t	func;
+	void				*param;
+} scrcapture_t;
+
+static scrcapture_t	scr_captures[MAX_CAPTURES];
+static int			scr_capturehead;
+static int			scr_capturecount;
+
+/*
+==================
+SCR_CopyCapture
+
+Worker job: flips the mapped rows into a malloc'ed top-down image
+==================
+*/
+static void SCR_CopyCapture (void *param)
+{
+	scrcapture_t	*cap = (scrcapture_t *) param;
+	size_t			rowsize = cap->width * 3;
+	int				y;
+
+	cap->pixels = (byte *) malloc (rowsize * cap->height);
+	if (!cap->pixels)
+		return;
+
+	for (y = 0; y < cap->height; y++)
+		memcpy (cap->pixels + y * rowsize, cap->mapped + (cap->height - 1 - y) * rowsize, rowsize);
+}
+
+/*
+==================
+SCR_RetireCapture
+==================
+*/
+static void SCR_RetireCapture (scrcapture_t *cap)
+{
+	if (cap->job)
+	{
+		Job_Wait (cap->job);
+		Job_Release (cap->job);
+		cap->job = NULL;
+	}
+
+	if (cap->mapped)
+	{
+		GL_BindBuffer (GL_PIXEL_PACK_BUFFER, cap->pbo);
+		GL_UnmapBufferFunc (GL_PIXEL_PACK_BUFFER);
+		GL_BindBuffer (GL_PIXEL_PACK_BUFFER, 0);
+		cap->mapped = NULL;
+	}
+
+	scr_capturehead = (scr_capturehead + 1) % MAX_CAPTURES;
+	scr_capturecount--;
+
+	// pixels is NULL if the capture failed, the callback still has to clean up
+	cap->func (cap->pixels, cap->width, cap->height, cap->param);
+	cap->pixels = NULL;
+}
+
+/*
+==================
+SCR_UpdateCaptures
+
+Completes the captures that are ready, blocking until at most maxpending are left
+==================
+*/
+static void SCR_UpdateCaptures (int maxpending)
+{
+	while (scr_capturecount > 0)
+	{
+		scrcapture_t	*cap = &scr_captures[scr_capturehead];
+		qboolean		wait = scr_capturecount > maxpending;
+
+		if (cap->fence)
+		{
+			GLuint64 timeout = wait ? 1ull * 1000 * 1000 * 1000 : 0; // 1 second
+			GLenum result = GL_ClientWaitSyncFunc (cap->fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+			if (result == GL_TIMEOUT_EXPIRED)
+			{
+				if (!wait)
+					return;
+				glFinish ();
+			}
+			else if (result == GL_WAIT_FAILED)
+				Sys_Error ("SCR_UpdateCaptures: wait failed (0x%04X)", glGetError ());
+			GL_DeleteSyncFunc (cap->fence);
+			cap->fence = NULL;
+
+			GL_BindBuffer (GL_PIXEL_PACK_BUFFER, cap->pbo);
+			cap->mapped = (const byte *) GL_MapBufferRangeFunc (GL_PIXEL_PACK_BUFFER, 0, cap->width * cap->height * 3, GL_MAP_READ_BIT);
+			GL_BindBuffer (GL_PIXEL_PACK_BUFFER, 0);
+			if (!cap->mapped)
+			{
+				Con_Warning ("SCR_UpdateCaptures: couldn't map pixel buffer (0x%04X)\n", glGetError ());
+				SCR_RetireCapture (cap);
+				continue;
+			}
+
+			cap->job = Job_Create (SCR_CopyCapture, cap);
+			Job_Submit (cap->job);
+		}
+
+		if (!wait && !Job_IsDone (cap->job))
+			return;
+		SCR_RetireCapture (cap);
+	}
+}
+
+/*
+==================
+SCR_CaptureFrame
+
+Queues a readback of the current back buffer; func is called with the
+top-down RGB image once it's available, a few frames from now
+==================
+*/
+void SCR_CaptureFrame (scrcapturefunc_t func, void *param)
+{
+	scrcapture_t	*cap;
+	GLsizeiptr		size = (GLsizeiptr) glwidth * glheight * 3;
+
+	SCR_UpdateCaptures (MAX_CAPTURES - 1);
+
+	cap = &scr_captures[(scr_capturehead + scr_capturecount) % MAX_CAPTURES];
+	if (!cap->pbo)
+	{
+		GL_GenBuffersFunc (1, &cap->pbo);
+		GL_BindBuffer (GL_PIXEL_PACK_BUFFER, cap->pbo);
+		GL_ObjectLabelFunc (GL_BUFFER, cap->pbo, -1, "frame capture");
+	}
 	else
+		GL_BindBuffer (GL_PIXEL_PACK_BUFFER, cap->pbo);
+
+	if (cap->pbosize != size)
+	{
+		GL_BufferDataFunc (GL_PIXEL_PACK_BUFFER, size, NULL, GL_STREAM_READ);
+		cap->pbosize = size;
+	}
+
+	glPixelStorei (GL_PACK_ALIGNMENT, 1);/* for widths that aren't a multiple of 4 */
+	glReadPixels (glx, gly, glwidth, glheight, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+	GL_BindBuffer (GL_PIXEL_PACK_BUFFER, 0);
+
+	cap->fence = GL_FenceSyncFunc (GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	if (!cap->fence)
+		Sys_Error ("glFenceSync failed (error code 0x%04X)", glGetError ());
+	cap->width = glwidth;
+	cap->height = glheight;
+	cap->func = func;
+	cap->param = param;
+	scr_capturecount++;
+}
+
+/*
+==================
+SCR_FlushCaptures
+
+Completes all pending captures, and frees the pixel buffers if release is set
+==================
+*/
+void SCR_FlushCaptures (qboolean release)
+{
+	int i;
+
+	SCR_UpdateCaptures (0);
+
+	if (!release)
+		return;
+
+	for (i = 0; i < MAX_CAPTURES; i++)
+	{
+		if (scr_captures[i].pbo)
+		{
+			GL_DeleteBuffersFunc (1, &scr_captures[i].pbo);
+			scr_captures[i].pbo = 0;
+			scr_captures[i].pbosize = 0;
+		}
+	}
+}
+
+
+/*
+==================
+SCR_ShutdownCaptures
+
+Hands the outstanding captures to their writers before the GL context goes
+away. Screenshots requested after the last frame was read back are never
+taken, so only their reserved files are removed.
+==================
+*/
+void SCR_ShutdownCaptures (void)
+{
+	size_t i;
+
+	SCR_FlushCaptures (true);
+
+	for (i = 0; i < VEC_SIZE (scr_pendingshots); i++)
+	{
+		Sys_remove (va ("%s/%s", com_gamedir, scr_pendingshots[i]->imagename));
+		free (scr_pendingshots[i]);
+	}
+	VEC_FREE (scr_pendingshots);
+}
+
+
+/*
+==============================================================================
+
+DEMO RENDERING
+
+demorender plays a demo at a fixed timestep, as fast as the frames can be
+drawn, and captures every frame of it. The frames are either written as
+an image sequence to demorender/<demo>/ in the game directory, encoded on
+worker threads, or piped as raw top-down RGB to the process started from
+scr_demorender_command. The sound mixed for each frame goes to
+demorender/<demo>.wav, to be muxed in afterwards.
+
+In scr_demorender_command, %w and %h expand to the frame size, %r to the
+frame rate and %o to the output path without extension.
+
+==============================================================================
+*/
+
+#ifdef _WIN32
+#define popen	_popen
+#define pclose	_pclose
+#define DR_PIPEMODE	"wb"
+#else
+#define DR_PIPEMODE	"w"		// POSIX popen only takes "r" or "w"
+#endif
+
+#define MAX_DEMORENDER_JOBS	64
+
+typedef enum
+{
+	DR_PNG,
+	DR_JPG,
+	DR_TGA,
+	DR_PIPE,
+} drformat_t;
+
+static const char *const dr_formatnames[] = {"png", "jpg", "tga", "pipe"};
+
+typedef struct
+{
+	byte		*pixels;
+	int			width;
+	int			height;
+	char		name[MAX_OSPATH];	// relative to com_gamedir
+} drframe_t;
+
+static struct
+{
+	qboolean		active;
+	drformat_t		format;
+	int				quality;
+	double			fps;
+	int				width;
+	int				height;
+	int				frames;
+	int				lastframe;		// host_framecount of the last frame captured
+	double			starttime;
+	char			name[MAX_OSPATH];	// demorender/<demo>, relative to com_gamedir
+	FILE			*pipe;
+#ifndef _WIN32
+	void			(*oldsigpipe) (int);	// restored when the pipe closes
+#endif
+	FILE			*wav;
+	int				wavbytes;
+	job_t			*jobs[MAX_DEMORENDER_JOBS];	// writes in flight, oldest first
+	int				jobhead;
+	int				jobcount;
+	int				maxjobs;
+	SDL_atomic_t	errors;
+} demorender;
+
+/*
+==================
+SCR_DemoRenderWriteImage
+
+Worker job
+==================
+*/
+static void SCR_DemoRenderWriteImage (void *param)
+{
+	drframe_t	*frame = (drframe_t *) param;
+	qboolean	ok;
+
+	switch (demorender.format)
+	{
+	case DR_PNG:
+		ok = Image_WritePNG (frame->name, frame->pixels, frame->width, frame->height, 24, true);
+		break;
+	case DR_JPG:
+		ok = Image_WriteJPG (frame->name, frame->pixels, frame->width, frame->height, 24, demorender.quality, true);
+		break;
+	case DR_TGA:
+		ok = Image_WriteTGA (frame->name, frame->pixels, frame->width, frame->height, 24, true);
+		break;
+	default:
 		ok = false;
+		break;
+	}
+
+	if (!ok)
+		SDL_AtomicIncRef (&demorender.errors);
+	free (frame->pixels);
+	free (frame);
+}
+
+/*
+==================
+SCR_DemoRenderWritePipe
+
+Worker job, runs after the previous frame's
+==================
+*/
+static void SCR_DemoRenderWritePipe (void *param)
+{
+	drframe_t	*frame = (drframe_t *) param;
+	size_t		size = (size_t) frame->width * frame->height * 3;
+
+	// once the encoder has gone away, don't keep writing to it
+	if (SDL_AtomicGet (&demorender.errors) || fwrite (frame->pixels, 1, size, demorender.pipe) != size)
+		SDL_AtomicIncRef (&demorender.errors);
+	free (frame->pixels);
+	free (frame);
+}
+
+/*
+==================
+SCR_DemoRenderRetireJob
+==================
+*/
+static void SCR_DemoRenderRetireJob (void)
+{
+	job_t *job = demorender.jobs[demorender.jobhead];
+
+	Job_Wait (job);
+	Job_Release (job);
+	demorender.jobhead = (demorender.jobhead + 1) % MAX_DEMORENDER_JOBS;
+	demorender.jobcount--;
+}
+
+/*
+==================
+SCR_DemoRenderFrame
+
+Capture callback, hands the frame to a writer job
+==================
+*/
+static void SCR_DemoRenderFrame (byte *pixels, int width, int height, void *param)
+{
+	drframe_t	*frame;
+	job_t		*job;
+	int			index = (int)(intptr_t) param;
 
-	UTF8_ToQuake (basename, sizeof (basename), imagename);
-	if (ok)
+	if (!pixels)
 	{
-		Con_SafePrintf ("Wrote ");
-		Con_LinkPrintf (va("%s/%s", com_gamedir, imagename), "%s", basename);
-		Con_SafePrintf ("\n");
+		SDL_AtomicIncRef (&demorender.errors);
+		return;
+	}
+
+	// the encoder was told the frame size up front, and
+	// there's no point queueing frames after a failed write
+	if (demorender.format == DR_PIPE &&
+		(width != demorender.width || height != demorender.height || SDL_AtomicGet (&demorender.errors)))
+	{
+		SDL_AtomicIncRef (&demorender.errors);
+		free (pixels);
+		return;
+	}
+
+	frame = (drframe_t *) malloc (sizeof (*frame));
+	if (!frame)
+	{
+		SDL_AtomicIncRef (&demorender.errors);
+		free (pixels);
+		return;
+	}
+	frame->pixels = pixels;
+	frame->width = width;
+	frame->height = height;
+	q_snprintf (frame->name, sizeof (frame->name), "%s/%06i.%s", demorender.name, index, dr_formatnames[demorender.format]);
+
+	if (demorender.format == DR_PIPE)
+	{
+		job = Job_Create (SCR_DemoRenderWritePipe, frame);
+		if (demorender.jobcount)	// keep the frames in order
+			Job_AddDependency (job, demorender.jobs[(demorender.jobhead + demorender.jobcount - 1) % MAX_DEMORENDER_JOBS]);
 	}
 	else
-		Con_Printf ("SCR_ScreenShot_f: Couldn't create %s\n", basename);
+		job = Job_Create (SCR_DemoRenderWriteImage, frame);
+	Job_Submit (job);
+
+	// don't let the renderer run too far ahead of the writers
+	if (demorender.jobcount == demorender.maxjobs)
+		SCR_DemoRenderRetireJob ();
+	demorender.jobs[(demorender.jobhead + demorender.jobcount) % MAX_DEMORENDER_JOBS] = job;
+	demorender.jobcount++;
+}
+
+/*
+==================
+SCR_DemoRenderSound
+
+Sound capture callback, only keeps the sound of frames that were captured
+==================
+*/
+static void SCR_DemoRenderSound (const byte *data, int size)
+{
+	if (!demorender.wav || demorender.lastframe != host_framecount)
+		return;
+
+	if (fwrite (data, 1, size, demorender.wav) != (size_t) size)
+		SDL_AtomicIncRef (&demorender.errors);
+	demorender.wavbytes += size;
+}
+
+/*
+==================
+SCR_WriteWavHeader
+==================
+*/
+static void SCR_PutLittle (byte *dst, int value, int bytes)
+{
+	for (; bytes > 0; bytes--, value >>= 8)
+		*dst++ = value & 0xff;
+}
 
-	free (buffer);
+static void SCR_WriteWavHeader (FILE *f, int datasize)
+{
+	byte	header[44];
+	int		blockalign = shm->channels * (shm->samplebits / 8);
+
+	memcpy (header, "RIFF", 4);
+	SCR_PutLittle (header + 4, 36 + datasize, 4);
+	memcpy (header + 8, "WAVEfmt ", 8);
+	SCR_PutLittle (header + 16, 16, 4);
+	SCR_PutLittle (header + 20, WAV_FORMAT_PCM, 2);
+	SCR_PutLittle (header + 22, shm->channels, 2);
+	SCR_PutLittle (header + 24, shm->speed, 4);
+	SCR_PutLittle (header + 28, shm->speed * blockalign, 4);
+	SCR_PutLittle (header + 32, blockalign, 2);
+	SCR_PutLittle (header + 34, shm->samplebits, 2);
+	memcpy (header + 36, "data", 4);
+	SCR_PutLittle (header + 40, datasize, 4);
+
+	fseek (f, 0, SEEK_SET);
+	fwrite (header, 1, sizeof (header), f);
+}
+
+/*
+==================
+SCR_ExpandDemoRenderCommand
+==================
+*/
+static void SCR_ExpandDemoRenderCommand (char *dst, size_t maxchars)
+{
+	const char	*src = scr_demorender_command.string;
+	size_t		len = 0;
+
+	for (; *src && len + 1 < maxchars; src++)
+	{
+		const char *var = NULL;
+
+		if (src[0] == '%' && src[1])
+		{
+			switch (src[1])
+			{
+			case 'w': var = va ("%i", demorender.width); break;
+			case 'h': var = va ("%i", demorender.height); break;
+			case 'r': var = va ("%g", demorender.fps); break;
+			case 'o': var = va ("%s/%s", com_gamedir, demorender.name); break;
+			case '%': var = "%"; break;
+			}
+		}
+
+		if (!var)
+		{
+			dst[len++] = *src;
+			continue;
+		}
+
+		len += q_strlcpy (dst + len, var, maxchars - len);
+		len = q_min (len, maxchars - 1);
+		src++;
+	}
+
+	dst[len] = '\0';
+}
+
+/*
+==================
+SCR_BeginDemoRender
+
+Sets up the outputs for rendering demoname, returns false on failure
+==================
+*/
+qboolean SCR_BeginDemoRender (const char *demoname, double fps)
+{
+	char	path[MAX_OSPATH];
+	char	command[1024];
+	int		i;
+
+	if (demorender.active)
+		SCR_EndDemoRender ();
+
+	for (i = 0; i < (int) countof (dr_formatnames); i++)
+		if (!q_strcasecmp (scr_demorender_format.string, dr_formatnames[i]))
+			break;
+	if (i == countof (dr_formatnames))
+	{
+		Con_Printf ("scr_demorender_format must be \"png\", \"jpg\", \"tga\" or \"pipe\"\n");
+		return false;
+	}
+
+	memset (&demorender, 0, sizeof (demorender));
+	demorender.format = (drformat_t) i;
+	demorender.quality = CLAMP (1, (int) scr_demorender_quality.value, 100);
+	demorender.fps = fps;
+	demorender.width = glwidth;
+	demorender.height = glheight;
+	demorender.lastframe = -1;
+	demorender.maxjobs = CLAMP (2, Jobs_NumWorkers () * 2, MAX_DEMORENDER_JOBS);
+	q_snprintf (demorender.name, sizeof (demorender.name), "demorender/%s", demoname);
+
+	if (demorender.format == DR_PIPE)
+	{
+		q_snprintf (path, sizeof (path), "%s/%s", com_gamedir, demorender.name);
+		COM_CreatePath (path);
+		SCR_ExpandDemoRenderCommand (command, sizeof (command));
+		demorender.pipe = popen (command, DR_PIPEMODE);
+		if (!demorender.pipe)
+		{
+			Con_Printf ("ERROR: couldn't start %s\n", command);
+			return false;
+		}
+#ifndef _WIN32
+		// an encoder that exits early shows up as a write error instead
+		demorender.oldsigpipe = signal (SIGPIPE, SIG_IGN);
+#endif
+		setvbuf (demorender.pipe, NULL, _IOFBF, 1 << 20);
+	}
+	else
+	{
+		q_snprintf (path, sizeof (path), "%s/%s/", com_gamedir, demorender.name);
+		COM_CreatePath (path);
+	}
+
+	if (shm)
+	{
+		q_snprintf (path, sizeof (path), "%s/%s.wav", com_gamedir, demorender.name);
+		demorender.wav = Sys_fopen (path, "wb");
+		if (demorender.wav)
+		{
+			SCR_WriteWavHeader (demorender.wav, 0);
+			S_BeginCapture (1.0 / fps, SCR_DemoRenderSound);
+		}
+		else
+			Con_Printf ("ERROR: couldn't open file %s.\n", path);
+	}
+
+	demorender.active = true;
+	demorender.starttime = Sys_DoubleTime ();
+
+	Con_Printf ("Rendering %s at %g fps to %s\n", demoname, fps,
+		demorender.format == DR_PIPE ? command : va ("%s/", demorender.name));
+
+	return true;
+}
+
+/*
+==================
+SCR_EndDemoRender
+
+Waits for the outstanding frames and closes the outputs
+==================
+*/
+void SCR_EndDemoRender (void)
+{
+	double	time;
+	int		errors;
+
+	if (!demorender.active)
+		return;
+
+	S_EndCapture ();
+	SCR_FlushCaptures (true);
+	demorender.active = false;
+
+	while (demorender.jobcount)
+		SCR_DemoRenderRetireJob ();
+
+	if (demorender.pipe)
+	{
+		if (pclose (demorender.pipe) != 0)
+			Con_Printf ("ERROR: encoder exited with an error\n");
+#ifndef _WIN32
+		signal (SIGPIPE, demorender.oldsigpipe);
+#endif
+	}
+	demorender.pipe = NULL;
+
+	if (demorender.wav)
+	{
+		SCR_WriteWavHeader (demorender.wav, demorender.wavbytes);
+		fclose (demorender.wav);
+		demorender.wav = NULL;
+		Con_Printf ("Wrote %s/%s.wav\n", com_gamedir, demorender.name);
+	}
+
+	time = q_max (Sys_DoubleTime () - demorender.starttime, 0.001);
+	Con_Printf ("Rendered %i frames in %.1f seconds (%.1f fps)\n", demorender.frames, time, demorender.frames / time);
+
+	errors = SDL_AtomicGet (&demorender.errors);
+	if (errors)
+		Con_Printf ("ERROR: %i frames couldn't be written\n", errors);
+}
+
+/*
+==================
+SCR_ReadbackFrame
+
+Called once the frame is complete, before the buffers are swapped
+==================
+*/
+void SCR_ReadbackFrame (void)
+{
+	size_t	i;
+
+	for (i = 0; i < VEC_SIZE (scr_pendingshots); i++)
+		SCR_CaptureFrame (SCR_ScreenShotCaptured, scr_pendingshots[i]);
+	VEC_CLEAR (scr_pendingshots);
+
+	if (demorender.active && cls.demoplayback && cls.signon == SIGNONS &&
+		!scr_drawloading && demorender.lastframe != host_framecount)
+	{
+		demorender.lastframe = host_framecount;
+		SCR_CaptureFrame (SCR_DemoRenderFrame, (void *)(intptr_t) demorender.frames++);
+	}
+
+	SCR_UpdateCaptures (MAX_CAPTURES);
 }
 
 
@@ -1907,6 +2676,31 @@ void SCR_TileClear (void)
 	}
 }
 
+/*
+==================
+SCR_UpdateHeadless
+
+Runs the CPU side of a screen update (view setup, entity sorting and
+particle/light bookkeeping) without any GL submission
+==================
+*/
+static void SCR_UpdateHeadless (void)
+{
+	glx = gly = 0;
+	glwidth = vid.width;
+	glheight = vid.height;
+
+	if (vid.recalc_refdef)
+		SCR_CalcRefdef ();
+	r_refdef.scale = 1;
+
+	SCR_SetUpToDrawConsole ();
+
+	V_UpdateBlend ();
+
+	V_RenderView ();
+}
+
 /*
 ==================
 SCR_UpdateScreen
@@ -1936,6 +2730,11 @@ void SCR_UpdateScreen (void)
 	if (!scr_initialized || !con_initialized)
 		return;				// not initialized yet
 
+	if (isHeadless)
+	{
+		SCR_UpdateHeadless ();
+		return;
+	}
 
 	GL_BeginRendering (&glx, &gly, &glwidth, &glheight);
 
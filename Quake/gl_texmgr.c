@@ -45,6 +45,8 @@ cvar_t			gl_lodbias = {"gl_lodbias", "auto", CVAR_ARCHIVE };
 cvar_t			gl_texturemode = {"gl_texturemode", "", CVAR_ARCHIVE};
 cvar_t			gl_texture_anisotropy = {"gl_texture_anisotropy", "8", CVAR_ARCHIVE};
 cvar_t			gl_compress_textures = {"gl_compress_textures", "0", CVAR_ARCHIVE};
+static cvar_t	gl_texcache = {"gl_texcache", "1", CVAR_ARCHIVE};
+static cvar_t	gl_texcache_size = {"gl_texcache_size", "256", CVAR_ARCHIVE}; // megabytes
 GLint			gl_max_texture_size;
 
 static float	lodbias;
@@ -67,6 +69,7 @@ unsigned int d_8to24table_conchars[256];		//conchars palette, 0 and 255 are tran
 uint32_t is_fullbright[256/32];
 
 static void GL_DeleteTexture (gltexture_t *texture);
+static void TexMgr_SIMDTest_f (void);
 
 /*
 ================================================================================
@@ -709,6 +712,713 @@ void TexMgr_DeleteTextureObjects (void)
 	TexMgr_DeleteSamplers ();
 }
 
+/*
+================================================================================
+
+	DISK CACHE
+
+	Processed texels and other level load results are kept in <userdir>/texcache.
+	Items stored while a map loads are collected in memory and written together
+	as one blob file by a background job when the map is done loading. Each item
+	in a blob starts with its full key, which is compared on lookup. An index
+	tracks where the items are, and the size and last use of each blob, so that
+	the least recently used blobs can be deleted when the cache grows past
+	gl_texcache_size megabytes.
+
+================================================================================
+*/
+
+#define DISKCACHE_MAGIC		0x43545749	// "IWTC"
+#define DISKCACHE_VERSION	2
+#define DISKCACHE_INDEX		"index.bin"
+#define DISKCACHE_EXT		"blb"
+#define DISKCACHE_MAXKEYS	64
+#define DISKCACHE_MAXBATCH	(64 * 1024 * 1024)	// start a new blob past this many bytes
+
+// item header: magic, version, ext, number of keys, keys, data size
+#define DISKCACHE_HEADERSIZE(numkeys)	((5 + (numkeys)) * sizeof (unsigned))
+
+typedef struct {
+	unsigned	hash;
+	unsigned	blob;			// 0 if still in the batch
+	unsigned	offset;			// item header offset in the blob or batch
+	unsigned	size;			// including the item header
+	char		ext[4];
+} diskcacheentry_t;
+
+typedef struct {
+	unsigned	id;
+	unsigned	size;
+	unsigned	lastuse;
+} diskcacheblob_t;
+
+typedef struct {
+	char		path[MAX_OSPATH];
+	byte		*data;			// dynamic array
+} diskcachewrite_t;
+
+static struct {
+	qboolean			initialized;
+	qboolean			dirty;
+	char				dir[MAX_OSPATH];
+	diskcacheentry_t	*entries;		// dynamic array
+	diskcacheblob_t		*blobs;			// dynamic array
+	int					*table;			// open addressing, 1 + entry index, 0 if empty
+	int					tablesize;
+	byte				*batch;			// dynamic array, items not submitted yet
+	job_t				*writer;
+	unsigned			writingblob;
+	unsigned			nextblob;
+	unsigned			clock;
+	uint64_t			totalsize;		// blobs only
+	int					hits, misses, writes, evictions;
+} diskcache;
+
+/*
+================
+TexMgr_DiskCachePath
+================
+*/
+static void TexMgr_DiskCachePath (char *path, size_t size, unsigned blob)
+{
+	q_snprintf (path, size, "%s/%08x.%s", diskcache.dir, blob, DISKCACHE_EXT);
+}
+
+/*
+================
+TexMgr_FindDiskCacheEntry -- returns the entry index or -1
+================
+*/
+static int TexMgr_FindDiskCacheEntry (unsigned hash, const char *ext)
+{
+	unsigned pos, mask;
+
+	if (!diskcache.tablesize)
+		return -1;
+
+	mask = diskcache.tablesize - 1;
+	for (pos = hash & mask; diskcache.table[pos]; pos = (pos + 1) & mask)
+	{
+		diskcacheentry_t *entry = &diskcache.entries[diskcache.table[pos] - 1];
+		if (entry->hash == hash && !strcmp (entry->ext, ext))
+			return diskcache.table[pos] - 1;
+	}
+
+	return -1;
+}
+
+/*
+================
+TexMgr_FindDiskCacheBlob -- returns the blob index or -1
+================
+*/
+static int TexMgr_FindDiskCacheBlob (unsigned id)
+{
+	int i;
+
+	for (i = 0; i < (int) VEC_SIZE (diskcache.blobs); i++)
+		if (diskcache.blobs[i].id == id)
+			return i;
+
+	return -1;
+}
+
+/*
+================
+TexMgr_InsertDiskCacheTable
+================
+*/
+static void TexMgr_InsertDiskCacheTable (int index)
+{
+	unsigned pos, mask = diskcache.tablesize - 1;
+
+	for (pos = diskcache.entries[index].hash & mask; diskcache.table[pos]; pos = (pos + 1) & mask)
+		;
+	diskcache.table[pos] = index + 1;
+}
+
+/*
+================
+TexMgr_RebuildDiskCacheTable -- keeps the load factor at or below 50%
+================
+*/
+static void TexMgr_RebuildDiskCacheTable (void)
+{
+	int i, size, count = VEC_SIZE (diskcache.entries);
+
+	for (size = 64; size < count * 2; size <<= 1)
+		;
+	if (size != diskcache.tablesize)
+	{
+		free (diskcache.table);
+		diskcache.table = (int *) calloc (size, sizeof (*diskcache.table));
+		if (!diskcache.table)
+			Sys_Error ("TexMgr_RebuildDiskCacheTable: out of memory on %d entries", size);
+		diskcache.tablesize = size;
+	}
+	else
+		memset (diskcache.table, 0, size * sizeof (*diskcache.table));
+
+	for (i = 0; i < count; i++)
+		TexMgr_InsertDiskCacheTable (i);
+}
+
+/*
+================
+TexMgr_AddDiskCacheEntry
+================
+*/
+static void TexMgr_AddDiskCacheEntry (unsigned hash, const char *ext, unsigned blob, unsigned offset, unsigned size)
+{
+	diskcacheentry_t entry;
+	int index = TexMgr_FindDiskCacheEntry (hash, ext);
+
+	memset (&entry, 0, sizeof (entry));
+	entry.hash = hash;
+	entry.blob = blob;
+	entry.offset = offset;
+	entry.size = size;
+	q_strlcpy (entry.ext, ext, sizeof (entry.ext));
+	diskcache.dirty = true;
+
+	if (index >= 0)
+	{
+		diskcache.entries[index] = entry;
+		return;
+	}
+
+	VEC_PUSH (diskcache.entries, entry);
+	if ((int) VEC_SIZE (diskcache.entries) * 2 > diskcache.tablesize)
+		TexMgr_RebuildDiskCacheTable ();
+	else
+		TexMgr_InsertDiskCacheTable (VEC_SIZE (diskcache.entries) - 1);
+}
+
+/*
+================
+TexMgr_PurgeDiskCacheEntries -- forgets about items in blobs that are gone
+================
+*/
+static void TexMgr_PurgeDiskCacheEntries (void)
+{
+	int i, count = 0;
+
+	for (i = 0; i < (int) VEC_SIZE (diskcache.entries); i++)
+		if (!diskcache.entries[i].blob || TexMgr_FindDiskCacheBlob (diskcache.entries[i].blob) >= 0)
+			diskcache.entries[count++] = diskcache.entries[i];
+	VEC_POP_N (diskcache.entries, VEC_SIZE (diskcache.entries) - count);
+	TexMgr_RebuildDiskCacheTable ();
+	diskcache.dirty = true;
+}
+
+/*
+================
+TexMgr_WaitDiskCacheWriter
+================
+*/
+static void TexMgr_WaitDiskCacheWriter (void)
+{
+	if (!diskcache.writer)
+		return;
+	Job_Wait (diskcache.writer);
+	Job_Release (diskcache.writer);
+	diskcache.writer = NULL;
+	diskcache.writingblob = 0;
+}
+
+/*
+================
+TexMgr_DeleteDiskCacheBlob -- deletes the file, the caller has to purge the entries
+================
+*/
+static void TexMgr_DeleteDiskCacheBlob (int index)
+{
+	char path[MAX_OSPATH];
+
+	if (diskcache.blobs[index].id == diskcache.writingblob)
+		TexMgr_WaitDiskCacheWriter ();
+	TexMgr_DiskCachePath (path, sizeof (path), diskcache.blobs[index].id);
+	Sys_remove (path);
+	diskcache.totalsize -= diskcache.blobs[index].size;
+	diskcache.blobs[index] = VEC_LAST (diskcache.blobs);
+	VEC_POP (diskcache.blobs);
+}
+
+/*
+================
+TexMgr_ScanDiskCacheBlob -- adds the items of a blob file, up to the first broken one
+================
+*/
+static void TexMgr_ScanDiskCacheBlob (const char *path, unsigned id)
+{
+	unsigned		header[5 + DISKCACHE_MAXKEYS + 1];
+	unsigned		offset, numkeys, size, filesize;
+	char			ext[4];
+	diskcacheblob_t	blob;
+	FILE			*f;
+	long			end;
+
+	f = fopen (path, "rb");
+	if (!f)
+		return;
+	if (fseek (f, 0, SEEK_END) != 0 || (end = ftell (f)) < 0 || fseek (f, 0, SEEK_SET) != 0)
+	{
+		fclose (f);
+		return;
+	}
+	filesize = (unsigned) q_min (end, 0x7fffffffL);
+
+	for (offset = 0; fread (header, sizeof (header[0]), 4, f) == 4; offset += size)
+	{
+		numkeys = header[3];
+		if (header[0] != DISKCACHE_MAGIC || header[1] != DISKCACHE_VERSION || numkeys > DISKCACHE_MAXKEYS ||
+			fread (header + 4, sizeof (header[0]), numkeys + 1, f) != numkeys + 1)
+			break;
+		size = DISKCACHE_HEADERSIZE (numkeys) + header[4 + numkeys];
+		if (size < header[4 + numkeys] || size > filesize - offset || fseek (f, offset + size, SEEK_SET) != 0)
+			break;
+		memcpy (ext, &header[2], sizeof (ext));
+		ext[countof (ext) - 1] = '\0';
+		TexMgr_AddDiskCacheEntry (COM_HashBlock (header + 4, numkeys * sizeof (header[0])), ext, id, offset, size);
+	}
+	fclose (f);
+
+	blob.id = id;
+	blob.size = filesize;
+	blob.lastuse = 0;
+	VEC_PUSH (diskcache.blobs, blob);
+	diskcache.totalsize += blob.size;
+	diskcache.nextblob = q_max (diskcache.nextblob, id + 1);
+}
+
+/*
+================
+TexMgr_ScanDiskCache -- rebuilds the index from the files on disk, removing anything else
+================
+*/
+static void TexMgr_ScanDiskCache (void)
+{
+	findfile_t	*find;
+	char		path[MAX_OSPATH], ext[4];
+	unsigned	id;
+
+	for (find = Sys_FindFirst (diskcache.dir, NULL); find; find = Sys_FindNext (find))
+	{
+		if (find->attribs & FA_DIRECTORY || !strcmp (find->name, DISKCACHE_INDEX))
+			continue;
+		q_snprintf (path, sizeof (path), "%s/%s", diskcache.dir, find->name);
+		if (sscanf (find->name, "%8x.%3s", &id, ext) == 2 && strlen (find->name) == 12 &&
+			!strcmp (ext, DISKCACHE_EXT) && id)
+			TexMgr_ScanDiskCacheBlob (path, id);
+		else
+			Sys_remove (path); // left over from an older version
+	}
+	diskcache.dirty = true;
+}
+
+/*
+================
+TexMgr_InitDiskCache -- loads the index on first use
+================
+*/
+static qboolean TexMgr_InitDiskCache (void)
+{
+	char		path[MAX_OSPATH];
+	unsigned	header[5];
+	FILE		*f;
+
+	if (!gl_texcache.value)
+		return false;
+	if (diskcache.initialized)
+		return true;
+	diskcache.initialized = true;
+	diskcache.nextblob = 1;
+
+	q_snprintf (diskcache.dir, sizeof (diskcache.dir), "%s/texcache", host_parms->userdir);
+	q_snprintf (path, sizeof (path), "%s/%s", diskcache.dir, DISKCACHE_INDEX);
+
+	f = fopen (path, "rb");
+	if (f && fread (header, sizeof (header), 1, f) == 1 &&
+		header[0] == DISKCACHE_MAGIC && header[1] == DISKCACHE_VERSION &&
+		header[2] <= 0x1000000u && header[3] <= 0x10000u)
+	{
+		diskcacheentry_t entry;
+		diskcacheblob_t blob;
+		unsigned i, j;
+
+		diskcache.clock = header[4];
+		for (i = 0; i < header[3] && fread (&blob, sizeof (blob), 1, f) == 1; i++)
+		{
+			if (!blob.id)
+				break;
+			VEC_PUSH (diskcache.blobs, blob);
+			diskcache.totalsize += blob.size;
+			diskcache.nextblob = q_max (diskcache.nextblob, blob.id + 1);
+		}
+		for (j = 0; i == header[3] && j < header[2] && fread (&entry, sizeof (entry), 1, f) == 1; j++)
+		{
+			if (!entry.blob || entry.size < DISKCACHE_HEADERSIZE (0))
+				break;
+			entry.ext[countof (entry.ext) - 1] = '\0';
+			VEC_PUSH (diskcache.entries, entry);
+		}
+		if (i != header[3] || j != header[2])
+		{
+			VEC_CLEAR (diskcache.blobs);
+			VEC_CLEAR (diskcache.entries);
+			diskcache.totalsize = 0;
+			diskcache.nextblob = 1;
+		}
+	}
+	if (f)
+		fclose (f);
+
+	if (!VEC_SIZE (diskcache.blobs))
+		TexMgr_ScanDiskCache ();
+	TexMgr_PurgeDiskCacheEntries ();
+
+	return true;
+}
+
+/*
+================
+TexMgr_WriteDiskCacheBlob -- runs on a worker
+================
+*/
+static void TexMgr_WriteDiskCacheBlob (void *param)
+{
+	diskcachewrite_t	*write = (diskcachewrite_t *) param;
+	size_t				size = VEC_SIZE (write->data);
+	qboolean			ok;
+	FILE				*f;
+
+	f = fopen (write->path, "wb");
+	if (f)
+	{
+		ok = fwrite (write->data, 1, size, f) == size;
+		ok = (fclose (f) == 0) && ok;
+		if (!ok)
+			Sys_remove (write->path); // the entries go away on the first lookup
+	}
+
+	VEC_FREE (write->data);
+	free (write);
+}
+
+/*
+================
+TexMgr_CompareDiskCacheUse -- most recently used first
+================
+*/
+static int TexMgr_CompareDiskCacheUse (const void *a, const void *b)
+{
+	unsigned usea = ((const diskcacheblob_t *) a)->lastuse;
+	unsigned useb = ((const diskcacheblob_t *) b)->lastuse;
+	return (usea < useb) - (usea > useb);
+}
+
+/*
+================
+TexMgr_TrimDiskCache -- deletes the least recently used blobs until the cache fits
+================
+*/
+static void TexMgr_TrimDiskCache (void)
+{
+	uint64_t	maxsize = (uint64_t) (q_max (gl_texcache_size.value, 0.f) * 1024.0 * 1024.0);
+
+	if (diskcache.totalsize <= maxsize)
+		return;
+
+	// leave some headroom so that we don't have to trim after every map,
+	// and always keep the most recent blob
+	maxsize -= maxsize / 8;
+	qsort (diskcache.blobs, VEC_SIZE (diskcache.blobs), sizeof (diskcache.blobs[0]), TexMgr_CompareDiskCacheUse);
+	while (VEC_SIZE (diskcache.blobs) > 1 && diskcache.totalsize > maxsize)
+	{
+		TexMgr_DeleteDiskCacheBlob (VEC_SIZE (diskcache.blobs) - 1);
+		diskcache.evictions++;
+	}
+	TexMgr_PurgeDiskCacheEntries ();
+}
+
+/*
+================
+TexMgr_SubmitDiskCacheBatch -- hands the items stored so far to a worker as a new blob
+================
+*/
+static void TexMgr_SubmitDiskCacheBatch (void)
+{
+	diskcachewrite_t	*write;
+	diskcacheblob_t		blob;
+	int					i;
+
+	if (!VEC_SIZE (diskcache.batch))
+		return;
+
+	// one blob at a time, so that we never hold more than two batches
+	TexMgr_WaitDiskCacheWriter ();
+
+	blob.id = diskcache.nextblob++;
+	blob.size = VEC_SIZE (diskcache.batch);
+	blob.lastuse = ++diskcache.clock;
+	if (!diskcache.nextblob)
+		diskcache.nextblob = 1;
+	VEC_PUSH (diskcache.blobs, blob);
+	diskcache.totalsize += blob.size;
+
+	for (i = 0; i < (int) VEC_SIZE (diskcache.entries); i++)
+		if (!diskcache.entries[i].blob)
+			diskcache.entries[i].blob = blob.id;
+	diskcache.dirty = true;
+
+	write = (diskcachewrite_t *) calloc (1, sizeof (*write));
+	if (!write)
+		Sys_Error ("TexMgr_SubmitDiskCacheBatch: out of memory");
+	TexMgr_DiskCachePath (write->path, sizeof (write->path), blob.id);
+	write->data = diskcache.batch;
+	diskcache.batch = NULL;
+
+	Sys_mkdir (diskcache.dir);
+	diskcache.writer = Job_Create (TexMgr_WriteDiskCacheBlob, write);
+	diskcache.writingblob = blob.id;
+	Job_Submit (diskcache.writer);
+
+	TexMgr_TrimDiskCache ();
+}
+
+/*
+================
+TexMgr_FlushDiskCache -- starts writing the items stored so far, and writes the index if it has changed
+================
+*/
+void TexMgr_FlushDiskCache (void)
+{
+	char		path[MAX_OSPATH];
+	unsigned	header[5];
+	FILE		*f;
+	size_t		numentries, numblobs;
+
+	if (!diskcache.initialized)
+		return;
+	TexMgr_SubmitDiskCacheBatch ();
+	if (!diskcache.dirty)
+		return;
+	diskcache.dirty = false;
+
+	numentries = VEC_SIZE (diskcache.entries);
+	numblobs = VEC_SIZE (diskcache.blobs);
+
+	Sys_mkdir (diskcache.dir);
+	q_snprintf (path, sizeof (path), "%s/%s", diskcache.dir, DISKCACHE_INDEX);
+	f = fopen (path, "wb");
+	if (!f)
+		return;
+
+	header[0] = DISKCACHE_MAGIC;
+	header[1] = DISKCACHE_VERSION;
+	header[2] = (unsigned) numentries;
+	header[3] = (unsigned) numblobs;
+	header[4] = diskcache.clock;
+	if (fwrite (header, sizeof (header), 1, f) != 1 ||
+		(numblobs && fwrite (diskcache.blobs, sizeof (diskcache.blobs[0]), numblobs, f) != numblobs) ||
+		(numentries && fwrite (diskcache.entries, sizeof (diskcache.entries[0]), numentries, f) != numentries))
+	{
+		fclose (f);
+		Sys_remove (path);
+		return;
+	}
+	fclose (f);
+}
+
+/*
+================
+TexMgr_ReadDiskCacheItem -- returns the malloc'ed item, header included, or NULL
+================
+*/
+static unsigned *TexMgr_ReadDiskCacheItem (const diskcacheentry_t *entry)
+{
+	char		path[MAX_OSPATH];
+	unsigned	*item;
+	qboolean	ok;
+	FILE		*f;
+
+	if ((uint64_t) entry->offset + entry->size > (entry->blob ? diskcache.blobs[TexMgr_FindDiskCacheBlob (entry->blob)].size : VEC_SIZE (diskcache.batch)))
+		return NULL;
+
+	item = (unsigned *) malloc (entry->size);
+	if (!item)
+		return NULL;
+
+	if (!entry->blob)
+	{
+		memcpy (item, diskcache.batch + entry->offset, entry->size);
+		return item;
+	}
+
+	if (entry->blob == diskcache.writingblob)
+		TexMgr_WaitDiskCacheWriter ();
+	TexMgr_DiskCachePath (path, sizeof (path), entry->blob);
+	f = fopen (path, "rb");
+	ok = f && fseek (f, entry->offset, SEEK_SET) == 0 && fread (item, 1, entry->size, f) == entry->size;
+	if (f)
+		fclose (f);
+	if (!ok)
+	{
+		free (item);
+		return NULL;
+	}
+
+	return item;
+}
+
+/*
+================
+TexMgr_ReadDiskCache
+
+Returns the malloc'ed data stored with the given key, or NULL
+================
+*/
+void *TexMgr_ReadDiskCache (const char *ext, const unsigned *key, int numkeys, size_t *size)
+{
+	diskcacheentry_t	entry;
+	unsigned			*item;
+	size_t				headersize = DISKCACHE_HEADERSIZE (numkeys);
+	char				itemext[4];
+	int					index;
+
+	if (!TexMgr_InitDiskCache () || numkeys > DISKCACHE_MAXKEYS)
+		return NULL;
+
+	index = TexMgr_FindDiskCacheEntry (COM_HashBlock (key, numkeys * sizeof (key[0])), ext);
+	if (index < 0)
+	{
+		diskcache.misses++;
+		return NULL;
+	}
+	entry = diskcache.entries[index];
+
+	item = entry.size >= headersize ? TexMgr_ReadDiskCacheItem (&entry) : NULL;
+	if (item)
+		memcpy (itemext, &item[2], sizeof (itemext));
+	if (!item || item[0] != DISKCACHE_MAGIC || item[1] != DISKCACHE_VERSION ||
+		item[3] != (unsigned) numkeys || item[4 + numkeys] != entry.size - headersize ||
+		strncmp (itemext, ext, sizeof (itemext)) != 0)
+	{
+		// a broken item most likely means a broken blob
+		free (item);
+		if (entry.blob)
+		{
+			TexMgr_DeleteDiskCacheBlob (TexMgr_FindDiskCacheBlob (entry.blob));
+			TexMgr_PurgeDiskCacheEntries ();
+		}
+		diskcache.misses++;
+		return NULL;
+	}
+
+	// a different key with the same hash is just a miss
+	if (memcmp (item + 4, key, numkeys * sizeof (key[0])) != 0)
+	{
+		free (item);
+		diskcache.misses++;
+		return NULL;
+	}
+
+	*size = entry.size - headersize;
+	memmove (item, (byte *) item + headersize, *size);
+
+	if (entry.blob)
+	{
+		diskcache.blobs[TexMgr_FindDiskCacheBlob (entry.blob)].lastuse = ++diskcache.clock;
+		diskcache.dirty = true;
+	}
+	diskcache.hits++;
+
+	return item;
+}
+
+/*
+================
+TexMgr_WriteDiskCache
+
+Stores data under the given key, replacing any previous item with the same key hash.
+Nothing is written to disk until TexMgr_FlushDiskCache.
+================
+*/
+void TexMgr_WriteDiskCache (const char *ext, const unsigned *key, int numkeys, const void *data, size_t size)
+{
+	unsigned	header[5 + DISKCACHE_MAXKEYS + 1];
+	size_t		headersize = DISKCACHE_HEADERSIZE (numkeys);
+	size_t		offset;
+
+	if (!TexMgr_InitDiskCache () || numkeys > DISKCACHE_MAXKEYS)
+		return;
+	if (headersize + size > q_max (gl_texcache_size.value, 0.f) * 1024.0 * 1024.0)
+		return;
+
+	header[0] = DISKCACHE_MAGIC;
+	header[1] = DISKCACHE_VERSION;
+	memset (&header[2], 0, sizeof (header[2]));
+	memcpy (&header[2], ext, q_min (strlen (ext), sizeof (header[2]) - 1));
+	header[3] = numkeys;
+	memcpy (header + 4, key, numkeys * sizeof (key[0]));
+	header[4 + numkeys] = (unsigned) size;
+
+	offset = VEC_SIZE (diskcache.batch);
+	Vec_Append ((void **) &diskcache.batch, 1, header, headersize);
+	Vec_Append ((void **) &diskcache.batch, 1, data, size);
+	TexMgr_AddDiskCacheEntry (COM_HashBlock (key, numkeys * sizeof (key[0])), ext, 0, (unsigned) offset, (unsigned) (headersize + size));
+	diskcache.writes++;
+
+	if (VEC_SIZE (diskcache.batch) >= DISKCACHE_MAXBATCH)
+		TexMgr_SubmitDiskCacheBatch ();
+}
+
+/*
+================
+TexMgr_DiskCacheStats_f
+================
+*/
+static void TexMgr_DiskCacheStats_f (void)
+{
+	if (!TexMgr_InitDiskCache ())
+	{
+		Con_Printf ("Texture cache is disabled (gl_texcache 0)\n");
+		return;
+	}
+
+	Con_Printf ("%s\n", diskcache.dir);
+	Con_Printf ("%d items in %d files, %.1f of %.1f MB, %.1f MB not written yet\n",
+		(int) VEC_SIZE (diskcache.entries), (int) VEC_SIZE (diskcache.blobs),
+		diskcache.totalsize / (1024.0 * 1024.0), q_max (gl_texcache_size.value, 0.f),
+		VEC_SIZE (diskcache.batch) / (1024.0 * 1024.0));
+	Con_Printf ("%d hits, %d misses, %d writes, %d evictions\n",
+		diskcache.hits, diskcache.misses, diskcache.writes, diskcache.evictions);
+}
+
+/*
+================
+TexMgr_DiskCacheClear_f
+================
+*/
+static void TexMgr_DiskCacheClear_f (void)
+{
+	int count;
+
+	if (!TexMgr_InitDiskCache ())
+		return;
+
+	count = VEC_SIZE (diskcache.blobs);
+	while (VEC_SIZE (diskcache.blobs))
+		TexMgr_DeleteDiskCacheBlob (VEC_SIZE (diskcache.blobs) - 1);
+	VEC_CLEAR (diskcache.entries);
+	VEC_CLEAR (diskcache.batch);
+	TexMgr_RebuildDiskCacheTable ();
+	diskcache.dirty = true;
+	TexMgr_FlushDiskCache ();
+
+	Con_Printf ("Removed %d cached files\n", count);
+}
+
 /*
 ================================================================================
 
@@ -875,6 +1585,11 @@ void TexMgr_Init (void)
 	cmd = Cmd_AddCommand ("imagedump", &TexMgr_Imagedump_f);
 	if (cmd)
 		cmd->completion = TexMgr_Imagelist_Completion_f;
+	Cmd_AddCommand ("imagesimdtest", &TexMgr_SIMDTest_f);
+	Cvar_RegisterVariable (&gl_texcache);
+	Cvar_RegisterVariable (&gl_texcache_size);
+	Cmd_AddCommand ("texcache_stats", &TexMgr_DiskCacheStats_f);
+	Cmd_AddCommand ("texcache_clear", &TexMgr_DiskCacheClear_f);
 
 	// poll max size from hardware
 	glGetIntegerv (GL_MAX_TEXTURE_SIZE, &gl_max_texture_size);
@@ -913,20 +1628,29 @@ int TexMgr_Pad (int s)
 
 /*
 ===============
-TexMgr_SafeTextureSize -- return a size with hardware and user prefs in mind
+TexMgr_ClampTextureSize -- return a size with hardware limits and the given max size in mind
 ===============
 */
-int TexMgr_SafeTextureSize (int s)
+static int TexMgr_ClampTextureSize (int s, int maxsize)
 {
-	int p = (int)gl_max_size.value;
-	if (p > 0) {
-		p = TexMgr_Pad(p);
-		if (p < s) s = p;
+	if (maxsize > 0) {
+		maxsize = TexMgr_Pad(maxsize);
+		if (maxsize < s) s = maxsize;
 	}
 	s = CLAMP(1, s, gl_max_texture_size);
 	return s;
 }
 
+/*
+===============
+TexMgr_SafeTextureSize -- return a size with hardware and user prefs in mind
+===============
+*/
+int TexMgr_SafeTextureSize (int s)
+{
+	return TexMgr_ClampTextureSize (s, (int)gl_max_size.value);
+}
+
 /*
 ================
 TexMgr_PadConditional -- only pad if a texture of that size would be padded. (used for tex coords)
@@ -939,12 +1663,215 @@ int TexMgr_PadConditional (int s)
 	return s;
 }
 
+/*
+================================================================================
+
+	PIXEL KERNELS
+
+	Each kernel has a scalar reference path. The SSE2 and AVX2 paths handle
+	as much of the data as they can and must give bit-identical results,
+	which can be checked with the imagesimdtest command.
+
+================================================================================
+*/
+
+typedef enum {
+	TEXSIMD_SCALAR,
+	TEXSIMD_SSE2,
+	TEXSIMD_AVX2,
+
+	TEXSIMD_COUNT
+} texsimd_t;
+
+static const char *const texsimd_names[TEXSIMD_COUNT] = {"scalar", "SSE2", "AVX2"};
+
+/*
+================
+TexMgr_GetSIMDLevel -- returns the best code path allowed by r_simd and the cpu
+================
+*/
+static texsimd_t TexMgr_GetSIMDLevel (void)
+{
+#ifdef USE_AVX2
+	if (use_avx2)
+		return TEXSIMD_AVX2;
+#endif
+#ifdef USE_SSE2
+	if (use_simd)
+		return TEXSIMD_SSE2;
+#endif
+	return TEXSIMD_SCALAR;
+}
+
+#ifdef USE_AVX2
 /*
 ================
-TexMgr_MipMapW
+TexMgr_MipMapW_AVX2 -- returns the number of output pixels written
 ================
 */
-static unsigned *TexMgr_MipMapW (unsigned *data, int width, int height, int depth)
+static TARGET_AVX2 int TexMgr_MipMapW_AVX2 (byte *out, const byte *in, int size)
+{
+	int i;
+
+	for (i = 0; i + 8 <= size; i += 8, in += 64, out += 32)
+	{
+		__m256i v0, v1, v2, v3;
+
+		v0 = _mm256_loadu_si256 ((const __m256i *)in);
+		v1 = _mm256_loadu_si256 ((const __m256i *)in + 1);
+		v0 = _mm256_shuffle_epi32 (v0, _MM_SHUFFLE (3, 1, 2, 0));
+		v1 = _mm256_shuffle_epi32 (v1, _MM_SHUFFLE (3, 1, 2, 0));
+		v2 = _mm256_unpacklo_epi64 (v0, v1);
+		v3 = _mm256_unpackhi_epi64 (v0, v1);
+		v0 = _mm256_avg_epu8 (v2, v3);
+		v0 = _mm256_permute4x64_epi64 (v0, _MM_SHUFFLE (3, 1, 2, 0));
+		_mm256_storeu_si256 ((__m256i *)out, v0);
+	}
+
+	return i;
+}
+
+/*
+================
+TexMgr_MipMapH_AVX2 -- returns the number of bytes written
+================
+*/
+static TARGET_AVX2 int TexMgr_MipMapH_AVX2 (byte *out, const byte *in, int width)
+{
+	int j;
+
+	for (j = 0; j + 32 <= width; j += 32)
+	{
+		__m256i v0, v1;
+
+		v0 = _mm256_loadu_si256 ((const __m256i *)(in + j));
+		v1 = _mm256_loadu_si256 ((const __m256i *)(in + width + j));
+		_mm256_storeu_si256 ((__m256i *)(out + j), _mm256_avg_epu8 (v0, v1));
+	}
+
+	return j;
+}
+
+/*
+================
+TexMgr_ResampleRow_AVX2 -- two pixels at a time, returns the number of pixels written
+================
+*/
+static TARGET_AVX2 int TexMgr_ResampleRow_AVX2 (unsigned *dest, const unsigned *row, int inwidth, int outwidth,
+	unsigned xfrac, unsigned mody, qboolean alpha)
+{
+	__m256i zero = _mm256_setzero_si256 ();
+	__m256i wy0 = _mm256_set1_epi32 (256 - mody);
+	__m256i wy1 = _mm256_set1_epi32 (mody);
+	unsigned alphamask = alpha ? 0 : 0xff000000u;
+	unsigned x, x1, w0, w1;
+	int j;
+
+	for (j = 0, x = 0; j + 2 <= outwidth; j += 2, x += 2*xfrac)
+	{
+		const unsigned *nw0, *nw1;
+		__m256i t, b, wx;
+
+		x1 = x + xfrac;
+		nw0 = row + (x>>16);
+		nw1 = row + (x1>>16);
+
+		// horizontal weights (256 - modx, modx) as 16-bit pairs
+		w0 = (x>>8) & 0xFF;
+		w0 = (w0 << 16) | (256 - w0);
+		w1 = (x1>>8) & 0xFF;
+		w1 = (w1 << 16) | (256 - w1);
+		wx = _mm256_setr_epi32 (w0, w0, w0, w0, w1, w1, w1, w1);
+
+		// nw/ne and sw/se pairs, interleaved per channel
+		t = _mm256_inserti128_si256 (_mm256_castsi128_si256 (_mm_loadl_epi64 ((const __m128i *)nw0)),
+			_mm_loadl_epi64 ((const __m128i *)nw1), 1);
+		b = _mm256_inserti128_si256 (_mm256_castsi128_si256 (_mm_loadl_epi64 ((const __m128i *)(nw0 + inwidth))),
+			_mm_loadl_epi64 ((const __m128i *)(nw1 + inwidth)), 1);
+		t = _mm256_unpacklo_epi8 (t, zero);
+		b = _mm256_unpacklo_epi8 (b, zero);
+		t = _mm256_madd_epi16 (_mm256_unpacklo_epi16 (t, _mm256_srli_si256 (t, 8)), wx);
+		b = _mm256_madd_epi16 (_mm256_unpacklo_epi16 (b, _mm256_srli_si256 (b, 8)), wx);
+
+		t = _mm256_add_epi32 (_mm256_mullo_epi32 (t, wy0), _mm256_mullo_epi32 (b, wy1));
+		t = _mm256_srli_epi32 (t, 16);
+		t = _mm256_packs_epi32 (t, t);
+		t = _mm256_packus_epi16 (t, t);
+
+		dest[j] = (unsigned) _mm_cvtsi128_si32 (_mm256_castsi256_si128 (t)) | alphamask;
+		dest[j+1] = (unsigned) _mm_cvtsi128_si32 (_mm256_extracti128_si256 (t, 1)) | alphamask;
+	}
+
+	return j;
+}
+
+/*
+================
+TexMgr_8to32_AVX2 -- returns the number of pixels written
+================
+*/
+static TARGET_AVX2 int TexMgr_8to32_AVX2 (unsigned *out, const byte *in, int pixels, const unsigned int *usepal)
+{
+	int i;
+
+	for (i = 0; i + 8 <= pixels; i += 8)
+	{
+		__m256i idx = _mm256_cvtepu8_epi32 (_mm_loadl_epi64 ((const __m128i *)(in + i)));
+		_mm256_storeu_si256 ((__m256i *)(out + i), _mm256_i32gather_epi32 ((const int *)usepal, idx, 4));
+	}
+
+	return i;
+}
+#endif // USE_AVX2
+
+#ifdef USE_SSE2
+/*
+================
+TexMgr_ResampleRow_SSE2 -- writes pixels first to outwidth-1
+================
+*/
+static void TexMgr_ResampleRow_SSE2 (unsigned *dest, const unsigned *row, int inwidth, int first, int outwidth,
+	unsigned xfrac, unsigned mody, qboolean alpha)
+{
+	__m128i zero = _mm_setzero_si128 ();
+	__m128i wy0 = _mm_set1_epi32 (256 - mody);
+	__m128i wy1 = _mm_set1_epi32 (mody);
+	unsigned alphamask = alpha ? 0 : 0xff000000u;
+	unsigned x, wx;
+	int j;
+
+	for (j = first, x = first * xfrac; j < outwidth; j++, x += xfrac)
+	{
+		const unsigned *nw = row + (x>>16);
+		__m128i t, b, w;
+
+		wx = (x>>8) & 0xFF;
+		w = _mm_set1_epi32 ((int) ((wx << 16) | (256 - wx)));
+
+		t = _mm_unpacklo_epi8 (_mm_loadl_epi64 ((const __m128i *)nw), zero);
+		b = _mm_unpacklo_epi8 (_mm_loadl_epi64 ((const __m128i *)(nw + inwidth)), zero);
+		t = _mm_madd_epi16 (_mm_unpacklo_epi16 (t, _mm_srli_si128 (t, 8)), w);
+		b = _mm_madd_epi16 (_mm_unpacklo_epi16 (b, _mm_srli_si128 (b, 8)), w);
+
+		// no 32-bit multiply in SSE2, but the horizontal sums fit in 16 bits
+		// and the high halves of both operands are zero
+		t = _mm_or_si128 (_mm_mullo_epi16 (t, wy0), _mm_slli_epi32 (_mm_mulhi_epu16 (t, wy0), 16));
+		b = _mm_or_si128 (_mm_mullo_epi16 (b, wy1), _mm_slli_epi32 (_mm_mulhi_epu16 (b, wy1), 16));
+		t = _mm_srli_epi32 (_mm_add_epi32 (t, b), 16);
+		t = _mm_packs_epi32 (t, t);
+		t = _mm_packus_epi16 (t, t);
+
+		dest[j] = (unsigned) _mm_cvtsi128_si32 (t) | alphamask;
+	}
+}
+#endif // USE_SSE2
+
+/*
+================
+TexMgr_MipMapWEx
+================
+*/
+static unsigned *TexMgr_MipMapWEx (texsimd_t simd, unsigned *data, int width, int height, int depth)
 {
 	int	i, size;
 	byte	*out, *in;
@@ -955,8 +1882,18 @@ static unsigned *TexMgr_MipMapW (unsigned *data, int width, int height, int dept
 	out = in = (byte *)data;
 	size = ((width*height)>>1)*depth;
 
+#ifdef USE_AVX2
+	if (simd >= TEXSIMD_AVX2)
+	{
+		i = TexMgr_MipMapW_AVX2 (out, in, size);
+		size -= i;
+		in += i*8;
+		out += i*4;
+	}
+#endif
+
 #ifdef USE_SSE2
-	while (size >= 4)
+	while (simd >= TEXSIMD_SSE2 && size >= 4)
 	{
 		__m128i v0, v1, v2, v3;
 
@@ -988,10 +1925,20 @@ static unsigned *TexMgr_MipMapW (unsigned *data, int width, int height, int dept
 
 /*
 ================
-TexMgr_MipMapH
+TexMgr_MipMapW
 ================
 */
-static unsigned *TexMgr_MipMapH (unsigned *data, int width, int height, int depth)
+static unsigned *TexMgr_MipMapW (unsigned *data, int width, int height, int depth)
+{
+	return TexMgr_MipMapWEx (TexMgr_GetSIMDLevel (), data, width, height, depth);
+}
+
+/*
+================
+TexMgr_MipMapHEx
+================
+*/
+static unsigned *TexMgr_MipMapHEx (texsimd_t simd, unsigned *data, int width, int height, int depth)
 {
 	int	i, j;
 	byte	*out, *in;
@@ -1007,8 +1954,16 @@ static unsigned *TexMgr_MipMapH (unsigned *data, int width, int height, int dept
 	for (i = 0; i < height; i++, in += width)
 	{
 		j = 0;
+#ifdef USE_AVX2
+		if (simd >= TEXSIMD_AVX2)
+		{
+			j = TexMgr_MipMapH_AVX2 (out, in, width);
+			in += j;
+			out += j;
+		}
+#endif
 #ifdef USE_SSE2
-		while (j + 16 <= width)
+		while (simd >= TEXSIMD_SSE2 && j + 16 <= width)
 		{
 			__m128i v0, v1;
 
@@ -1036,61 +1991,280 @@ static unsigned *TexMgr_MipMapH (unsigned *data, int width, int height, int dept
 
 /*
 ================
-TexMgr_ResampleTexture -- bilinear resample
+TexMgr_MipMapH
+================
+*/
+static unsigned *TexMgr_MipMapH (unsigned *data, int width, int height, int depth)
+{
+	return TexMgr_MipMapHEx (TexMgr_GetSIMDLevel (), data, width, height, depth);
+}
+
+/*
+================
+TexMgr_ResampleTextureEx -- bilinear resample
+================
+*/
+static unsigned *TexMgr_ResampleTextureEx (texsimd_t simd, unsigned *in, int inwidth, int inheight, qboolean alpha)
+{
+	byte *nwpx, *nepx, *swpx, *sepx, *dest;
+	unsigned xfrac, yfrac, x, y, modx, mody, imodx, imody, injump, outjump;
+	unsigned *out;
+	int i, j, outwidth, outheight;
+
+	if (inwidth == TexMgr_Pad(inwidth) && inheight == TexMgr_Pad(inheight))
+		return in;
+
+	outwidth = TexMgr_Pad(inwidth);
+	outheight = TexMgr_Pad(inheight);
+	out = (unsigned *) Hunk_AllocNoFill (outwidth*outheight*4);
+
+	xfrac = ((inwidth-1) << 16) / (outwidth-1);
+	yfrac = ((inheight-1) << 16) / (outheight-1);
+	y = outjump = 0;
+
+	for (i = 0; i < outheight; i++)
+	{
+		mody = (y>>8) & 0xFF;
+		imody = 256 - mody;
+		injump = (y>>16) * inwidth;
+		j = 0;
+
+#ifdef USE_AVX2
+		if (simd >= TEXSIMD_AVX2)
+			j = TexMgr_ResampleRow_AVX2 (out + outjump, in + injump, inwidth, outwidth, xfrac, mody, alpha);
+#endif
+#ifdef USE_SSE2
+		if (simd >= TEXSIMD_SSE2)
+		{
+			TexMgr_ResampleRow_SSE2 (out + outjump, in + injump, inwidth, j, outwidth, xfrac, mody, alpha);
+			j = outwidth;
+		}
+#endif
+
+		for (x = j * xfrac; j < outwidth; j++)
+		{
+			modx = (x>>8) & 0xFF;
+			imodx = 256 - modx;
+
+			nwpx = (byte *)(in + (x>>16) + injump);
+			nepx = nwpx + 4;
+			swpx = nwpx + inwidth*4;
+			sepx = swpx + 4;
+
+			dest = (byte *)(out + outjump + j);
+
+			dest[0] = (nwpx[0]*imodx*imody + nepx[0]*modx*imody + swpx[0]*imodx*mody + sepx[0]*modx*mody)>>16;
+			dest[1] = (nwpx[1]*imodx*imody + nepx[1]*modx*imody + swpx[1]*imodx*mody + sepx[1]*modx*mody)>>16;
+			dest[2] = (nwpx[2]*imodx*imody + nepx[2]*modx*imody + swpx[2]*imodx*mody + sepx[2]*modx*mody)>>16;
+			if (alpha)
+				dest[3] = (nwpx[3]*imodx*imody + nepx[3]*modx*imody + swpx[3]*imodx*mody + sepx[3]*modx*mody)>>16;
+			else
+				dest[3] = 255;
+
+			x += xfrac;
+		}
+		outjump += outwidth;
+		y += yfrac;
+	}
+
+	return out;
+}
+
+/*
+================
+TexMgr_ResampleTexture
+================
+*/
+static unsigned *TexMgr_ResampleTexture (unsigned *in, int inwidth, int inheight, qboolean alpha)
+{
+	return TexMgr_ResampleTextureEx (TexMgr_GetSIMDLevel (), in, inwidth, inheight, alpha);
+}
+
+/*
+================
+TexMgr_8to32Ex
+
+SSE2 has no gather instruction, so there is only an AVX2 path
+================
+*/
+static unsigned *TexMgr_8to32Ex (texsimd_t simd, byte *in, int pixels, unsigned int *usepal)
+{
+	int i = 0;
+	unsigned *data;
+
+	data = (unsigned *) Hunk_AllocNoFill (pixels*4);
+
+#ifdef USE_AVX2
+	if (simd >= TEXSIMD_AVX2)
+		i = TexMgr_8to32_AVX2 (data, in, pixels, usepal);
+#endif
+
+	for (; i < pixels; i++)
+		data[i] = usepal[in[i]];
+
+	return data;
+}
+
+/*
+================
+TexMgr_8to32
 ================
 */
-static unsigned *TexMgr_ResampleTexture (unsigned *in, int inwidth, int inheight, qboolean alpha)
+static unsigned *TexMgr_8to32 (byte *in, int pixels, unsigned int *usepal)
 {
-	byte *nwpx, *nepx, *swpx, *sepx, *dest;
-	unsigned xfrac, yfrac, x, y, modx, mody, imodx, imody, injump, outjump;
-	unsigned *out;
-	int i, j, outwidth, outheight;
+	return TexMgr_8to32Ex (TexMgr_GetSIMDLevel (), in, pixels, usepal);
+}
 
-	if (inwidth == TexMgr_Pad(inwidth) && inheight == TexMgr_Pad(inheight))
-		return in;
+/*
+================
+TexMgr_SIMDSupported -- whether the cpu can run a code path, regardless of r_simd
+================
+*/
+static qboolean TexMgr_SIMDSupported (texsimd_t simd)
+{
+	switch (simd)
+	{
+	case TEXSIMD_SCALAR:
+		return true;
+#ifdef USE_SSE2
+	case TEXSIMD_SSE2:
+		return SDL_HasSSE2 ();
+#endif
+#ifdef USE_AVX2
+	case TEXSIMD_AVX2:
+		return SDL_HasSSE2 () && SDL_HasAVX2 ();
+#endif
+	default:
+		return false;
+	}
+}
 
-	outwidth = TexMgr_Pad(inwidth);
-	outheight = TexMgr_Pad(inheight);
-	out = (unsigned *) Hunk_AllocNoFill (outwidth*outheight*4);
+typedef struct {
+	const char	*name;
+	void		(*run) (texsimd_t simd, byte *dst, byte *src, int width, int height);
+} simdtest_t;
 
-	xfrac = ((inwidth-1) << 16) / (outwidth-1);
-	yfrac = ((inheight-1) << 16) / (outheight-1);
-	y = outjump = 0;
+static void TexMgr_TestMipMapW (texsimd_t simd, byte *dst, byte *src, int width, int height)
+{
+	memcpy (dst, src, width * height * 4);
+	TexMgr_MipMapWEx (simd, (unsigned *)dst, width, height, 1);
+}
 
-	for (i = 0; i < outheight; i++)
-	{
-		mody = (y>>8) & 0xFF;
-		imody = 256 - mody;
-		injump = (y>>16) * inwidth;
-		x = 0;
+static void TexMgr_TestMipMapH (texsimd_t simd, byte *dst, byte *src, int width, int height)
+{
+	memcpy (dst, src, width * height * 4);
+	TexMgr_MipMapHEx (simd, (unsigned *)dst, width, height, 1);
+}
 
-		for (j = 0; j < outwidth; j++)
-		{
-			modx = (x>>8) & 0xFF;
-			imodx = 256 - modx;
+static void TexMgr_TestResample (texsimd_t simd, byte *dst, byte *src, int width, int height, qboolean alpha)
+{
+	int mark = Hunk_LowMark ();
+	memcpy (dst, TexMgr_ResampleTextureEx (simd, (unsigned *)src, width, height, alpha), TexMgr_Pad (width) * TexMgr_Pad (height) * 4);
+	Hunk_FreeToLowMark (mark);
+}
 
-			nwpx = (byte *)(in + (x>>16) + injump);
-			nepx = nwpx + 4;
-			swpx = nwpx + inwidth*4;
-			sepx = swpx + 4;
+static void TexMgr_TestResampleAlpha (texsimd_t simd, byte *dst, byte *src, int width, int height)
+{
+	TexMgr_TestResample (simd, dst, src, width, height, true);
+}
 
-			dest = (byte *)(out + outjump + j);
+static void TexMgr_TestResampleOpaque (texsimd_t simd, byte *dst, byte *src, int width, int height)
+{
+	TexMgr_TestResample (simd, dst, src, width, height, false);
+}
 
-			dest[0] = (nwpx[0]*imodx*imody + nepx[0]*modx*imody + swpx[0]*imodx*mody + sepx[0]*modx*mody)>>16;
-			dest[1] = (nwpx[1]*imodx*imody + nepx[1]*modx*imody + swpx[1]*imodx*mody + sepx[1]*modx*mody)>>16;
-			dest[2] = (nwpx[2]*imodx*imody + nepx[2]*modx*imody + swpx[2]*imodx*mody + sepx[2]*modx*mody)>>16;
-			if (alpha)
-				dest[3] = (nwpx[3]*imodx*imody + nepx[3]*modx*imody + swpx[3]*imodx*mody + sepx[3]*modx*mody)>>16;
-			else
-				dest[3] = 255;
+static void TexMgr_Test8to32 (texsimd_t simd, byte *dst, byte *src, int width, int height)
+{
+	int mark = Hunk_LowMark ();
+	memcpy (dst, TexMgr_8to32Ex (simd, src, width * height, d_8to24table), width * height * 4);
+	Hunk_FreeToLowMark (mark);
+}
 
-			x += xfrac;
+/*
+================
+TexMgr_SIMDTest_f -- checks the SIMD kernels against the scalar code and times them
+================
+*/
+static void TexMgr_SIMDTest_f (void)
+{
+	static const simdtest_t tests[] = {
+		{"mipmapw",			TexMgr_TestMipMapW},
+		{"mipmaph",			TexMgr_TestMipMapH},
+		{"resample",		TexMgr_TestResampleAlpha},
+		{"resample opaque",	TexMgr_TestResampleOpaque},
+		{"8to32",			TexMgr_Test8to32},
+	};
+	static const int sizes[][2] = {
+		{2, 2}, {6, 10}, {18, 3}, {34, 130}, {64, 64}, {100, 75}, {256, 256}, {640, 480}, {1024, 1024},
+	};
+	const int	maxsize = 1024 * 1024 * 4 + 16; // padding for the reads past the last row of the resampler
+	byte		*src, *ref, *dst;
+	unsigned	seed = 0x2545F491u;
+	int			i, j, k, rep, reps, failures = 0;
+	double		start, times[TEXSIMD_COUNT];
+	texsimd_t	simd;
+
+	src = (byte *) malloc (maxsize);
+	ref = (byte *) malloc (maxsize);
+	dst = (byte *) malloc (maxsize);
+	if (!src || !ref || !dst)
+		Sys_Error ("TexMgr_SIMDTest_f: out of memory");
+
+	for (i = 0; i < maxsize; i++)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		src[i] = seed >> 24;
+	}
+
+	for (i = 0; i < (int) countof (tests); i++)
+	{
+		memset (times, 0, sizeof (times));
+		for (j = 0; j < (int) countof (sizes); j++)
+		{
+			int width = sizes[j][0];
+			int height = sizes[j][1];
+			int size = TexMgr_Pad (width) * TexMgr_Pad (height) * 4;
+
+			reps = q_max (1, (1 << 20) / (width * height));
+			for (simd = TEXSIMD_SCALAR; simd < TEXSIMD_COUNT; simd++)
+			{
+				if (!TexMgr_SIMDSupported (simd))
+					continue;
+
+				start = Sys_DoubleTime ();
+				for (rep = 0; rep < reps; rep++)
+					tests[i].run (simd, dst, src, width, height);
+				times[simd] += Sys_DoubleTime () - start;
+
+				if (simd == TEXSIMD_SCALAR)
+					memcpy (ref, dst, size);
+				else if (memcmp (ref, dst, size) != 0)
+				{
+					for (k = 0; k < size && ref[k] == dst[k]; k++)
+						;
+					Con_Warning ("%s %s: mismatch at byte %d for %dx%d\n", tests[i].name, texsimd_names[simd], k, width, height);
+					failures++;
+				}
+			}
 		}
-		outjump += outwidth;
-		y += yfrac;
+
+		Con_Printf ("%-16s %s %6.2f ms", tests[i].name, texsimd_names[TEXSIMD_SCALAR], times[TEXSIMD_SCALAR] * 1000.0);
+		for (simd = TEXSIMD_SCALAR + 1; simd < TEXSIMD_COUNT; simd++)
+			if (TexMgr_SIMDSupported (simd))
+				Con_Printf (", %s %6.2f ms (%.1fx)", texsimd_names[simd], times[simd] * 1000.0,
+					times[simd] > 0.0 ? times[TEXSIMD_SCALAR] / times[simd] : 0.0);
+		Con_Printf ("\n");
 	}
 
-	return out;
+	if (failures)
+		Con_Warning ("%d mismatches\n", failures);
+	else
+		Con_Printf ("All SIMD kernels match the scalar code\n");
+	Con_Printf ("Active path: %s\n", texsimd_names[TexMgr_GetSIMDLevel ()]);
+
+	free (src);
+	free (ref);
+	free (dst);
 }
 
 /*
@@ -1226,24 +2400,6 @@ static void TexMgr_PadEdgeFixH (byte *data, int width, int height)
 	}
 }
 
-/*
-================
-TexMgr_8to32
-================
-*/
-static unsigned *TexMgr_8to32 (byte *in, int pixels, unsigned int *usepal)
-{
-	int i;
-	unsigned *out, *data;
-
-	out = data = (unsigned *) Hunk_AllocNoFill (pixels*4);
-
-	for (i = 0; i < pixels; i++)
-		*out++ = usepal[*in++];
-
-	return data;
-}
-
 /*
 ================
 TexMgr_PadImageW -- return image with width padded up to power-of-two dimentions
@@ -1285,120 +2441,421 @@ static byte *TexMgr_PadImageH (byte *in, int width, int height, byte padbyte)
 	if (height == TexMgr_Pad(height))
 		return in;
 
-	srcpix = width * height;
-	dstpix = width * TexMgr_Pad(height);
+	srcpix = width * height;
+	dstpix = width * TexMgr_Pad(height);
+
+	out = data = (byte *) Hunk_AllocNoFill(dstpix);
+
+	for (i = 0; i < srcpix; i++)
+		*out++ = *in++;
+	for (     ; i < dstpix; i++)
+		*out++ = padbyte;
+
+	return data;
+}
+
+/*
+================
+GL_TexImage -- calls glTexImage2D/3D based on texture type
+================
+*/
+static void GL_TexImage (gltexture_t *glt, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLenum format, GLenum type, const GLvoid *pixels)
+{
+	const GLvoid **images = (const GLvoid **)pixels; // for arrays/cubemaps "pixels" is actually an array of pointers
+	unsigned int i;
+
+	switch (glt->target)
+	{
+	case GL_TEXTURE_2D_ARRAY:
+		GL_TexImage3DFunc (glt->target, level, internalformat, width, height, glt->depth, 0, format, type, NULL);
+		for (i = 0; i < glt->depth; i++)
+			GL_TexSubImage3DFunc (glt->target, level, 0, 0, i, width, height, 1, format, type, images ? images[i] : NULL);
+		break;
+
+	case GL_TEXTURE_CUBE_MAP:
+		for (i = 0; i < 6; i++)
+			glTexImage2D (GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, level, internalformat, width, height, 0, format, type, images ? images[i] : NULL);
+		break;
+
+	case GL_TEXTURE_2D:
+		glTexImage2D (glt->target, level, internalformat, width, height, 0, format, type, pixels);
+		break;
+
+	default:
+		Sys_Error ("GL_TexImage: unknown target %d for %s", glt->target, glt->name);
+		break;
+	}
+}
+
+/*
+================
+TexMgr_DownsampleImage32 -- halves 32bit data in place until it fits in maxwidth x maxheight
+================
+*/
+static void TexMgr_DownsampleImage32 (unsigned *data, int *width, int *height, int depth, int maxwidth, int maxheight, qboolean alphafix)
+{
+	while (*height > maxheight)
+	{
+		TexMgr_MipMapH (data, *width, *height, depth);
+		*height >>= 1;
+		if (alphafix)
+			TexMgr_AlphaEdgeFix ((byte *)data, *width, *height);
+	}
+	while (*width > maxwidth)
+	{
+		TexMgr_MipMapW (data, *width, *height, depth);
+		*width >>= 1;
+		if (alphafix)
+			TexMgr_AlphaEdgeFix ((byte *)data, *width, *height);
+	}
+}
+
+/*
+================
+TexMgr_PicmipImage32 -- scales 32bit data down in place to the size allowed by gl_picmip/gl_max_size
+================
+*/
+static void TexMgr_PicmipImage32 (gltexture_t *glt, unsigned *data)
+{
+	int	width, height, picmip;
+
+	picmip = (glt->flags & TEXPREF_NOPICMIP) ? 0 : q_max((int)gl_picmip.value, 0);
+	width = glt->width;
+	height = glt->height;
+	TexMgr_DownsampleImage32 (data, &width, &height, glt->depth,
+		TexMgr_SafeTextureSize (width >> picmip), TexMgr_SafeTextureSize (height >> picmip),
+		(glt->flags & TEXPREF_ALPHA) && glt->target == GL_TEXTURE_2D);
+	glt->width = width;
+	glt->height = height;
+}
+
+/*
+================
+TexMgr_GetInternalFormat
+================
+*/
+static GLenum TexMgr_GetInternalFormat (gltexture_t *glt)
+{
+	qboolean compress = gl_compress_textures.value && TexMgr_CanCompress (glt);
+	glformat_t internalformat = (glt->flags & TEXPREF_HASALPHA) ? glformats[compress].alpha : glformats[compress].solid;
+	glt->compression = internalformat.ratio;
+	return internalformat.id;
+}
+
+/*
+================
+TexMgr_LoadImage32 -- handles 32bit source data
+================
+*/
+static void TexMgr_LoadImage32 (gltexture_t *glt, unsigned *data)
+{
+	int	miplevel, mipwidth, mipheight;
+	GLenum internalformat;
+
+	// mipmap down
+	TexMgr_PicmipImage32 (glt, data);
+
+	// upload
+	internalformat = TexMgr_GetInternalFormat (glt);
+	GL_Bind (GL_TEXTURE0, glt);
+	GL_TexImage (glt, 0, internalformat, glt->width, glt->height, GL_RGBA, GL_UNSIGNED_BYTE, data);
+
+	// upload mipmaps
+	if (glt->flags & TEXPREF_MIPMAP)
+	{
+		if (glt->flags & (TEXPREF_CUBEMAP|TEXPREF_ARRAY))
+		{
+			GL_GenerateMipmapFunc (glt->target);
+		}
+		else
+		{
+			mipwidth = glt->width;
+			mipheight = glt->height;
+
+			for (miplevel=1; mipwidth > 1 || mipheight > 1; miplevel++)
+			{
+				if (mipheight > 1)
+				{
+					TexMgr_MipMapH (data, mipwidth, mipheight, glt->depth);
+					mipheight >>= 1;
+				}
+				if (mipwidth > 1)
+				{
+					TexMgr_MipMapW (data, mipwidth, mipheight, glt->depth);
+					mipwidth >>= 1;
+				}
+				GL_TexImage (glt, miplevel, internalformat, mipwidth, mipheight, GL_RGBA, GL_UNSIGNED_BYTE, data);
+			}
+		}
+	}
+
+	// set filter modes
+	TexMgr_SetFilterModes (glt);
+}
+
+#define TEXSTAGING_SEGMENTS		4
+#define TEXSTAGING_SEGMENT_SIZE	(8 * 1024 * 1024)
+
+// persistently mapped upload ring, split in fenced segments
+static struct {
+	GLuint			buffer;
+	byte			*ptr;
+	int				segment;
+	size_t			offset;				// within the current segment
+	GLsync			fences[TEXSTAGING_SEGMENTS];
+	qboolean		initialized;
+} texstaging;
+
+/*
+================
+TexMgr_BuildMipChain -- stores level 0 of data and all its mips (if requested) back to back
+================
+*/
+static byte *TexMgr_BuildMipChain (unsigned *data, int width, int height, qboolean mipmap, int *numlevels)
+{
+	int		mipwidth, mipheight, levels;
+	size_t	size, total;
+	byte	*chain, *out;
+
+	mipwidth = width;
+	mipheight = height;
+	total = (size_t) mipwidth * mipheight * 4;
+	levels = 1;
+	while (mipmap && (mipwidth > 1 || mipheight > 1))
+	{
+		mipwidth = q_max (mipwidth >> 1, 1);
+		mipheight = q_max (mipheight >> 1, 1);
+		total += (size_t) mipwidth * mipheight * 4;
+		levels++;
+	}
+
+	chain = (byte *) malloc (total);
+	if (!chain)
+		Sys_Error ("TexMgr_BuildMipChain: out of memory on %" SDL_PRIu64 " bytes", (uint64_t) total);
+
+	// same steps as TexMgr_LoadImage32, so that the results are identical
+	mipwidth = width;
+	mipheight = height;
+	size = (size_t) mipwidth * mipheight * 4;
+	memcpy (chain, data, size);
+	out = chain + size;
+	while (mipmap && (mipwidth > 1 || mipheight > 1))
+	{
+		if (mipheight > 1)
+		{
+			TexMgr_MipMapH (data, mipwidth, mipheight, 1);
+			mipheight >>= 1;
+		}
+		if (mipwidth > 1)
+		{
+			TexMgr_MipMapW (data, mipwidth, mipheight, 1);
+			mipwidth >>= 1;
+		}
+		size = (size_t) mipwidth * mipheight * 4;
+		memcpy (out, data, size);
+		out += size;
+	}
+
+	*numlevels = levels;
+	return chain;
+}
+
+/*
+================
+TexMgr_InitStaging -- lazily creates the persistently mapped upload ring
+================
+*/
+static qboolean TexMgr_InitStaging (void)
+{
+	GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	GLsizeiptr size = TEXSTAGING_SEGMENTS * TEXSTAGING_SEGMENT_SIZE;
+
+	if (texstaging.initialized)
+		return texstaging.ptr != NULL;
+	texstaging.initialized = true;
+
+	if (!gl_buffer_storage_able)
+		return false;
+
+	GL_GenBuffersFunc (1, &texstaging.buffer);
+	GL_BindBuffer (GL_PIXEL_UNPACK_BUFFER, texstaging.buffer);
+	GL_ObjectLabelFunc (GL_BUFFER, texstaging.buffer, -1, "texture staging buffer");
+	GL_BufferStorageFunc (GL_PIXEL_UNPACK_BUFFER, size, NULL, flags);
+	texstaging.ptr = (byte *) GL_MapBufferRangeFunc (GL_PIXEL_UNPACK_BUFFER, 0, size, flags);
+	GL_BindBuffer (GL_PIXEL_UNPACK_BUFFER, 0);
+	if (!texstaging.ptr)
+		Con_DWarning ("TexMgr_InitStaging: MapBufferRange failed on %" SDL_PRIu64 " bytes\n", (uint64_t) size);
+
+	return texstaging.ptr != NULL;
+}
+
+/*
+================
+TexMgr_StagePixels
+
+Copies data into the upload ring and returns the offset to pass to glTexImage
+with the ring bound, or binds no buffer and returns data if it can't be staged.
+Before a segment is reused, the uploads that last read from it have to be complete.
+================
+*/
+static const GLvoid *TexMgr_StagePixels (const byte *data, size_t size)
+{
+	size_t		offset;
+	GLsync		*fence;
+
+	if (!TexMgr_InitStaging () || size > TEXSTAGING_SEGMENT_SIZE)
+	{
+		GL_BindBuffer (GL_PIXEL_UNPACK_BUFFER, 0);
+		return data;
+	}
+
+	if (texstaging.offset + size > TEXSTAGING_SEGMENT_SIZE)
+	{
+		texstaging.fences[texstaging.segment] = GL_FenceSyncFunc (GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		texstaging.segment = (texstaging.segment + 1) % TEXSTAGING_SEGMENTS;
+		texstaging.offset = 0;
 
-	out = data = (byte *) Hunk_AllocNoFill(dstpix);
+		fence = &texstaging.fences[texstaging.segment];
+		if (*fence)
+		{
+			GLuint64 timeout = 1ull * 1000 * 1000 * 1000; // 1 second
+			GLenum result = GL_ClientWaitSyncFunc (*fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+			if (result == GL_TIMEOUT_EXPIRED)
+				glFinish ();
+			else if (result == GL_WAIT_FAILED)
+				Sys_Error ("TexMgr_StagePixels: wait failed (0x%04X)", glGetError ());
+			GL_DeleteSyncFunc (*fence);
+			*fence = NULL;
+		}
+	}
 
-	for (i = 0; i < srcpix; i++)
-		*out++ = *in++;
-	for (     ; i < dstpix; i++)
-		*out++ = padbyte;
+	offset = texstaging.segment * TEXSTAGING_SEGMENT_SIZE + texstaging.offset;
+	memcpy (texstaging.ptr + offset, data, size);
+	texstaging.offset = (texstaging.offset + size + 15) & ~(size_t)15;
 
-	return data;
+	GL_BindBuffer (GL_PIXEL_UNPACK_BUFFER, texstaging.buffer);
+	return (const GLvoid *) offset;
 }
 
 /*
 ================
-GL_TexImage -- calls glTexImage2D/3D based on texture type
+TexMgr_UploadMipChain -- uploads levels stored back to back, as built by TexMgr_BuildMipChain
 ================
 */
-static void GL_TexImage (gltexture_t *glt, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLenum format, GLenum type, const GLvoid *pixels)
+static void TexMgr_UploadMipChain (gltexture_t *glt, const byte *data, int numlevels)
 {
-	const GLvoid **images = (const GLvoid **)pixels; // for arrays/cubemaps "pixels" is actually an array of pointers
-	unsigned int i;
+	GLenum		internalformat;
+	int			miplevel, mipwidth, mipheight;
+	size_t		size;
 
-	switch (glt->target)
+	internalformat = TexMgr_GetInternalFormat (glt);
+	GL_Bind (GL_TEXTURE0, glt);
+
+	mipwidth = glt->width;
+	mipheight = glt->height;
+	for (miplevel = 0; miplevel < numlevels; miplevel++)
 	{
-	case GL_TEXTURE_2D_ARRAY:
-		GL_TexImage3DFunc (glt->target, level, internalformat, width, height, glt->depth, 0, format, type, NULL);
-		for (i = 0; i < glt->depth; i++)
-			GL_TexSubImage3DFunc (glt->target, level, 0, 0, i, width, height, 1, format, type, images ? images[i] : NULL);
-		break;
+		size = (size_t) mipwidth * mipheight * 4;
+		GL_TexImage (glt, miplevel, internalformat, mipwidth, mipheight, GL_RGBA, GL_UNSIGNED_BYTE, TexMgr_StagePixels (data, size));
+		data += size;
+		mipwidth = q_max (mipwidth >> 1, 1);
+		mipheight = q_max (mipheight >> 1, 1);
+	}
+	GL_BindBuffer (GL_PIXEL_UNPACK_BUFFER, 0);
 
-	case GL_TEXTURE_CUBE_MAP:
-		for (i = 0; i < 6; i++)
-			glTexImage2D (GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, level, internalformat, width, height, 0, format, type, images ? images[i] : NULL);
-		break;
+	TexMgr_SetFilterModes (glt);
+}
 
-	case GL_TEXTURE_2D:
-		glTexImage2D (glt->target, level, internalformat, width, height, 0, format, type, pixels);
-		break;
+#define TEXCACHE_KEYS		8
 
-	default:
-		Sys_Error ("GL_TexImage: unknown target %d for %s", glt->target, glt->name);
-		break;
-	}
+/*
+================
+TexMgr_GetCacheKey8 -- describes everything the processed texels of an 8bit image depend on
+================
+*/
+static void TexMgr_GetCacheKey8 (gltexture_t *glt, byte *data, unsigned int *usepal, unsigned key[TEXCACHE_KEYS])
+{
+	int size = glt->width * glt->height * glt->depth;
+
+	key[0] = COM_HashBlock (data, size);
+	key[1] = CRC_Block (data, size);
+	key[2] = glt->width | (glt->height << 16);
+	key[3] = glt->flags;
+	key[4] = COM_HashBlock (usepal, 256 * sizeof (usepal[0]));
+	key[5] = (glt->flags & TEXPREF_NOPICMIP) ? 0 : q_max ((int)gl_picmip.value, 0);
+	key[6] = (int)gl_max_size.value;
+	key[7] = gl_max_texture_size;
 }
 
 /*
 ================
-TexMgr_LoadImage32 -- handles 32bit source data
+TexMgr_LoadCachedImage -- uploads a mip chain from the disk cache
 ================
 */
-static void TexMgr_LoadImage32 (gltexture_t *glt, unsigned *data)
+static qboolean TexMgr_LoadCachedImage (gltexture_t *glt, const unsigned key[TEXCACHE_KEYS])
 {
-	int	miplevel, mipwidth, mipheight, picmip;
-	glformat_t internalformat;
-	qboolean compress;
+	unsigned	*data, width, height, numlevels, w, h, i;
+	size_t		size, expected;
 
-	// mipmap down
-	picmip = (glt->flags & TEXPREF_NOPICMIP) ? 0 : q_max((int)gl_picmip.value, 0);
-	mipwidth = TexMgr_SafeTextureSize (glt->width >> picmip);
-	mipheight = TexMgr_SafeTextureSize (glt->height >> picmip);
-	while ((int) glt->height > mipheight)
+	data = (unsigned *) TexMgr_ReadDiskCache ("tex", key, TEXCACHE_KEYS, &size);
+	if (!data)
+		return false;
+
+	// header: width, height, flags, number of levels
+	expected = 0;
+	if (size >= 4 * sizeof (unsigned))
 	{
-		TexMgr_MipMapH (data, glt->width, glt->height, glt->depth);
-		glt->height >>= 1;
-		if (glt->flags & TEXPREF_ALPHA && glt->target == GL_TEXTURE_2D)
-			TexMgr_AlphaEdgeFix ((byte *)data, glt->width, glt->height);
+		width = data[0];
+		height = data[1];
+		numlevels = data[3];
+		if (width - 1 < (unsigned) gl_max_texture_size && height - 1 < (unsigned) gl_max_texture_size && numlevels - 1 < 32)
+			for (i = 0, w = width, h = height, expected = 4 * sizeof (unsigned); i < numlevels; i++, w = q_max (w >> 1, 1), h = q_max (h >> 1, 1))
+				expected += (size_t) w * h * 4;
 	}
-	while ((int) glt->width > mipwidth)
+	if (!expected || expected != size)
 	{
-		TexMgr_MipMapW (data, glt->width, glt->height, glt->depth);
-		glt->width >>= 1;
-		if (glt->flags & TEXPREF_ALPHA && glt->target == GL_TEXTURE_2D)
-			TexMgr_AlphaEdgeFix ((byte *)data, glt->width, glt->height);
+		free (data);
+		return false;
 	}
 
-	// upload
-	compress = gl_compress_textures.value && TexMgr_CanCompress (glt);
-	internalformat = (glt->flags & TEXPREF_HASALPHA) ? glformats[compress].alpha : glformats[compress].solid;
-	glt->compression = internalformat.ratio;
-	GL_Bind (GL_TEXTURE0, glt);
-	GL_TexImage (glt, 0, internalformat.id, glt->width, glt->height, GL_RGBA, GL_UNSIGNED_BYTE, data);
-
-	// upload mipmaps
-	if (glt->flags & TEXPREF_MIPMAP)
-	{
-		if (glt->flags & (TEXPREF_CUBEMAP|TEXPREF_ARRAY))
-		{
-			GL_GenerateMipmapFunc (glt->target);
-		}
-		else
-		{
-			mipwidth = glt->width;
-			mipheight = glt->height;
+	glt->width = width;
+	glt->height = height;
+	glt->flags = data[2];
+	TexMgr_UploadMipChain (glt, (const byte *) (data + 4), numlevels);
+	free (data);
 
-			for (miplevel=1; mipwidth > 1 || mipheight > 1; miplevel++)
-			{
-				if (mipheight > 1)
-				{
-					TexMgr_MipMapH (data, mipwidth, mipheight, glt->depth);
-					mipheight >>= 1;
-				}
-				if (mipwidth > 1)
-				{
-					TexMgr_MipMapW (data, mipwidth, mipheight, glt->depth);
-					mipwidth >>= 1;
-				}
-				GL_TexImage (glt, miplevel, internalformat.id, mipwidth, mipheight, GL_RGBA, GL_UNSIGNED_BYTE, data);
-			}
-		}
-	}
+	return true;
+}
 
-	// set filter modes
-	TexMgr_SetFilterModes (glt);
+/*
+================
+TexMgr_LoadImage32Cached -- like TexMgr_LoadImage32 for 2D textures, but also stores the result in the disk cache
+================
+*/
+static void TexMgr_LoadImage32Cached (gltexture_t *glt, unsigned *data, const unsigned key[TEXCACHE_KEYS])
+{
+	unsigned	*cached;
+	byte		*chain;
+	int			numlevels, size, w, h, i;
+
+	TexMgr_PicmipImage32 (glt, data);
+	chain = TexMgr_BuildMipChain (data, glt->width, glt->height, (glt->flags & TEXPREF_MIPMAP) != 0, &numlevels);
+	TexMgr_UploadMipChain (glt, chain, numlevels);
+
+	for (i = 0, w = glt->width, h = glt->height, size = 0; i < numlevels; i++, w = q_max (w >> 1, 1), h = q_max (h >> 1, 1))
+		size += w * h * 4;
+	cached = (unsigned *) malloc (4 * sizeof (unsigned) + size);
+	if (cached)
+	{
+		cached[0] = glt->width;
+		cached[1] = glt->height;
+		cached[2] = glt->flags;
+		cached[3] = numlevels;
+		memcpy (cached + 4, chain, size);
+		TexMgr_WriteDiskCache ("tex", key, TEXCACHE_KEYS, cached, 4 * sizeof (unsigned) + size);
+		free (cached);
+	}
+	free (chain);
 }
 
 /*
@@ -1412,6 +2869,8 @@ static void TexMgr_LoadImage8 (gltexture_t *glt, byte *data)
 	qboolean padw = false, padh = false;
 	byte padbyte;
 	unsigned int *usepal;
+	unsigned cachekey[TEXCACHE_KEYS];
+	qboolean cache;
 	int i;
 
 	// HACK HACK HACK -- taken from tomazquake
@@ -1468,6 +2927,16 @@ static void TexMgr_LoadImage8 (gltexture_t *glt, byte *data)
 		padbyte = 255;
 	}
 
+	// the rest only depends on the data, flags, palette and size limits, so it can be cached,
+	// except for colormapped skins, which would add an item for every shirt and pants color
+	cache = (glt->flags & TEXPREF_MIPMAP) && glt->target == GL_TEXTURE_2D && glt->shirt < 0 && glt->pants < 0;
+	if (cache)
+	{
+		TexMgr_GetCacheKey8 (glt, data, usepal, cachekey);
+		if (TexMgr_LoadCachedImage (glt, cachekey))
+			return;
+	}
+
 	// pad each dimention, but only if it's not going to be downsampled later
 	if (glt->flags & TEXPREF_PAD)
 	{
@@ -1500,7 +2969,10 @@ static void TexMgr_LoadImage8 (gltexture_t *glt, byte *data)
 	}
 
 	// upload it
-	TexMgr_LoadImage32 (glt, (unsigned *)data);
+	if (cache)
+		TexMgr_LoadImage32Cached (glt, (unsigned *)data, cachekey);
+	else
+		TexMgr_LoadImage32 (glt, (unsigned *)data);
 }
 
 /*
@@ -1519,6 +2991,52 @@ static void TexMgr_LoadLightmap (gltexture_t *glt, byte *data)
 	TexMgr_SetFilterModes (glt);
 }
 
+/*
+================
+TexMgr_InitTexture -- fills in the texture description before uploading
+================
+*/
+static void TexMgr_InitTexture (gltexture_t *glt, qmodel_t *owner, const char *name, int width, int height, int depth,
+			       enum srcformat format, const char *source_file, src_offset_t source_offset, unsigned flags)
+{
+	glt->owner = owner;
+	if (flags & TEXPREF_CUBEMAP)
+		glt->target = GL_TEXTURE_CUBE_MAP;
+	else if (flags & TEXPREF_ARRAY)
+		glt->target = GL_TEXTURE_2D_ARRAY;
+	else
+		glt->target = GL_TEXTURE_2D;
+	q_strlcpy (glt->name, name, sizeof(glt->name));
+	glt->width = width;
+	glt->height = height;
+	glt->depth = depth;
+	glt->compression = 1;
+	glt->flags = flags;
+	glt->shirt = -1;
+	glt->pants = -1;
+	q_strlcpy (glt->source_file, source_file, sizeof(glt->source_file));
+	glt->source_offset = source_offset;
+	glt->source_format = format;
+	glt->source_width = width;
+	glt->source_height = height;
+	glt->source_crc = 0;
+}
+
+/*
+================
+TexMgr_FinishTexture -- labels the uploaded texture and makes it resident
+================
+*/
+static void TexMgr_FinishTexture (gltexture_t *glt)
+{
+	GL_ObjectLabelFunc (GL_TEXTURE, glt->texnum, -1, glt->name);
+	if (glt->flags & TEXPREF_BINDLESS && gl_bindless_able)
+	{
+		glt->bindless_handle = GL_GetTextureHandleARBFunc (glt->texnum);
+		GL_MakeTextureHandleResidentARBFunc (glt->bindless_handle);
+	}
+}
+
 /*
 ================
 TexMgr_LoadImageEx -- the one entry point for loading all textures
@@ -1531,7 +3049,7 @@ gltexture_t *TexMgr_LoadImageEx (qmodel_t *owner, const char *name, int width, i
 	gltexture_t *glt = NULL;
 	int mark;
 
-	if (isDedicated)
+	if (isDedicated || isHeadless)
 		return NULL;
 
 	// cubemaps/arrays are only partially implemented, disable unsupported flags
@@ -1565,26 +3083,7 @@ gltexture_t *TexMgr_LoadImageEx (qmodel_t *owner, const char *name, int width, i
 		glt = TexMgr_NewTexture ();
 
 	// copy data
-	glt->owner = owner;
-	if (flags & TEXPREF_CUBEMAP)
-		glt->target = GL_TEXTURE_CUBE_MAP;
-	else if (flags & TEXPREF_ARRAY)
-		glt->target = GL_TEXTURE_2D_ARRAY;
-	else
-		glt->target = GL_TEXTURE_2D;
-	q_strlcpy (glt->name, name, sizeof(glt->name));
-	glt->width = width;
-	glt->height = height;
-	glt->depth = depth;
-	glt->compression = 1;
-	glt->flags = flags;
-	glt->shirt = -1;
-	glt->pants = -1;
-	q_strlcpy (glt->source_file, source_file, sizeof(glt->source_file));
-	glt->source_offset = source_offset;
-	glt->source_format = format;
-	glt->source_width = width;
-	glt->source_height = height;
+	TexMgr_InitTexture (glt, owner, name, width, height, depth, format, source_file, source_offset, flags);
 	glt->source_crc = crc;
 
 	//upload it
@@ -1603,12 +3102,7 @@ gltexture_t *TexMgr_LoadImageEx (qmodel_t *owner, const char *name, int width, i
 		break;
 	}
 
-	GL_ObjectLabelFunc (GL_TEXTURE, glt->texnum, -1, glt->name);
-	if (flags & TEXPREF_BINDLESS && gl_bindless_able)
-	{
-		glt->bindless_handle = GL_GetTextureHandleARBFunc (glt->texnum);
-		GL_MakeTextureHandleResidentARBFunc (glt->bindless_handle);
-	}
+	TexMgr_FinishTexture (glt);
 
 	Hunk_FreeToLowMark(mark);
 
@@ -1627,6 +3121,218 @@ gltexture_t *TexMgr_LoadImage (qmodel_t *owner, const char *name, int width, int
 }
 
 
+/*
+================================================================================
+
+	BACKGROUND IMAGE LOADING
+
+	External images are decoded, scaled down and mipmapped on worker threads.
+	The main thread only has to upload the finished mip chains, which are
+	staged through a persistently mapped pixel unpack buffer when available.
+
+================================================================================
+*/
+
+typedef struct {
+	char			name[MAX_OSPATH];	// file name without extension
+	enum srcformat	format;
+	int				srcwidth, srcheight;
+	int				width, height;		// after picmip
+	int				numlevels;			// 0 for indexed data, which is uploaded as is
+	byte			*data;				// malloc'ed mip levels back to back
+} texjobimage_t;
+
+struct texjob_s {
+	job_t			*job;
+	char			names[2][MAX_OSPATH];
+	int				numnames;
+	unsigned		flags;
+	qboolean		glow;
+	int				picmip, maxsize;	// snapshot of the cvars, which are only safe to read on the main thread
+	texjobimage_t	image, glowimage;
+	char			error[2 * (MAX_OSPATH + 128)];
+};
+
+/*
+================
+TexMgr_DecodeJobImage -- loads and prepares a single image on a worker thread
+================
+*/
+static qboolean TexMgr_DecodeJobImage (texjob_t *job, texjobimage_t *img, const char *name)
+{
+	char	error[MAX_OSPATH + 128];
+	byte	*data;
+	int		width, height, picmip;
+
+	data = Image_LoadImageMalloc (name, &img->srcwidth, &img->srcheight, &img->format, error, sizeof (error));
+	if (error[0])
+	{
+		q_strlcat (job->error, error, sizeof (job->error));
+		q_strlcat (job->error, "\n", sizeof (job->error));
+	}
+	if (!data)
+		return false;
+
+	q_strlcpy (img->name, name, sizeof (img->name));
+	img->width = img->srcwidth;
+	img->height = img->srcheight;
+
+	if (img->format != SRC_RGBA)
+	{
+		img->data = data;
+		img->numlevels = 0;
+		return true;
+	}
+
+	width = img->srcwidth;
+	height = img->srcheight;
+	picmip = (job->flags & TEXPREF_NOPICMIP) ? 0 : job->picmip;
+	TexMgr_DownsampleImage32 ((unsigned *) data, &width, &height, 1,
+		TexMgr_ClampTextureSize (width >> picmip, job->maxsize), TexMgr_ClampTextureSize (height >> picmip, job->maxsize),
+		(job->flags & TEXPREF_ALPHA) != 0);
+	img->width = width;
+	img->height = height;
+	img->data = TexMgr_BuildMipChain ((unsigned *) data, width, height, (job->flags & TEXPREF_MIPMAP) != 0, &img->numlevels);
+	free (data);
+
+	return true;
+}
+
+/*
+================
+TexMgr_RunJob
+================
+*/
+static void TexMgr_RunJob (void *param)
+{
+	texjob_t *job = (texjob_t *) param;
+	char	name[MAX_OSPATH];
+	int		i;
+
+	for (i = 0; i < job->numnames; i++)
+		if (TexMgr_DecodeJobImage (job, &job->image, job->names[i]))
+			break;
+
+	if (i == job->numnames || !job->glow)
+		return;
+
+	//now try to load glow/luma image from the same place
+	q_snprintf (name, sizeof (name), "%s_glow", job->image.name);
+	if (!TexMgr_DecodeJobImage (job, &job->glowimage, name))
+	{
+		q_snprintf (name, sizeof (name), "%s_luma", job->image.name);
+		TexMgr_DecodeJobImage (job, &job->glowimage, name);
+	}
+}
+
+/*
+================
+TexMgr_QueueExternalImage
+
+Starts loading the first of name/altname (altname may be NULL) that exists,
+plus its _glow/_luma image if glow is set. The result has to be collected
+with TexMgr_FinishExternalImage.
+================
+*/
+texjob_t *TexMgr_QueueExternalImage (const char *name, const char *altname, unsigned flags, qboolean glow)
+{
+	texjob_t *job;
+
+	job = (texjob_t *) calloc (1, sizeof (*job));
+	if (!job)
+		Sys_Error ("TexMgr_QueueExternalImage: out of memory");
+	q_strlcpy (job->names[job->numnames++], name, sizeof (job->names[0]));
+	if (altname)
+		q_strlcpy (job->names[job->numnames++], altname, sizeof (job->names[0]));
+	job->flags = flags;
+	job->glow = glow;
+	job->picmip = q_max ((int) gl_picmip.value, 0);
+	job->maxsize = (int) gl_max_size.value;
+
+	job->job = Job_Create (TexMgr_RunJob, job);
+	Job_Submit (job->job);
+
+	return job;
+}
+
+/*
+================
+TexMgr_LoadPreparedImage -- uploads the mip chain of an image prepared by a worker
+================
+*/
+static gltexture_t *TexMgr_LoadPreparedImage (qmodel_t *owner, const texjobimage_t *img, unsigned flags)
+{
+	gltexture_t	*glt;
+
+	if (img->format != SRC_RGBA)
+		return TexMgr_LoadImage (owner, img->name, img->width, img->height, img->format, img->data, img->name, 0, flags);
+
+	glt = TexMgr_NewTexture ();
+	TexMgr_InitTexture (glt, owner, img->name, img->srcwidth, img->srcheight, 1, SRC_RGBA, img->name, 0, flags);
+	glt->width = img->width;
+	glt->height = img->height;
+	TexMgr_UploadMipChain (glt, img->data, img->numlevels);
+	TexMgr_FinishTexture (glt);
+
+	return glt;
+}
+
+/*
+================
+TexMgr_FinishExternalImage
+
+Waits for a job started with TexMgr_QueueExternalImage, uploads its images
+with the given owner and frees it. Returns false if no image was found,
+in which case *base and *glow are left untouched.
+================
+*/
+qboolean TexMgr_FinishExternalImage (texjob_t *job, qmodel_t *owner, gltexture_t **base, gltexture_t **glow)
+{
+	qboolean found;
+
+	Job_Wait (job->job);
+	Job_Release (job->job);
+	job->job = NULL;	// the upload can still fail, see TexMgr_CancelExternalImage
+
+	if (job->error[0])
+		Con_Warning ("%s", job->error);
+
+	found = job->image.data != NULL;
+	if (found)
+	{
+		*base = TexMgr_LoadPreparedImage (owner, &job->image, job->flags);
+		if (job->glowimage.data && glow)
+			*glow = TexMgr_LoadPreparedImage (owner, &job->glowimage, job->flags);
+	}
+
+	free (job->image.data);
+	free (job->glowimage.data);
+	free (job);
+
+	return found;
+}
+
+/*
+================
+TexMgr_CancelExternalImage
+
+Waits for a job started with TexMgr_QueueExternalImage and frees it without
+uploading anything, also after TexMgr_FinishExternalImage failed part way
+================
+*/
+void TexMgr_CancelExternalImage (texjob_t *job)
+{
+	if (job->job)
+	{
+		Job_Wait (job->job);
+		Job_Release (job->job);
+	}
+	free (job->image.data);
+	free (job->glowimage.data);
+	free (job);
+}
+
+
 /*
 ================================================================================
 
@@ -1654,11 +3360,7 @@ void TexMgr_ReloadImage (gltexture_t *glt, int shirt, int pants)
 
 	if (glt->source_file[0] && glt->source_offset) {
 		//lump inside file
-		FILE *f;
 		int sz;
-		COM_FOpenFile(glt->source_file, &f, NULL);
-		if (!f) goto invalid;
-		fseek (f, glt->source_offset, SEEK_CUR);
 		size = glt->source_width * glt->source_height;
 		/* should be SRC_INDEXED, but no harm being paranoid:  */
 		if (glt->source_format == SRC_RGBA) {
@@ -1668,8 +3370,8 @@ void TexMgr_ReloadImage (gltexture_t *glt, int shirt, int pants)
 			size *= lightmap_bytes;
 		}
 		data = (byte *) Hunk_AllocNoFill (size);
-		sz = (int) fread (data, 1, size, f);
-		fclose (f);
+		sz = COM_ReadFileRange (glt->source_file, (int) glt->source_offset, data, size, NULL);
+		if (sz < 0) goto invalid;
 		if (sz != size) {
 			Hunk_FreeToLowMark(mark);
 			Host_Error("Read error for %s", glt->name);
@@ -129,6 +129,16 @@ void TexMgr_ReloadImage (gltexture_t *glt, int shirt, int pants);
 void TexMgr_ReloadImages (void);
 void TexMgr_ReloadNobrightImages (void);
 
+typedef struct texjob_s texjob_t;
+texjob_t *TexMgr_QueueExternalImage (const char *name, const char *altname, unsigned flags, qboolean glow);
+qboolean TexMgr_FinishExternalImage (texjob_t *job, qmodel_t *owner, gltexture_t **base, gltexture_t **glow);
+void TexMgr_CancelExternalImage (texjob_t *job);
+
+// DISK CACHE
+void *TexMgr_ReadDiskCache (const char *ext, const unsigned *key, int numkeys, size_t *size);
+void TexMgr_WriteDiskCache (const char *ext, const unsigned *key, int numkeys, const void *data, size_t size);
+void TexMgr_FlushDiskCache (void);
+
 int TexMgr_Pad(int s);
 int TexMgr_SafeTextureSize (int s);
 int TexMgr_PadConditional (int s);
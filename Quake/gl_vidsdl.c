@@ -196,6 +196,9 @@ static void VID_FreeMouseCursors (void)
 
 void VID_SetMouseCursor (mousecursor_t cursor)
 {
+	if (!draw_context)
+		return;
+
 	switch (cursor)
 	{
 	case MOUSECURSOR_DEFAULT:
@@ -331,6 +334,8 @@ VID_SetWindowTitle
 */
 void VID_SetWindowTitle (const char *title)
 {
+	if (!draw_context)
+		return;
 	SDL_SetWindowTitle (draw_context, title);
 }
 
@@ -1361,6 +1366,7 @@ GL_EndRendering
 void GL_EndRendering (void)
 {
 	GL_PostProcess ();
+	SCR_ReadbackFrame ();
 	GL_ReleaseFrameResources ();
 
 	if (!scr_skipupdate)
@@ -1543,6 +1549,44 @@ static void VID_InitModelist (void)
 	}
 }
 
+/*
+===================
+VID_InitHeadless
+
+Sets up a video state without a window or GL context, so the
+client and refresh code can run for -headless benchmarks
+===================
+*/
+static void VID_InitHeadless (void)
+{
+	int		p;
+
+	vid.width = 640;
+	vid.height = 480;
+
+	p = COM_CheckParm ("-width");
+	if (p && p < com_argc-1)
+	{
+		vid.width = q_max (320, Q_atoi (com_argv[p+1]));
+		vid.height = vid.width * 3 / 4;
+	}
+	p = COM_CheckParm ("-height");
+	if (p && p < com_argc-1)
+		vid.height = q_max (200, Q_atoi (com_argv[p+1]));
+
+	vid.maxscale = 1;
+	vid.refreshrate = 0;
+	vid.numpages = 2;
+	vid.colormap = host_colormap;
+	vid.fullbright = 256 - LittleLong (*((int *)vid.colormap + 2048));
+	modestate = MS_WINDOWED;
+
+	VID_RecalcInterfaceSize ();
+	VID_Gamma_Init ();
+
+	Con_SafePrintf ("Headless: %dx%d, no rendering\n", vid.width, vid.height);
+}
+
 /*
 ===================
 VID_Init
@@ -1609,6 +1653,12 @@ void	VID_Init (void)
 	Cvar_RegisterVariable (&scr_pixelaspect);
 	Cvar_SetCallback (&scr_pixelaspect, SCR_PixelAspect_f);
 
+	if (isHeadless)
+	{
+		VID_InitHeadless ();
+		return;
+	}
+
 	Cmd_AddCommand ("vid_unlock", VID_Unlock); //johnfitz
 	Cmd_AddCommand ("vid_restart", VID_Restart); //johnfitz
 	Cmd_AddCommand ("vid_test", VID_Test); //johnfitz
@@ -69,6 +69,7 @@ extern	int		r_framecount;
 extern	mplane_t	frustum[4];
 
 extern	qboolean use_simd;
+extern	qboolean use_avx2;
 
 //
 // view origin
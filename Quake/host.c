@@ -189,11 +189,15 @@ void Host_ReportError (const char *error, ...)
 	va_end (argptr);
 	Con_Printf ("Host_Error: %s\n",string);
 
+	Mod_AbortLoadTasks ();
+	Host_EndSaveBench ();
+	SaveData_FreeBinaryTables ();
+
 	if (sv.active)
 		Host_ShutdownServer (false);
 
-	if (cls.state == ca_dedicated)
-		Sys_Error ("Host_Error: %s\n",string);	// dedicated servers exit
+	if (cls.state == ca_dedicated || isHeadless)
+		Sys_Error ("Host_Error: %s\n",string);	// dedicated servers and headless runs exit
 
 	CL_Disconnect ();
 	cls.demonum = -1;
@@ -282,8 +286,8 @@ void Host_WriteConfigurationToFile (const char *name)
 	FILE	*f;
 
 // dedicated servers initialize the host but don't parse and set the
-// config.cfg cvars
-	if (host_initialized && !isDedicated && !host_parms->errstate)
+// config.cfg cvars, headless runs don't touch the user's config
+	if (host_initialized && !isDedicated && !isHeadless && !host_parms->errstate)
 	{
 		char fullname[MAX_OSPATH];
 		q_snprintf (fullname, sizeof (fullname), "%s/%s", com_gamedir, name);
@@ -624,7 +628,9 @@ void Host_ClearMemory (void)
 	}
 
 	Con_DPrintf ("Clearing memory\n");
+	COM_InvalidateFileCache ();
 	Mod_ClearAll ();
+	SV_InvalidateFatPVS ();
 	Sky_ClearAll();
 	PR_ClearProgs(&sv.qcvm);
 	PR_ClearProgs(&cl.qcvm);
@@ -643,20 +649,23 @@ void Host_ClearMemory (void)
 //
 //==============================================================================
 
+// bounded multi-producer, single-consumer queue: producers claim a slot by
+// bumping tail, then publish it by advancing the slot's sequence number
+
 typedef struct asyncproc_s
 {
+	SDL_atomic_t		sequence;
 	void				(*func) (void *param);
 	void				*param;
 } asyncproc_t;
 
 typedef struct asyncqueue_s
 {
-	size_t				head;
-	size_t				tail;
-	size_t				capacity;
-	qboolean			teardown;
-	SDL_mutex			*mutex;
-	SDL_cond			*notfull;
+	SDL_atomic_t		tail;		// next slot to claim, shared by the producers
+	unsigned			head;		// next slot to run, main thread only
+	unsigned			capacity;
+	SDL_atomic_t		teardown;
+	SDL_threadID		owner;
 	asyncproc_t			*procs;
 } asyncqueue_t;
 
@@ -664,73 +673,92 @@ static asyncqueue_t		async_queue;
 
 static void AsyncQueue_Init (asyncqueue_t *queue, size_t capacity)
 {
+	size_t i;
+
 	memset (queue, 0, sizeof (*queue));
 
 	if (!capacity)
 		capacity = 1024;
 	else
 		capacity = Q_nextPow2 (capacity);
-	queue->capacity = capacity;
+	queue->capacity = (unsigned) capacity;
+	queue->owner = SDL_ThreadID ();
 	capacity *= sizeof (queue->procs[0]);
 	queue->procs = (asyncproc_t *) malloc (capacity);
 	if (!queue->procs)
 		Sys_Error ("AsyncQueue_Init: malloc failed on %" SDL_PRIu64 " bytes", (uint64_t) capacity);
 
-	queue->mutex = SDL_CreateMutex ();
-	if (!queue->mutex)
-		Sys_Error ("AsyncQueue_Init: could not create mutex");
-
-	queue->notfull = SDL_CreateCond ();
-	if (!queue->notfull)
-		Sys_Error ("AsyncQueue_Init: could not create condition variable");
+	for (i = 0; i < queue->capacity; i++)
+		SDL_AtomicSet (&queue->procs[i].sequence, (int) i);
 }
 
+static void AsyncQueue_Drain (asyncqueue_t *queue);
+
 static void AsyncQueue_Push (asyncqueue_t *queue, void (*func) (void *param), void *param)
 {
-	asyncproc_t *proc;
+	asyncproc_t	*proc;
+	unsigned	pos;
+	int			diff;
 
-	if (!queue->mutex)
+	if (!queue->procs)
 		return;
-	SDL_LockMutex (queue->mutex);
-	while (!queue->teardown && queue->tail - queue->head >= queue->capacity)
-		SDL_CondWait (queue->notfull, queue->mutex);
 
-	if (!queue->teardown)
+	while (1)
 	{
-		proc = &queue->procs[(queue->tail++) & (queue->capacity - 1)];
-		proc->func = func;
-		proc->param = param;
+		if (SDL_AtomicGet (&queue->teardown))
+			return;
+		pos = (unsigned) SDL_AtomicGet (&queue->tail);
+		proc = &queue->procs[pos & (queue->capacity - 1)];
+		diff = (int) ((unsigned) SDL_AtomicGet (&proc->sequence) - pos);
+		if (diff == 0)
+		{
+			if (SDL_AtomicCAS (&queue->tail, (int) pos, (int) (pos + 1)))
+				break;
+		}
+		else if (diff < 0)
+		{
+			// full, wait for the main thread to catch up
+			if (SDL_ThreadID () == queue->owner)
+				AsyncQueue_Drain (queue);
+			else
+				SDL_Delay (1);
+		}
 	}
 
-	SDL_UnlockMutex (queue->mutex);
+	proc->func = func;
+	proc->param = param;
+	SDL_AtomicSet (&proc->sequence, (int) (pos + 1));
 }
 
 static void AsyncQueue_Drain (asyncqueue_t *queue)
 {
-	SDL_LockMutex (queue->mutex);
-	while (queue->head != queue->tail)
+	while (queue->procs)
 	{
-		asyncproc_t *proc = &queue->procs[(queue->head++) & (queue->capacity - 1)];
-		proc->func (proc->param);
-		SDL_CondSignal (queue->notfull);
+		asyncproc_t	*proc = &queue->procs[queue->head & (queue->capacity - 1)];
+		void		(*func) (void *param);
+		void		*param;
+
+		if ((int) ((unsigned) SDL_AtomicGet (&proc->sequence) - (queue->head + 1)) < 0)
+			break; // not published yet
+
+		func = proc->func;
+		param = proc->param;
+		SDL_AtomicSet (&proc->sequence, (int) (queue->head + queue->capacity));
+		queue->head++;
+
+		func (param);
 	}
-	SDL_UnlockMutex (queue->mutex);
 }
 
 static void AsyncQueue_Destroy (asyncqueue_t *queue)
 {
-	if (!queue->mutex)
+	if (!queue->procs)
 		return;
 
-	SDL_LockMutex (queue->mutex);
-	queue->teardown = true;
-	SDL_UnlockMutex (queue->mutex);
-	SDL_CondBroadcast (queue->notfull);
-
+	SDL_AtomicSet (&queue->teardown, 1);
 	AsyncQueue_Drain (queue);
 
-	SDL_DestroyCond (queue->notfull);
-	SDL_DestroyMutex (queue->mutex);
+	free (queue->procs);
 	memset (queue, 0, sizeof (*queue));
 }
 
@@ -752,7 +780,7 @@ Host_GetFrameInterval
 */
 double Host_GetFrameInterval (void)
 {
-	if ((host_maxfps.value || cls.state == ca_disconnected) && !cls.timedemo)
+	if ((host_maxfps.value || cls.state == ca_disconnected) && !cls.timedemo && !cls.benchmark && !cls.demorender)
 	{
 		float maxfps;
 		if (cls.state == ca_disconnected)
@@ -780,10 +808,16 @@ Host_AdvanceTime
 */
 static void Host_AdvanceTime (double dt)
 {
+	if (cls.demorender)	// every rendered frame is the same step of demo time
+		dt = cls.dr_frametime;
+
 	realtime += dt;
 	host_frametime = host_rawframetime = realtime - oldrealtime;
 	oldrealtime = realtime;
 
+	if (cls.demorender)
+		return;
+
 	//johnfitz -- host_timescale is more intuitive than host_framerate
 	if (host_timescale.value > 0)
 		host_frametime *= host_timescale.value;
@@ -1147,6 +1181,7 @@ void _Host_Frame (double time)
 	static double	accumtime = 0;
 	double time1, time2, time3;
 	qboolean ranserver = false;
+	qboolean speeds;
 
 	time1 = Sys_DoubleTime ();
 
@@ -1165,11 +1200,14 @@ void _Host_Frame (double time)
 
 // get new key events
 	Key_UpdateForDest ();
-	IN_UpdateInputMode ();
-	Sys_SendKeyEvents ();
+	if (!isHeadless)
+	{
+		IN_UpdateInputMode ();
+		Sys_SendKeyEvents ();
 
-// allow mice or other external controllers to add commands
-	IN_Commands ();
+	// allow mice or other external controllers to add commands
+		IN_Commands ();
+	}
 
 //check the stdin for commands (dedicated servers)
 	Host_GetConsoleCommands ();
@@ -1223,14 +1261,15 @@ void _Host_Frame (double time)
 		CL_ReadFromServer ();
 
 // update video
-	if (host_speeds.value)
+	speeds = host_speeds.value || cls.timedemo || cls.benchmark;
+	if (speeds)
 		time2 = Sys_DoubleTime ();
 
 	SCR_UpdateScreen ();
 
 	CL_RunParticles (); //johnfitz -- seperated from rendering
 
-	if (host_speeds.value)
+	if (speeds)
 		time3 = Sys_DoubleTime ();
 
 // update audio
@@ -1246,17 +1285,22 @@ void _Host_Frame (double time)
 	CDAudio_Update();
 	UpdateWindowTitle();
 
-	if (host_speeds.value)
+	if (speeds)
+	{
+		time1 = time2 - time1;
+		time2 = time3 - time2;
+		time3 = Sys_DoubleTime () - time3;
+
+		CL_TimeDemoFrame (ranserver ? time1 : 0.0, time2, time3);
+	}
+
+	if (speeds && host_speeds.value)
 	{
 		static double pass[3] = {0.0, 0.0, 0.0};
 		static double elapsed = 0.0;
 		static int numframes = 0;
 		static int numserverframes = 0;
 
-		time1 = time2 - time1;
-		time2 = time3 - time2;
-		time3 = Sys_DoubleTime () - time3;
-
 		if (ranserver || host_speeds.value < 0.f)
 		{
 			pass[0] += time1;
@@ -1341,6 +1385,7 @@ void Host_Init (void)
 	AsyncQueue_Init (&async_queue, 1024);
 	Cbuf_Init ();
 	Cmd_Init ();
+	Jobs_Init ();
 	LOG_Init (host_parms);
 	Cvar_Init (); //johnfitz
 	COM_Init ();
@@ -1370,13 +1415,17 @@ void Host_Init (void)
 		Chase_Init ();
 		M_Init ();
 		VID_Init ();
-		IN_Init ();
-		TexMgr_Init (); //johnfitz
-		Draw_Init ();
+		if (!isHeadless)
+		{
+			IN_Init ();
+			TexMgr_Init (); //johnfitz
+			Draw_Init ();
+		}
 		SCR_Init ();
 		R_Init ();
 		S_Init ();
-		CDAudio_Init ();
+		if (!isHeadless)
+			CDAudio_Init ();
 		BGM_Init();
 		Sbar_Init ();
 		CL_Init ();
@@ -1400,7 +1449,8 @@ void Host_Init (void)
 		Cbuf_InsertText ("exec quake.rc\n");
 	// johnfitz -- in case the vid mode was locked during vid_init, we can unlock it now.
 		// note: two leading newlines because the command buffer swallows one of them.
-		Cbuf_AddText ("\n\nvid_unlock\n");
+		if (!isHeadless)
+			Cbuf_AddText ("\n\nvid_unlock\n");
 	}
 
 	if (cls.state == ca_dedicated)
@@ -1436,9 +1486,13 @@ void Host_Shutdown(void)
 // keep Con_Printf from trying to update the screen
 	scr_disabled_for_loading = true;
 
-	AsyncQueue_Destroy (&async_queue);
-
+	// jobs can still queue work for the main thread
 	Host_ShutdownSave ();
+	if (cls.state != ca_dedicated && !isHeadless)
+		SCR_ShutdownCaptures ();	// hand the last screenshots to the writers
+	ExtraMaps_ShutDown ();		// cancels the map description parse
+	Jobs_Shutdown ();
+	AsyncQueue_Destroy (&async_queue);
 	Host_WriteConfiguration ();
 
 // stop downloads before shutting down networking
@@ -1450,12 +1504,14 @@ void Host_Shutdown(void)
 	{
 		if (con_initialized)
 			History_Shutdown ();
-		ExtraMaps_ShutDown ();
 		BGM_Shutdown();
 		CDAudio_Shutdown ();
 		S_Shutdown ();
-		IN_Shutdown ();
-		VID_Shutdown();
+		if (!isHeadless)
+		{
+			IN_Shutdown ();
+			VID_Shutdown();
+		}
 	}
 
 	LOG_Close ();
@@ -35,6 +35,8 @@ extern cvar_t	nomonsters;
 
 // 0 = no, 1 = ask, 2 = when dead, 3 = always
 cvar_t sv_autoload = {"sv_autoload", "2", CVAR_ARCHIVE};
+// 0 = text savegames, 1 = binary (same progs.dat only)
+cvar_t sv_savebinary = {"sv_savebinary", "0", CVAR_ARCHIVE};
 
 int	current_skill;
 
@@ -164,7 +166,7 @@ filelist_item_t *extralevels;
 filelist_item_t **extralevels_sorted;
 size_t maxlevelnamelen;
 
-static SDL_Thread*	extralevels_parsing_thread;
+static job_t*		extralevels_parsing_job;
 static SDL_atomic_t	extralevels_cancel_parsing;
 
 /*
@@ -398,7 +400,7 @@ static void ExtraMaps_Add (const char *name, const searchpath_t *source)
 ExtraMaps_ParseDescriptions
 ==================
 */
-static int ExtraMaps_ParseDescriptions (void *unused)
+static void ExtraMaps_ParseDescriptions (void *unused)
 {
 	char buf[1024];
 	int i;
@@ -409,14 +411,12 @@ static int ExtraMaps_ParseDescriptions (void *unused)
 		levelinfo_t		*extra = (levelinfo_t *) (item + 1);
 
 		if (SDL_AtomicGet (&extralevels_cancel_parsing))
-			return 1;
+			return;
 
 		if (!Mod_LoadMapDescription (buf, sizeof (buf), item->name))
 			SDL_AtomicSet (&extra->type, MAPTYPE_BMODEL);
 		SDL_AtomicSetPtr ((void **) &extra->message, buf[0] ? strdup (buf) : "");
 	}
-
-	return 0;
 }
 
 /*
@@ -426,10 +426,11 @@ ExtraMaps_WaitForParsingThread
 */
 static void ExtraMaps_WaitForParsingThread (void)
 {
-	if (extralevels_parsing_thread)
+	if (extralevels_parsing_job)
 	{
-		SDL_WaitThread (extralevels_parsing_thread, NULL);
-		extralevels_parsing_thread = NULL;
+		Job_Wait (extralevels_parsing_job);
+		Job_Release (extralevels_parsing_job);
+		extralevels_parsing_job = NULL;
 		SDL_AtomicSet (&extralevels_cancel_parsing, 0);
 	}
 }
@@ -487,7 +488,8 @@ void ExtraMaps_Init (void)
 	ExtraMaps_Sort ();
 
 	SDL_AtomicSet (&extralevels_cancel_parsing, 0);
-	extralevels_parsing_thread = SDL_CreateThread (ExtraMaps_ParseDescriptions, "Map parser", NULL);
+	extralevels_parsing_job = Job_Create (ExtraMaps_ParseDescriptions, NULL);
+	Job_Submit (extralevels_parsing_job);
 }
 
 /*
@@ -1974,7 +1976,11 @@ static void Host_Map_f (void)
 	SV_SpawnServer (name);
 	PR_SwitchQCVM(NULL);
 	if (!sv.active)
+	{
+		if (isHeadless && cls.benchmark)	// nothing else will end the run
+			Sys_Error ("benchmark: couldn't load map %s", name);
 		return;
+	}
 
 	if (cls.state != ca_dedicated)
 	{
@@ -2182,12 +2188,11 @@ LOAD / SAVE GAME
 ===============================================================================
 */
 
+#define SAVE_IOBUF_SIZE		(256 * 1024)
+
 static savedata_t		save_data;
-static qboolean			save_pending;
-static SDL_Thread		*save_thread;
-static SDL_mutex		*save_mutex;
-static SDL_cond			*save_finished_condition;
-static SDL_cond			*save_pending_condition;
+static job_t			*save_job;
+static qboolean			savebench_loading;	// savebench is timing a load
 
 /*
 ===============
@@ -2239,47 +2244,27 @@ static void Host_InvalidateSave (const char *relname)
 
 void Host_ShutdownSave (void)
 {
-	if (!save_mutex)
-		return; // not initialized yet
-
-	SDL_LockMutex (save_mutex);
-	while (save_pending)
-		SDL_CondWait (save_finished_condition, save_mutex);
-	save_pending = true;
-	save_data.file = NULL;
-	SDL_CondSignal (save_pending_condition);
-	SDL_UnlockMutex (save_mutex);
-
-	SDL_WaitThread (save_thread, NULL);
-	save_thread = NULL;
-
-	SDL_DestroyCond (save_finished_condition);
-	save_finished_condition = NULL;
-
-	SDL_DestroyCond (save_pending_condition);
-	save_pending_condition = NULL;
-
+	Host_WaitForSaveThread ();
 	SaveData_Clear (&save_data);
 }
 
 void Host_WaitForSaveThread (void)
 {
-	SDL_LockMutex (save_mutex);
-	while (save_pending)
-		SDL_CondWait (save_finished_condition, save_mutex);
-	SDL_UnlockMutex (save_mutex);
+	if (save_job)
+	{
+		Job_Wait (save_job);
+		Job_Release (save_job);
+		save_job = NULL;
+	}
 }
 
 qboolean Host_IsSaving (void)
 {
-	qboolean saving;
-	SDL_LockMutex (save_mutex);
-	saving = save_pending;
-	SDL_UnlockMutex (save_mutex);
-
-	if (saving)
+	if (save_job && !Job_IsDone (save_job))
 		return true;
 
+	Host_WaitForSaveThread ();
+
 	if (save_data.abort.value && sv.lastsave[0])
 	{
 		sv.lastsave[0] = '\0';
@@ -2290,25 +2275,22 @@ qboolean Host_IsSaving (void)
 	return false;
 }
 
-static int Host_BackgroundSave (void *param)
+static void Host_BackgroundSave (void *param)
 {
 	savedata_t	*save = (savedata_t *) param;
+	edict_t		*ed;
+	int			i;
+	qboolean	abort = false;
+	qcvm_t		*oldvm;
 
-	while (true)
-	{
-		edict_t		*ed;
-		int			i;
-		qboolean	abort = false;
-
-		SDL_LockMutex (save_mutex);
-		while (!save_pending)
-			SDL_CondWait (save_pending_condition, save_mutex);
-		SDL_UnlockMutex (save_mutex);
-
-		if (!save->file)
-			break;
+	setvbuf (save->file, NULL, _IOFBF, SAVE_IOBUF_SIZE);
 
-		PR_SwitchQCVM (&sv.qcvm);
+	// the job may also run on the main thread while it waits for other jobs
+	PR_PushQCVM (&sv.qcvm, &oldvm);
+	if (save->binary)
+		abort = !SaveData_WriteBinary (save);
+	else
+	{
 		SaveData_WriteHeader (save);
 		for (i = 0, ed = save->edicts; i < save->num_edicts; i++, ed = NEXT_EDICT (ed))
 		{
@@ -2318,32 +2300,26 @@ static int Host_BackgroundSave (void *param)
 				break;
 			}
 			ED_Write (save, ed);
-			fflush (save->file);
 		}
 		if (!abort)
 			fprintf (save->file, "// %d edicts\n", save->num_edicts);
-		PR_SwitchQCVM (NULL);
-
-		fclose (save->file);
-		save->file = NULL;
-		if (abort)
-			Sys_remove (save->path);
+	}
+	PR_PopQCVM (oldvm);
 
-		SDL_LockMutex (save_mutex);
-		save_pending = false;
-		SDL_CondSignal (save_finished_condition);
-		SDL_UnlockMutex (save_mutex);
+	if (!abort && (fflush (save->file) != 0 || ferror (save->file)))
+	{
+		SDL_AtomicCAS (&save->abort, 0, -1);
+		abort = true;
 	}
 
-	return 0;
+	fclose (save->file);
+	save->file = NULL;
+	if (abort)
+		Sys_remove (save->path);
 }
 
-static void Host_InitSaveThread (void)
+static void Host_InitSaveData (void)
 {
-	save_mutex = SDL_CreateMutex ();
-	save_finished_condition = SDL_CreateCond ();
-	save_pending_condition = SDL_CreateCond ();
-	save_thread = SDL_CreateThread (Host_BackgroundSave, "SaveThread", &save_data);
 	SaveData_Init (&save_data);
 }
 
@@ -2421,40 +2397,186 @@ static void Host_Savegame_f (void)
 	if (!strcmp (relname, sv.lastsave) && Host_IsSaving ())
 	{
 		SDL_AtomicCAS (&save_data.abort, 0, 1);
-		SDL_LockMutex (save_mutex);
-		while (save_pending)
-			SDL_CondWait (save_finished_condition, save_mutex);
-		SDL_UnlockMutex (save_mutex);
+		Host_WaitForSaveThread ();
 	}
 
-	f = Sys_fopen (name, "w");
+	f = Sys_fopen (name, sv_savebinary.value ? "wb" : "w");
 	if (!f)
 	{
 		Con_Printf ("ERROR: couldn't open.\n");
 		return;
 	}
 
-	SDL_LockMutex (save_mutex);
-	while (save_pending)
-		SDL_CondWait (save_finished_condition, save_mutex);
+	Host_WaitForSaveThread ();
 
 	q_strlcpy (save_data.path, name, sizeof (save_data.path));
 	save_data.file = f;
 	save_data.abort.value = 0;
+	save_data.binary = sv_savebinary.value != 0.f;
 
 	PR_SwitchQCVM (&sv.qcvm);
 	SaveData_Fill (&save_data);
 	PR_SwitchQCVM (NULL);
 
-	save_pending = true;
-	SDL_CondSignal (save_pending_condition);
-	SDL_UnlockMutex (save_mutex);
+	save_job = Job_Create (Host_BackgroundSave, &save_data);
+	Job_Submit (save_job);
 
 	q_strlcpy (sv.lastsave, relname, sizeof (sv.lastsave));
 	COM_StripExtension (sv.lastsave, relname, sizeof (relname));
 	FileList_Add (relname, &savelist);
 }
 
+/*
+===============
+Host_GetSaveVersion
+
+Reads the version line of a savegame, or returns -1
+===============
+*/
+static int Host_GetSaveVersion (const char *path)
+{
+	FILE	*f;
+	int		version;
+
+	f = Sys_fopen (path, "rb");
+	if (!f)
+		return -1;
+	if (fscanf (f, "%i", &version) != 1)
+		version = -1;
+	fclose (f);
+
+	return version;
+}
+
+/*
+===============
+Host_FinishLoadgame
+
+Common tail of text and binary loads, called once the edicts are restored
+===============
+*/
+static void Host_FinishLoadgame (const char *relname, int num_edicts, double time, const float *spawn_parms, double start)
+{
+	int		i;
+	double	elapsed;
+
+	// Free edicts allocated during map loading but no longer used after restoring saved game state
+	// Note: we use ED_ClearEdict instead of ED_Free to avoid placing entities >= num_edicts in the free list
+	// This is different from QuakeSpasm, which doesn't use a free list
+	for (i = num_edicts; i < qcvm->num_edicts; i++)
+		ED_ClearEdict (EDICT_NUM (i));
+
+	qcvm->num_edicts = num_edicts;
+	qcvm->time = time;
+	sv.autosave.time = time;
+
+	for (i = 0; i < NUM_SPAWN_PARMS; i++)
+		svs.clients->spawn_parms[i] = spawn_parms[i];
+
+	PR_SwitchQCVM(NULL);
+
+	elapsed = (Sys_DoubleTime () - start) * 1000.0;
+	if (savebench_loading)
+		Con_Printf ("%s: game state restored in %.2f ms\n", relname, elapsed);
+	else
+		Con_DPrintf ("Game state restored in %.2f ms\n", elapsed);
+
+	q_strlcpy (sv.lastsave, relname, sizeof (sv.lastsave));
+
+	if (cls.state != ca_dedicated)
+	{
+		CL_EstablishConnection ("local");
+		Host_Reconnect_f ();
+	}
+
+	if (cls.state != ca_dedicated && key_dest == key_game)
+		IN_Activate(); // moved to here from M_Load_Key()
+}
+
+/*
+===============
+Host_LoadBinaryGame
+===============
+*/
+static void Host_LoadBinaryGame (const char *name, const char *relname)
+{
+	static byte		*buf;
+
+	savedata_t		header;
+	savereader_t	reader;
+	FILE			*f;
+	long			len;
+	int				i, num_edicts;
+	double			start;
+
+// avoid leaking if the previous load failed with a Host_Error
+	if (buf != NULL)
+		free (buf);
+	buf = NULL;
+
+	f = Sys_fopen (name, "rb");
+	len = f ? (long) COM_filelength (f) : -1;
+	if (len > 0)
+		buf = (byte *) malloc (len);
+	if (!buf || fread (buf, 1, len, f) != (size_t) len)
+	{
+		if (f)
+			fclose (f);
+		free (buf);
+		buf = NULL;
+		Con_Printf ("ERROR: couldn't open.\n");
+		Host_InvalidateSave (relname);
+		SCR_EndLoadingPlaque ();
+		return;
+	}
+	fclose (f);
+
+	reader.data = buf;
+	reader.end = buf + len;
+	reader.error = false;
+	if (!SaveData_ReadBinaryHeader (&header, &reader))
+	{
+		free (buf);
+		buf = NULL;
+		Con_Printf ("ERROR: savegame is corrupt.\n");
+		Host_InvalidateSave (relname);
+		SCR_EndLoadingPlaque ();
+		return;
+	}
+
+	current_skill = header.skill;
+	Cvar_SetValue ("skill", (float)current_skill);
+
+	CL_Disconnect_f ();
+
+	PR_SwitchQCVM(&sv.qcvm);
+	SV_SpawnServer (header.mapname);
+
+	if (!sv.active)
+	{
+		PR_SwitchQCVM(NULL);
+		free (buf);
+		buf = NULL;
+		SCR_EndLoadingPlaque ();
+		Con_Printf ("Couldn't load map\n");
+		return;
+	}
+	sv.paused = true;		// pause until all clients connect
+	sv.loadgame = true;
+
+	start = Sys_DoubleTime ();
+
+	for (i = 0; i < MAX_LIGHTSTYLES; i++)
+		sv.lightstyles[i] = (const char *)Hunk_Strdup (header.lightstyles[i], "lightstyles");
+
+	num_edicts = SaveData_ReadBinary (&reader);
+
+	free (buf);
+	buf = NULL;
+
+	Host_FinishLoadgame (relname, num_edicts, header.time, header.spawn_parms, start);
+}
+
 /*
 ===============
 Host_Loadgame_f
@@ -2475,6 +2597,7 @@ static void Host_Loadgame_f (void)
 	int	version;
 	float	spawn_parms[NUM_SPAWN_PARMS];
 	qboolean kexonly = false;
+	double	loadstart;
 
 	if (cmd_source != src_command)
 		return;
@@ -2538,7 +2661,14 @@ static void Host_Loadgame_f (void)
 // avoid leaking if the previous Host_Loadgame_f failed with a Host_Error
 	if (start != NULL)
 		free (start);
-	
+	start = NULL;
+
+	if (!kexonly && Host_GetSaveVersion (name) == SAVEGAME_VERSION_BINARY)
+	{
+		Host_LoadBinaryGame (name, relname);
+		return;
+	}
+
 	start = (char *) COM_LoadMallocFile_TextMode_OSPath(name, NULL);
 	if (start == NULL)
 	{
@@ -2610,6 +2740,8 @@ static void Host_Loadgame_f (void)
 	sv.paused = true;		// pause until all clients connect
 	sv.loadgame = true;
 
+	loadstart = Sys_DoubleTime ();
+
 // load the light styles
 	for (i = 0; i < MAX_LIGHTSTYLES; i++)
 	{
@@ -2655,34 +2787,114 @@ static void Host_Loadgame_f (void)
 		entnum++;
 	}
 
-	// Free edicts allocated during map loading but no longer used after restoring saved game state
-	// Note: we use ED_ClearEdict instead of ED_Free to avoid placing entities >= num_edicts in the free list
-	// This is different from QuakeSpasm, which doesn't use a free list
-	for (i = entnum; i < qcvm->num_edicts; i++)
-		ED_ClearEdict (EDICT_NUM (i));
-
-	qcvm->num_edicts = entnum;
-	qcvm->time = time;
-	sv.autosave.time = time;
-
 	free (start);
 	start = NULL;
 
-	for (i = 0; i < NUM_SPAWN_PARMS; i++)
-		svs.clients->spawn_parms[i] = spawn_parms[i];
+	Host_FinishLoadgame (relname, entnum, time, spawn_parms, loadstart);
+}
 
-	PR_SwitchQCVM(NULL);
+static const char *const savebench_names[2] = {"savebench_text", "savebench_binary"};
+static char savebench_lastsave[MAX_OSPATH];	// sv.lastsave before the loads
 
-	q_strlcpy (sv.lastsave, relname, sizeof (sv.lastsave));
+/*
+===============
+Host_EndSaveBench -- removes the temporary saves, also called on Host_Error
+===============
+*/
+void Host_EndSaveBench (void)
+{
+	char	name[MAX_OSPATH];
+	int		i;
 
-	if (cls.state != ca_dedicated)
+	// the loads made the bench saves the last save, which autoload would pick
+	if (savebench_loading)
+		q_strlcpy (sv.lastsave, savebench_lastsave, sizeof (sv.lastsave));
+	savebench_loading = false;
+
+	for (i = 0; i < 2; i++)
 	{
-		CL_EstablishConnection ("local");
-		Host_Reconnect_f ();
+		q_snprintf (name, sizeof (name), "%s.sav", savebench_names[i]);
+		if (!strcmp (sv.lastsave, name))
+			sv.lastsave[0] = '\0';
+		q_snprintf (name, sizeof (name), "%s/%s.sav", com_gamedir, savebench_names[i]);
+		if (Sys_FileExists (name))
+			Sys_remove (name);
 	}
+}
 
-	if (cls.state != ca_dedicated && key_dest == key_game)
-		IN_Activate(); // moved to here from M_Load_Key()
+/*
+===============
+Host_SaveBench_f
+
+Saves the current game in both formats, timing the writes, then reloads
+both to time restoring them. The binary save is loaded last, so the game
+ends up where it was.
+===============
+*/
+static void Host_SaveBench_f (void)
+{
+	const char *const *names = savebench_names;
+	char	name[MAX_OSPATH];
+	FILE	*f;
+	double	start, elapsed;
+	int		i;
+	long	size;
+
+	if (cmd_source != src_command)
+		return;
+
+	if (!sv.active || svs.maxclients != 1 || cl.intermission || sv.nomonsters)
+	{
+		Con_Printf ("savebench needs a single player game that can be saved.\n");
+		return;
+	}
+
+	Host_WaitForSaveThread ();
+
+	for (i = 0; i < 2; i++)
+	{
+		q_snprintf (name, sizeof (name), "%s/%s.sav", com_gamedir, names[i]);
+		f = Sys_fopen (name, i ? "wb" : "w");
+		if (!f)
+		{
+			Con_Printf ("ERROR: couldn't open %s.\n", name);
+			Host_EndSaveBench ();
+			return;
+		}
+
+		q_strlcpy (save_data.path, name, sizeof (save_data.path));
+		save_data.file = f;
+		save_data.abort.value = 0;
+		save_data.binary = i != 0;
+
+		start = Sys_DoubleTime ();
+		PR_SwitchQCVM (&sv.qcvm);
+		SaveData_Fill (&save_data);
+		PR_SwitchQCVM (NULL);
+		Host_BackgroundSave (&save_data);
+		elapsed = (Sys_DoubleTime () - start) * 1000.0;
+
+		if (save_data.abort.value)
+		{
+			Con_Printf ("ERROR: couldn't write %s.\n", name);
+			Host_EndSaveBench ();
+			return;
+		}
+
+		f = Sys_fopen (name, "rb");
+		size = f ? (long) COM_filelength (f) : 0;
+		if (f)
+			fclose (f);
+
+		Con_Printf ("%s: %ld KB written in %.2f ms\n", names[i], size / 1024, elapsed);
+	}
+
+	// load right away, so that the temporary saves can be removed afterwards
+	q_strlcpy (savebench_lastsave, sv.lastsave, sizeof (savebench_lastsave));
+	savebench_loading = true;
+	for (i = 0; i < 2; i++)
+		Cmd_ExecuteString (va ("load %s", names[i]), src_command);
+	Host_EndSaveBench ();
 }
 
 //============================================================================
@@ -2724,6 +2936,7 @@ static void Host_Name_f (void)
 	}
 	Q_strcpy (host_client->name, newName);
 	host_client->edict->v.netname = PR_SetEngineString(host_client->name);
+	ED_StringFieldsChanged ();
 
 // send notification to all clients
 	MSG_WriteByte (&sv.reliable_datagram, svc_updatename);
@@ -3060,6 +3273,7 @@ static void Host_Spawn_f (void)
 		ent->v.colormap = NUM_FOR_EDICT(ent);
 		ent->v.team = (host_client->colors & 15) + 1;
 		ent->v.netname = PR_SetEngineString(host_client->name);
+		ED_StringFieldsChanged ();
 
 		// copy spawn parms out of the client_t
 		for (i=0 ; i< NUM_SPAWN_PARMS ; i++)
@@ -3722,7 +3936,7 @@ Host_InitCommands
 */
 void Host_InitCommands (void)
 {
-	Host_InitSaveThread ();
+	Host_InitSaveData ();
 
 	Cmd_AddCommand ("maps", Host_Maps_f); //johnfitz
 	Cmd_AddCommand ("mods", Host_Mods_f); //johnfitz
@@ -3758,6 +3972,7 @@ void Host_InitCommands (void)
 	Cmd_AddCommand_ClientCommand ("ping", Host_Ping_f);
 	Cmd_AddCommand ("load", Host_Loadgame_f);
 	Cmd_AddCommand ("save", Host_Savegame_f);
+	Cmd_AddCommand ("savebench", Host_SaveBench_f);
 	Cmd_AddCommand_ClientCommand ("give", Host_Give_f);
 
 	Cmd_AddCommand ("startdemos", Host_Startdemos_f);
@@ -23,8 +23,8 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "quakedef.h"
 
-static byte *Image_LoadPCX (FILE *f, int *width, int *height);
-static byte *Image_LoadLMP (FILE *f, int *width, int *height);
+static byte *Image_LoadPCX (FILE *f, int *width, int *height, qboolean usehunk);
+static byte *Image_LoadLMP (FILE *f, int *width, int *height, qboolean usehunk);
 
 #ifdef __GNUC__
 	// Suppress unused function warnings on GCC/clang
@@ -59,7 +59,7 @@ static byte *Image_LoadLMP (FILE *f, int *width, int *height);
 #include "lodepng.h"
 #include "lodepng.c"
 
-static char loadfilename[MAX_OSPATH]; //file scope so that error messages can use it
+static THREAD_LOCAL char loadfilename[MAX_OSPATH]; //file scope so that error messages can use it
 
 typedef struct stdio_buffer_s {
 	FILE *f;
@@ -98,17 +98,41 @@ static inline int Buf_GetC(stdio_buffer_t *buf)
 
 /*
 ============
-Image_LoadImage
+Image_Alloc
+============
+*/
+static byte *Image_Alloc (size_t size, qboolean usehunk, const char *tag)
+{
+	byte *data;
 
-returns a pointer to hunk allocated RGBA data
+	if (usehunk)
+		return (byte *) Hunk_AllocName (size, tag);
+
+	data = (byte *) malloc (size);
+	if (!data)
+		Sys_Error ("Image_Alloc: out of memory on %" SDL_PRIu64 " bytes", (uint64_t) size);
+
+	return data;
+}
+
+/*
+============
+Image_Load
+
+Tries all supported extensions in order. If usehunk is false the result
+is malloc'ed and no console output is made, so that it can be used from
+worker threads; a decoding error message is stored in error instead.
 ============
 */
-byte *Image_LoadImage (const char *name, int *width, int *height, enum srcformat *fmt)
+static byte *Image_Load (const char *name, int *width, int *height, enum srcformat *fmt, qboolean usehunk, char *error, size_t errorsize)
 {
 	static const char *const stbi_formats[] = {"png", "tga", "jpg", NULL};
 	FILE	*f;
 	int		i;
 
+	if (errorsize)
+		error[0] = '\0';
+
 	for (i = 0; stbi_formats[i]; i++)
 	{
 		q_snprintf (loadfilename, sizeof(loadfilename), "%s.%s", name, stbi_formats[i]);
@@ -118,15 +142,18 @@ byte *Image_LoadImage (const char *name, int *width, int *height, enum srcformat
 			byte *data = stbi_load_from_file (f, width, height, NULL, 4);
 			if (data)
 			{
-				int numbytes = (*width) * (*height) * 4;
-				byte *hunkdata = (byte *) Hunk_AllocName (numbytes, stbi_formats[i]);
-				memcpy (hunkdata, data, numbytes);
-				free (data);
-				data = hunkdata;
+				if (usehunk)
+				{
+					int numbytes = (*width) * (*height) * 4;
+					byte *hunkdata = Image_Alloc (numbytes, true, stbi_formats[i]);
+					memcpy (hunkdata, data, numbytes);
+					free (data);
+					data = hunkdata;
+				}
 				*fmt = SRC_RGBA;
 			}
 			else
-				Con_Warning ("couldn't load %s (%s)\n", loadfilename, stbi_failure_reason ());
+				q_snprintf (error, errorsize, "couldn't load %s (%s)", loadfilename, stbi_failure_reason ());
 			fclose (f);
 			return data;
 		}
@@ -137,7 +164,7 @@ byte *Image_LoadImage (const char *name, int *width, int *height, enum srcformat
 	if (f)
 	{
 		*fmt = SRC_RGBA;
-		return Image_LoadPCX(f, width, height);
+		return Image_LoadPCX(f, width, height, usehunk);
 	}
 
 	q_snprintf (loadfilename, sizeof(loadfilename), "%s.lmp", name);
@@ -145,12 +172,43 @@ byte *Image_LoadImage (const char *name, int *width, int *height, enum srcformat
 	if (f)
 	{
 		*fmt = SRC_INDEXED;
-		return Image_LoadLMP (f, width, height);
+		return Image_LoadLMP (f, width, height, usehunk);
 	}
 
 	return NULL;
 }
 
+/*
+============
+Image_LoadImage
+
+returns a pointer to hunk allocated RGBA data
+============
+*/
+byte *Image_LoadImage (const char *name, int *width, int *height, enum srcformat *fmt)
+{
+	char	error[MAX_OSPATH + 128];
+	byte	*data;
+
+	data = Image_Load (name, width, height, fmt, true, error, sizeof (error));
+	if (!data && error[0])
+		Con_Warning ("%s\n", error);
+
+	return data;
+}
+
+/*
+============
+Image_LoadImageMalloc
+
+thread-safe version of Image_LoadImage, returns a pointer to malloc'ed data
+============
+*/
+byte *Image_LoadImageMalloc (const char *name, int *width, int *height, enum srcformat *fmt, char *error, size_t errorsize)
+{
+	return Image_Load (name, width, height, fmt, false, error, errorsize);
+}
+
 //==============================================================================
 //
 //  TGA
@@ -238,7 +296,7 @@ typedef struct
 Image_LoadPCX
 ============
 */
-static byte *Image_LoadPCX (FILE *f, int *width, int *height)
+static byte *Image_LoadPCX (FILE *f, int *width, int *height, qboolean usehunk)
 {
 	pcxheader_t	pcx;
 	int			x, y, w, h, readbyte, runlength, start;
@@ -269,7 +327,7 @@ static byte *Image_LoadPCX (FILE *f, int *width, int *height)
 	w = pcx.xmax - pcx.xmin + 1;
 	h = pcx.ymax - pcx.ymin + 1;
 
-	data = (byte *) Hunk_Alloc((w*h+1)*4); //+1 to allow reading padding byte on last line
+	data = Image_Alloc((w*h+1)*4, usehunk, "pcx"); //+1 to allow reading padding byte on last line
 
 	//load palette
 	fseek (f, start + com_filesize - 768, SEEK_SET);
@@ -333,7 +391,7 @@ typedef struct
 Image_LoadLMP
 ============
 */
-static byte *Image_LoadLMP (FILE *f, int *width, int *height)
+static byte *Image_LoadLMP (FILE *f, int *width, int *height, qboolean usehunk)
 {
 	lmpheader_t	qpic;
 	size_t		pix;
@@ -351,7 +409,7 @@ static byte *Image_LoadLMP (FILE *f, int *width, int *height)
 		return NULL;
 	}
 
-	data = (byte *) Hunk_Alloc(pix); //+1 to allow reading padding byte on last line
+	data = Image_Alloc(pix, usehunk, "lmp"); //+1 to allow reading padding byte on last line
 	fread(data, 1, pix, f);
 	fclose(f);
 
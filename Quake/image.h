@@ -28,6 +28,8 @@ enum srcformat;
 
 //be sure to free the hunk after using this loading function
 byte *Image_LoadImage (const char *name, int *width, int *height, enum srcformat *fmt);
+//thread-safe, returns malloc'ed data and doesn't print anything (errors go to error)
+byte *Image_LoadImageMalloc (const char *name, int *width, int *height, enum srcformat *fmt, char *error, size_t errorsize);
 
 qboolean Image_WriteTGA (const char *name, byte *data, int width, int height, int bpp, qboolean upsidedown);
 qboolean Image_WritePNG (const char *name, byte *data, int width, int height, int bpp, qboolean upsidedown);
@@ -239,7 +239,7 @@ static void IN_ReenableOSXMouseAccel (void)
 
 void IN_Activate (void)
 {
-	if (no_mouse)
+	if (no_mouse || isHeadless)
 		return;
 
 #ifdef MACOS_X_ACCELERATION_HACK
@@ -257,7 +257,7 @@ void IN_Activate (void)
 
 void IN_Deactivate (qboolean free_cursor)
 {
-	if (no_mouse)
+	if (no_mouse || isHeadless)
 		return;
 
 #ifdef MACOS_X_ACCELERATION_HACK
@@ -0,0 +1,803 @@
+/*
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// jobs.c -- work-stealing job system
+
+#include "quakedef.h"
+
+/*
+
+Each worker thread, and the main thread, owns a fixed-size deque of jobs:
+the owner pushes and pops at the bottom, while other threads that run out
+of work steal from the top (Chase-Lev). Jobs submitted from any other thread
+go on a lock-free stack that the workers move into their own deques.
+
+A job runs once all the jobs it depends on have finished. The dependents of
+a job are kept in a lock-free list that is closed when the job completes, so
+dependencies can be added while the other job is already running.
+
+A thread waiting for a job helps by running that job and the jobs it depends
+on, and hands anything else it comes across back to the other threads.
+
+The only locks are taken by threads going to sleep because there's nothing
+left to do.
+
+*/
+
+#define MAX_JOB_WORKERS			32
+#define JOB_QUEUE_SIZE			4096	// per thread, must be a power of two
+#define JOB_MAX_DEPENDENCIES	8
+#define JOB_SPIN_COUNT			64
+#define JOB_MAX_SKIPPED			64		// jobs set aside per Job_Wait search
+#define JOB_MAX_DEPTH			16		// how far Job_Wait follows the dependents of a job
+
+typedef struct jobedge_s
+{
+	struct jobedge_s	*next;
+	job_t				*job;			// the job waiting on the dependency
+} jobedge_t;
+
+struct job_s
+{
+	jobfunc_t			func;
+	void				*param;
+	SDL_atomic_t		pending;		// unfinished dependencies, plus one until submitted
+	SDL_atomic_t		refcount;
+	SDL_atomic_t		done;
+	void				*dependents;	// jobedge_t list, job_finished once the job has run
+	job_t				*next;			// injection stack link
+	qboolean			isstatic;		// owned by the caller, never freed
+	int					numedges;
+	jobedge_t			edges[JOB_MAX_DEPENDENCIES];
+};
+
+typedef struct
+{
+	SDL_atomic_t		top;
+	byte				pad[60];		// keep thieves and the owner on separate cache lines
+	SDL_atomic_t		bottom;
+	void				*slots[JOB_QUEUE_SIZE];
+} jobdeque_t;
+
+typedef struct
+{
+	jobdeque_t			deque;
+	SDL_Thread			*thread;
+	unsigned			seed;
+
+	// only written by the owning thread
+	int					executed;
+	int					steals;
+	double				busytime;
+
+	// values at the previous jobs_stats
+	int					lastexecuted;
+	int					laststeals;
+	double				lastbusytime;
+} jobthread_t;
+
+static struct
+{
+	jobthread_t			*threads;		// [0] is the main thread
+	int					numthreads;		// workers + 1
+	SDL_atomic_t		quit;
+	SDL_atomic_t		queued;			// jobs sitting in a deque or the injection stack
+	SDL_atomic_t		sleepers;
+	SDL_atomic_t		waiters;
+	void				*injected;		// job_t stack
+	SDL_sem				*wake;
+	SDL_mutex			*mutex;
+	SDL_cond			*finished;
+	double				statstime;
+} jobs;
+
+static jobedge_t			job_finished;
+static THREAD_LOCAL jobthread_t *jobs_self;
+
+static void Jobs_Execute (job_t *job);
+
+/*
+================================================================================
+
+	DEQUES
+
+	Indices wrap around, so they are only ever compared through their difference
+
+================================================================================
+*/
+
+/*
+================
+Jobs_Push -- owner only
+================
+*/
+static qboolean Jobs_Push (jobdeque_t *q, job_t *job)
+{
+	unsigned b = (unsigned) SDL_AtomicGet (&q->bottom);
+	unsigned t = (unsigned) SDL_AtomicGet (&q->top);
+
+	if (b - t >= JOB_QUEUE_SIZE)
+		return false;
+
+	SDL_AtomicSetPtr (&q->slots[b & (JOB_QUEUE_SIZE - 1)], job);
+	SDL_MemoryBarrierRelease ();	// thieves that see the new bottom also see the slot
+	SDL_AtomicSet (&q->bottom, (int) (b + 1));
+
+	return true;
+}
+
+/*
+================
+Jobs_Pop -- owner only
+================
+*/
+static job_t *Jobs_Pop (jobdeque_t *q)
+{
+	unsigned	b, t;
+	job_t		*job;
+
+	// the read-modify-write is a full fence: the new bottom has to be visible
+	// to the thieves before we read top, or both sides could take the last job
+	b = (unsigned) SDL_AtomicAdd (&q->bottom, -1) - 1;
+	t = (unsigned) SDL_AtomicGet (&q->top);
+	if ((int) (b - t) < 0)
+	{
+		SDL_AtomicSet (&q->bottom, (int) t);
+		return NULL;
+	}
+
+	job = (job_t *) SDL_AtomicGetPtr (&q->slots[b & (JOB_QUEUE_SIZE - 1)]);
+	if (b == t)
+	{
+		// last one, race against the thieves
+		if (!SDL_AtomicCAS (&q->top, (int) t, (int) (t + 1)))
+			job = NULL;
+		SDL_AtomicSet (&q->bottom, (int) (t + 1));
+	}
+
+	return job;
+}
+
+/*
+================
+Jobs_Steal -- any thread
+================
+*/
+static job_t *Jobs_Steal (jobdeque_t *q)
+{
+	unsigned	t, b;
+	job_t		*job;
+
+	t = (unsigned) SDL_AtomicGet (&q->top);
+	SDL_MemoryBarrierAcquire ();
+	b = (unsigned) SDL_AtomicGet (&q->bottom);
+	if ((int) (b - t) <= 0)
+		return NULL;
+	SDL_MemoryBarrierAcquire ();	// pairs with the release in Jobs_Push
+
+	job = (job_t *) SDL_AtomicGetPtr (&q->slots[t & (JOB_QUEUE_SIZE - 1)]);
+	if (!SDL_AtomicCAS (&q->top, (int) t, (int) (t + 1)))
+		return NULL;
+
+	return job;
+}
+
+/*
+================================================================================
+
+	SCHEDULING
+
+================================================================================
+*/
+
+/*
+================
+Jobs_Inject -- pushes a job on the stack shared by all threads
+================
+*/
+static void Jobs_Inject (job_t *job)
+{
+	void *head;
+
+	do
+	{
+		head = SDL_AtomicGetPtr (&jobs.injected);
+		job->next = (job_t *) head;
+	} while (!SDL_AtomicCASPtr (&jobs.injected, head, job));
+}
+
+/*
+================
+Jobs_Schedule -- queues a job whose dependencies are all done
+================
+*/
+static void Jobs_Schedule (job_t *job)
+{
+	if (jobs.numthreads <= 1)
+	{
+		Jobs_Execute (job);
+		return;
+	}
+
+	SDL_AtomicAdd (&jobs.queued, 1);
+	if (!jobs_self || !Jobs_Push (&jobs_self->deque, job))
+		Jobs_Inject (job);
+
+	if (SDL_AtomicGet (&jobs.sleepers) > 0)
+		SDL_SemPost (jobs.wake);
+}
+
+/*
+================
+Jobs_Random -- xorshift
+================
+*/
+static unsigned Jobs_Random (unsigned *seed)
+{
+	unsigned x = *seed;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return *seed = x;
+}
+
+/*
+================
+Jobs_FindWork
+
+Own deque first, then the injection stack, then the other threads
+================
+*/
+static job_t *Jobs_FindWork (void)
+{
+	job_t	*job, *rest, *next;
+	int		i, start;
+
+	if (jobs.numthreads <= 1)
+		return NULL;
+
+	if (jobs_self)
+	{
+		job = Jobs_Pop (&jobs_self->deque);
+		if (job)
+			goto found;
+
+		// take the whole stack at once, which avoids the ABA problem of popping single entries
+		if (SDL_AtomicGetPtr (&jobs.injected))
+		{
+			job = (job_t *) SDL_AtomicSetPtr (&jobs.injected, NULL);
+			if (job)
+			{
+				for (rest = job->next; rest; rest = next)
+				{
+					next = rest->next;
+					if (!Jobs_Push (&jobs_self->deque, rest))
+						Jobs_Inject (rest);
+				}
+				goto found;
+			}
+		}
+	}
+
+	start = jobs_self ? (int) (Jobs_Random (&jobs_self->seed) % jobs.numthreads) : 0;
+	for (i = 0; i < jobs.numthreads; i++)
+	{
+		jobthread_t *victim = &jobs.threads[(start + i) % jobs.numthreads];
+		if (victim == jobs_self)
+			continue;
+		job = Jobs_Steal (&victim->deque);
+		if (job)
+		{
+			if (jobs_self)
+				jobs_self->steals++;
+			goto found;
+		}
+	}
+
+	return NULL;
+
+found:
+	SDL_AtomicAdd (&jobs.queued, -1);
+	return job;
+}
+
+/*
+================
+Jobs_Execute
+================
+*/
+static void Jobs_Execute (job_t *job)
+{
+	jobthread_t	*self = jobs_self;
+	jobedge_t	*edge, *next;
+	job_t		*dependent;
+	qboolean	isstatic;
+	double		time = 0.0;
+
+	if (self)
+		time = Sys_DoubleTime ();
+
+	job->func (job->param);
+
+	if (self)
+	{
+		self->busytime += Sys_DoubleTime () - time;
+		self->executed++;
+	}
+
+	// close the list of dependents and release them
+	edge = (jobedge_t *) SDL_AtomicSetPtr (&job->dependents, &job_finished);
+	for (; edge; edge = next)
+	{
+		// the edge lives in the dependent, which can be gone as soon as its counter is decremented
+		next = edge->next;
+		dependent = edge->job;
+		if (SDL_AtomicAdd (&dependent->pending, -1) == 1)
+			Jobs_Schedule (dependent);
+	}
+
+	// a static job can go away as soon as it's marked as done
+	isstatic = job->isstatic;
+	SDL_AtomicSet (&job->done, 1);
+
+	if (SDL_AtomicGet (&jobs.waiters) > 0)
+	{
+		SDL_LockMutex (jobs.mutex);
+		SDL_CondBroadcast (jobs.finished);
+		SDL_UnlockMutex (jobs.mutex);
+	}
+
+	if (!isstatic)
+		Job_Release (job);
+}
+
+/*
+================
+Jobs_Worker
+================
+*/
+static int SDLCALL Jobs_Worker (void *param)
+{
+	jobs_self = (jobthread_t *) param;
+
+	while (1)
+	{
+		job_t	*job = NULL;
+		int		spin;
+
+		for (spin = 0; spin < JOB_SPIN_COUNT && !job; spin++)
+			job = Jobs_FindWork ();
+
+		if (job)
+		{
+			Jobs_Execute (job);
+			continue;
+		}
+
+		// only leave once our own deque is empty
+		if (SDL_AtomicGet (&jobs.quit))
+			break;
+
+		// announce ourselves before checking the queue one last time,
+		// so that a concurrent Jobs_Schedule either sees us or we see its job
+		SDL_AtomicAdd (&jobs.sleepers, 1);
+		if (!SDL_AtomicGet (&jobs.queued) && !SDL_AtomicGet (&jobs.quit))
+			SDL_SemWait (jobs.wake);
+		SDL_AtomicAdd (&jobs.sleepers, -1);
+	}
+
+	return 0;
+}
+
+/*
+================================================================================
+
+	JOBS
+
+================================================================================
+*/
+
+/*
+================
+Jobs_InitJob
+================
+*/
+static void Jobs_InitJob (job_t *job, jobfunc_t func, void *param)
+{
+	memset (job, 0, sizeof (*job));
+	job->func = func;
+	job->param = param;
+	SDL_AtomicSet (&job->pending, 1);
+}
+
+/*
+================
+Job_Create
+================
+*/
+job_t *Job_Create (jobfunc_t func, void *param)
+{
+	job_t *job = (job_t *) malloc (sizeof (*job));
+
+	if (!job)
+		Sys_Error ("Job_Create: out of memory");
+	Jobs_InitJob (job, func, param);
+	SDL_AtomicSet (&job->refcount, 2);	// one for the caller, one until the job has run
+
+	return job;
+}
+
+/*
+================
+Job_AddDependency -- job won't start before dependency has finished
+================
+*/
+void Job_AddDependency (job_t *job, job_t *dependency)
+{
+	jobedge_t	*edge;
+	void		*head;
+
+	if (job->numedges >= JOB_MAX_DEPENDENCIES)
+		Sys_Error ("Job_AddDependency: too many dependencies");
+
+	edge = &job->edges[job->numedges++];
+	edge->job = job;
+	SDL_AtomicAdd (&job->pending, 1);
+
+	do
+	{
+		head = SDL_AtomicGetPtr (&dependency->dependents);
+		if (head == &job_finished)
+		{
+			// already done
+			job->numedges--;
+			SDL_AtomicAdd (&job->pending, -1);
+			return;
+		}
+		edge->next = (jobedge_t *) head;
+	} while (!SDL_AtomicCASPtr (&dependency->dependents, head, edge));
+}
+
+/*
+================
+Job_Submit
+================
+*/
+void Job_Submit (job_t *job)
+{
+	if (SDL_AtomicAdd (&job->pending, -1) == 1)
+		Jobs_Schedule (job);
+}
+
+/*
+================
+Job_IsDone
+================
+*/
+qboolean Job_IsDone (job_t *job)
+{
+	return SDL_AtomicGet (&job->done) != 0;
+}
+
+/*
+================
+Jobs_IsNeededBy -- true if job has to run before target can finish
+
+Only called on jobs that haven't run yet, so their dependents are still
+waiting on them and can't go away while we follow the edges
+================
+*/
+static qboolean Jobs_IsNeededBy (job_t *job, job_t *target, int depth)
+{
+	jobedge_t *edge;
+
+	if (job == target)
+		return true;
+	if (depth >= JOB_MAX_DEPTH)
+		return false;
+
+	edge = (jobedge_t *) SDL_AtomicGetPtr (&job->dependents);
+	if (edge == &job_finished)
+		return false;
+	for (; edge; edge = edge->next)
+		if (Jobs_IsNeededBy (edge->job, target, depth + 1))
+			return true;
+
+	return false;
+}
+
+/*
+================
+Jobs_Requeue -- gives a job taken by Job_Wait back to the other threads
+================
+*/
+static void Jobs_Requeue (job_t *job)
+{
+	SDL_AtomicAdd (&jobs.queued, 1);
+	Jobs_Inject (job);
+	if (SDL_AtomicGet (&jobs.sleepers) > 0)
+		SDL_SemPost (jobs.wake);
+}
+
+/*
+================
+Jobs_FindWorkFor -- like Jobs_FindWork, but only returns jobs that target depends on
+
+Anything else is handed back, so that waiting for a short job never ends up
+running an unrelated long one, like a save or a map scan
+================
+*/
+static job_t *Jobs_FindWorkFor (job_t *target)
+{
+	job_t	*skipped[JOB_MAX_SKIPPED];
+	job_t	*job;
+	int		i, numskipped = 0;
+
+	while (numskipped < JOB_MAX_SKIPPED && (job = Jobs_FindWork ()) != NULL)
+	{
+		if (Jobs_IsNeededBy (job, target, 0))
+			break;
+		skipped[numskipped++] = job;
+		job = NULL;
+	}
+
+	for (i = 0; i < numskipped; i++)
+		Jobs_Requeue (skipped[i]);
+
+	return job;
+}
+
+/*
+================
+Job_Wait
+================
+*/
+void Job_Wait (job_t *job)
+{
+	while (!SDL_AtomicGet (&job->done))
+	{
+		job_t *other = Jobs_FindWorkFor (job);
+		if (other)
+		{
+			Jobs_Execute (other);
+			continue;
+		}
+
+		// nothing to help with, sleep until some job finishes
+		SDL_AtomicAdd (&jobs.waiters, 1);
+		SDL_LockMutex (jobs.mutex);
+		if (!SDL_AtomicGet (&job->done))
+			SDL_CondWaitTimeout (jobs.finished, jobs.mutex, 1);
+		SDL_UnlockMutex (jobs.mutex);
+		SDL_AtomicAdd (&jobs.waiters, -1);
+	}
+}
+
+/*
+================
+Job_Release
+================
+*/
+void Job_Release (job_t *job)
+{
+	if (SDL_AtomicAdd (&job->refcount, -1) == 1)
+		free (job);
+}
+
+/*
+================
+Jobs_Dispatch
+================
+*/
+void Jobs_Dispatch (jobfunc_t func, void *param)
+{
+	job_t *job = Job_Create (func, param);
+	Job_Submit (job);
+	Job_Release (job);
+}
+
+typedef struct
+{
+	void				(*func) (int index, void *param);
+	void				*param;
+	int					count;
+	int					batch;
+	SDL_atomic_t		next;
+} parallelfor_t;
+
+/*
+================
+Jobs_ParallelForWorker
+================
+*/
+static void Jobs_ParallelForWorker (void *param)
+{
+	parallelfor_t	*pf = (parallelfor_t *) param;
+	int				first, last;
+
+	while ((first = SDL_AtomicAdd (&pf->next, pf->batch)) < pf->count)
+	{
+		last = q_min (first + pf->batch, pf->count);
+		for (; first < last; first++)
+			pf->func (first, pf->param);
+	}
+}
+
+/*
+================
+Jobs_ParallelFor
+================
+*/
+void Jobs_ParallelFor (void (*func) (int index, void *param), void *param, int count, int batch)
+{
+	parallelfor_t	pf;
+	job_t			helpers[MAX_JOB_WORKERS];
+	int				i, numhelpers;
+
+	if (count <= 0)
+		return;
+
+	pf.func = func;
+	pf.param = param;
+	pf.count = count;
+	pf.batch = q_max (batch, 1);
+	SDL_AtomicSet (&pf.next, 0);
+
+	numhelpers = q_min (jobs.numthreads - 1, (count + pf.batch - 1) / pf.batch - 1);
+	for (i = 0; i < numhelpers; i++)
+	{
+		Jobs_InitJob (&helpers[i], Jobs_ParallelForWorker, &pf);
+		helpers[i].isstatic = true;
+		Job_Submit (&helpers[i]);
+	}
+
+	Jobs_ParallelForWorker (&pf);
+
+	for (i = 0; i < numhelpers; i++)
+		Job_Wait (&helpers[i]);
+}
+
+/*
+================
+Jobs_NumWorkers
+================
+*/
+int Jobs_NumWorkers (void)
+{
+	return q_max (jobs.numthreads - 1, 0);
+}
+
+/*
+================================================================================
+
+	INIT
+
+================================================================================
+*/
+
+/*
+================
+Jobs_Stats_f -- prints per-thread statistics since the previous call
+================
+*/
+static void Jobs_Stats_f (void)
+{
+	double	now, elapsed;
+	int		i;
+
+	if (!jobs.threads)
+		return;
+
+	now = Sys_DoubleTime ();
+	elapsed = q_max (now - jobs.statstime, 1e-6);
+
+	Con_Printf ("%d worker threads, %d jobs queued\n", jobs.numthreads - 1, SDL_AtomicGet (&jobs.queued));
+	Con_Printf ("thread     queue    jobs  steals   busy\n");
+	for (i = 0; i < jobs.numthreads; i++)
+	{
+		jobthread_t	*t = &jobs.threads[i];
+		int			executed = t->executed;
+		int			steals = t->steals;
+		double		busytime = t->busytime;
+		int			depth = (int) ((unsigned) SDL_AtomicGet (&t->deque.bottom) - (unsigned) SDL_AtomicGet (&t->deque.top));
+
+		Con_Printf ("%-9s %6d %7d %7d %5.1f%%\n", i ? va ("worker %d", i) : "main",
+			q_max (depth, 0), executed - t->lastexecuted, steals - t->laststeals,
+			100.0 * (busytime - t->lastbusytime) / elapsed);
+
+		t->lastexecuted = executed;
+		t->laststeals = steals;
+		t->lastbusytime = busytime;
+	}
+	Con_Printf ("over the last %.1f seconds\n", elapsed);
+
+	jobs.statstime = now;
+}
+
+/*
+================
+Jobs_Init
+================
+*/
+void Jobs_Init (void)
+{
+	int i, numworkers;
+
+	i = COM_CheckParm ("-jobthreads");
+	if (i && i < com_argc - 1)
+		numworkers = atoi (com_argv[i + 1]);
+	else
+		numworkers = host_parms->numcpus - 1;
+	numworkers = CLAMP (1, numworkers, MAX_JOB_WORKERS);
+
+	jobs.threads = (jobthread_t *) calloc (numworkers + 1, sizeof (jobs.threads[0]));
+	jobs.wake = SDL_CreateSemaphore (0);
+	jobs.mutex = SDL_CreateMutex ();
+	jobs.finished = SDL_CreateCond ();
+	if (!jobs.threads || !jobs.wake || !jobs.mutex || !jobs.finished)
+		Sys_Error ("Jobs_Init: %s", SDL_GetError ());
+
+	jobs_self = &jobs.threads[0];
+	jobs.threads[0].seed = 1;
+	jobs.numthreads = numworkers + 1;
+	for (i = 1; i <= numworkers; i++)
+	{
+		jobthread_t *t = &jobs.threads[i];
+		t->seed = i * 2654435761u;
+		t->thread = SDL_CreateThread (Jobs_Worker, "Job worker", t);
+		if (!t->thread)
+			Sys_Error ("Jobs_Init: could not create worker thread: %s", SDL_GetError ());
+	}
+	jobs.statstime = Sys_DoubleTime ();
+
+	Cmd_AddCommand ("jobs_stats", Jobs_Stats_f);
+}
+
+/*
+================
+Jobs_Shutdown -- runs whatever is still queued, then stops the workers
+================
+*/
+void Jobs_Shutdown (void)
+{
+	job_t	*job;
+	int		i;
+
+	if (!jobs.threads || jobs_self != &jobs.threads[0])
+		return; // not initialized, or called from a worker (Sys_Error)
+
+	while ((job = Jobs_FindWork ()) != NULL)
+		Jobs_Execute (job);
+
+	SDL_AtomicSet (&jobs.quit, 1);
+	for (i = 1; i < jobs.numthreads; i++)
+		SDL_SemPost (jobs.wake);
+	for (i = 1; i < jobs.numthreads; i++)
+		SDL_WaitThread (jobs.threads[i].thread, NULL);
+
+	// anything the workers left in the injection stack
+	while ((job = Jobs_FindWork ()) != NULL)
+		Jobs_Execute (job);
+
+	SDL_DestroyCond (jobs.finished);
+	SDL_DestroyMutex (jobs.mutex);
+	SDL_DestroySemaphore (jobs.wake);
+	free (jobs.threads);
+	memset (&jobs, 0, sizeof (jobs));
+	jobs_self = NULL;
+}
@@ -0,0 +1,48 @@
+/*
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+#ifndef _JOBS_H_
+#define _JOBS_H_
+
+// jobs.h -- work-stealing job system
+
+typedef struct job_s job_t;
+typedef void (*jobfunc_t) (void *param);
+
+void	Jobs_Init (void);
+void	Jobs_Shutdown (void);
+int		Jobs_NumWorkers (void);
+
+// jobs are reference counted: the caller owns the reference returned by Job_Create
+// and has to drop it with Job_Release, which may happen before the job has run
+job_t	*Job_Create (jobfunc_t func, void *param);
+void	Job_AddDependency (job_t *job, job_t *dependency);	// only before job is submitted
+void	Job_Submit (job_t *job);
+qboolean Job_IsDone (job_t *job);
+void	Job_Wait (job_t *job);	// runs job and the jobs it depends on while waiting
+void	Job_Release (job_t *job);
+
+// fire and forget
+void	Jobs_Dispatch (jobfunc_t func, void *param);
+
+// calls func for each index in [0, count) on all workers plus the calling thread,
+// handing out batch indices at a time, and returns when all of them are done
+void	Jobs_ParallelFor (void (*func) (int index, void *param), void *param, int count, int batch);
+
+#endif	/* _JOBS_H_ */
@@ -140,6 +140,7 @@ int main(int argc, char *argv[])
 	COM_InitArgv(parms.argc, parms.argv);
 
 	isDedicated = (COM_CheckParm("-dedicated") != 0);
+	isHeadless = !isDedicated && COM_CheckParm("-headless") != 0;
 
 	Sys_InitSDL ();
 
@@ -185,11 +186,24 @@ int main(int argc, char *argv[])
 			oldtime = newtime;
 		}
 	}
+	else if (isHeadless)
+	{
+		// no window to wait on, just keep running frames
+		while (1)
+		{
+			newtime = Sys_Throttle (oldtime);
+			time = newtime - oldtime;
+
+			Host_Frame (time);
+			oldtime = newtime;
+		}
+	}
 	else
 	while (1)
 	{
-		/* If we have no input focus at all, sleep a bit */
-		if (!VID_HasMouseOrInputFocus() || cl.paused)
+		/* If we have no input focus at all, sleep a bit,
+		 * unless a demo is being rendered in the background */
+		if ((!VID_HasMouseOrInputFocus() || cl.paused) && !cls.demorender)
 		{
 			SDL_Delay(16);
 		}
@@ -150,6 +150,17 @@ qboolean RayVsBox (const vec3_t org, const vec3_t rcpdelta, const vec3_t mins, c
 	#include <emmintrin.h>
 #endif
 
+/* AVX2 code paths are compiled separately and only used if the cpu supports them */
+#if defined(USE_SSE2) && (defined(_MSC_VER) || (defined(__GNUC__) && (__GNUC__ >= 5 || defined(__clang__))))
+	#define USE_AVX2
+	#include <immintrin.h>
+	#if defined(__GNUC__)
+		#define TARGET_AVX2 __attribute__((target("avx2")))
+	#else
+		#define TARGET_AVX2
+	#endif
+#endif
+
 /*==========================================================================*/
 
 #endif	/* __MATHLIB_H */
@@ -7037,30 +7037,26 @@ void M_ConfigureNetSubsystem(void)
 static qboolean M_CheckCustomGfx (const char *custompath, const char *basepath, int knownlength, const unsigned int *hashes, int numhashes)
 {
 	unsigned int id_custom, id_base;
-	int h, length;
+	fileview_t view;
 	qboolean ret = false;
 
 	if (!COM_FileExists (custompath, &id_custom))
 		return false;
 
-	length = COM_OpenFile (basepath, &h, &id_base);
+	if (!COM_OpenFileView (basepath, &view, &id_base))
+		return true;
+
 	if (id_custom >= id_base)
 		ret = true;
-	else if (length == knownlength)
+	else if (view.size == knownlength)
 	{
-		int mark = Hunk_LowMark ();
-		byte* data = (byte*) Hunk_Alloc (length);
-		if (length == Sys_FileRead (h, data, length))
-		{
-			unsigned int hash = COM_HashBlock (data, length);
-			while (numhashes-- > 0 && !ret)
-				if (hash == *hashes++)
-					ret = true;
-		}
-		Hunk_FreeToLowMark (mark);
+		unsigned int hash = COM_HashBlock (view.data, view.size);
+		while (numhashes-- > 0 && !ret)
+			if (hash == *hashes++)
+				ret = true;
 	}
 
-	COM_CloseFile (h);
+	COM_CloseFileView (&view);
 
 	return ret;
 }
@@ -34,6 +34,27 @@ static char *PR_GetTempString (void)
 	return pr_string_temp[(STRINGTEMP_BUFFERS-1) & ++pr_string_tempindex];
 }
 
+/*
+=================
+PR_ReserveTempStrings
+
+Gives every temp string buffer a fixed known string slot, so handing one to
+QC doesn't need a lookup
+=================
+*/
+void PR_ReserveTempStrings (void)
+{
+	int i;
+
+	qcvm->tempstringslot = -1 - PR_SetEngineString (pr_string_temp[0]);
+	for (i = 1; i < STRINGTEMP_BUFFERS; i++)
+		if (PR_SetEngineString (pr_string_temp[i]) != -1 - (qcvm->tempstringslot + i))
+			Sys_Error ("PR_ReserveTempStrings: slots not contiguous");
+	qcvm->tempstrings = pr_string_temp[0];
+	qcvm->tempstringsize = STRINGTEMP_LENGTH;
+	qcvm->numtempstrings = STRINGTEMP_BUFFERS;
+}
+
 int PR_MakeTempString (const char *val)
 {
 	char *tmp = PR_GetTempString();
@@ -304,7 +325,7 @@ setmodel(entity, model)
 static void PF_setmodel (void)
 {
 	int		i;
-	const char	*m, **check;
+	const char	*m;
 	qmodel_t	*mod;
 	edict_t		*e;
 
@@ -312,17 +333,13 @@ static void PF_setmodel (void)
 	m = G_STRING(OFS_PARM1);
 
 // check to see if model was properly precached
-	for (i = 0, check = sv.model_precache; *check; i++, check++)
-	{
-		if (!strcmp(*check, m))
-			break;
-	}
-
-	if (!*check)
+	i = StrIndex_Find (&sv_modelnames, m);
+	if (i < 0)
 	{
 		PR_RunError ("no precache: %s", m);
 	}
-	e->v.model = PR_SetEngineString(*check);
+	e->v.model = PR_SetEngineString(sv.model_precache[i]);
+	ED_StringFieldsChanged ();
 	e->v.modelindex = i; //SV_ModelIndex (m);
 
 	mod = sv.models[ (int)e->v.modelindex];  // Mod_ForName (m, true);
@@ -588,7 +605,7 @@ PF_ambientsound
 */
 static void PF_ambientsound (void)
 {
-	const char	*samp, **check;
+	const char	*samp;
 	float		*pos;
 	float		vol, attenuation;
 	int		i, soundnum;
@@ -600,13 +617,8 @@ static void PF_ambientsound (void)
 	attenuation = G_FLOAT(OFS_PARM3);
 
 // check to see if samp was properly precached
-	for (soundnum = 0, check = sv.sound_precache; *check; check++, soundnum++)
-	{
-		if (!strcmp(*check, samp))
-			break;
-	}
-
-	if (!*check)
+	soundnum = StrIndex_Find (&sv_soundnames, samp);
+	if (soundnum < 0)
 	{
 		Con_Printf ("no precache: %s\n", samp);
 		return;
@@ -694,6 +706,27 @@ static void PF_break (void)
 //	PR_RunError ("break statement");
 }
 
+/*
+=================
+PF_SetTraceGlobals
+=================
+*/
+static void PF_SetTraceGlobals (const trace_t *trace)
+{
+	pr_global_struct->trace_allsolid = trace->allsolid;
+	pr_global_struct->trace_startsolid = trace->startsolid;
+	pr_global_struct->trace_fraction = trace->fraction;
+	pr_global_struct->trace_inwater = trace->inwater;
+	pr_global_struct->trace_inopen = trace->inopen;
+	VectorCopy (trace->endpos, pr_global_struct->trace_endpos);
+	VectorCopy (trace->plane.normal, pr_global_struct->trace_plane_normal);
+	pr_global_struct->trace_plane_dist =  trace->plane.dist;
+	if (trace->ent)
+		pr_global_struct->trace_ent = EDICT_TO_PROG(trace->ent);
+	else
+		pr_global_struct->trace_ent = EDICT_TO_PROG(qcvm->edicts);
+}
+
 /*
 =================
 PF_traceline
@@ -733,18 +766,67 @@ static void PF_traceline (void)
 
 	trace = SV_Move (v1, vec3_origin, vec3_origin, v2, nomonsters, ent);
 
-	pr_global_struct->trace_allsolid = trace.allsolid;
-	pr_global_struct->trace_startsolid = trace.startsolid;
-	pr_global_struct->trace_fraction = trace.fraction;
-	pr_global_struct->trace_inwater = trace.inwater;
-	pr_global_struct->trace_inopen = trace.inopen;
-	VectorCopy (trace.endpos, pr_global_struct->trace_endpos);
-	VectorCopy (trace.plane.normal, pr_global_struct->trace_plane_normal);
-	pr_global_struct->trace_plane_dist =  trace.plane.dist;
-	if (trace.ent)
-		pr_global_struct->trace_ent = EDICT_TO_PROG(trace.ent);
-	else
-		pr_global_struct->trace_ent = EDICT_TO_PROG(qcvm->edicts);
+	PF_SetTraceGlobals (&trace);
+}
+
+/*
+=================
+PF_tracelines
+
+Traces count lines, each one offset by step from the previous one, with the
+world part of the traces done together. The trace globals are set to the
+shortest trace (the first one on ties).
+Returns the number of lines that were blocked.
+
+float tracelines (vector start, vector end, vector step, float count, float nomonsters, entity ignore)
+=================
+*/
+#define	MAX_TRACELINES	64
+static void PF_tracelines (void)
+{
+	vec3_t	starts[MAX_TRACELINES], ends[MAX_TRACELINES];
+	trace_t	traces[MAX_TRACELINES];
+	float	*v1, *v2, *step;
+	int		i, count, nomonsters, best, blocked;
+	edict_t	*ent;
+
+	v1 = G_VECTOR(OFS_PARM0);
+	v2 = G_VECTOR(OFS_PARM1);
+	step = G_VECTOR(OFS_PARM2);
+	count = (int) G_FLOAT(OFS_PARM3);
+	nomonsters = G_FLOAT(OFS_PARM4);
+	ent = G_EDICT(OFS_PARM5);
+
+	if (count < 1 || count > MAX_TRACELINES)
+		PR_RunError ("tracelines: bad count %d (1 to %d)", count, MAX_TRACELINES);
+
+	if (IS_NAN(v1[0]) || IS_NAN(v1[1]) || IS_NAN(v1[2]))
+		v1[0] = v1[1] = v1[2] = 0;
+	if (IS_NAN(v2[0]) || IS_NAN(v2[1]) || IS_NAN(v2[2]))
+		v2[0] = v2[1] = v2[2] = 0;
+	if (IS_NAN(step[0]) || IS_NAN(step[1]) || IS_NAN(step[2]))
+		step[0] = step[1] = step[2] = 0;
+
+	for (i = 0; i < count; i++)
+	{
+		VectorMA (v1, i, step, starts[i]);
+		VectorMA (v2, i, step, ends[i]);
+	}
+
+	SV_MoveBatch (count, starts, vec3_origin, vec3_origin, ends, nomonsters, ent, traces);
+
+	best = 0;
+	blocked = 0;
+	for (i = 0; i < count; i++)
+	{
+		if (traces[i].fraction < 1.f)
+			blocked++;
+		if (traces[i].fraction < traces[best].fraction)
+			best = i;
+	}
+
+	PF_SetTraceGlobals (&traces[best]);
+	G_FLOAT(OFS_RETURN) = blocked;
 }
 
 /*
@@ -963,6 +1045,92 @@ static void PF_cvar_set (void)
 	Cvar_Set (var, val);
 }
 
+/*
+=================
+PF_InRadius
+
+The findradius test: the center of the edict's box within rad (squared) of org
+=================
+*/
+static qboolean PF_InRadius (edict_t *ent, const float *org, float rad)
+{
+	float d, lensq;
+
+	if (ent->free)
+		return false;
+	if (ent->v.solid == SOLID_NOT)
+		return false;
+
+	d = org[0] - (ent->v.origin[0] + (ent->v.mins[0] + ent->v.maxs[0]) * 0.5);
+	lensq = d * d;
+	if (lensq > rad)
+		return false;
+	d = org[1] - (ent->v.origin[1] + (ent->v.mins[1] + ent->v.maxs[1]) * 0.5);
+	lensq += d * d;
+	if (lensq > rad)
+		return false;
+	d = org[2] - (ent->v.origin[2] + (ent->v.mins[2] + ent->v.maxs[2]) * 0.5);
+	lensq += d * d;
+	if (lensq > rad)
+		return false;
+
+	return true;
+}
+
+static edict_t	**findradius_list;
+static int		findradius_capacity;
+
+/*
+=================
+PF_FindRadiusList
+
+Fills findradius_list with the matching edicts. Unless mode is 2, they are
+sorted by edict number, which gives the same chain as a linear scan.
+mode is a sv_spatialhash value.
+=================
+*/
+static int PF_FindRadiusList (const float *org, float radius, int mode)
+{
+	edict_t	*ent;
+	vec3_t	mins, maxs;
+	float	rad = radius * radius;
+	int		i, count, found;
+
+	if (qcvm->num_edicts > findradius_capacity)
+	{
+		findradius_capacity = qcvm->max_edicts;
+		findradius_list = (edict_t **) realloc (findradius_list, sizeof (*findradius_list) * findradius_capacity);
+		if (!findradius_list)
+			Sys_Error ("PF_FindRadiusList: out of memory");
+	}
+
+	found = 0;
+	if (mode <= 0)
+	{
+		ent = NEXT_EDICT(qcvm->edicts);
+		for (i = 1; i < qcvm->num_edicts; i++, ent = NEXT_EDICT(ent))
+			if (PF_InRadius (ent, org, rad))
+				findradius_list[found++] = ent;
+		return found;
+	}
+
+	radius = fabs (radius);
+	for (i = 0; i < 3; i++)
+	{
+		mins[i] = org[i] - radius;
+		maxs[i] = org[i] + radius;
+	}
+
+	count = SV_GridEdicts (mins, maxs, true, findradius_list, findradius_capacity);
+	for (i = 0; i < count; i++)
+		if (PF_InRadius (findradius_list[i], org, rad))
+			findradius_list[found++] = findradius_list[i];
+	if (mode < 2)
+		SV_SortEdicts (findradius_list, found);
+
+	return found;
+}
+
 /*
 =================
 PF_findradius
@@ -975,43 +1143,101 @@ findradius (origin, radius)
 static void PF_findradius (void)
 {
 	edict_t	*ent, *chain;
-	float	rad;
-	float	*org;
-	int		i;
+	int		i, count;
 
 	chain = (edict_t *)qcvm->edicts;
 
-	org = G_VECTOR(OFS_PARM0);
-	rad = G_FLOAT(OFS_PARM1);
-	rad *= rad;
+	count = PF_FindRadiusList (G_VECTOR(OFS_PARM0), G_FLOAT(OFS_PARM1), (int) sv_spatialhash.value);
+	for (i = 0; i < count; i++)
+	{
+		ent = findradius_list[i];
+		ent->v.chain = EDICT_TO_PROG(chain);
+		chain = ent;
+	}
+
+	RETURN_EDICT(chain);
+}
+
+/*
+=================
+PR_FindRadiusBench_f
+
+Times findradius around every solid edict with a linear scan and with
+the spatial hash, and checks that both return the same chains
+=================
+*/
+void PR_FindRadiusBench_f (void)
+{
+	edict_t		**linear;
+	edict_t		*ent;
+	vec3_t		org;
+	float		radius;
+	double		start, times[2];
+	int			repeats, e, r, mode, count, lincount, queries, mismatches, total;
+	qcvm_t		*oldvm;
+
+	if (!sv.active)
+	{
+		Con_Printf ("Not running a local server.\n");
+		return;
+	}
+
+	radius = Cmd_Argc () > 1 ? Q_atof (Cmd_Argv (1)) : 256.f;
+	repeats = Cmd_Argc () > 2 ? q_max (Q_atoi (Cmd_Argv (2)), 1) : 10;
+
+	PR_PushQCVM (&sv.qcvm, &oldvm);
+
+	linear = (edict_t **) malloc (sizeof (*linear) * qcvm->max_edicts);
+	if (!linear)
+	{
+		PR_PopQCVM (oldvm);
+		Con_Printf ("Out of memory.\n");
+		return;
+	}
 
+	queries = mismatches = total = count = lincount = 0;
+	times[0] = times[1] = 0.0;
 	ent = NEXT_EDICT(qcvm->edicts);
-	for (i = 1; i < qcvm->num_edicts; i++, ent = NEXT_EDICT(ent))
+	for (e = 1; e < qcvm->num_edicts; e++, ent = NEXT_EDICT(ent))
 	{
-		float d, lensq;
-		if (ent->free)
-			continue;
-		if (ent->v.solid == SOLID_NOT)
+		if (ent->free || ent->v.solid == SOLID_NOT)
 			continue;
+		VectorAdd (ent->v.absmin, ent->v.absmax, org);
+		VectorScale (org, 0.5f, org);
+		queries++;
 
-		d = org[0] - (ent->v.origin[0] + (ent->v.mins[0] + ent->v.maxs[0]) * 0.5);
-		lensq = d * d;
-		if (lensq > rad)
-			continue;
-		d = org[1] - (ent->v.origin[1] + (ent->v.mins[1] + ent->v.maxs[1]) * 0.5);
-		lensq += d * d;
-		if (lensq > rad)
-			continue;
-		d = org[2] - (ent->v.origin[2] + (ent->v.mins[2] + ent->v.maxs[2]) * 0.5);
-		lensq += d * d;
-		if (lensq > rad)
-			continue;
+		for (mode = 0; mode < 2; mode++)
+		{
+			start = Sys_DoubleTime ();
+			for (r = 0; r < repeats; r++)
+				count = PF_FindRadiusList (org, radius, mode);
+			times[mode] += Sys_DoubleTime () - start;
+			if (mode == 0)
+			{
+				memcpy (linear, findradius_list, sizeof (*linear) * count);
+				lincount = count;
+				total += count;
+			}
+			else if (count != lincount || memcmp (linear, findradius_list, sizeof (*linear) * count) != 0)
+				mismatches++;
+		}
+	}
 
-		ent->v.chain = EDICT_TO_PROG(chain);
-		chain = ent;
+	free (linear);
+	PR_PopQCVM (oldvm);
+
+	if (!queries)
+	{
+		Con_Printf ("No solid edicts.\n");
+		return;
 	}
 
-	RETURN_EDICT(chain);
+	queries *= repeats;
+	Con_Printf ("%d queries, radius %g, %.1f edicts found per query\n", queries, radius, (double) total * repeats / queries);
+	Con_Printf ("linear: %.3f us/query\n", times[0] * 1e6 / queries);
+	Con_Printf ("grid:   %.3f us/query\n", times[1] * 1e6 / queries);
+	if (mismatches)
+		Con_Printf ("%d queries returned different results\n", mismatches);
 }
 
 /*
@@ -1086,6 +1312,14 @@ static void PF_Find (void)
 	if (!s)
 		PR_RunError ("PF_Find: bad search string");
 
+	if (f > 0 && f < qcvm->progs->entityfields)
+	{
+		e = ED_FindString (e, f, s);
+		ed = EDICT_NUM(e);
+		RETURN_EDICT(ed);
+		return;
+	}
+
 	for (e++ ; e < qcvm->num_edicts ; e++)
 	{
 		ed = EDICT_NUM(e);
@@ -1127,17 +1361,13 @@ static void PF_precache_sound (void)
 	G_INT(OFS_RETURN) = G_INT(OFS_PARM0);
 	PR_CheckEmptyString (s);
 
-	for (i = 0; i < MAX_SOUNDS; i++)
-	{
-		if (!sv.sound_precache[i])
-		{
-			sv.sound_precache[i] = s;
-			return;
-		}
-		if (!strcmp(sv.sound_precache[i], s))
-			return;
-	}
-	PR_RunError ("PF_precache_sound: overflow");
+	if (StrIndex_Find (&sv_soundnames, s) >= 0)
+		return;
+	i = sv_soundnames.count;
+	if (i == MAX_SOUNDS)
+		PR_RunError ("PF_precache_sound: overflow");
+	sv.sound_precache[i] = s;
+	StrIndex_Add (&sv_soundnames, s, i);
 }
 
 static void PF_precache_model (void)
@@ -1152,18 +1382,14 @@ static void PF_precache_model (void)
 	G_INT(OFS_RETURN) = G_INT(OFS_PARM0);
 	PR_CheckEmptyString (s);
 
-	for (i = 0; i < MAX_MODELS; i++)
-	{
-		if (!sv.model_precache[i])
-		{
-			sv.model_precache[i] = s;
-			sv.models[i] = Mod_ForName (s, true);
-			return;
-		}
-		if (!strcmp(sv.model_precache[i], s))
-			return;
-	}
-	PR_RunError ("PF_precache_model: overflow");
+	if (StrIndex_Find (&sv_modelnames, s) >= 0)
+		return;
+	i = sv_modelnames.count;
+	if (i == MAX_MODELS)
+		PR_RunError ("PF_precache_model: overflow");
+	sv.model_precache[i] = s;
+	sv.models[i] = Mod_ForName (s, true);
+	StrIndex_Add (&sv_modelnames, s, i);
 }
 
 
@@ -1777,7 +2003,8 @@ static void PF_checkextension(void)
 	// Note: we expose FTE_QC_CHECKCOMMAND so that AD considers the engine
 	// FTE-like instead of DP-like, in order to avoid a bug in the DP codepath
 	// in older AD versions (e.g. 1.42, used in jam8)
-	if (i == FTE_QC_CHECKCOMMAND)
+	// IW_QC_TRACELINES is our own, so there's nothing to be compatible with
+	if (i == FTE_QC_CHECKCOMMAND || i == IW_QC_TRACELINES)
 	{
 		G_FLOAT(OFS_RETURN) = true;
 		SetBit (qcvm->advertised_ext, i);
@@ -3628,6 +3855,8 @@ builtindef_t pr_builtindefs[] =
 	{"argv",					PF_BOTH(PF_ArgV),				442,	KRIMZON_SV_PARSECLIENTCOMMAND},	// string(float n)
 	{"argc",					PF_BOTH(PF_ArgC)},						// float()
 
+	{"tracelines",				PF_SSQC(PF_tracelines),			0,		IW_QC_TRACELINES},	// float(vector start, vector end, vector step, float count, float nomonsters, entity ignore)
+
 	{"asin",					PF_BOTH(PF_asin),				471,	DP_QC_ASINACOSATANATAN2TAN},	// float(float s)
 	{"acos",					PF_BOTH(PF_acos),				472,	DP_QC_ASINACOSATANATAN2TAN},	// float(float c)
 	{"atan",					PF_BOTH(PF_atan),				473,	DP_QC_ASINACOSATANATAN2TAN},	// float(float t)
@@ -38,6 +38,7 @@ extern const int type_size[NUM_TYPE_SIZES] = {
 
 static ddef_t	*ED_FieldAtOfs (int ofs);
 static qboolean	ED_ParseEpair (void *base, ddef_t *key, const char *s, qboolean zoned);
+static void	ED_ClearFieldIndexes (void);
 
 cvar_t	nomonsters = {"nomonsters", "0", CVAR_NONE};
 cvar_t	gamecfg = {"gamecfg", "0", CVAR_NONE};
@@ -184,6 +185,7 @@ void ED_ClearEdict (edict_t *e)
 	else
 		ED_RemoveFromFreeList (e);
 	memset (&e->v, 0, qcvm->progs->entityfields * 4);
+	ED_StringFieldsChanged ();
 }
 
 /*
@@ -219,6 +221,7 @@ edict_t *ED_Alloc (void)
 		Host_Error ("ED_Alloc: no free edicts (max_edicts is %i)", qcvm->max_edicts);
 
 	e = EDICT_NUM(qcvm->num_edicts++);
+	ED_StringFieldsChanged ();
 	memset(e, 0, qcvm->edict_size); // ericw -- switched sv.edicts to malloc(), so we are accessing uninitialized memory and must fully zero it, not just ED_ClearEdict
 	e->baseline.scale = ENTSCALE_DEFAULT;
 
@@ -1242,6 +1245,7 @@ static qboolean ED_ParseEpair (void *base, ddef_t *key, const char *s, qboolean
 	dfunction_t	*func;
 
 	d = (void *)((int *)base + key->ofs);
+	ED_StringFieldsChanged ();
 
 	switch (key->type & ~DEF_SAVEGLOBAL)
 	{
@@ -1330,6 +1334,7 @@ const char *ED_ParseEdict (const char *data, edict_t *ent)
 	int		n;
 
 	init = false;
+	ED_StringFieldsChanged ();
 
 	// clear it
 	if (ent != qcvm->edicts)	// hack
@@ -1587,9 +1592,15 @@ void PR_ClearProgs(qcvm_t *vm)
 	qcvm = NULL;
 	PR_SwitchQCVM(vm);
 	PR_ShutdownExtensions();
+	PR_ProfileStop(vm);
 
 	if (qcvm->knownstrings)
 		Z_Free ((void *)qcvm->knownstrings);
+	if (qcvm->knownstable)
+		Z_Free (qcvm->knownstable);
+	if (qcvm->knownhash)
+		Z_Free (qcvm->knownhash);
+	ED_ClearFieldIndexes ();
 	free(qcvm->edicts); // ericw -- sv.edicts switched to use malloc()
 	if (qcvm->fielddefs != (ddef_t *)((byte *)qcvm->progs + qcvm->progs->ofs_fielddefs))
 		free(qcvm->fielddefs);
@@ -2118,8 +2129,20 @@ qboolean PR_LoadProgs (const char *filename, qboolean fatal)
 	if (qcvm->knownstrings)
 		Z_Free ((void *)qcvm->knownstrings);
 	qcvm->knownstrings = NULL;
+	if (qcvm->knownstable)
+		Z_Free (qcvm->knownstable);
+	qcvm->knownstable = NULL;
+	if (qcvm->knownhash)
+		Z_Free (qcvm->knownhash);
+	qcvm->knownhash = NULL;
+	qcvm->knownhashsize = 0;
+	qcvm->tempstrings = NULL;
+	qcvm->numtempstrings = 0;
 	qcvm->firstfreeknownstring = NULL;
+	ED_ClearFieldIndexes ();
+	ED_StringFieldsChanged ();
 	PR_SetEngineString("");
+	PR_ReserveTempStrings ();
 
 	qcvm->globaldefs = (ddef_t *)((byte *)qcvm->progs + qcvm->progs->ofs_globaldefs);
 	qcvm->fielddefs = (ddef_t *)((byte *)qcvm->progs + qcvm->progs->ofs_fielddefs);
@@ -2189,6 +2212,7 @@ qboolean PR_LoadProgs (const char *filename, qboolean fatal)
 	PR_FindEntityFields ();
 	PR_FindFunctionRanges ();
 	PR_FillOffsetTables ();
+	PR_TranslateProgram ();
 
 	qcvm->effects_mask = PR_FindSupportedEffects ();
 
@@ -2222,6 +2246,10 @@ void PR_Init (void)
 	Cmd_AddCommand ("edicts", ED_PrintEdicts);
 	Cmd_AddCommand ("edictcount", ED_Count);
 	Cmd_AddCommand ("profile", PR_Profile_f);
+	Cmd_AddCommand ("sv_findradiusbench", PR_FindRadiusBench_f);
+	Cmd_AddCommand ("pr_bench", PR_Bench_f);
+	Cmd_AddCommand ("pr_profile", PR_Profiler_f);
+	Cvar_RegisterVariable (&pr_predecode);
 	Cvar_RegisterVariable (&nomonsters);
 	Cvar_SetCallback (&nomonsters, ED_Nomonsters_f);
 	Cvar_RegisterVariable (&gamecfg);
@@ -2277,6 +2305,89 @@ int SAVE_NUM_FOR_EDICT (savedata_t *save, edict_t *e)
 
 #define	PR_STRING_ALLOCSLOTS	256
 
+static qboolean PR_IsValidString (const char *p);
+
+/*
+=================
+PR_KnownHashHome
+=================
+*/
+static int PR_KnownHashHome (const char *s)
+{
+	uint64_t h = (uintptr_t) s;
+
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdull;
+	h ^= h >> 33;
+	return (int) h & (qcvm->knownhashsize - 1);
+}
+
+/*
+=================
+PR_KnownHashPos
+
+Returns the hash table position of s, or the empty one where it would go
+=================
+*/
+static int PR_KnownHashPos (const char *s)
+{
+	int pos, slot;
+
+	pos = PR_KnownHashHome (s);
+	while ((slot = qcvm->knownhash[pos]) != 0 && qcvm->knownstrings[slot - 1] != s)
+		pos = (pos + 1) & (qcvm->knownhashsize - 1);
+	return pos;
+}
+
+/*
+=================
+PR_KnownHashResize
+
+Rebuilds the pointer to slot hash table after knownstrings has grown
+=================
+*/
+static void PR_KnownHashResize (void)
+{
+	int i;
+
+	if (qcvm->knownhash)
+		Z_Free (qcvm->knownhash);
+	for (qcvm->knownhashsize = 64; qcvm->knownhashsize < qcvm->maxknownstrings * 2; qcvm->knownhashsize <<= 1)
+		;
+	qcvm->knownhash = (int *) Z_Malloc (sizeof (int) * qcvm->knownhashsize);
+	for (i = 0; i < qcvm->numknownstrings; i++)
+		if (PR_IsValidString (qcvm->knownstrings[i]))
+			qcvm->knownhash[PR_KnownHashPos (qcvm->knownstrings[i])] = i + 1;
+}
+
+/*
+=================
+PR_KnownHashRemove
+
+Removes a slot from the hash table, shifting back the entries after it
+so that no probe sequence is broken
+=================
+*/
+static void PR_KnownHashRemove (int i)
+{
+	int pos, next, home, mask;
+
+	mask = qcvm->knownhashsize - 1;
+	pos = PR_KnownHashPos (qcvm->knownstrings[i]);
+	if (qcvm->knownhash[pos] != i + 1)
+		return;
+	for (next = (pos + 1) & mask; qcvm->knownhash[next]; next = (next + 1) & mask)
+	{
+		home = PR_KnownHashHome (qcvm->knownstrings[qcvm->knownhash[next] - 1]);
+		if (((next - home) & mask) >= ((next - pos) & mask))
+		{
+			qcvm->knownhash[pos] = qcvm->knownhash[next];
+			pos = next;
+		}
+	}
+	qcvm->knownhash[pos] = 0;
+}
+
 static int PR_AllocStringSlot (void)
 {
 	ptrdiff_t i;
@@ -2296,6 +2407,8 @@ static int PR_AllocStringSlot (void)
 			qcvm->maxknownstrings += PR_STRING_ALLOCSLOTS;
 			Con_DPrintf2 ("PR_AllocStringSlot: realloc'ing for %d slots\n", qcvm->maxknownstrings);
 			qcvm->knownstrings = (const char **) Z_Realloc ((void *)qcvm->knownstrings, qcvm->maxknownstrings * sizeof(char *));
+			qcvm->knownstable = (unsigned char *) Z_Realloc (qcvm->knownstable, (qcvm->maxknownstrings + 7) >> 3);
+			PR_KnownHashResize ();
 		}
 	}
 
@@ -2337,6 +2450,8 @@ void PR_ClearEngineString (int num)
 	if (num < 0 && num >= -qcvm->numknownstrings)
 	{
 		num = -1 - num;
+		PR_KnownHashRemove (num);
+		qcvm->knownstable[num >> 3] &= ~(1 << (num & 7));
 		qcvm->knownstrings[num] = (const char*) qcvm->firstfreeknownstring;
 		qcvm->firstfreeknownstring = &qcvm->knownstrings[num];
 	}
@@ -2344,7 +2459,8 @@ void PR_ClearEngineString (int num)
 
 int PR_SetEngineString (const char *s)
 {
-	int		i;
+	int			i;
+	uintptr_t	d;
 
 	if (!s)
 		return 0;
@@ -2355,15 +2471,21 @@ int PR_SetEngineString (const char *s)
 	if (s >= qcvm->strings && s <= qcvm->strings + qcvm->stringssize - 2)
 		return (int)(s - qcvm->strings);
 #endif
-	for (i = 0; i < qcvm->numknownstrings; i++)
+	d = (uintptr_t) s - (uintptr_t) qcvm->tempstrings;
+	if (d < (uintptr_t) qcvm->numtempstrings * qcvm->tempstringsize && d % qcvm->tempstringsize == 0)
+		return -1 - (qcvm->tempstringslot + (int) (d / qcvm->tempstringsize));
+	if (qcvm->knownhash)
 	{
-		if (qcvm->knownstrings[i] == s)
-			return -1 - i;
+		i = qcvm->knownhash[PR_KnownHashPos (s)];
+		if (i)
+			return -i;
 	}
 	// new unknown engine string
 	//Con_DPrintf ("PR_SetEngineString: new engine string %p\n", s);
 	i = PR_AllocStringSlot ();
 	qcvm->knownstrings[i] = s;
+	qcvm->knownhash[PR_KnownHashPos (s)] = i + 1;
+	qcvm->knownstable[i >> 3] &= ~(1 << (i & 7));
 	return -1 - i;
 }
 
@@ -2375,11 +2497,279 @@ int PR_AllocString (int size, char **ptr)
 		return 0;
 	i = PR_AllocStringSlot ();
 	qcvm->knownstrings[i] = (char *)Hunk_AllocName(size, "string");
+	qcvm->knownhash[PR_KnownHashPos (qcvm->knownstrings[i])] = i + 1;
+	qcvm->knownstable[i >> 3] |= 1 << (i & 7);
 	if (ptr)
 		*ptr = (char *) qcvm->knownstrings[i];
 	return -1 - i;
 }
 
+/*
+===============================================================================
+
+FIELD INDEXES
+
+find () on the same string field is often called in a loop to walk all the
+edicts with a given classname or targetname, which is quadratic with a linear
+scan. Once a field has been searched FIELD_INDEX_MIN_FINDS times without any
+string field being written in between, and there are enough edicts for the
+scans to matter, the edicts are grouped by the hash of their value, in edict
+order, so the next finds only have to look at the edicts with a matching hash.
+
+Only strings from the progs or allocated with PR_AllocString are hashed, since
+their contents never change; edicts with any other string are kept in a
+separate list that is always checked. Any store to a string field, edict
+allocation or load drops all indexes (see ED_StringFieldsChanged).
+
+===============================================================================
+*/
+
+/*
+=============
+ED_IsStableString
+
+Returns true if num is a valid string whose contents can't change
+=============
+*/
+static qboolean ED_IsStableString (int num)
+{
+	int i;
+
+	if (num >= 0)
+		return num < qcvm->stringssize;
+	i = -1 - num;
+	if (i >= qcvm->numknownstrings || !PR_IsValidString (qcvm->knownstrings[i]))
+		return false;
+	return (qcvm->knownstable[i >> 3] & (1 << (i & 7))) != 0;
+}
+
+/*
+=============
+ED_BuildFieldIndex
+=============
+*/
+static void ED_BuildFieldIndex (fieldindex_t *index, int field)
+{
+	int			e, i, n, num, hashsize;
+	int			*start;
+	edict_t		*ed;
+
+	n = qcvm->num_edicts;
+	for (hashsize = 64; hashsize < n; hashsize <<= 1)
+		;
+
+	if (n > index->capacity)
+	{
+		index->capacity = qcvm->max_edicts;
+		index->edicts = (int *) realloc (index->edicts, sizeof (int) * index->capacity);
+		index->hashes = (int *) realloc (index->hashes, sizeof (int) * index->capacity);
+		index->volatiles = (int *) realloc (index->volatiles, sizeof (int) * index->capacity);
+	}
+	if (hashsize + 2 > index->bucketcapacity)
+	{
+		index->bucketcapacity = hashsize + 2;
+		index->bucketstart = (int *) realloc (index->bucketstart, sizeof (int) * index->bucketcapacity);
+	}
+	if (!index->edicts || !index->hashes || !index->volatiles || !index->bucketstart)
+		Sys_Error ("ED_BuildFieldIndex: out of memory");
+
+	index->field = field;
+	index->hashmask = hashsize - 1;
+	index->numvolatiles = 0;
+
+	// count the edicts in each bucket, shifted by one so the
+	// prefix sums below end up as the insertion cursors
+	start = index->bucketstart;
+	memset (start, 0, sizeof (int) * (hashsize + 2));
+	for (e = 1, ed = EDICT_NUM (1); e < n; e++, ed = NEXT_EDICT (ed))
+	{
+		index->hashes[e] = -1;
+		if (ed->free)
+			continue;
+		num = *(string_t *) &((float *) &ed->v)[field];
+		if (!ED_IsStableString (num))
+		{
+			index->volatiles[index->numvolatiles++] = e;
+			continue;
+		}
+		index->hashes[e] = COM_HashString (PR_GetString (num)) & index->hashmask;
+		start[index->hashes[e] + 2]++;
+	}
+	for (i = 2; i < hashsize + 2; i++)
+		start[i] += start[i - 1];
+
+	// fill in edict order, which leaves start[b]..start[b+1] as the range of bucket b
+	for (e = 1; e < n; e++)
+		if (index->hashes[e] >= 0)
+			index->edicts[start[index->hashes[e] + 1]++] = e;
+
+	index->writes = qcvm->stringfieldwrites;
+	index->valid = true;
+	qcvm->fieldindexwrites = qcvm->stringfieldwrites;
+}
+
+/*
+=============
+ED_FirstAfter
+
+Returns the position of the first entry greater than start in a sorted list
+=============
+*/
+static int ED_FirstAfter (const int *list, int lo, int hi, int start)
+{
+	while (lo < hi)
+	{
+		int mid = (lo + hi) >> 1;
+		if (list[mid] <= start)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/*
+=============
+ED_GetFieldIndex
+
+Returns an up to date index for field, or NULL if a linear scan should be used
+=============
+*/
+static fieldindex_t *ED_GetFieldIndex (int field)
+{
+	int				i;
+	fieldindex_t	*index, *oldest;
+
+	oldest = &qcvm->fieldindexes[0];
+	for (i = 0; i < MAX_FIELD_INDEXES; i++)
+	{
+		index = &qcvm->fieldindexes[i];
+		if (index->field == field)
+			break;
+		if (index->lastused < oldest->lastused)
+			oldest = index;
+	}
+	if (i == MAX_FIELD_INDEXES)
+	{
+		index = oldest;
+		index->field = field;
+		index->valid = false;
+		index->lastquery = qcvm->stringfieldwrites - 1;
+		index->numqueries = 0;
+	}
+	index->lastused = ++qcvm->fieldindexcounter;
+
+	if (index->valid && index->writes == qcvm->stringfieldwrites)
+		return index;
+	index->valid = false;
+
+	// building costs about as much as a scan, so only do it for fields that keep
+	// being searched without any string field changing, and only on big levels
+	if (index->lastquery != qcvm->stringfieldwrites)
+	{
+		index->lastquery = qcvm->stringfieldwrites;
+		index->numqueries = 0;
+	}
+	if (++index->numqueries < FIELD_INDEX_MIN_FINDS || qcvm->num_edicts < FIELD_INDEX_MIN_EDICTS)
+		return NULL;
+
+	ED_BuildFieldIndex (index, field);
+	return index;
+}
+
+/*
+=============
+ED_FindString
+
+Returns the number of the first edict after start whose string field matches s, or 0
+=============
+*/
+int ED_FindString (int start, int field, const char *s)
+{
+	int				e, i, iend, v, vend;
+	const char		*t;
+	edict_t			*ed;
+	fieldindex_t	*index;
+
+	index = ED_GetFieldIndex (field);
+	if (!index)
+	{
+		for (e = start + 1; e < qcvm->num_edicts; e++)
+		{
+			ed = EDICT_NUM (e);
+			if (ed->free)
+				continue;
+			t = E_STRING (ed, field);
+			if (t && !strcmp (t, s))
+				return e;
+		}
+		return 0;
+	}
+
+	// merge the matching bucket with the volatile list, in edict order
+	i = index->bucketstart[COM_HashString (s) & index->hashmask];
+	iend = index->bucketstart[(COM_HashString (s) & index->hashmask) + 1];
+	i = ED_FirstAfter (index->edicts, i, iend, start);
+	vend = index->numvolatiles;
+	v = ED_FirstAfter (index->volatiles, 0, vend, start);
+	while (i < iend || v < vend)
+	{
+		if (v == vend || (i < iend && index->edicts[i] < index->volatiles[v]))
+			e = index->edicts[i++];
+		else
+			e = index->volatiles[v++];
+		ed = EDICT_NUM (e);
+		if (ed->free)
+			continue;
+		t = E_STRING (ed, field);
+		if (t && !strcmp (t, s))
+			return e;
+	}
+	return 0;
+}
+
+/*
+=============
+ED_CheckIndexedFieldStore
+
+Called after a non-string store through a pointer, which may still have been a string
+=============
+*/
+void ED_CheckIndexedFieldStore (int field)
+{
+	int i;
+
+	for (i = 0; i < MAX_FIELD_INDEXES; i++)
+	{
+		if (qcvm->fieldindexes[i].valid && qcvm->fieldindexes[i].field == field)
+		{
+			ED_StringFieldsChanged ();
+			return;
+		}
+	}
+}
+
+/*
+=============
+ED_ClearFieldIndexes
+=============
+*/
+static void ED_ClearFieldIndexes (void)
+{
+	int				i;
+	fieldindex_t	*index;
+
+	for (i = 0; i < MAX_FIELD_INDEXES; i++)
+	{
+		index = &qcvm->fieldindexes[i];
+		free (index->bucketstart);
+		free (index->edicts);
+		free (index->hashes);
+		free (index->volatiles);
+		memset (index, 0, sizeof (*index));
+	}
+}
+
 //===========================================================================
 
 void SaveData_Init (savedata_t *save)
@@ -2503,3 +2893,625 @@ void SaveData_WriteHeader (savedata_t *save)
 
 	ED_WriteGlobals (save);
 }
+
+/*
+==============================================================================
+
+BINARY SAVEGAMES
+
+Same contents as the text format, but field values are stored as raw words:
+engine strings go through an interned string table, entity references are
+stored as edict numbers and runs of zero words are skipped. The first two
+lines are still text, so the menus can read the comment. Raw words are only
+meaningful for the progs that wrote them, so the progs checksum and layout
+are stored as well and checked on load.
+
+==============================================================================
+*/
+
+#define SAVEBIN_MAGIC		(('I'<<0)|('W'<<8)|('S'<<16)|('B'<<24))
+
+typedef struct
+{
+	const char	**strings;
+	int			numstrings;
+	int			*remap;			// known string index -> table index + 1
+	int			*hash;			// table index + 1, 0 = empty slot
+	int			hashmask;
+} savestrings_t;
+
+/*
+============
+SaveBin_WriteInt
+============
+*/
+static void SaveBin_WriteInt (FILE *f, int v)
+{
+	v = LittleLong (v);
+	fwrite (&v, 4, 1, f);
+}
+
+/*
+============
+SaveBin_WriteVarint
+============
+*/
+static void SaveBin_WriteVarint (FILE *f, unsigned int v)
+{
+	do
+	{
+		int b = v & 127;
+		v >>= 7;
+		putc (v ? b | 128 : b, f);
+	} while (v);
+}
+
+/*
+============
+SaveBin_WriteString
+============
+*/
+static void SaveBin_WriteString (FILE *f, const char *s)
+{
+	size_t len = strlen (s);
+	SaveBin_WriteVarint (f, (unsigned int) len);
+	fwrite (s, 1, len + 1, f);
+}
+
+/*
+============
+SaveBin_WriteWords
+
+Writes count words as alternating runs of zero and non-zero words
+============
+*/
+static void SaveBin_WriteWords (FILE *f, const int *words, int count)
+{
+	int i = 0, start, zeros;
+
+	while (i < count)
+	{
+		for (start = i; i < count && !words[i]; i++)
+			;
+		zeros = i - start;
+		for (start = i; i < count && words[i]; i++)
+			;
+		SaveBin_WriteVarint (f, zeros);
+		SaveBin_WriteVarint (f, i - start);
+		for (; start < i; start++)
+			SaveBin_WriteInt (f, words[start]);
+	}
+}
+
+/*
+============
+SaveBin_WordTypes
+
+Returns the type of each word in a field or global block, with ev_void for
+the words that the text format doesn't save either
+============
+*/
+static byte *SaveBin_WordTypes (ddef_t *defs, int numdefs, int numwords, qboolean globals)
+{
+	byte	*types;
+	int		i, j, type;
+
+	types = (byte *) calloc (numwords ? numwords : 1, 1);
+	if (!types)
+		Sys_Error ("SaveBin_WordTypes: out of memory");
+
+	for (i = globals ? 0 : 1; i < numdefs; i++)
+	{
+		if (!(defs[i].type & DEF_SAVEGLOBAL))
+			continue;
+		type = defs[i].type & ~DEF_SAVEGLOBAL;
+		if (globals && type != ev_string && type != ev_float && type != ev_entity)
+			continue;
+		if (type != ev_string && type != ev_float && type != ev_vector &&
+			type != ev_entity && type != ev_field && type != ev_function)
+			continue;
+		for (j = 0; j < type_size[type] && defs[i].ofs + j < numwords; j++)
+			types[defs[i].ofs + j] = type == ev_vector ? ev_float : type;
+	}
+
+	return types;
+}
+
+/*
+============
+SaveBin_InternString
+
+Returns the string table index for a known string, adding it if needed
+============
+*/
+static int SaveBin_InternString (savedata_t *save, savestrings_t *tab, int num)
+{
+	const char		*str;
+	unsigned int	h;
+	int				i, slot;
+
+	i = -1 - num;
+	if (tab->remap[i])
+		return tab->remap[i] - 1;
+
+	str = PR_GetSaveString (save, num);
+	h = COM_HashString (str);
+	for (slot = h & tab->hashmask; tab->hash[slot]; slot = (slot + 1) & tab->hashmask)
+	{
+		if (!strcmp (tab->strings[tab->hash[slot] - 1], str))
+			return (tab->remap[i] = tab->hash[slot]) - 1;
+	}
+
+	tab->strings[tab->numstrings++] = str;
+	tab->hash[slot] = tab->numstrings;
+	tab->remap[i] = tab->numstrings;
+	return tab->numstrings - 1;
+}
+
+/*
+============
+SaveBin_EncodeWords
+
+Converts a saved field or global block to its on-disk form.
+Returns true if any word is non-zero.
+============
+*/
+static qboolean SaveBin_EncodeWords (savedata_t *save, savestrings_t *tab, const byte *types, const int *src, int *dst, int count)
+{
+	qboolean	any = false;
+	int			i, v;
+
+	for (i = 0; i < count; i++)
+	{
+		v = src[i];
+		if (!v || types[i] == ev_void)
+		{
+			dst[i] = 0;
+			continue;
+		}
+
+		switch (types[i])
+		{
+		case ev_string:
+			if (v < 0)
+			{
+				if (v < -save->numknownstrings)
+				{
+					SDL_AtomicCAS (&save->abort, 0, -1);
+					v = 0;
+				}
+				else
+					v = -1 - SaveBin_InternString (save, tab, v);
+			}
+			else if (v >= qcvm->stringssize)
+			{
+				SDL_AtomicCAS (&save->abort, 0, -1);
+				v = 0;
+			}
+			break;
+		case ev_entity:
+			v = SAVE_NUM_FOR_EDICT (save, SAVE_PROG_TO_EDICT (save, v));
+			break;
+		default:
+			break;
+		}
+
+		dst[i] = v;
+		any |= v != 0;
+	}
+
+	return any;
+}
+
+/*
+============
+SaveData_WriteBinary
+
+Writes the whole savegame. Returns false if the save was aborted.
+============
+*/
+qboolean SaveData_WriteBinary (savedata_t *save)
+{
+	FILE			*f = save->file;
+	savestrings_t	tab;
+	byte			*fieldtypes, *globaltypes;
+	int				*words;
+	int				numfields, numglobals, hashsize, i;
+	edict_t			*ed;
+	uint64_t		time;
+	qboolean		ok = true;
+
+	numfields = qcvm->progs->entityfields;
+	numglobals = qcvm->progs->numglobals;
+	fieldtypes = SaveBin_WordTypes (qcvm->fielddefs, qcvm->progs->numfielddefs, numfields, false);
+	globaltypes = SaveBin_WordTypes (qcvm->globaldefs, qcvm->progs->numglobaldefs, numglobals, true);
+
+	for (hashsize = 64; hashsize < save->numknownstrings * 2; hashsize <<= 1)
+		;
+	memset (&tab, 0, sizeof (tab));
+	tab.strings = (const char **) malloc (sizeof (*tab.strings) * (save->numknownstrings + 1));
+	tab.remap = (int *) calloc (save->numknownstrings + 1, sizeof (*tab.remap));
+	tab.hash = (int *) calloc (hashsize, sizeof (*tab.hash));
+	tab.hashmask = hashsize - 1;
+	words = (int *) malloc (sizeof (*words) * (q_max (numfields, numglobals) + 1));
+	if (!tab.strings || !tab.remap || !tab.hash || !words)
+		Sys_Error ("SaveData_WriteBinary: out of memory");
+
+	// first pass fills the string table, which has to come before the values
+	SaveBin_EncodeWords (save, &tab, globaltypes, (int *) save->globals, words, numglobals);
+	for (i = 0, ed = save->edicts; i < save->num_edicts; i++, ed = NEXT_EDICT (ed))
+		if (!ed->free)
+			SaveBin_EncodeWords (save, &tab, fieldtypes, (int *) &ed->v, words, numfields);
+
+	fprintf (f, "%i\n", SAVEGAME_VERSION_BINARY);
+	fprintf (f, "%s\n", save->comment);
+
+	SaveBin_WriteInt (f, SAVEBIN_MAGIC);
+	for (i = 0; i < NUM_SPAWN_PARMS; i++)
+	{
+		int v;
+		memcpy (&v, &save->spawn_parms[i], sizeof (v));
+		SaveBin_WriteInt (f, v);
+	}
+	SaveBin_WriteInt (f, save->skill);
+	SaveBin_WriteString (f, save->mapname);
+	memcpy (&time, &save->time, sizeof (time));
+	SaveBin_WriteInt (f, (int) (time & 0xffffffffu));
+	SaveBin_WriteInt (f, (int) (time >> 32));
+	for (i = 0; i < MAX_LIGHTSTYLES; i++)
+		SaveBin_WriteString (f, save->lightstyles[i]);
+
+	SaveBin_WriteInt (f, qcvm->crc);
+	SaveBin_WriteInt (f, numfields);
+	SaveBin_WriteInt (f, numglobals);
+	SaveBin_WriteInt (f, qcvm->progs->numfielddefs);
+	SaveBin_WriteInt (f, qcvm->progs->numglobaldefs);
+
+	SaveBin_WriteVarint (f, tab.numstrings);
+	for (i = 0; i < tab.numstrings; i++)
+		SaveBin_WriteString (f, tab.strings[i]);
+
+	SaveBin_EncodeWords (save, &tab, globaltypes, (int *) save->globals, words, numglobals);
+	SaveBin_WriteWords (f, words, numglobals);
+
+	SaveBin_WriteVarint (f, save->num_edicts);
+	for (i = 0, ed = save->edicts; i < save->num_edicts; i++, ed = NEXT_EDICT (ed))
+	{
+		qboolean	used, alpha;
+
+		if (SDL_AtomicGet (&save->abort))
+		{
+			ok = false;
+			break;
+		}
+
+		used = !ed->free && SaveBin_EncodeWords (save, &tab, fieldtypes, (int *) &ed->v, words, numfields);
+		//johnfitz -- save entity alpha manually when progs.dat doesn't know about alpha
+		alpha = !ed->free && qcvm->extfields.alpha < 0 && ed->alpha != ENTALPHA_DEFAULT;
+
+		if (!used && !alpha)
+		{
+			putc (0, f);	// loaded as a free edict, same as an empty text block
+			continue;
+		}
+
+		putc (alpha ? 3 : 1, f);
+		if (alpha)
+			putc (ed->alpha, f);
+		SaveBin_WriteWords (f, words, numfields);
+	}
+
+	free (words);
+	free (tab.hash);
+	free (tab.remap);
+	free (tab.strings);
+	free (globaltypes);
+	free (fieldtypes);
+
+	return ok;
+}
+
+/*
+============
+SaveBin_ReadInt
+============
+*/
+static int SaveBin_ReadInt (savereader_t *r)
+{
+	int v;
+	if (r->end - r->data < 4)
+	{
+		r->error = true;
+		return 0;
+	}
+	memcpy (&v, r->data, 4);
+	r->data += 4;
+	return LittleLong (v);
+}
+
+/*
+============
+SaveBin_ReadVarint
+============
+*/
+static unsigned int SaveBin_ReadVarint (savereader_t *r)
+{
+	unsigned int	v = 0;
+	int				shift, b;
+
+	for (shift = 0; shift < 32; shift += 7)
+	{
+		if (r->data >= r->end)
+			break;
+		b = *r->data++;
+		v |= (unsigned int) (b & 127) << shift;
+		if (!(b & 128))
+			return v;
+	}
+
+	r->error = true;
+	return 0;
+}
+
+/*
+============
+SaveBin_ReadByte
+============
+*/
+static int SaveBin_ReadByte (savereader_t *r)
+{
+	if (r->data >= r->end)
+	{
+		r->error = true;
+		return 0;
+	}
+	return *r->data++;
+}
+
+/*
+============
+SaveBin_ReadString
+
+Returns a pointer into the file data
+============
+*/
+static const char *SaveBin_ReadString (savereader_t *r, int *outlen)
+{
+	const char		*s;
+	unsigned int	len = SaveBin_ReadVarint (r);
+
+	if (r->error || len >= (unsigned int) (r->end - r->data) || r->data[len])
+	{
+		r->error = true;
+		return "";
+	}
+	s = (const char *) r->data;
+	r->data += len + 1;
+	if (outlen)
+		*outlen = (int) len;
+	return s;
+}
+
+/*
+============
+SaveBin_ReadWords
+
+Reads a block written by SaveBin_WriteWords into dst. Zero runs only
+clear the saved words if clearzeros is set.
+============
+*/
+static void SaveBin_ReadWords (savereader_t *r, int *dst, const byte *types, int count,
+	const string_t *strings, int numstrings, qboolean clearzeros)
+{
+	unsigned int	zeros, literals;
+	int				pos = 0, v;
+
+	while (pos < count && !r->error)
+	{
+		zeros = SaveBin_ReadVarint (r);
+		literals = SaveBin_ReadVarint (r);
+		if (zeros > (unsigned int) (count - pos) || literals > (unsigned int) (count - pos) - zeros || zeros + literals == 0)
+		{
+			r->error = true;
+			return;
+		}
+
+		if (clearzeros)
+		{
+			for (; zeros; zeros--, pos++)
+				if (types[pos] != ev_void)
+					dst[pos] = 0;
+		}
+		else
+			pos += zeros;
+
+		for (; literals; literals--, pos++)
+		{
+			v = SaveBin_ReadInt (r);
+			switch (types[pos])
+			{
+			case ev_void:
+				r->error = true;
+				return;
+			case ev_string:
+				if (v < -numstrings || v >= qcvm->stringssize)
+				{
+					r->error = true;
+					return;
+				}
+				if (v < 0)
+					v = strings[-1 - v];
+				break;
+			case ev_entity:
+				if (v < 0 || v >= qcvm->max_edicts)
+				{
+					r->error = true;
+					return;
+				}
+				v = EDICT_TO_PROG (EDICT_NUM (v));
+				break;
+			default:
+				break;
+			}
+			dst[pos] = v;
+		}
+	}
+}
+
+/*
+============
+SaveData_ReadBinaryHeader
+
+Reads everything up to and including the lightstyles, which point into the file data
+============
+*/
+qboolean SaveData_ReadBinaryHeader (savedata_t *save, savereader_t *r)
+{
+	const byte	*eol;
+	uint64_t	lo, hi, time;
+	int			i, len;
+
+	memset (save, 0, sizeof (*save));
+
+	// version and comment lines
+	for (i = 0; i < 2; i++)
+	{
+		eol = (const byte *) memchr (r->data, '\n', r->end - r->data);
+		if (!eol)
+			return false;
+		if (i == 1)
+		{
+			len = q_min ((int) (eol - r->data), SAVEGAME_COMMENT_LENGTH);
+			memcpy (save->comment, r->data, len);
+			save->comment[len] = '\0';
+		}
+		r->data = eol + 1;
+	}
+
+	if (SaveBin_ReadInt (r) != SAVEBIN_MAGIC)
+		return false;
+	for (i = 0; i < NUM_SPAWN_PARMS; i++)
+	{
+		int v = SaveBin_ReadInt (r);
+		memcpy (&save->spawn_parms[i], &v, sizeof (v));
+	}
+	save->skill = SaveBin_ReadInt (r);
+	q_strlcpy (save->mapname, SaveBin_ReadString (r, NULL), sizeof (save->mapname));
+	lo = (uint32_t) SaveBin_ReadInt (r);
+	hi = (uint32_t) SaveBin_ReadInt (r);
+	time = lo | (hi << 32);
+	memcpy (&save->time, &time, sizeof (time));
+	for (i = 0; i < MAX_LIGHTSTYLES; i++)
+		save->lightstyles[i] = SaveBin_ReadString (r, NULL);
+
+	return !r->error;
+}
+
+// tables used by SaveData_ReadBinary, kept here so that a Host_Error can free them
+static string_t	*savebin_strings;
+static byte		*savebin_fieldtypes;
+static byte		*savebin_globaltypes;
+
+/*
+============
+SaveData_FreeBinaryTables
+============
+*/
+void SaveData_FreeBinaryTables (void)
+{
+	free (savebin_strings);
+	free (savebin_fieldtypes);
+	free (savebin_globaltypes);
+	savebin_strings = NULL;
+	savebin_fieldtypes = NULL;
+	savebin_globaltypes = NULL;
+}
+
+/*
+============
+SaveData_ReadBinary
+
+Restores the globals and edicts into the current (freshly spawned) server.
+Returns the number of edicts.
+============
+*/
+int SaveData_ReadBinary (savereader_t *r)
+{
+	byte		*fieldtypes, *globaltypes;
+	string_t	*strings;
+	int			numfields, numglobals, numstrings, num_edicts, i, len, flags;
+	const char	*str;
+	char		*dst;
+	edict_t		*ent;
+
+	numfields = qcvm->progs->entityfields;
+	numglobals = qcvm->progs->numglobals;
+
+	if (SaveBin_ReadInt (r) != qcvm->crc ||
+		SaveBin_ReadInt (r) != numfields ||
+		SaveBin_ReadInt (r) != numglobals ||
+		SaveBin_ReadInt (r) != qcvm->progs->numfielddefs ||
+		SaveBin_ReadInt (r) != qcvm->progs->numglobaldefs)
+		Host_Error ("Binary savegame was written with a different progs.dat");
+
+	numstrings = SaveBin_ReadVarint (r);
+	if (r->error || numstrings > r->end - r->data)
+		Host_Error ("SaveData_ReadBinary: bad string table");
+	SaveData_FreeBinaryTables ();
+	strings = savebin_strings = (string_t *) malloc (sizeof (*strings) * (numstrings + 1));
+	if (!strings)
+		Sys_Error ("SaveData_ReadBinary: out of memory");
+	for (i = 0; i < numstrings; i++)
+	{
+		str = SaveBin_ReadString (r, &len);
+		strings[i] = PR_AllocString (len + 1, &dst);
+		memcpy (dst, str, len + 1);
+	}
+
+	fieldtypes = savebin_fieldtypes = SaveBin_WordTypes (qcvm->fielddefs, qcvm->progs->numfielddefs, numfields, false);
+	globaltypes = savebin_globaltypes = SaveBin_WordTypes (qcvm->globaldefs, qcvm->progs->numglobaldefs, numglobals, true);
+
+	SaveBin_ReadWords (r, (int *) qcvm->globals, globaltypes, numglobals, strings, numstrings, true);
+
+	num_edicts = SaveBin_ReadVarint (r);
+	if (num_edicts > qcvm->max_edicts)
+		r->error = true;
+	ED_StringFieldsChanged ();
+
+	for (i = 0; i < num_edicts && !r->error; i++)
+	{
+		ent = EDICT_NUM (i);
+		if (i < qcvm->num_edicts)
+			ED_ClearEdict (ent);
+		else
+		{
+			memset (ent, 0, qcvm->edict_size);
+			ent->baseline.scale = ENTSCALE_DEFAULT;
+		}
+
+		// clear it
+		if (ent != qcvm->edicts)	// hack
+			memset (&ent->v, 0, numfields * 4);
+
+		flags = SaveBin_ReadByte (r);
+		if (!flags)
+		{
+			ED_Free (ent);
+			continue;
+		}
+		if (flags & 2)
+			ent->alpha = SaveBin_ReadByte (r);
+		SaveBin_ReadWords (r, (int *) &ent->v, fieldtypes, numfields, strings, numstrings, false);
+
+		// link it into the bsp tree
+		if (!ent->free)
+			SV_LinkEdict (ent, false);
+	}
+
+	SaveData_FreeBinaryTables ();
+
+	if (r->error)
+		Host_Error ("SaveData_ReadBinary: savegame is corrupt");
+
+	return num_edicts;
+}
@@ -319,6 +319,8 @@ static int PR_EnterFunction (dfunction_t *f)
 	}
 
 	qcvm->xfunction = f;
+	if (qcvm->profiler)
+		PR_ProfileEnter (f);
 	return f->first_statement - 1;	// offset the s++
 }
 
@@ -334,6 +336,9 @@ static int PR_LeaveFunction (void)
 	if (qcvm->depth <= 0)
 		Host_Error("prog stack underflow");
 
+	if (qcvm->profiler)
+		PR_ProfileLeave ();
+
 	// Restore locals from the stack
 	c = qcvm->xfunction->locals;
 	qcvm->localstack_used -= c;
@@ -383,39 +388,25 @@ static void PR_CheckBuiltinExtension (dfunction_t *func)
 
 /*
 ====================
-PR_ExecuteProgram
+PR_ExecuteStatements
 
-The interpretation main loop
+The plain interpretation loop, used for tracing and when pr_predecode is 0.
+Starts at the statement after s and runs until the stack is back to exitdepth
 ====================
 */
 #define OPA ((eval_t *)&qcvm->globals[(unsigned short)st->a])
 #define OPB ((eval_t *)&qcvm->globals[(unsigned short)st->b])
 #define OPC ((eval_t *)&qcvm->globals[(unsigned short)st->c])
 
-void PR_ExecuteProgram (func_t fnum)
+static void PR_ExecuteStatements (int s, int exitdepth)
 {
 	eval_t		*ptr;
 	dstatement_t	*st;
-	dfunction_t	*f, *newf;
+	dfunction_t	*newf;
 	int profile, startprofile;
 	edict_t		*ed;
-	int		exitdepth;
-
-	if (!fnum || fnum >= qcvm->progs->numfunctions)
-	{
-		if (pr_global_struct->self)
-			ED_Print (PROG_TO_EDICT(pr_global_struct->self));
-		Host_Error ("PR_ExecuteProgram: NULL function");
-	}
-
-	f = &qcvm->functions[fnum];
-
-	qcvm->trace = false;
 
-// make a stack frame
-	exitdepth = qcvm->depth;
-
-	st = &qcvm->statements[PR_EnterFunction(f)];
+	st = &qcvm->statements[s];
 	startprofile = profile = 0;
 
     while (1)
@@ -569,10 +560,15 @@ void PR_ExecuteProgram (func_t fnum)
 	case OP_STOREP_F:
 	case OP_STOREP_ENT:
 	case OP_STOREP_FLD:	// integers
-	case OP_STOREP_S:
 	case OP_STOREP_FNC:	// pointers
 		ptr = (eval_t *)((byte *)qcvm->edicts + OPB->_int);
 		ptr->_int = OPA->_int;
+		ED_PointerStored (OPB->_int);
+		break;
+	case OP_STOREP_S:
+		ptr = (eval_t *)((byte *)qcvm->edicts + OPB->_int);
+		ptr->_int = OPA->_int;
+		ED_StringFieldsChanged ();
 		break;
 	case OP_STOREP_V:
 		ptr = (eval_t *)((byte *)qcvm->edicts + OPB->_int);
@@ -653,7 +649,10 @@ void PR_ExecuteProgram (func_t fnum)
 			if (i >= qcvm->numbuiltins)
 				PR_RunError("Bad builtin call number %d", i);
 			PR_CheckBuiltinExtension (newf);
-			qcvm->builtins[i]();
+			if (qcvm->profiler)
+				PR_ProfileBuiltin (newf, i);
+			else
+				qcvm->builtins[i]();
 			break;
 		}
 		// Normal function
@@ -692,3 +691,734 @@ void PR_ExecuteProgram (func_t fnum)
 #undef OPA
 #undef OPB
 #undef OPC
+
+/*
+===============================================================================
+
+PRE-DECODED EXECUTION
+
+PR_TranslateProgram turns the statements into a parallel array of prinstr_t
+with the global operands resolved to pointers. Statement numbers are the same
+in both, so function entry points, xstatement and stack traces don't change.
+An OP_ADDRESS followed by a store through its result is fused into a single
+instruction; the store keeps its own entry, so a jump straight to it still
+works.
+
+The runaway counter and the per-function statement counts are only updated on
+branches, calls and returns, and tracing drops back to the plain loop.
+
+===============================================================================
+*/
+
+enum
+{
+	OPX_ADDRESS_STOREP = OP_BITOR + 1,	// OP_ADDRESS + OP_STOREP_F/ENT/FLD/FNC
+	OPX_ADDRESS_STOREP_S,				// OP_ADDRESS + OP_STOREP_S
+	OPX_ADDRESS_STOREP_V,				// OP_ADDRESS + OP_STOREP_V
+	OPX_BAD,
+	OPX_COUNT
+};
+
+#if defined(__GNUC__) && !defined(PR_NO_COMPUTED_GOTO)
+#define PR_COMPUTED_GOTO
+#endif
+
+cvar_t	pr_predecode = {"pr_predecode", "1", CVAR_NONE};
+
+/*
+====================
+PR_TranslateProgram
+====================
+*/
+void PR_TranslateProgram (void)
+{
+	int				i, n;
+	dstatement_t	*st;
+	prinstr_t		*in;
+
+	n = qcvm->progs->numstatements;
+	qcvm->code = (prinstr_t *) Hunk_AllocName (sizeof (prinstr_t) * n, "qccode");
+
+	for (i = 0, st = qcvm->statements, in = qcvm->code; i < n; i++, st++, in++)
+	{
+		in->op = st->op;
+		in->a = (eval_t *)&qcvm->globals[(unsigned short)st->a];
+		in->b = (eval_t *)&qcvm->globals[(unsigned short)st->b];
+		in->c = (eval_t *)&qcvm->globals[(unsigned short)st->c];
+
+		switch (st->op)
+		{
+		case OP_IF:
+		case OP_IFNOT:
+			in->jump = st->b;
+			break;
+
+		case OP_GOTO:
+			in->jump = st->a;
+			break;
+
+		case OP_ADDRESS:
+			if (i + 1 == n || st[1].b != st->c)
+				break;
+			switch (st[1].op)
+			{
+			case OP_STOREP_F:
+			case OP_STOREP_ENT:
+			case OP_STOREP_FLD:
+			case OP_STOREP_FNC:
+				in->op = OPX_ADDRESS_STOREP;
+				break;
+			case OP_STOREP_S:
+				in->op = OPX_ADDRESS_STOREP_S;
+				break;
+			case OP_STOREP_V:
+				in->op = OPX_ADDRESS_STOREP_V;
+				break;
+			}
+			break;
+
+		default:
+			if (st->op > OP_BITOR)
+				in->op = OPX_BAD;
+			break;
+		}
+	}
+}
+
+/*
+====================
+PR_ExecuteCode
+
+Runs the pre-decoded instructions starting at statement s until the stack
+is back to exitdepth
+====================
+*/
+#define OPA (st->a)
+#define OPB (st->b)
+#define OPC (st->c)
+
+// adds up the statements run since the last branch and checks for runaway loops
+#define PR_ENDBLOCK() \
+	do { \
+		profile += st - block + 1; \
+		if (profile > 0x1000000) \
+		{ \
+			qcvm->xstatement = st - qcvm->code; \
+			PR_RunError ("runaway loop error"); \
+		} \
+	} while (0)
+
+#ifdef PR_COMPUTED_GOTO
+#define PR_SWITCH(op)	goto *dispatch[op];
+#define PR_CASE(op)		lbl_##op
+#define PR_DEFAULT		lbl_OPX_BAD
+#define PR_NEXT			goto *dispatch[(++st)->op]
+#define PR_DISPATCH		goto *dispatch[st->op]
+#else
+#define PR_SWITCH(op)	switch (op)
+#define PR_CASE(op)		case op
+#define PR_DEFAULT		default
+#define PR_NEXT			st++; continue
+#define PR_DISPATCH		continue
+#endif
+
+static void PR_ExecuteCode (int s, int exitdepth)
+{
+	eval_t			*ptr;
+	const prinstr_t	*st, *block;
+	dfunction_t		*newf;
+	int				profile, startprofile;
+	edict_t			*ed;
+#ifdef PR_COMPUTED_GOTO
+	static const void *const dispatch[OPX_COUNT] =
+	{
+		&&lbl_OP_DONE, &&lbl_OP_MUL_F, &&lbl_OP_MUL_V, &&lbl_OP_MUL_FV, &&lbl_OP_MUL_VF,
+		&&lbl_OP_DIV_F, &&lbl_OP_ADD_F, &&lbl_OP_ADD_V, &&lbl_OP_SUB_F, &&lbl_OP_SUB_V,
+		&&lbl_OP_EQ_F, &&lbl_OP_EQ_V, &&lbl_OP_EQ_S, &&lbl_OP_EQ_E, &&lbl_OP_EQ_FNC,
+		&&lbl_OP_NE_F, &&lbl_OP_NE_V, &&lbl_OP_NE_S, &&lbl_OP_NE_E, &&lbl_OP_NE_FNC,
+		&&lbl_OP_LE, &&lbl_OP_GE, &&lbl_OP_LT, &&lbl_OP_GT,
+		&&lbl_OP_LOAD_F, &&lbl_OP_LOAD_V, &&lbl_OP_LOAD_S, &&lbl_OP_LOAD_ENT, &&lbl_OP_LOAD_FLD, &&lbl_OP_LOAD_FNC,
+		&&lbl_OP_ADDRESS,
+		&&lbl_OP_STORE_F, &&lbl_OP_STORE_V, &&lbl_OP_STORE_S, &&lbl_OP_STORE_ENT, &&lbl_OP_STORE_FLD, &&lbl_OP_STORE_FNC,
+		&&lbl_OP_STOREP_F, &&lbl_OP_STOREP_V, &&lbl_OP_STOREP_S, &&lbl_OP_STOREP_ENT, &&lbl_OP_STOREP_FLD, &&lbl_OP_STOREP_FNC,
+		&&lbl_OP_RETURN,
+		&&lbl_OP_NOT_F, &&lbl_OP_NOT_V, &&lbl_OP_NOT_S, &&lbl_OP_NOT_ENT, &&lbl_OP_NOT_FNC,
+		&&lbl_OP_IF, &&lbl_OP_IFNOT,
+		&&lbl_OP_CALL0, &&lbl_OP_CALL1, &&lbl_OP_CALL2, &&lbl_OP_CALL3, &&lbl_OP_CALL4,
+		&&lbl_OP_CALL5, &&lbl_OP_CALL6, &&lbl_OP_CALL7, &&lbl_OP_CALL8,
+		&&lbl_OP_STATE, &&lbl_OP_GOTO, &&lbl_OP_AND, &&lbl_OP_OR,
+		&&lbl_OP_BITAND, &&lbl_OP_BITOR,
+		&&lbl_OPX_ADDRESS_STOREP, &&lbl_OPX_ADDRESS_STOREP_S, &&lbl_OPX_ADDRESS_STOREP_V,
+		&&lbl_OPX_BAD,
+	};
+#endif
+
+	st = block = &qcvm->code[s];
+	startprofile = profile = 0;
+
+    while (1)
+    {
+	PR_SWITCH (st->op)
+	{
+	PR_CASE (OP_ADD_F):
+		OPC->_float = OPA->_float + OPB->_float;
+		PR_NEXT;
+	PR_CASE (OP_ADD_V):
+		OPC->vector[0] = OPA->vector[0] + OPB->vector[0];
+		OPC->vector[1] = OPA->vector[1] + OPB->vector[1];
+		OPC->vector[2] = OPA->vector[2] + OPB->vector[2];
+		PR_NEXT;
+
+	PR_CASE (OP_SUB_F):
+		OPC->_float = OPA->_float - OPB->_float;
+		PR_NEXT;
+	PR_CASE (OP_SUB_V):
+		OPC->vector[0] = OPA->vector[0] - OPB->vector[0];
+		OPC->vector[1] = OPA->vector[1] - OPB->vector[1];
+		OPC->vector[2] = OPA->vector[2] - OPB->vector[2];
+		PR_NEXT;
+
+	PR_CASE (OP_MUL_F):
+		OPC->_float = OPA->_float * OPB->_float;
+		PR_NEXT;
+	PR_CASE (OP_MUL_V):
+		OPC->_float = OPA->vector[0] * OPB->vector[0] +
+			      OPA->vector[1] * OPB->vector[1] +
+			      OPA->vector[2] * OPB->vector[2];
+		PR_NEXT;
+	PR_CASE (OP_MUL_FV):
+		OPC->vector[0] = OPA->_float * OPB->vector[0];
+		OPC->vector[1] = OPA->_float * OPB->vector[1];
+		OPC->vector[2] = OPA->_float * OPB->vector[2];
+		PR_NEXT;
+	PR_CASE (OP_MUL_VF):
+		OPC->vector[0] = OPB->_float * OPA->vector[0];
+		OPC->vector[1] = OPB->_float * OPA->vector[1];
+		OPC->vector[2] = OPB->_float * OPA->vector[2];
+		PR_NEXT;
+
+	PR_CASE (OP_DIV_F):
+		OPC->_float = OPA->_float / OPB->_float;
+		PR_NEXT;
+
+	PR_CASE (OP_BITAND):
+		OPC->_float = (int)OPA->_float & (int)OPB->_float;
+		PR_NEXT;
+
+	PR_CASE (OP_BITOR):
+		OPC->_float = (int)OPA->_float | (int)OPB->_float;
+		PR_NEXT;
+
+	PR_CASE (OP_GE):
+		OPC->_float = OPA->_float >= OPB->_float;
+		PR_NEXT;
+	PR_CASE (OP_LE):
+		OPC->_float = OPA->_float <= OPB->_float;
+		PR_NEXT;
+	PR_CASE (OP_GT):
+		OPC->_float = OPA->_float > OPB->_float;
+		PR_NEXT;
+	PR_CASE (OP_LT):
+		OPC->_float = OPA->_float < OPB->_float;
+		PR_NEXT;
+	PR_CASE (OP_AND):
+		OPC->_float = OPA->_float && OPB->_float;
+		PR_NEXT;
+	PR_CASE (OP_OR):
+		OPC->_float = OPA->_float || OPB->_float;
+		PR_NEXT;
+
+	PR_CASE (OP_NOT_F):
+		OPC->_float = !OPA->_float;
+		PR_NEXT;
+	PR_CASE (OP_NOT_V):
+		OPC->_float = !OPA->vector[0] && !OPA->vector[1] && !OPA->vector[2];
+		PR_NEXT;
+	PR_CASE (OP_NOT_S):
+		OPC->_float = !OPA->string || !*PR_GetString(OPA->string);
+		PR_NEXT;
+	PR_CASE (OP_NOT_FNC):
+		OPC->_float = !OPA->function;
+		PR_NEXT;
+	PR_CASE (OP_NOT_ENT):
+		OPC->_float = (PROG_TO_EDICT(OPA->edict) == qcvm->edicts);
+		PR_NEXT;
+
+	PR_CASE (OP_EQ_F):
+		OPC->_float = OPA->_float == OPB->_float;
+		PR_NEXT;
+	PR_CASE (OP_EQ_V):
+		OPC->_float = (OPA->vector[0] == OPB->vector[0]) &&
+			      (OPA->vector[1] == OPB->vector[1]) &&
+			      (OPA->vector[2] == OPB->vector[2]);
+		PR_NEXT;
+	PR_CASE (OP_EQ_S):
+		OPC->_float = !strcmp(PR_GetString(OPA->string), PR_GetString(OPB->string));
+		PR_NEXT;
+	PR_CASE (OP_EQ_E):
+		OPC->_float = OPA->_int == OPB->_int;
+		PR_NEXT;
+	PR_CASE (OP_EQ_FNC):
+		OPC->_float = OPA->function == OPB->function;
+		PR_NEXT;
+
+	PR_CASE (OP_NE_F):
+		OPC->_float = OPA->_float != OPB->_float;
+		PR_NEXT;
+	PR_CASE (OP_NE_V):
+		OPC->_float = (OPA->vector[0] != OPB->vector[0]) ||
+			      (OPA->vector[1] != OPB->vector[1]) ||
+			      (OPA->vector[2] != OPB->vector[2]);
+		PR_NEXT;
+	PR_CASE (OP_NE_S):
+		OPC->_float = strcmp(PR_GetString(OPA->string), PR_GetString(OPB->string));
+		PR_NEXT;
+	PR_CASE (OP_NE_E):
+		OPC->_float = OPA->_int != OPB->_int;
+		PR_NEXT;
+	PR_CASE (OP_NE_FNC):
+		OPC->_float = OPA->function != OPB->function;
+		PR_NEXT;
+
+	PR_CASE (OP_STORE_F):
+	PR_CASE (OP_STORE_ENT):
+	PR_CASE (OP_STORE_FLD):	// integers
+	PR_CASE (OP_STORE_S):
+	PR_CASE (OP_STORE_FNC):	// pointers
+		OPB->_int = OPA->_int;
+		PR_NEXT;
+	PR_CASE (OP_STORE_V):
+		OPB->vector[0] = OPA->vector[0];
+		OPB->vector[1] = OPA->vector[1];
+		OPB->vector[2] = OPA->vector[2];
+		PR_NEXT;
+
+	PR_CASE (OP_STOREP_F):
+	PR_CASE (OP_STOREP_ENT):
+	PR_CASE (OP_STOREP_FLD):	// integers
+	PR_CASE (OP_STOREP_FNC):	// pointers
+		ptr = (eval_t *)((byte *)qcvm->edicts + OPB->_int);
+		ptr->_int = OPA->_int;
+		ED_PointerStored (OPB->_int);
+		PR_NEXT;
+	PR_CASE (OP_STOREP_S):
+		ptr = (eval_t *)((byte *)qcvm->edicts + OPB->_int);
+		ptr->_int = OPA->_int;
+		ED_StringFieldsChanged ();
+		PR_NEXT;
+	PR_CASE (OP_STOREP_V):
+		ptr = (eval_t *)((byte *)qcvm->edicts + OPB->_int);
+		ptr->vector[0] = OPA->vector[0];
+		ptr->vector[1] = OPA->vector[1];
+		ptr->vector[2] = OPA->vector[2];
+		PR_NEXT;
+
+	PR_CASE (OP_ADDRESS):
+	PR_CASE (OPX_ADDRESS_STOREP):
+	PR_CASE (OPX_ADDRESS_STOREP_S):
+	PR_CASE (OPX_ADDRESS_STOREP_V):
+		ed = PROG_TO_EDICT(OPA->edict);
+#ifdef PARANOID
+		NUM_FOR_EDICT(ed);	// Make sure it's in range
+#endif
+		if (ed == (edict_t *)qcvm->edicts && sv.state == ss_active)
+		{
+			qcvm->xstatement = st - qcvm->code;
+			PR_RunError("assignment to world entity");
+		}
+		ptr = (eval_t *)((int *)&ed->v + OPB->_int);
+		OPC->_int = (byte *)ptr - (byte *)qcvm->edicts;
+		switch (st->op)
+		{
+		case OPX_ADDRESS_STOREP:
+			ptr->_int = st[1].a->_int;
+			ED_FieldStored (OPB->_int);
+			st++;
+			break;
+		case OPX_ADDRESS_STOREP_S:
+			ptr->_int = st[1].a->_int;
+			ED_StringFieldsChanged ();
+			st++;
+			break;
+		case OPX_ADDRESS_STOREP_V:
+			ptr->vector[0] = st[1].a->vector[0];
+			ptr->vector[1] = st[1].a->vector[1];
+			ptr->vector[2] = st[1].a->vector[2];
+			st++;
+			break;
+		}
+		PR_NEXT;
+
+	PR_CASE (OP_LOAD_F):
+	PR_CASE (OP_LOAD_FLD):
+	PR_CASE (OP_LOAD_ENT):
+	PR_CASE (OP_LOAD_S):
+	PR_CASE (OP_LOAD_FNC):
+		ed = PROG_TO_EDICT(OPA->edict);
+#ifdef PARANOID
+		NUM_FOR_EDICT(ed);	// Make sure it's in range
+#endif
+		OPC->_int = ((eval_t *)((int *)&ed->v + OPB->_int))->_int;
+		PR_NEXT;
+
+	PR_CASE (OP_LOAD_V):
+		ed = PROG_TO_EDICT(OPA->edict);
+#ifdef PARANOID
+		NUM_FOR_EDICT(ed);	// Make sure it's in range
+#endif
+		ptr = (eval_t *)((int *)&ed->v + OPB->_int);
+		OPC->vector[0] = ptr->vector[0];
+		OPC->vector[1] = ptr->vector[1];
+		OPC->vector[2] = ptr->vector[2];
+		PR_NEXT;
+
+	PR_CASE (OP_IFNOT):
+		if (OPA->_int)
+		{
+			PR_NEXT;
+		}
+		PR_ENDBLOCK ();
+		st = block = st + st->jump;
+		PR_DISPATCH;
+
+	PR_CASE (OP_IF):
+		if (!OPA->_int)
+		{
+			PR_NEXT;
+		}
+		PR_ENDBLOCK ();
+		st = block = st + st->jump;
+		PR_DISPATCH;
+
+	PR_CASE (OP_GOTO):
+		PR_ENDBLOCK ();
+		st = block = st + st->jump;
+		PR_DISPATCH;
+
+	PR_CASE (OP_CALL0):
+	PR_CASE (OP_CALL1):
+	PR_CASE (OP_CALL2):
+	PR_CASE (OP_CALL3):
+	PR_CASE (OP_CALL4):
+	PR_CASE (OP_CALL5):
+	PR_CASE (OP_CALL6):
+	PR_CASE (OP_CALL7):
+	PR_CASE (OP_CALL8):
+		PR_ENDBLOCK ();
+		qcvm->xfunction->profile += profile - startprofile;
+		startprofile = profile;
+		qcvm->xstatement = st - qcvm->code;
+		qcvm->argc = st->op - OP_CALL0;
+		if (!OPA->function)
+			PR_RunError("NULL function");
+		newf = &qcvm->functions[OPA->function];
+		if (newf->first_statement < 0)
+		{ // Built-in function
+			int i = -newf->first_statement;
+			if (i >= qcvm->numbuiltins)
+				PR_RunError("Bad builtin call number %d", i);
+			PR_CheckBuiltinExtension (newf);
+			if (qcvm->profiler)
+				PR_ProfileBuiltin (newf, i);
+			else
+				qcvm->builtins[i]();
+			if (qcvm->trace)
+			{ // traceon: continue in the plain loop
+				PR_ExecuteStatements (st - qcvm->code, exitdepth);
+				return;
+			}
+			block = st + 1;
+			PR_NEXT;
+		}
+		// Normal function
+		st = block = &qcvm->code[PR_EnterFunction(newf) + 1];
+		PR_DISPATCH;
+
+	PR_CASE (OP_DONE):
+	PR_CASE (OP_RETURN):
+		PR_ENDBLOCK ();
+		qcvm->xfunction->profile += profile - startprofile;
+		startprofile = profile;
+		qcvm->xstatement = st - qcvm->code;
+		qcvm->globals[OFS_RETURN] = OPA->vector[0];
+		qcvm->globals[OFS_RETURN + 1] = OPA->vector[1];
+		qcvm->globals[OFS_RETURN + 2] = OPA->vector[2];
+		st = &qcvm->code[PR_LeaveFunction()];
+		if (qcvm->depth == exitdepth)
+		{ // Done
+			return;
+		}
+		st = block = st + 1;
+		PR_DISPATCH;
+
+	PR_CASE (OP_STATE):
+		ed = PROG_TO_EDICT(pr_global_struct->self);
+		ed->v.nextthink = pr_global_struct->time + 0.1;
+		ed->v.frame = OPA->_float;
+		ed->v.think = OPB->function;
+		PR_NEXT;
+
+	PR_DEFAULT:
+		qcvm->xstatement = st - qcvm->code;
+		PR_RunError("Bad opcode %i", qcvm->statements[st - qcvm->code].op);
+	}
+    }	/* end of while(1) loop */
+}
+
+#undef PR_SWITCH
+#undef PR_CASE
+#undef PR_DEFAULT
+#undef PR_NEXT
+#undef PR_DISPATCH
+#undef PR_ENDBLOCK
+#undef OPA
+#undef OPB
+#undef OPC
+
+/*
+====================
+PR_ExecuteProgram
+====================
+*/
+void PR_ExecuteProgram (func_t fnum)
+{
+	dfunction_t	*f;
+	int		exitdepth, s;
+
+	if (!fnum || fnum >= qcvm->progs->numfunctions)
+	{
+		if (pr_global_struct->self)
+			ED_Print (PROG_TO_EDICT(pr_global_struct->self));
+		Host_Error ("PR_ExecuteProgram: NULL function");
+	}
+
+	f = &qcvm->functions[fnum];
+
+	qcvm->trace = false;
+
+// make a stack frame
+	exitdepth = qcvm->depth;
+
+	s = PR_EnterFunction(f);
+	if (qcvm->code && pr_predecode.value)
+		PR_ExecuteCode (s + 1, exitdepth);
+	else
+		PR_ExecuteStatements (s, exitdepth);
+}
+
+/*
+===============================================================================
+
+MICROBENCHMARKS
+
+pr_bench runs a few hand-assembled QC loops in a private VM, once with the
+plain loop and once pre-decoded, and prints the statements per second of each.
+The final globals and entity fields of both runs are compared as a sanity check.
+
+===============================================================================
+*/
+
+#define BENCH_ITERATIONS	(1 << 20)
+
+enum
+{
+	BG_ONE = RESERVED_OFS,
+	BG_N,
+	BG_I,
+	BG_T,
+	BG_X,
+	BG_Y,
+	BG_A,
+	BG_B,
+	BG_C,
+	BG_ENT,
+	BG_FLD_F,
+	BG_FLD_V,
+	BG_PTR,
+	BG_FUNC,
+	BG_V,
+	BG_W = BG_V + 3,
+	BG_U = BG_W + 3,
+	BG_COUNT = BG_U + 3
+};
+
+typedef struct
+{
+	const char		*name;
+	dstatement_t	body[8];
+	int				numstatements;
+} prbench_t;
+
+static const prbench_t pr_benches[] =
+{
+	{"arith", {
+		{OP_MUL_F, BG_X, BG_A, BG_T},
+		{OP_ADD_F, BG_T, BG_B, BG_X},
+		{OP_DIV_F, BG_X, BG_C, BG_T},
+		{OP_SUB_F, BG_Y, BG_T, BG_Y},
+	}, 4},
+	{"vector", {
+		{OP_MUL_VF, BG_W, BG_A, BG_U},
+		{OP_ADD_V, BG_V, BG_U, BG_V},
+		{OP_MUL_V, BG_V, BG_W, BG_T},
+		{OP_SUB_F, BG_Y, BG_T, BG_Y},
+	}, 4},
+	{"fields", {
+		{OP_LOAD_F, BG_ENT, BG_FLD_F, BG_T},
+		{OP_ADD_F, BG_T, BG_ONE, BG_T},
+		{OP_ADDRESS, BG_ENT, BG_FLD_F, BG_PTR},
+		{OP_STOREP_F, BG_T, BG_PTR, 0},
+		{OP_LOAD_V, BG_ENT, BG_FLD_V, BG_U},
+		{OP_ADD_V, BG_U, BG_W, BG_U},
+		{OP_ADDRESS, BG_ENT, BG_FLD_V, BG_PTR},
+		{OP_STOREP_V, BG_U, BG_PTR, 0},
+	}, 8},
+	{"branches", {
+		{OP_GE, BG_I, BG_C, BG_T},
+		{OP_IF, BG_T, 2, 0},
+		{OP_ADD_F, BG_X, BG_ONE, BG_X},
+	}, 3},
+	{"calls", {
+		{OP_CALL0, BG_FUNC, 0, 0},
+		{OP_ADD_F, BG_Y, OFS_RETURN, BG_Y},
+	}, 2},
+};
+
+#define NUM_BENCHES	(int)(sizeof (pr_benches) / sizeof (pr_benches[0]))
+
+/*
+====================
+PR_BenchReset
+====================
+*/
+static void PR_BenchReset (qcvm_t *vm, func_t callee)
+{
+	memset (vm->globals, 0, sizeof (float) * BG_COUNT);
+	memset (vm->edicts, 0, vm->edict_size * 2);
+	vm->globals[BG_ONE] = 1.f;
+	vm->globals[BG_N] = BENCH_ITERATIONS;
+	vm->globals[BG_A] = 0.5f;
+	vm->globals[BG_B] = 3.f;
+	vm->globals[BG_C] = BENCH_ITERATIONS / 2;
+	vm->globals[BG_W + 0] = 0.25f;
+	vm->globals[BG_W + 1] = 0.5f;
+	vm->globals[BG_W + 2] = 0.75f;
+	((int *)vm->globals)[BG_ENT] = vm->edict_size;
+	((int *)vm->globals)[BG_FLD_F] = offsetof (entvars_t, health) / 4;
+	((int *)vm->globals)[BG_FLD_V] = offsetof (entvars_t, origin) / 4;
+	((int *)vm->globals)[BG_FUNC] = callee;
+}
+
+/*
+====================
+PR_Bench_f
+====================
+*/
+void PR_Bench_f (void)
+{
+	qcvm_t			*vm, *oldvm;
+	dprograms_t		progs;
+	dfunction_t		functions[NUM_BENCHES + 2];
+	dstatement_t	statements[NUM_BENCHES * 12 + 4];
+	float			globals[BG_COUNT], saved[BG_COUNT];
+	byte			*savededicts;
+	int				i, j, k, mode, reps, mark, numstatements;
+	double			best[2], t;
+	int				counted[2];
+	prinstr_t		*code;
+
+	reps = Cmd_Argc () > 1 ? q_max (1, atoi (Cmd_Argv (1))) : 5;
+
+	vm = (qcvm_t *) calloc (1, sizeof (*vm));
+	if (!vm)
+		Sys_Error ("PR_Bench_f: out of memory");
+
+	// statement 0 is an error, function 0 is empty
+	memset (functions, 0, sizeof (functions));
+	memset (statements, 0, sizeof (statements));
+	numstatements = 1;
+	for (i = 0; i < NUM_BENCHES; i++)
+	{
+		const prbench_t *b = &pr_benches[i];
+		functions[i + 1].first_statement = numstatements;
+		memcpy (&statements[numstatements], b->body, sizeof (b->body[0]) * b->numstatements);
+		numstatements += b->numstatements;
+		statements[numstatements].op = OP_ADD_F;
+		statements[numstatements].a = BG_I;
+		statements[numstatements].b = BG_ONE;
+		statements[numstatements++].c = BG_I;
+		statements[numstatements].op = OP_LT;
+		statements[numstatements].a = BG_I;
+		statements[numstatements].b = BG_N;
+		statements[numstatements++].c = BG_T;
+		statements[numstatements].op = OP_IF;
+		statements[numstatements].a = BG_T;
+		statements[numstatements].b = -(b->numstatements + 2);
+		numstatements++;
+		statements[numstatements++].op = OP_DONE;
+	}
+	// the callee for the "calls" loop
+	functions[NUM_BENCHES + 1].first_statement = numstatements;
+	statements[numstatements].op = OP_RETURN;
+	statements[numstatements++].a = BG_ONE;
+
+	memset (&progs, 0, sizeof (progs));
+	progs.numstatements = numstatements;
+	progs.numfunctions = NUM_BENCHES + 2;
+	progs.entityfields = sizeof (entvars_t) / 4;
+
+	vm->progs = &progs;
+	vm->functions = functions;
+	vm->statements = statements;
+	vm->globals = globals;
+	vm->edict_size = sizeof (edict_t);
+	vm->edicts = (edict_t *) calloc (2, vm->edict_size);
+	savededicts = (byte *) malloc (vm->edict_size * 2);
+	if (!vm->edicts || !savededicts)
+		Sys_Error ("PR_Bench_f: out of memory");
+	vm->num_edicts = vm->max_edicts = 2;
+
+	PR_PushQCVM (vm, &oldvm);
+	mark = Hunk_LowMark ();
+	PR_TranslateProgram ();
+	code = qcvm->code;
+
+	Con_Printf ("%-10s %12s %12s\n", "kernel", "plain", "predecoded");
+	for (i = 0; i < NUM_BENCHES; i++)
+	{
+		for (mode = 0; mode < 2; mode++)
+		{
+			qcvm->code = mode ? code : NULL;
+			best[mode] = 1e9;
+			for (j = 0; j < reps; j++)
+			{
+				PR_BenchReset (qcvm, NUM_BENCHES + 1);
+				for (k = 0; k < progs.numfunctions; k++)
+					functions[k].profile = 0;
+				t = Sys_DoubleTime ();
+				PR_ExecuteProgram (i + 1);
+				t = Sys_DoubleTime () - t;
+				best[mode] = q_min (best[mode], t);
+			}
+			counted[mode] = functions[i + 1].profile + functions[NUM_BENCHES + 1].profile;
+			if (!mode)
+			{
+				memcpy (saved, globals, sizeof (saved));
+				memcpy (savededicts, qcvm->edicts, vm->edict_size * 2);
+			}
+		}
+
+		Con_Printf ("%-10s %8.1f M/s %8.1f M/s  %.2fx%s\n", pr_benches[i].name,
+			counted[0] / q_max (best[0], 1e-9) / 1e6, counted[1] / q_max (best[1], 1e-9) / 1e6,
+			best[0] / q_max (best[1], 1e-9),
+			(counted[0] != counted[1] || memcmp (saved, globals, sizeof (saved)) ||
+			 memcmp (savededicts, qcvm->edicts, vm->edict_size * 2)) ? "  MISMATCH" : "");
+	}
+
+	Hunk_FreeToLowMark (mark);
+	PR_PopQCVM (oldvm);
+
+	free (savededicts);
+	free (vm->edicts);
+	free (vm);
+}
@@ -0,0 +1,580 @@
+/*
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// pr_profile.c -- wall-clock QuakeC profiler
+
+/*
+While running, PR_EnterFunction/PR_LeaveFunction and every builtin call report
+to the profiler, which keeps a stack of open calls and charges each finished
+call to both its function and its call path. That gives self and inclusive
+time per function and builtin, exact folded stacks for flamegraphs, and a
+timeline of individual calls for chrome://tracing or Perfetto.
+
+Only the thread that started the profiler records anything, so QC run from
+job threads doesn't corrupt the stack.
+*/
+
+#include "quakedef.h"
+
+#define PROF_MAX_DEPTH		(MAX_STACK_DEPTH * 2)	// QC frames plus builtins
+#define PROF_MAX_EVENTS		(1 << 20)
+
+typedef struct
+{
+	uint64_t	self;		// ticks excluding callees
+	uint64_t	inclusive;	// ticks including callees, outermost activation only
+	uint64_t	calls;
+	int			active;		// open activations, to not count recursion twice
+	qboolean	builtin;
+} prproffunc_t;
+
+// one distinct call path
+typedef struct
+{
+	int			func;
+	int			parent;		// node index, -1 for top-level calls
+	uint64_t	self;
+	uint64_t	calls;
+} prprofnode_t;
+
+typedef struct
+{
+	int			node;
+	uint64_t	start;
+	uint64_t	children;	// ticks spent in callees
+} prprofframe_t;
+
+// one finished call, for the trace timeline
+typedef struct
+{
+	int			func;
+	int			depth;
+	uint64_t	start;
+	uint64_t	duration;
+} prprofevent_t;
+
+struct prprofiler_s
+{
+	qcvm_t			*vm;
+	qboolean		running;
+	uint64_t		starttime;
+	uint64_t		totaltime;
+	uint64_t		frequency;
+
+	int				numfunctions;
+	prproffunc_t	*funcs;
+	char			**names;	// copied on stop, so reports outlive the progs
+
+	prprofnode_t	*nodes;
+	int				numnodes;
+	int				maxnodes;
+	int				*nodehash;	// node index + 1, keyed by parent and function
+	int				nodehashsize;
+
+	prprofframe_t	stack[PROF_MAX_DEPTH];
+	int				depth;
+	int				overflow;
+
+	prprofevent_t	*events;
+	int				numevents;
+	int				droppedevents;
+};
+
+static prprofiler_t	pr_profiler;
+static THREAD_LOCAL qboolean pr_profthread;
+
+/*
+=================
+PR_ProfileFree
+=================
+*/
+static void PR_ProfileFree (prprofiler_t *p)
+{
+	int i;
+
+	if (p->names)
+		for (i = 0; i < p->numfunctions; i++)
+			if (p->names[i])
+				Z_Free (p->names[i]);
+	free (p->names);
+	free (p->funcs);
+	free (p->nodes);
+	free (p->nodehash);
+	free (p->events);
+	memset (p, 0, sizeof (*p));
+}
+
+/*
+=================
+PR_ProfileHashNodes
+=================
+*/
+static void PR_ProfileHashNodes (prprofiler_t *p)
+{
+	int i, pos;
+
+	free (p->nodehash);
+	for (p->nodehashsize = 1024; p->nodehashsize < p->maxnodes * 2; p->nodehashsize <<= 1)
+		;
+	p->nodehash = (int *) calloc (p->nodehashsize, sizeof (int));
+	if (!p->nodehash)
+		Sys_Error ("PR_ProfileHashNodes: out of memory");
+	for (i = 0; i < p->numnodes; i++)
+	{
+		pos = (p->nodes[i].parent * 31 + p->nodes[i].func * 1031) & (p->nodehashsize - 1);
+		while (p->nodehash[pos])
+			pos = (pos + 1) & (p->nodehashsize - 1);
+		p->nodehash[pos] = i + 1;
+	}
+}
+
+/*
+=================
+PR_ProfileNode
+
+Returns the node for func called from the parent call path
+=================
+*/
+static int PR_ProfileNode (prprofiler_t *p, int parent, int func)
+{
+	int				pos, n;
+	prprofnode_t	*node;
+
+	pos = (parent * 31 + func * 1031) & (p->nodehashsize - 1);
+	while ((n = p->nodehash[pos]) != 0)
+	{
+		node = &p->nodes[n - 1];
+		if (node->parent == parent && node->func == func)
+			return n - 1;
+		pos = (pos + 1) & (p->nodehashsize - 1);
+	}
+
+	if (p->numnodes == p->maxnodes)
+	{
+		p->maxnodes *= 2;
+		p->nodes = (prprofnode_t *) realloc (p->nodes, sizeof (*p->nodes) * p->maxnodes);
+		if (!p->nodes)
+			Sys_Error ("PR_ProfileNode: out of memory");
+		PR_ProfileHashNodes (p);
+		return PR_ProfileNode (p, parent, func);
+	}
+
+	n = p->numnodes++;
+	node = &p->nodes[n];
+	node->func = func;
+	node->parent = parent;
+	node->self = 0;
+	node->calls = 0;
+	p->nodehash[pos] = n + 1;
+	return n;
+}
+
+/*
+=================
+PR_ProfileEnter
+=================
+*/
+void PR_ProfileEnter (dfunction_t *f)
+{
+	prprofiler_t	*p = qcvm->profiler;
+	prprofframe_t	*frame;
+	int				func;
+
+	if (!pr_profthread)
+		return;
+
+	// a top-level call: drop whatever a Host_Error left open
+	if (qcvm->depth <= 1 && f->first_statement >= 0 && (p->depth || p->overflow))
+	{
+		while (p->depth > 0)
+			p->funcs[p->nodes[p->stack[--p->depth].node].func].active = 0;
+		p->overflow = 0;
+	}
+
+	if (p->depth == PROF_MAX_DEPTH)
+	{
+		p->overflow++;
+		return;
+	}
+
+	func = f - qcvm->functions;
+	frame = &p->stack[p->depth];
+	frame->node = PR_ProfileNode (p, p->depth ? p->stack[p->depth - 1].node : -1, func);
+	frame->children = 0;
+	p->nodes[frame->node].calls++;
+	p->funcs[func].calls++;
+	p->funcs[func].active++;
+	p->depth++;
+	frame->start = SDL_GetPerformanceCounter ();
+}
+
+/*
+=================
+PR_ProfileLeave
+=================
+*/
+void PR_ProfileLeave (void)
+{
+	prprofiler_t	*p = qcvm->profiler;
+	prprofframe_t	*frame;
+	prprofnode_t	*node;
+	prproffunc_t	*func;
+	uint64_t		total, self;
+
+	if (!pr_profthread)
+		return;
+	if (p->overflow)
+	{
+		p->overflow--;
+		return;
+	}
+	if (!p->depth)
+		return;
+
+	frame = &p->stack[--p->depth];
+	total = SDL_GetPerformanceCounter () - frame->start;
+	self = total > frame->children ? total - frame->children : 0;
+	node = &p->nodes[frame->node];
+	func = &p->funcs[node->func];
+
+	node->self += self;
+	func->self += self;
+	if (--func->active == 0)
+		func->inclusive += total;
+	if (p->depth)
+		p->stack[p->depth - 1].children += total;
+
+	if (p->numevents < PROF_MAX_EVENTS)
+	{
+		prprofevent_t *ev = &p->events[p->numevents++];
+		ev->func = node->func;
+		ev->depth = p->depth;
+		ev->start = frame->start - p->starttime;
+		ev->duration = total;
+	}
+	else
+		p->droppedevents++;
+}
+
+/*
+=================
+PR_ProfileBuiltin
+
+Runs builtin number i, timed as a call to f
+=================
+*/
+void PR_ProfileBuiltin (dfunction_t *f, int i)
+{
+	PR_ProfileEnter (f);
+	qcvm->builtins[i] ();
+	PR_ProfileLeave ();
+}
+
+/*
+=================
+PR_ProfileStart
+=================
+*/
+static void PR_ProfileStart (qcvm_t *vm)
+{
+	prprofiler_t *p = &pr_profiler;
+
+	if (p->running)
+		PR_ProfileStop (p->vm);
+	PR_ProfileFree (p);
+
+	p->vm = vm;
+	p->numfunctions = vm->progs->numfunctions;
+	p->funcs = (prproffunc_t *) calloc (p->numfunctions, sizeof (*p->funcs));
+	p->maxnodes = 4096;
+	p->nodes = (prprofnode_t *) malloc (sizeof (*p->nodes) * p->maxnodes);
+	p->events = (prprofevent_t *) malloc (sizeof (*p->events) * PROF_MAX_EVENTS);
+	if (!p->funcs || !p->nodes || !p->events)
+		Sys_Error ("PR_ProfileStart: out of memory");
+	PR_ProfileHashNodes (p);
+
+	p->frequency = SDL_GetPerformanceFrequency ();
+	p->starttime = SDL_GetPerformanceCounter ();
+	p->running = true;
+	pr_profthread = true;
+	vm->profiler = p;
+}
+
+/*
+=================
+PR_ProfileStop
+
+Detaches the profiler from vm, keeping the results. Called when the progs are
+unloaded, too.
+=================
+*/
+void PR_ProfileStop (qcvm_t *vm)
+{
+	prprofiler_t	*p = &pr_profiler;
+	qcvm_t			*oldvm;
+	int				i;
+
+	if (!p->running || p->vm != vm)
+		return;
+
+	p->totaltime = SDL_GetPerformanceCounter () - p->starttime;
+	p->running = false;
+	vm->profiler = NULL;
+
+	p->names = (char **) calloc (p->numfunctions, sizeof (char *));
+	if (!p->names)
+		Sys_Error ("PR_ProfileStop: out of memory");
+	PR_PushQCVM (vm, &oldvm);
+	for (i = 0; i < p->numfunctions; i++)
+	{
+		if (!p->funcs[i].calls)
+			continue;
+		p->names[i] = Z_Strdup (PR_GetString (qcvm->functions[i].s_name));
+		p->funcs[i].builtin = qcvm->functions[i].first_statement < 0;
+	}
+	PR_PopQCVM (oldvm);
+}
+
+/*
+=================
+PR_ProfileName
+=================
+*/
+static const char *PR_ProfileName (int func)
+{
+	const char *name = pr_profiler.names[func];
+	return name && *name ? name : "<unnamed>";
+}
+
+static int PR_ProfileCompareSelf (const void *a, const void *b)
+{
+	const prproffunc_t *fa = &pr_profiler.funcs[*(const int *)a];
+	const prproffunc_t *fb = &pr_profiler.funcs[*(const int *)b];
+	if (fa->self != fb->self)
+		return fa->self < fb->self ? 1 : -1;
+	return *(const int *)a - *(const int *)b;
+}
+
+/*
+=================
+PR_ProfileReport
+=================
+*/
+static void PR_ProfileReport (int count)
+{
+	prprofiler_t	*p = &pr_profiler;
+	int				i, num, *order;
+	double			scale, total;
+
+	order = (int *) malloc (sizeof (int) * p->numfunctions);
+	if (!order)
+		Sys_Error ("PR_ProfileReport: out of memory");
+	for (i = num = 0; i < p->numfunctions; i++)
+		if (p->funcs[i].calls)
+			order[num++] = i;
+	qsort (order, num, sizeof (int), PR_ProfileCompareSelf);
+
+	scale = 1000.0 / p->frequency;
+	total = p->totaltime * scale;
+	Con_Printf ("%.1f ms captured, %d functions called, %d call paths\n", total, num, p->numnodes);
+	Con_Printf ("%9s %9s %6s %9s  %s\n", "calls", "self ms", "self%", "incl ms", "function");
+	for (i = 0; i < num && i < count; i++)
+	{
+		const prproffunc_t *f = &p->funcs[order[i]];
+		Con_Printf ("%9" SDL_PRIu64 " %9.2f %5.1f%% %9.2f  %s%s\n",
+			f->calls, f->self * scale, total > 0 ? 100.0 * f->self * scale / total : 0.0,
+			f->inclusive * scale, PR_ProfileName (order[i]), f->builtin ? " (builtin)" : "");
+	}
+
+	free (order);
+}
+
+/*
+=================
+PR_ProfileWriteFolded
+
+One line per call path, "outer;inner;innermost <self microseconds>", as read
+by flamegraph.pl, speedscope and similar tools
+=================
+*/
+static qboolean PR_ProfileWriteFolded (const char *path)
+{
+	prprofiler_t	*p = &pr_profiler;
+	FILE			*f;
+	int				i, n, depth, chain[PROF_MAX_DEPTH];
+	uint64_t		us;
+
+	f = Sys_fopen (path, "w");
+	if (!f)
+		return false;
+	for (i = 0; i < p->numnodes; i++)
+	{
+		us = p->nodes[i].self * 1000000 / p->frequency;
+		if (!us)
+			continue;
+		for (n = i, depth = 0; n >= 0 && depth < PROF_MAX_DEPTH; n = p->nodes[n].parent)
+			chain[depth++] = p->nodes[n].func;
+		while (depth-- > 0)
+			fprintf (f, "%s%c", PR_ProfileName (chain[depth]), depth ? ';' : ' ');
+		fprintf (f, "%" SDL_PRIu64 "\n", us);
+	}
+	fclose (f);
+	return true;
+}
+
+/*
+=================
+PR_ProfileWriteJSONString
+=================
+*/
+static void PR_ProfileWriteJSONString (FILE *f, const char *s)
+{
+	fputc ('"', f);
+	for (; *s; s++)
+	{
+		unsigned char c = (unsigned char) *s;
+		if (c == '"' || c == '\\')
+			fprintf (f, "\\%c", c);
+		else if (c < 0x20 || c >= 0x7f)	// also keeps the file valid UTF-8
+			fprintf (f, "\\u%04x", c);
+		else
+			fputc (c, f);
+	}
+	fputc ('"', f);
+}
+
+/*
+=================
+PR_ProfileWriteTrace
+
+Chrome trace event format, one complete event per call
+=================
+*/
+static qboolean PR_ProfileWriteTrace (const char *path)
+{
+	prprofiler_t	*p = &pr_profiler;
+	FILE			*f;
+	int				i;
+	double			scale;
+
+	f = Sys_fopen (path, "w");
+	if (!f)
+		return false;
+	scale = 1000000.0 / p->frequency;
+	fprintf (f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	for (i = 0; i < p->numevents; i++)
+	{
+		const prprofevent_t *ev = &p->events[i];
+		fprintf (f, "{\"name\":");
+		PR_ProfileWriteJSONString (f, PR_ProfileName (ev->func));
+		fprintf (f, ",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f}%s\n",
+			p->funcs[ev->func].builtin ? "builtin" : "qc",
+			ev->start * scale, ev->duration * scale, i + 1 < p->numevents ? "," : "");
+	}
+	fprintf (f, "]}\n");
+	fclose (f);
+	return true;
+}
+
+/*
+=================
+PR_ProfileSave
+=================
+*/
+static void PR_ProfileSave (const char *basename)
+{
+	char relname[MAX_OSPATH];
+	char path[MAX_OSPATH];
+
+	q_snprintf (relname, sizeof (relname), "%s.folded", basename);
+	q_snprintf (path, sizeof (path), "%s/%s", com_gamedir, relname);
+	if (PR_ProfileWriteFolded (path))
+		Con_Printf ("Wrote %s\n", relname);
+	else
+		Con_Printf ("ERROR: couldn't open file %s.\n", relname);
+
+	q_snprintf (relname, sizeof (relname), "%s.json", basename);
+	q_snprintf (path, sizeof (path), "%s/%s", com_gamedir, relname);
+	if (PR_ProfileWriteTrace (path))
+		Con_Printf ("Wrote %s (%d calls%s)\n", relname, pr_profiler.numevents,
+			pr_profiler.droppedevents ? ", timeline truncated" : "");
+	else
+		Con_Printf ("ERROR: couldn't open file %s.\n", relname);
+}
+
+/*
+=================
+PR_Profiler_f
+
+pr_profile start [sv|cl] | stop | report [count] | save [name] | clear
+=================
+*/
+void PR_Profiler_f (void)
+{
+	const char	*cmd = Cmd_Argc () > 1 ? Cmd_Argv (1) : "";
+	qcvm_t		*vm;
+
+	if (!strcmp (cmd, "start"))
+	{
+		vm = (Cmd_Argc () > 2 && !strcmp (Cmd_Argv (2), "cl")) ? &cl.qcvm : &sv.qcvm;
+		if (!vm->progs)
+		{
+			Con_Printf ("No %s progs loaded\n", vm == &sv.qcvm ? "server" : "client");
+			return;
+		}
+		PR_ProfileStart (vm);
+		Con_Printf ("QC profiler started\n");
+	}
+	else if (!strcmp (cmd, "stop"))
+	{
+		if (!pr_profiler.running)
+		{
+			Con_Printf ("QC profiler not running\n");
+			return;
+		}
+		PR_ProfileStop (pr_profiler.vm);
+		PR_ProfileReport (20);
+	}
+	else if (!strcmp (cmd, "report") || !strcmp (cmd, "save"))
+	{
+		if (pr_profiler.running)
+		{
+			Con_Printf ("Stop the profiler first\n");
+			return;
+		}
+		if (!pr_profiler.funcs)
+		{
+			Con_Printf ("No QC profile captured\n");
+			return;
+		}
+		if (cmd[0] == 'r')
+			PR_ProfileReport (Cmd_Argc () > 2 ? atoi (Cmd_Argv (2)) : 20);
+		else
+			PR_ProfileSave (Cmd_Argc () > 2 ? Cmd_Argv (2) : "qcprofile");
+	}
+	else if (!strcmp (cmd, "clear"))
+	{
+		if (pr_profiler.running)
+			PR_ProfileStop (pr_profiler.vm);
+		PR_ProfileFree (&pr_profiler);
+	}
+	else
+	{
+		Con_Printf ("usage: %s start [sv|cl] | stop | report [count] | save [name] | clear\n", Cmd_Argv (0));
+	}
+}
@@ -50,9 +50,17 @@ typedef struct edict_s
 	qboolean	free;			/* don't modify directly, use ED_AddToFreeList/ED_RemoveFromFreeList */
 	link_t		freechain;
 	link_t		area;			/* linked to a division node or leaf */
+	link_t		gridlink;		/* linked to a spatial hash bucket */
+	int		arealist;		/* AREA_SOLID or AREA_TRIGGER, the areanode list it was linked to */
+	uint64_t	areakey;		/* areanode walk order: node index, then link order */
+	int		bvhleaf;		/* leaf in the broadphase tree + 1, 0 if none */
+	int		bvhtree;		/* which broadphase tree holds the leaf */
 
 	int		num_leafs;
 	int		leafnums[MAX_ENT_LEAFS];
+	int		num_leafwords;				/* leafnums grouped by 32-bit pvs word, built by SV_LinkEdict */
+	int		leafwords[MAX_ENT_LEAFS];	/* pvs word index */
+	uint32_t	leafmasks[MAX_ENT_LEAFS];	/* leaf bits within that word, in pvs byte order */
 
 	entity_state_t	baseline;
 	unsigned char	alpha;			/* johnfitz -- hack to support alpha since it's not part of entvars_t */
@@ -85,6 +93,16 @@ typedef struct
 	dfunction_t	*f;
 } prstack_t;
 
+typedef struct prprofiler_s prprofiler_t;
+
+// a statement with its global operands resolved, see PR_TranslateProgram
+typedef struct prinstr_s
+{
+	int			op;
+	int			jump;		// relative branch for OP_IF/OP_IFNOT/OP_GOTO
+	eval_t		*a, *b, *c;
+} prinstr_t;
+
 typedef struct prhashtable_s
 {
 	int			capacity;
@@ -188,6 +206,7 @@ struct pr_extfields_s
 	QCEXTENSION(DP_QC_TOKENIZE_CONSOLE)			\
 	QCEXTENSION(DP_QC_STRFTIME)					\
 	QCEXTENSION(KRIMZON_SV_PARSECLIENTCOMMAND)	\
+	QCEXTENSION(IW_QC_TRACELINES)				\
 
 typedef enum
 {
@@ -200,11 +219,36 @@ typedef enum
 	QCEXT_COUNT,
 } qcextension_t;
 
+#define MAX_FIELD_INDEXES	8
+#define FIELD_INDEX_MIN_FINDS	8		// finds on a field without string writes before it gets indexed
+#define FIELD_INDEX_MIN_EDICTS	256		// below this, a linear scan is cheap enough
+
+// edicts grouped by the value of a string field, for find ()
+typedef struct fieldindex_s
+{
+	int				field;			// 0 = unused
+	qboolean		valid;
+	unsigned int	writes;			// qcvm->stringfieldwrites when built
+	unsigned int	lastquery;		// qcvm->stringfieldwrites at the last find on this field
+	int				numqueries;		// finds since lastquery changed
+	int				lastused;
+	int				hashmask;
+	int				*bucketstart;	// hashmask + 2 entries, ranges in edicts
+	int				*edicts;		// edict numbers, ascending within each bucket
+	int				*volatiles;		// edicts whose string can change in place, ascending
+	int				*hashes;		// per-edict bucket, scratch for building
+	int				numvolatiles;
+	int				capacity;
+	int				bucketcapacity;
+} fieldindex_t;
+
 typedef struct qcvm_s
 {
 	dprograms_t		*progs;
 	dfunction_t		*functions;
 	dstatement_t	*statements;
+	prinstr_t		*code;		// pre-decoded statements, same numbering
+	prprofiler_t	*profiler;	// non-NULL while pr_profile is recording this VM
 	float			*globals;	/* same as pr_global_struct */
 	ddef_t			*fielddefs;	//yay reflection.
 
@@ -242,6 +286,18 @@ typedef struct qcvm_s
 
 	unsigned char	*knownzone;
 	size_t			knownzonesize;
+	int				*knownhash;			// known string slot + 1, open addressed by pointer
+	int				knownhashsize;
+	const char		*tempstrings;		// temp string buffers, with fixed slots from tempstringslot on
+	int				tempstringslot;
+	int				tempstringsize;
+	int				numtempstrings;
+
+	unsigned char	*knownstable;		// known strings whose contents never change (PR_AllocString)
+	unsigned int	stringfieldwrites;	// bumped whenever an edict string field may have changed
+	unsigned int	fieldindexwrites;	// stringfieldwrites when the last field index was built
+	fieldindex_t	fieldindexes[MAX_FIELD_INDEXES];
+	int				fieldindexcounter;
 
 	ddef_t			*globaldefs;
 
@@ -299,10 +355,19 @@ typedef struct savedata_s
 	const char		*lightstyles[MAX_LIGHTSTYLES];
 	byte			*buffer;
 	int				buffersize;
+	qboolean		binary;
 } savedata_t;
 
+typedef struct savereader_s
+{
+	const byte		*data;
+	const byte		*end;
+	qboolean		error;
+} savereader_t;
+
 #define	SAVEGAME_VERSION		5
 #define	SAVEGAME_VERSION_KEX	6
+#define	SAVEGAME_VERSION_BINARY	100
 
 extern THREAD_LOCAL globalvars_t	*pr_global_struct;
 extern THREAD_LOCAL qcvm_t			*qcvm;
@@ -326,10 +391,28 @@ const char *PR_GetString (int num);
 int PR_SetEngineString (const char *s);
 void PR_ClearEngineString (int num);
 int PR_AllocString (int bufferlength, char **ptr);
+void PR_ReserveTempStrings (void);
 
 void PR_Profile_f (void);
+void PR_TranslateProgram (void);
+void PR_Bench_f (void);
+extern cvar_t pr_predecode;
+
+void PR_ProfileEnter (dfunction_t *f);
+void PR_ProfileLeave (void);
+void PR_ProfileBuiltin (dfunction_t *f, int i);
+void PR_ProfileStop (qcvm_t *vm);
+void PR_Profiler_f (void);
+void PR_FindRadiusBench_f (void);
 
 edict_t *ED_Alloc (void);
+int ED_FindString (int start, int field, const char *s);
+#define ED_StringFieldsChanged()	(qcvm->stringfieldwrites++)
+// the 32-bit STOREP opcodes are interchangeable, so any of them can put a
+// string in an indexed field; only checked while some index is up to date
+void ED_CheckIndexedFieldStore (int field);
+#define ED_FieldStored(field)		do { if (qcvm->fieldindexwrites == qcvm->stringfieldwrites) ED_CheckIndexedFieldStore (field); } while (0)
+#define ED_PointerStored(ofs)		ED_FieldStored (((ofs) % qcvm->edict_size - (int) offsetof (edict_t, v)) / 4)
 void ED_Free (edict_t *ed);
 void ED_ClearEdict (edict_t *e);
 
@@ -403,5 +486,9 @@ void SaveData_Init (savedata_t *save);
 void SaveData_Clear (savedata_t *save);
 void SaveData_Fill (savedata_t *save);
 void SaveData_WriteHeader (savedata_t *save);
+qboolean SaveData_WriteBinary (savedata_t *save);
+qboolean SaveData_ReadBinaryHeader (savedata_t *save, savereader_t *r);
+int SaveData_ReadBinary (savereader_t *r);
+void SaveData_FreeBinaryTables (void);
 
 #endif	/* QUAKE_PROGS_H */
@@ -103,6 +103,11 @@ void S_ExtraUpdate (void);
 void S_BlockSound (void);
 void S_UnblockSound (void);
 
+/* fixed-step capture of the mixed output, e.g. for rendering demos to video */
+typedef void (*sndcapturefunc_t) (const byte *data, int size);
+void S_BeginCapture (double frametime, sndcapturefunc_t write);
+void S_EndCapture (void);
+
 sfx_t *S_PrecacheSound (const char *sample);
 void S_TouchSound (const char *sample);
 void S_ClearPrecache (void);
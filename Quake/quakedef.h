@@ -249,6 +249,7 @@ typedef struct
 
 #include "cmd.h"
 #include "crc.h"
+#include "jobs.h"
 
 #include "platform.h"
 #if defined(SDL_FRAMEWORK) || defined(NO_SDL_CONFIG)
@@ -412,6 +413,7 @@ void Host_Resetdemos (void);
 void Host_SavegameComment (char text[SAVEGAME_COMMENT_LENGTH + 1]);
 void Host_WaitForSaveThread (void);
 void Host_ShutdownSave (void);
+void Host_EndSaveBench (void);
 qboolean Host_IsSaving (void);
 
 void ExtraMaps_Init (void);
@@ -437,6 +439,7 @@ extern int		current_skill;	// skill level for currently loaded level (in case
 					//  running, this reflects the level actually in use)
 
 extern qboolean		isDedicated;
+extern qboolean		isHeadless;		// client without video or input, for benchmarks
 
 extern int		minimum_memory;
 
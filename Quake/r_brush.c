@@ -316,6 +316,130 @@ static void GL_FreeLightmapData (void)
 	num_lightmap_samples = 0;
 }
 
+#define LMCACHE_KEYS	5
+
+/*
+==================
+GL_GetLightmapLayoutKey
+
+The packing only depends on the size, number of styles and
+presence of samples of each surface, in list order
+==================
+*/
+static void GL_GetLightmapLayoutKey (const int maxblack[2], unsigned key[LMCACHE_KEYS])
+{
+	unsigned	*desc;
+	int			i, count;
+
+	count = VEC_SIZE (lit_surfs);
+	desc = (unsigned *) malloc (sizeof (desc[0]) * 2 * count);
+	if (!desc)
+		Sys_Error ("GL_GetLightmapLayoutKey: out of memory (%d surfs)", count);
+
+	for (i = 0; i < count; i++)
+	{
+		const msurface_t *surf = lit_surfs[i];
+		desc[i*2+0] = ((surf->extents[0]>>4)+1) | (((surf->extents[1]>>4)+1) << 16);
+		desc[i*2+1] = GL_NumLightmapTaps (surf) | ((surf->samples != NULL) << 8);
+	}
+
+	key[0] = COM_HashBlock (desc, sizeof (desc[0]) * 2 * count);
+	key[1] = CRC_Block ((const byte *) desc, sizeof (desc[0]) * 2 * count);
+	key[2] = count;
+	key[3] = maxblack[0] | (maxblack[1] << 16);
+	key[4] = LMBLOCK_WIDTH | (LMBLOCK_HEIGHT << 16);
+
+	free (desc);
+}
+
+/*
+==================
+GL_LoadCachedLightmapLayout
+
+Cached layout: lightmap count, number of samples, number of surfaces,
+then the texture number and packed s/t position of each surface
+==================
+*/
+static qboolean GL_LoadCachedLightmapLayout (const unsigned key[LMCACHE_KEYS])
+{
+	unsigned	*data;
+	size_t		size;
+	int			i, count, smax, tmax;
+
+	data = (unsigned *) TexMgr_ReadDiskCache ("lm", key, LMCACHE_KEYS, &size);
+	if (!data)
+		return false;
+
+	count = VEC_SIZE (lit_surfs);
+	if (size != sizeof (data[0]) * (3 + 2 * count) || data[2] != (unsigned) count ||
+		data[0] - 1 >= MAX_SANITY_LIGHTMAPS)
+		goto invalid;
+
+	// validate everything before touching the surfaces
+	for (i = 0; i < count; i++)
+	{
+		const msurface_t *surf = lit_surfs[i];
+		smax = ((surf->extents[0]>>4)+1) * GL_NumLightmapTaps (surf);
+		tmax = (surf->extents[1]>>4)+1;
+		if (data[3+i*2] >= data[0] ||
+			(data[4+i*2] & 0xffff) + smax > LMBLOCK_WIDTH ||
+			(data[4+i*2] >> 16) + tmax > LMBLOCK_HEIGHT)
+			goto invalid;
+	}
+
+	lightmap_count = data[0];
+	lightmaps = (lightmap_t *) calloc (lightmap_count, sizeof (*lightmaps));
+	if (!lightmaps)
+		Sys_Error ("GL_LoadCachedLightmapLayout: out of memory (%d lightmaps)", lightmap_count);
+	num_lightmap_samples = data[1];
+
+	for (i = 0; i < count; i++)
+	{
+		msurface_t *surf = lit_surfs[i];
+		surf->lightmaptexturenum = data[3+i*2];
+		surf->light_s = data[4+i*2] & 0xffff;
+		surf->light_t = data[4+i*2] >> 16;
+	}
+
+	free (data);
+	return true;
+
+invalid:
+	free (data);
+	return false;
+}
+
+/*
+==================
+GL_SaveLightmapLayout
+==================
+*/
+static void GL_SaveLightmapLayout (const unsigned key[LMCACHE_KEYS])
+{
+	unsigned	*data;
+	size_t		size;
+	int			i, count;
+
+	count = VEC_SIZE (lit_surfs);
+	size = sizeof (data[0]) * (3 + 2 * count);
+	data = (unsigned *) malloc (size);
+	if (!data)
+		return;
+
+	data[0] = lightmap_count;
+	data[1] = num_lightmap_samples;
+	data[2] = count;
+	for (i = 0; i < count; i++)
+	{
+		const msurface_t *surf = lit_surfs[i];
+		data[3+i*2] = surf->lightmaptexturenum;
+		data[4+i*2] = (unsigned short) surf->light_s | ((unsigned short) surf->light_t << 16);
+	}
+
+	TexMgr_WriteDiskCache ("lm", key, LMCACHE_KEYS, data, size);
+	free (data);
+}
+
 /*
 ==================
 GL_PackLitSurfaces
@@ -327,6 +451,7 @@ static void GL_PackLitSurfaces (void)
 	int			maxblack[2] = {0, 0};
 	short		blackofs[2];
 	int			blacklm;
+	unsigned	cachekey[LMCACHE_KEYS];
 	msurface_t *surf;
 
 	// generate surface list
@@ -359,6 +484,14 @@ static void GL_PackLitSurfaces (void)
 		}
 	}
 
+	// same surfaces as last time? reuse the previous layout
+	if (VEC_SIZE (lit_surfs) != 0)
+	{
+		GL_GetLightmapLayoutKey (maxblack, cachekey);
+		if (GL_LoadCachedLightmapLayout (cachekey))
+			return;
+	}
+
 	blacklm = AllocBlock (maxblack[0]+1, maxblack[1]+1, &blackofs[0], &blackofs[1]);
 
 	if (VEC_SIZE (lit_surfs) == 0)
@@ -428,6 +561,8 @@ static void GL_PackLitSurfaces (void)
 			surf->light_t = blackofs[1];
 		}
 	}
+
+	GL_SaveLightmapLayout (cachekey);
 }
 
 /*
@@ -524,6 +659,9 @@ void GL_BuildLightmaps (void)
 	if (i > 64)
 		Con_DWarning("%i lightmaps exceeds standard limit of 64.\n",i);
 	//johnfitz
+
+	// level textures and lightmaps are done, start writing them to the cache
+	TexMgr_FlushDiskCache ();
 }
 
 /*
@@ -131,7 +131,8 @@ void R_MarkSurfaces (void)
 
 	r_visframecount++;
 
-	R_MarkVisSurfaces (vis);
+	if (!isHeadless) // world culling runs on the GPU
+		R_MarkVisSurfaces (vis);
 	R_AddStaticModels (vis);
 }
 
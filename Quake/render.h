@@ -119,6 +119,7 @@ void R_RenderView (void);		// must set r_refdef first
 void R_ClearEfrags (void);
 void R_CheckEfrags (void); //johnfitz
 void R_AddEfrags (entity_t *ent);
+void R_RemoveStaticEfrags (int first);
 void R_AddStaticModels (const byte *vis);
 
 void R_NewMap (void);
@@ -259,7 +259,8 @@ void Sbar_Init (void)
 	Cmd_AddCommand ("+showscores", Sbar_ShowScores);
 	Cmd_AddCommand ("-showscores", Sbar_DontShowScores);
 
-	Sbar_LoadPics ();
+	if (!isHeadless)
+		Sbar_LoadPics ();
 }
 
 
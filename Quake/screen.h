@@ -38,6 +38,15 @@ void SCR_EndLoadingPlaque (void);
 
 int SCR_ModalMessage (const char *text, float timeout); //johnfitz -- added timeout
 
+typedef void (*scrcapturefunc_t) (byte *pixels, int width, int height, void *param);
+void SCR_CaptureFrame (scrcapturefunc_t func, void *param);
+void SCR_FlushCaptures (qboolean release);
+void SCR_ShutdownCaptures (void);
+void SCR_ReadbackFrame (void);
+
+qboolean SCR_BeginDemoRender (const char *demoname, double fps);
+void SCR_EndDemoRender (void);
+
 extern	float		scr_con_current;
 extern	float		scr_conlines;		// lines of console to display
 
@@ -246,6 +246,8 @@ extern	cvar_t	timelimit;
 
 extern	server_static_t	svs;				// persistant server info
 extern	server_t		sv;					// local server
+extern	strindex_t		sv_modelnames;		// sv.model_precache positions by name
+extern	strindex_t		sv_soundnames;		// sv.sound_precache positions by name
 
 extern	client_t	*host_client;
 
@@ -264,6 +266,7 @@ void SV_DropClient (qboolean crash);
 
 void SV_SendClientMessages (void);
 void SV_ClearDatagram (void);
+void SV_InvalidateFatPVS (void);
 void SV_ReserveSignonSpace (int numbytes);
 
 int SV_ModelIndex (const char *name);
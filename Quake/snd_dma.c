@@ -32,6 +32,8 @@ static void S_Play (void);
 static void S_PlayVol (void);
 static void S_SoundList (void);
 static void S_Update_ (void);
+static void S_UpdateCapture (void);
+static void GetSoundtime (void);
 void S_StopAllSounds (qboolean clear);
 static void S_StopAllSoundsC (void);
 
@@ -67,6 +69,7 @@ portable_samplepair_t	s_rawsamples[MAX_RAW_SAMPLES];
 #define	MAX_SFX		1024
 static sfx_t	*known_sfx = NULL;	// hunk allocated [MAX_SFX]
 static int	num_sfx;
+static strindex_t	sfx_index;
 
 static sfx_t	*ambient_sfx[NUM_AMBIENTS];
 
@@ -92,6 +95,15 @@ static	cvar_t	snd_noextraupdate = {"snd_noextraupdate", "0", CVAR_NONE};
 static	cvar_t	snd_show = {"snd_show", "0", CVAR_NONE};
 static	cvar_t	_snd_mixahead = {"_snd_mixahead", "0.1", CVAR_ARCHIVE};
 
+// while capturing, the mixer is driven by a fixed frame time instead of the
+// device's play cursor, and everything it mixes is handed to the writer
+static struct
+{
+	sndcapturefunc_t	write;
+	double			frametime;
+	double			remainder;	// fractional sample pairs carried to the next frame
+} snd_capture;
+
 
 static void S_SoundInfo_f (void)
 {
@@ -215,6 +227,7 @@ void S_Init (void)
 
 	known_sfx = (sfx_t *) Hunk_AllocName (MAX_SFX*sizeof(sfx_t), "sfx_t");
 	num_sfx = 0;
+	StrIndex_Init (&sfx_index, MAX_SFX);
 
 	snd_initialized = true;
 
@@ -275,19 +288,16 @@ static sfx_t *S_FindName (const char *name)
 		Sys_Error ("Sound name too long: %s", name);
 
 // see if already loaded
-	for (i = 0; i < num_sfx; i++)
-	{
-		if (!strcmp(known_sfx[i].name, name))
-		{
-			return &known_sfx[i];
-		}
-	}
+	i = StrIndex_Find (&sfx_index, name);
+	if (i >= 0)
+		return &known_sfx[i];
 
 	if (num_sfx == MAX_SFX)
 		Sys_Error ("S_FindName: out of sfx_t");
 
-	sfx = &known_sfx[i];
+	sfx = &known_sfx[num_sfx];
 	q_strlcpy (sfx->name, name, sizeof(sfx->name));
+	StrIndex_Add (&sfx_index, sfx->name, num_sfx);
 
 	num_sfx++;
 
@@ -824,7 +834,7 @@ void S_Update (vec3_t origin, vec3_t forward, vec3_t right, vec3_t up)
 	channel_t	*ch;
 	channel_t	*combine;
 
-	if (!sound_started || (snd_blocked > 0))
+	if (!sound_started || (snd_blocked > 0 && !snd_capture.write))
 		return;
 
 	VectorCopy(origin, listener_origin);
@@ -911,7 +921,10 @@ void S_Update (vec3_t origin, vec3_t forward, vec3_t right, vec3_t up)
 //	BGM_Update();	// moved to the main loop just before S_Update ()
 
 // mix some sound
-	S_Update_();
+	if (snd_capture.write)
+		S_UpdateCapture ();
+	else
+		S_Update_();
 }
 
 static void GetSoundtime (void)
@@ -945,7 +958,7 @@ static void GetSoundtime (void)
 
 void S_ExtraUpdate (void)
 {
-	if (snd_noextraupdate.value)
+	if (snd_noextraupdate.value || snd_capture.write)
 		return;		// don't pollute timings
 	S_Update_();
 }
@@ -982,6 +995,93 @@ static void S_Update_ (void)
 	SNDDMA_Submit ();
 }
 
+/*
+============
+S_UpdateCapture
+
+Mixes exactly one frame's worth of samples and passes them to the capture writer
+============
+*/
+static void S_UpdateCapture (void)
+{
+	int		count, chunk, end, pos, bytes, fullsamples;
+	double	samples;
+
+	SNDDMA_LockBuffer ();
+	if (! shm->buffer)
+	{
+		SNDDMA_Submit ();
+		return;
+	}
+
+	samples = snd_capture.frametime * shm->speed + snd_capture.remainder;
+	count = (int) samples;
+	snd_capture.remainder = samples - count;
+
+	fullsamples = shm->samples / shm->channels;
+	bytes = shm->channels * (shm->samplebits / 8);
+
+	// the DMA buffer is a ring, so mix at most half of it at a time
+	while (count > 0)
+	{
+		chunk = q_min (count, fullsamples / 2);
+		soundtime = paintedtime;
+		S_PaintChannels (paintedtime + chunk);
+		count -= chunk;
+
+		// hand the new samples over, in two pieces if they wrap around
+		pos = (paintedtime - chunk) & (fullsamples - 1);
+		end = q_min (pos + chunk, fullsamples);
+		snd_capture.write (shm->buffer + pos * bytes, (end - pos) * bytes);
+		if (end - pos < chunk)
+			snd_capture.write (shm->buffer, (chunk - (end - pos)) * bytes);
+	}
+
+	SNDDMA_Submit ();
+}
+
+/*
+============
+S_BeginCapture
+
+Every following S_Update mixes frametime seconds of sound for write,
+regardless of the output device, which is paused in the meantime
+============
+*/
+void S_BeginCapture (double frametime, sndcapturefunc_t write)
+{
+	if (!sound_started || !shm)
+		return;
+
+	snd_capture.write = write;
+	snd_capture.frametime = frametime;
+	snd_capture.remainder = 0.0;
+
+	SNDDMA_BlockSound ();
+	S_ClearBuffer ();
+	soundtime = paintedtime;
+}
+
+/*
+============
+S_EndCapture
+============
+*/
+void S_EndCapture (void)
+{
+	if (!snd_capture.write)
+		return;
+
+	snd_capture.write = NULL;
+
+	// channels were timed against the capture clock, resync with the device
+	S_StopAllSounds (true);
+	GetSoundtime ();
+	paintedtime = soundtime;
+	if (sound_started && shm && !snd_blocked)
+		SNDDMA_UnblockSound ();
+}
+
 void S_BlockSound (void)
 {
 /* FIXME: do we really need the blocking at the
@@ -1003,7 +1103,8 @@ void S_UnblockSound (void)
 	if (snd_blocked == 1)			/* --snd_blocked == 0 */
 	{
 		snd_blocked  = 0;
-		SNDDMA_UnblockSound();
+		if (!snd_capture.write)
+			SNDDMA_UnblockSound();
 		S_ClearBuffer ();
 	}
 }
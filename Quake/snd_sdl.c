@@ -32,6 +32,11 @@
 
 static int	buffersize;
 
+/* -headless runs mix into a null device whose play cursor
+ * advances with wall time, so the mixer does its usual work */
+static qboolean	nulldevice;
+static double	nullstarttime;
+
 
 static void SDLCALL paint_audio (void *unused, Uint8 *stream, int len)
 {
@@ -74,6 +79,45 @@ static void SDLCALL paint_audio (void *unused, Uint8 *stream, int len)
 		shm->samplepos = 0;
 }
 
+static qboolean SNDDMA_InitNull (dma_t *dma)
+{
+	int		tmp, val;
+
+	memset ((void *) dma, 0, sizeof(dma_t));
+	shm = dma;
+
+	shm->samplebits = (loadas8bit.value) ? 8 : 16;
+	shm->speed = snd_mixspeed.value;
+	shm->channels = 2;
+
+	tmp = 1024 * shm->channels * 10;
+	if (tmp & (tmp - 1))
+	{	/* make it a power of two */
+		val = 1;
+		while (val < tmp)
+			val <<= 1;
+		tmp = val;
+	}
+	shm->samples = tmp;
+	shm->samplepos = 0;
+	shm->submission_chunk = 1;
+
+	buffersize = shm->samples * (shm->samplebits / 8);
+	shm->buffer = (unsigned char *) calloc (1, buffersize);
+	if (!shm->buffer)
+	{
+		shm = NULL;
+		Con_Printf ("Failed allocating memory for null audio\n");
+		return false;
+	}
+
+	nulldevice = true;
+	nullstarttime = Sys_DoubleTime ();
+	Con_Printf ("Null audio device: %d Hz, %d bytes buffer\n", shm->speed, buffersize);
+
+	return true;
+}
+
 qboolean SNDDMA_Init (dma_t *dma)
 {
 	SDL_AudioSpec desired;
@@ -81,6 +125,9 @@ qboolean SNDDMA_Init (dma_t *dma)
 	char	drivername[128];
 	const char *driver, *device;
 
+	if (isHeadless)
+		return SNDDMA_InitNull (dma);
+
 	if (SDL_InitSubSystem(SDL_INIT_AUDIO) < 0)
 	{
 		Con_Printf("Couldn't init SDL audio: %s\n", SDL_GetError());
@@ -164,6 +211,8 @@ qboolean SNDDMA_Init (dma_t *dma)
 
 int SNDDMA_GetDMAPos (void)
 {
+	if (nulldevice)
+		shm->samplepos = (int)((Sys_DoubleTime () - nullstarttime) * shm->speed * shm->channels) & (shm->samples - 1);
 	return shm->samplepos;
 }
 
@@ -171,9 +220,14 @@ void SNDDMA_Shutdown (void)
 {
 	if (shm)
 	{
-		Con_Printf ("Shutting down SDL sound\n");
-		SDL_CloseAudio();
-		SDL_QuitSubSystem(SDL_INIT_AUDIO);
+		if (nulldevice)
+			nulldevice = false;
+		else
+		{
+			Con_Printf ("Shutting down SDL sound\n");
+			SDL_CloseAudio();
+			SDL_QuitSubSystem(SDL_INIT_AUDIO);
+		}
 		if (shm->buffer)
 			free (shm->buffer);
 		shm->buffer = NULL;
@@ -183,21 +237,25 @@ void SNDDMA_Shutdown (void)
 
 void SNDDMA_LockBuffer (void)
 {
-	SDL_LockAudio ();
+	if (!nulldevice)
+		SDL_LockAudio ();
 }
 
 void SNDDMA_Submit (void)
 {
-	SDL_UnlockAudio();
+	if (!nulldevice)
+		SDL_UnlockAudio();
 }
 
 void SNDDMA_BlockSound (void)
 {
-	SDL_PauseAudio(1);
+	if (!nulldevice)
+		SDL_PauseAudio(1);
 }
 
 void SNDDMA_UnblockSound (void)
 {
-	SDL_PauseAudio(0);
+	if (!nulldevice)
+		SDL_PauseAudio(0);
 }
 
@@ -26,6 +26,8 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 server_t	sv;
 server_static_t	svs;
+strindex_t	sv_modelnames;
+strindex_t	sv_soundnames;
 
 static char	localmodels[MAX_MODELS][8];	// inline model names for precache
 
@@ -34,6 +36,9 @@ int		sv_protocol = PROTOCOL_RMQ; //johnfitz
 extern cvar_t nomonsters;
 
 static cvar_t sv_netsort = {"sv_netsort", "1", CVAR_NONE};
+static cvar_t sv_netthreads = {"sv_netthreads", "1", CVAR_NONE};
+
+static void SV_NetBench_f (void);
 
 //============================================================================
 
@@ -147,6 +152,7 @@ void SV_Init (void)
 	extern	cvar_t	sv_gravity;
 	extern	cvar_t	sv_nostep;
 	extern	cvar_t	sv_freezenonclients;
+	extern	cvar_t	sv_parallelphysics;
 	extern	cvar_t	sv_friction;
 	extern	cvar_t	sv_edgefriction;
 	extern	cvar_t	sv_stopspeed;
@@ -158,6 +164,7 @@ void SV_Init (void)
 	extern	cvar_t	sv_gameplayfix_random;
 	extern	cvar_t	sv_gameplayfix_elevators;
 	extern	cvar_t	sv_autoload;
+	extern	cvar_t	sv_savebinary;
 	extern	cvar_t	sv_autosave;
 	extern	cvar_t	sv_autosave_interval;
 
@@ -175,20 +182,32 @@ void SV_Init (void)
 	Cvar_RegisterVariable (&sv_aim);
 	Cvar_RegisterVariable (&sv_nostep);
 	Cvar_RegisterVariable (&sv_freezenonclients);
+	Cvar_RegisterVariable (&sv_parallelphysics);
 	Cvar_RegisterVariable (&pr_checkextension);
 	Cvar_RegisterVariable (&sv_altnoclip); //johnfitz
 	Cvar_RegisterVariable (&sv_gameplayfix_random);
 	Cvar_RegisterVariable (&sv_gameplayfix_elevators);
 	Cvar_RegisterVariable (&sv_netsort);
+	Cvar_RegisterVariable (&sv_netthreads);
+	Cvar_RegisterVariable (&sv_spatialhash);
+	Cvar_RegisterVariable (&sv_broadphase);
+	Cvar_RegisterVariable (&sv_hullbatch);
 	Cvar_RegisterVariable (&sv_autoload);
+	Cvar_RegisterVariable (&sv_savebinary);
 	Cvar_RegisterVariable (&sv_autosave);
 	Cvar_RegisterVariable (&sv_autosave_interval);
 
 	Cmd_AddCommand ("sv_protocol", &SV_Protocol_f); //johnfitz
+	Cmd_AddCommand ("sv_netbench", &SV_NetBench_f);
+	Cmd_AddCommand ("sv_tracebench", &SV_TraceBench_f);
+	Cmd_AddCommand ("hullbatchtest", &SV_HullBatchTest_f);
 
 	for (i=0 ; i<MAX_MODELS ; i++)
 		sprintf (localmodels[i], "*%i", i);
 
+	StrIndex_Init (&sv_modelnames, MAX_MODELS);
+	StrIndex_Init (&sv_soundnames, MAX_SOUNDS);
+
 	i = COM_CheckParm ("-protocol");
 	if (i && i < com_argc - 1)
 		sv_protocol = atoi (com_argv[i + 1]);
@@ -282,13 +301,8 @@ void SV_StartSound (edict_t *entity, int channel, const char *sample, int volume
 		return;
 
 // find precache number for sound
-	for (sound_num = 1; sound_num < MAX_SOUNDS && sv.sound_precache[sound_num]; sound_num++)
-	{
-		if (!strcmp(sample, sv.sound_precache[sound_num]))
-			break;
-	}
-
-	if (sound_num == MAX_SOUNDS || !sv.sound_precache[sound_num])
+	sound_num = StrIndex_Find (&sv_soundnames, sample);
+	if (sound_num <= 0)
 	{
 		Con_Printf ("SV_StartSound: %s not precached\n", sample);
 		return;
@@ -355,12 +369,8 @@ void SV_LocalSound (client_t *client, const char *sample)
 {
 	int	sound_num, field_mask;
 
-	for (sound_num = 1; sound_num < MAX_SOUNDS && sv.sound_precache[sound_num]; sound_num++)
-	{
-		if (!strcmp(sample, sv.sound_precache[sound_num]))
-			break;
-	}
-	if (sound_num == MAX_SOUNDS || !sv.sound_precache[sound_num])
+	sound_num = StrIndex_Find (&sv_soundnames, sample);
+	if (sound_num <= 0)
 	{
 		Con_Printf ("SV_LocalSound: %s not precached\n", sample);
 		return;
@@ -584,14 +594,70 @@ crosses a waterline.
 =============================================================================
 */
 
-static int	fatbytes;
-static byte	*fatpvs;
-static int	fatpvs_capacity;
+#define FATPVS_RADIUS		8
+#define FATPVS_MAX_LEAFS	16		// larger leaf sets aren't cached
+#define FATPVS_CACHE_SIZE	16
 
-void SV_AddToFatPVS (vec3_t org, mnode_t *node, qmodel_t *worldmodel) //johnfitz -- added worldmodel as a parameter
+// the fat pvs only depends on the set of leafs within FATPVS_RADIUS of the
+// origin, so it is cached by leaf set: a client standing still or moving
+// inside a leaf reuses the previous result instead of merging the leaf pvs again
+typedef struct
+{
+	qmodel_t	*model;
+	int			generation;
+	int			numleafs;
+	mleaf_t		*leafs[FATPVS_MAX_LEAFS];
+	int			lastused;
+	uint32_t	*pvs;
+	int			capacity;
+} fatpvscache_t;
+
+static int						fatpvs_generation;	// bumped on map change
+
+// per thread, so that entity updates can be built in parallel
+static THREAD_LOCAL fatpvscache_t	fatpvs_cache[FATPVS_CACHE_SIZE];
+static THREAD_LOCAL int				fatpvs_counter;
+static THREAD_LOCAL mleaf_t			*fatleafs[FATPVS_MAX_LEAFS];
+static THREAD_LOCAL int				numfatleafs;
+static THREAD_LOCAL uint32_t		*fatpvs;
+static THREAD_LOCAL int				fatpvs_capacity;
+
+/*
+=============
+SV_InvalidateFatPVS
+
+Called when the world model changes
+=============
+*/
+void SV_InvalidateFatPVS (void)
+{
+	fatpvs_generation++;
+}
+
+/*
+=============
+SV_MergeLeafPVS
+=============
+*/
+static void SV_MergeLeafPVS (uint32_t *dst, mleaf_t *leaf, qmodel_t *worldmodel, int numwords)
+{
+	const uint32_t	*src = (const uint32_t *) Mod_LeafPVS (leaf, worldmodel); //johnfitz -- worldmodel as a parameter
+	int				i;
+
+	for (i = 0; i < numwords; i++)
+		dst[i] |= src[i];
+}
+
+/*
+=============
+SV_AddToFatPVS
+
+Collects the non-solid leafs within FATPVS_RADIUS of org. If there are too
+many to cache, the rest are merged straight into fatpvs.
+=============
+*/
+static void SV_AddToFatPVS (vec3_t org, mnode_t *node, qmodel_t *worldmodel, int numwords) //johnfitz -- added worldmodel as a parameter
 {
-	int		i;
-	byte	*pvs;
 	mplane_t	*plane;
 	float	d;
 
@@ -602,22 +668,28 @@ void SV_AddToFatPVS (vec3_t org, mnode_t *node, qmodel_t *worldmodel) //johnfitz
 		{
 			if (node->contents != CONTENTS_SOLID)
 			{
-				pvs = Mod_LeafPVS ( (mleaf_t *)node, worldmodel); //johnfitz -- worldmodel as a parameter
-				for (i=0 ; i<fatbytes ; i++)
-					fatpvs[i] |= pvs[i];
+				if (numfatleafs < FATPVS_MAX_LEAFS)
+					fatleafs[numfatleafs] = (mleaf_t *)node;
+				else
+				{
+					if (numfatleafs == FATPVS_MAX_LEAFS)
+						Q_memset (fatpvs, 0, numwords * 4);
+					SV_MergeLeafPVS (fatpvs, (mleaf_t *)node, worldmodel, numwords);
+				}
+				numfatleafs++;
 			}
 			return;
 		}
 
 		plane = node->plane;
 		d = DotProduct (org, plane->normal) - plane->dist;
-		if (d > 8)
+		if (d > FATPVS_RADIUS)
 			node = node->children[0];
-		else if (d < -8)
+		else if (d < -FATPVS_RADIUS)
 			node = node->children[1];
 		else
 		{	// go down both
-			SV_AddToFatPVS (org, node->children[0], worldmodel); //johnfitz -- worldmodel as a parameter
+			SV_AddToFatPVS (org, node->children[0], worldmodel, numwords); //johnfitz -- worldmodel as a parameter
 			node = node->children[1];
 		}
 	}
@@ -633,31 +705,79 @@ given point.
 */
 byte *SV_FatPVS (vec3_t org, qmodel_t *worldmodel) //johnfitz -- added worldmodel as a parameter
 {
+	int				i, fatbytes, numwords;
+	fatpvscache_t	*entry, *oldest;
+
 	fatbytes = (worldmodel->numleafs+7)>>3; // ericw -- was +31, assumed to be a bug/typo
 	fatbytes = (fatbytes + VIS_ALIGN_MASK) & ~VIS_ALIGN_MASK; // round up
+	numwords = fatbytes / 4;
 	if (fatpvs == NULL || fatbytes > fatpvs_capacity)
 	{
 		fatpvs_capacity = fatbytes;
-		fatpvs = (byte *) realloc (fatpvs, fatpvs_capacity);
+		fatpvs = (uint32_t *) realloc (fatpvs, fatpvs_capacity);
 		if (!fatpvs)
 			Sys_Error ("SV_FatPVS: realloc() failed on %d bytes", fatpvs_capacity);
 	}
-	
-	Q_memset (fatpvs, 0, fatbytes);
-	SV_AddToFatPVS (org, worldmodel->nodes, worldmodel); //johnfitz -- worldmodel as a parameter
-	return fatpvs;
+
+	numfatleafs = 0;
+	SV_AddToFatPVS (org, worldmodel->nodes, worldmodel, numwords); //johnfitz -- worldmodel as a parameter
+	if (numfatleafs > FATPVS_MAX_LEAFS)
+	{
+		for (i = 0; i < FATPVS_MAX_LEAFS; i++)
+			SV_MergeLeafPVS (fatpvs, fatleafs[i], worldmodel, numwords);
+		return (byte *) fatpvs;
+	}
+
+	// the leafs are always visited in the same order, so the lists can be compared directly
+	fatpvs_counter++;
+	oldest = &fatpvs_cache[0];
+	for (i = 0, entry = fatpvs_cache; i < FATPVS_CACHE_SIZE; i++, entry++)
+	{
+		if (entry->model == worldmodel && entry->generation == fatpvs_generation &&
+			entry->numleafs == numfatleafs && !memcmp (entry->leafs, fatleafs, sizeof (fatleafs[0]) * numfatleafs))
+		{
+			entry->lastused = fatpvs_counter;
+			return (byte *) entry->pvs;
+		}
+		if (entry->lastused - oldest->lastused < 0)
+			oldest = entry;
+	}
+
+	entry = oldest;
+	if (entry->pvs == NULL || fatbytes > entry->capacity)
+	{
+		entry->capacity = fatbytes;
+		entry->pvs = (uint32_t *) realloc (entry->pvs, entry->capacity);
+		if (!entry->pvs)
+			Sys_Error ("SV_FatPVS: realloc() failed on %d bytes", entry->capacity);
+	}
+	entry->model = worldmodel;
+	entry->generation = fatpvs_generation;
+	entry->numleafs = numfatleafs;
+	memcpy (entry->leafs, fatleafs, sizeof (fatleafs[0]) * numfatleafs);
+	entry->lastused = fatpvs_counter;
+
+	Q_memset (entry->pvs, 0, fatbytes);
+	for (i = 0; i < numfatleafs; i++)
+		SV_MergeLeafPVS (entry->pvs, fatleafs[i], worldmodel, numwords);
+
+	return (byte *) entry->pvs;
 }
 
 /*
 =============
 SV_EdictInPVS
+
+Tests the leaf masks built by SV_LinkEdict against the pvs one word at a time
 =============
 */
 qboolean SV_EdictInPVS (edict_t *test, byte *pvs)
 {
-	int i;
-	for (i = 0 ; i < test->num_leafs ; i++)
-		if (pvs[test->leafnums[i] >> 3] & (1 << (test->leafnums[i] & 7)))
+	const uint32_t	*words = (const uint32_t *) pvs;
+	int				i;
+
+	for (i = 0 ; i < test->num_leafwords ; i++)
+		if (words[test->leafwords[i]] & test->leafmasks[i])
 			return true;
 	return false;
 }
@@ -684,26 +804,80 @@ qboolean SV_VisibleToClient (edict_t *client, edict_t *test, qmodel_t *worldmode
 
 #define MAX_NET_EDICTS 65536
 
-static uint16_t		net_edicts[MAX_NET_EDICTS];
-static byte			net_edict_dists[MAX_NET_EDICTS];
-static int			net_edict_bins[256];
-static uint16_t		net_edicts_sorted[MAX_NET_EDICTS];
+typedef struct
+{
+	uint16_t		edicts[MAX_NET_EDICTS];
+	byte			dists[MAX_NET_EDICTS];
+	int				bins[256];
+	uint16_t		sorted[MAX_NET_EDICTS];
+} netedicts_t;
+
+static THREAD_LOCAL netedicts_t	*net_scratch;
+
+/*
+=============
+SV_UpdateEntityFields
+
+Updates the alpha and scale of all edicts from their QC fields, once per frame
+before any entity updates are written, so that those only read the edicts
+=============
+*/
+static void SV_UpdateEntityFields (void)
+{
+	int		e;
+	eval_t	*val;
+	edict_t	*ent;
+
+	ent = NEXT_EDICT(qcvm->edicts);
+	for (e=1 ; e<qcvm->num_edicts ; e++, ent = NEXT_EDICT(ent))
+	{
+		if (ent->free || !ent->v.modelindex)
+			continue;
+
+		//johnfitz -- alpha
+		val = GetEdictFieldValue (ent, qcvm->extfields.alpha);
+		if (val)
+			ent->alpha = ENTALPHA_ENCODE(val->_float);
+
+		val = GetEdictFieldValue (ent, qcvm->extfields.scale);
+		if (val)
+			ent->scale = ENTSCALE_ENCODE(val->_float);
+		else
+			ent->scale = ENTSCALE_DEFAULT;
+	}
+}
 
 /*
 =============
 SV_WriteEntitiesToClient
 
+Only reads the edicts and writes to msg, so it can run on any thread
+as long as nothing else modifies the edicts in the meantime.
+Returns false if the packet overflowed.
 =============
 */
-void SV_WriteEntitiesToClient (edict_t	*clent, sizebuf_t *msg)
+qboolean SV_WriteEntitiesToClient (edict_t	*clent, sizebuf_t *msg)
 {
 	int		e, i, j, numents;
 	int		bits;
 	byte	*pvs;
 	vec3_t	org, forward, right, up;
 	float	miss, dist, size;
-	eval_t	*val;
 	edict_t	*ent;
+	uint16_t	*net_edicts, *net_edicts_sorted;
+	byte		*net_edict_dists;
+	int			*net_edict_bins;
+
+	if (!net_scratch)
+	{
+		net_scratch = (netedicts_t *) malloc (sizeof (*net_scratch));
+		if (!net_scratch)
+			Sys_Error ("SV_WriteEntitiesToClient: out of memory");
+	}
+	net_edicts = net_scratch->edicts;
+	net_edicts_sorted = net_scratch->sorted;
+	net_edict_dists = net_scratch->dists;
+	net_edict_bins = net_scratch->bins;
 
 // find the client's PVS
 	VectorAdd (clent->v.origin, clent->v.view_ofs, org);
@@ -713,7 +887,7 @@ void SV_WriteEntitiesToClient (edict_t	*clent, sizebuf_t *msg)
 	AngleVectors (clent->v.v_angle, forward, right, up);
 
 // reset sorting bins
-	memset (net_edict_bins, 0, sizeof (net_edict_bins));
+	memset (net_edict_bins, 0, sizeof (net_scratch->bins));
 
 // add clent
 	if (sv_netsort.value)
@@ -741,17 +915,13 @@ void SV_WriteEntitiesToClient (edict_t	*clent, sizebuf_t *msg)
 				continue;
 
 			// ignore if not touching a PV leaf
-			for (i=0 ; i < ent->num_leafs ; i++)
-				if (pvs[ent->leafnums[i] >> 3] & (1 << (ent->leafnums[i]&7) ))
-					break;
-			
 			// ericw -- added ent->num_leafs < MAX_ENT_LEAFS condition.
 			//
 			// if ent->num_leafs == MAX_ENT_LEAFS, the ent is visible from too many leafs
 			// for us to say whether it's in the PVS, so don't try to vis cull it.
 			// this commonly happens with rotators, because they often have huge bboxes
 			// spanning the entire map, or really tall lifts, etc.
-			if (i == ent->num_leafs && ent->num_leafs < MAX_ENT_LEAFS)
+			if (ent->num_leafs < MAX_ENT_LEAFS && !SV_EdictInPVS (ent, pvs))
 				continue;		// not visible
 
 			if (sv_netsort.value)
@@ -795,7 +965,7 @@ void SV_WriteEntitiesToClient (edict_t	*clent, sizebuf_t *msg)
 	{
 		// compute bin offsets
 		e = 0;
-		for (i=0 ; i<countof(net_edict_bins) ; i++)
+		for (i=0 ; i<countof(net_scratch->bins) ; i++)
 		{
 			int tmp = net_edict_bins[i];
 			net_edict_bins[i] = e;
@@ -818,16 +988,7 @@ void SV_WriteEntitiesToClient (edict_t	*clent, sizebuf_t *msg)
 		// For float coords and angles the limit is 40.
 		// FIXME: Use tighter limit according to protocol flags and send bits.
 		if (msg->cursize + 40 > msg->maxsize)
-		{
-			//johnfitz -- less spammy overflow message
-			if (!dev_overflows.packetsize || dev_overflows.packetsize + CONSOLE_RESPAM_TIME < realtime )
-			{
-				Con_Printf ("Packet overflow!\n");
-				dev_overflows.packetsize = realtime;
-			}
-			goto stats;
-			//johnfitz
-		}
+			return false;
 
 // send an update
 		bits = 0;
@@ -866,23 +1027,12 @@ void SV_WriteEntitiesToClient (edict_t	*clent, sizebuf_t *msg)
 		if (ent->baseline.modelindex != ent->v.modelindex)
 			bits |= U_MODEL;
 
-		//johnfitz -- alpha
-		// TODO: find a cleaner place to put this code
-		val = GetEdictFieldValueByName(ent, "alpha");
-		if (val)
-			ent->alpha = ENTALPHA_ENCODE(val->_float);
-
+		//johnfitz -- alpha (updated by SV_UpdateEntityFields)
 		//don't send invisible entities unless they have effects
 		if (ent->alpha == ENTALPHA_ZERO && !((int)ent->v.effects & qcvm->effects_mask))
 			continue;
 		//johnfitz
 
-		val = GetEdictFieldValueByName(ent, "scale");
-		if (val)
-			ent->scale = ENTSCALE_ENCODE(val->_float);
-		else
-			ent->scale = ENTSCALE_DEFAULT;
-
 		//johnfitz -- PROTOCOL_FITZQUAKE
 		if (sv.protocol != PROTOCOL_NETQUAKE)
 		{
@@ -960,8 +1110,28 @@ void SV_WriteEntitiesToClient (edict_t	*clent, sizebuf_t *msg)
 		//johnfitz
 	}
 
+	return true;
+}
+
+/*
+=============
+SV_UpdatePacketStats
+=============
+*/
+static void SV_UpdatePacketStats (sizebuf_t *msg, qboolean overflow)
+{
+	if (overflow)
+	{
+		//johnfitz -- less spammy overflow message
+		if (!dev_overflows.packetsize || dev_overflows.packetsize + CONSOLE_RESPAM_TIME < realtime )
+		{
+			Con_Printf ("Packet overflow!\n");
+			dev_overflows.packetsize = realtime;
+		}
+		//johnfitz
+	}
+
 	//johnfitz -- devstats
-stats:
 	if (msg->cursize > 1024 && dev_peakstats.packetsize <= 1024)
 		Con_DWarning ("%i byte packet exceeds standard limit of 1024 (max = %d).\n", msg->cursize, msg->maxsize);
 	dev_stats.packetsize = msg->cursize;
@@ -1179,39 +1349,150 @@ void SV_WriteClientdataToMessage (edict_t *ent, sizebuf_t *msg)
 	}
 }
 
+/*
+=============================================================================
+
+Entity updates are the bulk of the per-client work and don't modify anything,
+so they are built for all clients at once, in parallel, after the client data
+(which does have side effects) has been written on the main thread. Each client
+gets its own buffer, so the result doesn't depend on the number of threads.
+
+=============================================================================
+*/
+
+typedef struct
+{
+	edict_t		*clent;		// NULL if the slot isn't used
+	sizebuf_t	msg;
+	qboolean	overflow;
+} netdatagram_t;
+
+static netdatagram_t	*sv_netdatagrams;
+static byte				*sv_netdatagram_bufs;
+static int				sv_numnetdatagrams;
+
 /*
 =======================
-SV_SendClientDatagram
+SV_ReserveDatagrams
 =======================
 */
-qboolean SV_SendClientDatagram (client_t *client)
+static void SV_ReserveDatagrams (int count)
 {
-	byte		buf[MAX_DATAGRAM];
-	sizebuf_t	msg;
+	if (count <= sv_numnetdatagrams)
+		return;
 
-	msg.data = buf;
-	msg.maxsize = sizeof(buf);
-	msg.cursize = 0;
+	sv_netdatagrams = (netdatagram_t *) realloc (sv_netdatagrams, sizeof (sv_netdatagrams[0]) * count);
+	sv_netdatagram_bufs = (byte *) realloc (sv_netdatagram_bufs, (size_t) MAX_DATAGRAM * count);
+	if (!sv_netdatagrams || !sv_netdatagram_bufs)
+		Sys_Error ("SV_ReserveDatagrams: out of memory (%d clients)", count);
+	sv_numnetdatagrams = count;
+}
 
-	//johnfitz -- if client is nonlocal, use smaller max size so packets aren't fragmented
-	if (Q_strcmp(NET_QSocketGetAddressString(client->netconnection), "LOCAL") != 0)
-		msg.maxsize = DATAGRAM_MTU;
-	//johnfitz
+/*
+=======================
+SV_WriteEntitiesJob
+=======================
+*/
+static void SV_WriteEntitiesJob (int index, void *param)
+{
+	netdatagram_t	*dg = (netdatagram_t *) param + index;
+	qcvm_t			*oldvm;
+
+	if (!dg->clent)
+		return;
+
+	PR_PushQCVM (&sv.qcvm, &oldvm);
+	dg->overflow = !SV_WriteEntitiesToClient (dg->clent, &dg->msg);
+	PR_PopQCVM (oldvm);
+}
+
+/*
+=======================
+SV_WriteAllEntities
+=======================
+*/
+static void SV_WriteAllEntities (netdatagram_t *list, int count, qboolean threaded)
+{
+	int i;
+
+	if (threaded && count > 1 && Jobs_NumWorkers () > 0)
+		Jobs_ParallelFor (SV_WriteEntitiesJob, list, count, 1);
+	else
+		for (i = 0; i < count; i++)
+			SV_WriteEntitiesJob (i, list);
+}
+
+/*
+=======================
+SV_BuildClientDatagrams
+=======================
+*/
+static void SV_BuildClientDatagrams (void)
+{
+	int		i;
+	qboolean	any = false;
+
+	SV_ReserveDatagrams (svs.maxclients);
 
-	MSG_WriteByte (&msg, svc_time);
-	MSG_WriteFloat (&msg, qcvm->time);
+	for (i=0, host_client = svs.clients ; i<svs.maxclients ; i++, host_client++)
+	{
+		netdatagram_t *dg = &sv_netdatagrams[i];
 
-// add the client specific data to the datagram
-	SV_WriteClientdataToMessage (client->edict, &msg);
+		dg->clent = NULL;
+		if (!host_client->active || !host_client->spawned)
+			continue;
+
+		dg->clent = host_client->edict;
+		dg->overflow = false;
+		dg->msg.data = sv_netdatagram_bufs + (size_t) MAX_DATAGRAM * i;
+		dg->msg.maxsize = MAX_DATAGRAM;
+		dg->msg.cursize = 0;
+		dg->msg.allowoverflow = false;
+		dg->msg.overflowed = false;
+
+		//johnfitz -- if client is nonlocal, use smaller max size so packets aren't fragmented
+		if (Q_strcmp(NET_QSocketGetAddressString(host_client->netconnection), "LOCAL") != 0)
+			dg->msg.maxsize = DATAGRAM_MTU;
+		//johnfitz
 
-	SV_WriteEntitiesToClient (client->edict, &msg);
+		MSG_WriteByte (&dg->msg, svc_time);
+		MSG_WriteFloat (&dg->msg, qcvm->time);
+
+	// add the client specific data to the datagram
+		SV_WriteClientdataToMessage (host_client->edict, &dg->msg);
+		any = true;
+	}
+
+	if (!any)
+		return;
+
+	SV_UpdateEntityFields ();
+	SV_WriteAllEntities (sv_netdatagrams, svs.maxclients, sv_netthreads.value != 0.f);
+
+	for (i = 0; i < svs.maxclients; i++)
+		if (sv_netdatagrams[i].clent)
+			SV_UpdatePacketStats (&sv_netdatagrams[i].msg, sv_netdatagrams[i].overflow);
+}
+
+/*
+=======================
+SV_SendClientDatagram
+=======================
+*/
+qboolean SV_SendClientDatagram (client_t *client)
+{
+	netdatagram_t	*dg = &sv_netdatagrams[client - svs.clients];
+	sizebuf_t		*msg = &dg->msg;
+
+	if (!dg->clent)
+		return true;
 
 // copy the server datagram if there is space
-	if (msg.cursize + sv.datagram.cursize < msg.maxsize)
-		SZ_Write (&msg, sv.datagram.data, sv.datagram.cursize);
+	if (msg->cursize + sv.datagram.cursize < msg->maxsize)
+		SZ_Write (msg, sv.datagram.data, sv.datagram.cursize);
 
 // send the datagram
-	if (NET_SendUnreliableMessage (client->netconnection, &msg) == -1)
+	if (NET_SendUnreliableMessage (client->netconnection, msg) == -1)
 	{
 		SV_DropClient (true);// if the message couldn't send, kick off
 		return false;
@@ -1220,6 +1501,99 @@ qboolean SV_SendClientDatagram (client_t *client)
 	return true;
 }
 
+/*
+=======================
+SV_NetBench_f
+
+Times building the entity updates for 16, 32 and 64 simulated clients
+placed at the players and monsters, serially and in parallel
+=======================
+*/
+static void SV_NetBench_f (void)
+{
+	static const int	counts[] = {16, 32, 64};
+	const int			maxviews = 64;
+	edict_t				*views[64];
+	netdatagram_t		*dgs;
+	byte				*bufs;
+	edict_t				*ent;
+	int					numviews, frames, e, i, pass, frame, c;
+	double				start, times[2];
+	qboolean			identical;
+
+	if (!sv.active)
+	{
+		Con_Printf ("Not running a local server.\n");
+		return;
+	}
+
+	frames = Cmd_Argc () > 1 ? q_max (atoi (Cmd_Argv (1)), 1) : 100;
+
+	numviews = 0;
+	ent = NEXT_EDICT(qcvm->edicts);
+	for (e=1 ; e<qcvm->num_edicts && numviews<maxviews ; e++, ent = NEXT_EDICT(ent))
+		if (!ent->free && ent->num_leafs && ((int)ent->v.flags & (FL_CLIENT|FL_MONSTER)))
+			views[numviews++] = ent;
+	if (!numviews)
+	{
+		Con_Printf ("No players or monsters to use as viewpoints.\n");
+		return;
+	}
+
+	dgs = (netdatagram_t *) malloc (sizeof (dgs[0]) * 2 * maxviews);
+	bufs = (byte *) malloc ((size_t) MAX_DATAGRAM * 2 * maxviews);
+	if (!dgs || !bufs)
+	{
+		free (dgs);
+		free (bufs);
+		Con_Printf ("Out of memory.\n");
+		return;
+	}
+
+	SV_UpdateEntityFields ();
+
+	Con_Printf ("%d viewpoints, %d frames, %d worker threads\n", numviews, frames, Jobs_NumWorkers ());
+	Con_Printf ("clients  serial ms  parallel ms\n");
+	for (c = 0; c < countof (counts); c++)
+	{
+		for (pass = 0; pass < 2; pass++)
+		{
+			netdatagram_t *list = dgs + pass * maxviews;
+
+			start = Sys_DoubleTime ();
+			for (frame = 0; frame < frames; frame++)
+			{
+				for (i = 0; i < counts[c]; i++)
+				{
+					list[i].clent = views[i % numviews];
+					list[i].overflow = false;
+					list[i].msg.data = bufs + (size_t) MAX_DATAGRAM * (pass * maxviews + i);
+					list[i].msg.maxsize = MAX_DATAGRAM;
+					list[i].msg.cursize = 0;
+					list[i].msg.allowoverflow = false;
+					list[i].msg.overflowed = false;
+				}
+				SV_WriteAllEntities (list, counts[c], pass == 1);
+			}
+			times[pass] = (Sys_DoubleTime () - start) * 1000.0 / frames;
+		}
+
+		identical = true;
+		for (i = 0; i < counts[c]; i++)
+		{
+			sizebuf_t *a = &dgs[i].msg;
+			sizebuf_t *b = &dgs[maxviews + i].msg;
+			if (a->cursize != b->cursize || memcmp (a->data, b->data, a->cursize) != 0)
+				identical = false;
+		}
+
+		Con_Printf ("%7d  %9.3f  %11.3f%s\n", counts[c], times[0], times[1], identical ? "" : "  (output mismatch!)");
+	}
+
+	free (dgs);
+	free (bufs);
+}
+
 /*
 =======================
 SV_WriteStats
@@ -1380,6 +1754,9 @@ void SV_SendClientMessages (void)
 // update frags, names, etc
 	SV_UpdateToReliableMessages ();
 
+// write the unreliable updates for everyone in the game
+	SV_BuildClientDatagrams ();
+
 // build individual updates
 	for (i=0, host_client = svs.clients ; i<svs.maxclients ; i++, host_client++)
 	{
@@ -1525,10 +1902,8 @@ int SV_ModelIndex (const char *name)
 	if (!name || !name[0])
 		return 0;
 
-	for (i=0 ; i<MAX_MODELS && sv.model_precache[i] ; i++)
-		if (!strcmp(sv.model_precache[i], name))
-			return i;
-	if (i==MAX_MODELS || !sv.model_precache[i])
+	i = StrIndex_Find (&sv_modelnames, name);
+	if (i < 0)
 		Sys_Error ("SV_ModelIndex: model %s not precached", name);
 	return i;
 }
@@ -1828,10 +2203,16 @@ void SV_SpawnServer (const char *server)
 	sv.sound_precache[0] = dummy;
 	sv.model_precache[0] = dummy;
 	sv.model_precache[1] = sv.modelname;
+	StrIndex_Clear (&sv_soundnames);
+	StrIndex_Clear (&sv_modelnames);
+	StrIndex_Add (&sv_soundnames, dummy, 0);
+	StrIndex_Add (&sv_modelnames, dummy, 0);
+	StrIndex_Add (&sv_modelnames, sv.modelname, 1);
 	for (i=1 ; i<sv.worldmodel->numsubmodels ; i++)
 	{
 		sv.model_precache[1+i] = localmodels[i];
 		sv.models[i+1] = Mod_ForName (localmodels[i], false);
+		StrIndex_Add (&sv_modelnames, localmodels[i], 1+i);
 	}
 
 //
@@ -1860,6 +2241,7 @@ void SV_SpawnServer (const char *server)
 
 // all setup is completed, any further precache statements are errors
 	sv.state = ss_active;
+	StrIndex_PrintStats ("server precache");
 
 // run two frames to allow everything to settle
 	host_frametime = 0.1;
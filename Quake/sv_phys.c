@@ -47,6 +47,7 @@ cvar_t	sv_gravity = {"sv_gravity","800",CVAR_NOTIFY|CVAR_SERVERINFO};
 cvar_t	sv_maxvelocity = {"sv_maxvelocity","2000",CVAR_NONE};
 cvar_t	sv_nostep = {"sv_nostep","0",CVAR_NONE};
 cvar_t	sv_freezenonclients = {"sv_freezenonclients","0",CVAR_NONE};
+cvar_t	sv_parallelphysics = {"sv_parallelphysics","0",CVAR_NONE};	// 2 = also check against the serial moves
 
 
 #define	MOVE_EPSILON	0.01
@@ -393,6 +394,202 @@ PUSHMOVE
 ===============================================================================
 */
 
+/*
+===============================================================================
+
+PARALLEL MOVES
+
+With sv_parallelphysics, the moves that toss, bounce and fly entities are
+going to make this frame are traced ahead of time on the worker threads.
+Everything else still runs in edict order on the main thread, and a
+predicted trace is only used if nothing it depends on has changed in the
+meantime, so the result is the same as with the cvar off.
+
+===============================================================================
+*/
+
+#define	MIN_PARALLEL_MOVES	16
+
+static	movepredict_t	*sv_predicts;
+static	edict_t			**sv_predictents;
+static	int				sv_numpredicts;
+static	int				sv_maxpredicts;
+
+/*
+============
+SV_PushMoveType
+
+The kind of move SV_PushEntity makes for ent
+============
+*/
+static int SV_PushMoveType (edict_t *ent)
+{
+	if (ent->v.movetype == MOVETYPE_FLYMISSILE)
+		return MOVE_MISSILE;
+	if (ent->v.solid == SOLID_TRIGGER || ent->v.solid == SOLID_NOT)
+		return MOVE_NOMONSTERS;	// only clip against bmodels
+	return MOVE_NORMAL;
+}
+
+/*
+============
+SV_PredictPushJob
+============
+*/
+static void SV_PredictPushJob (int index, void *param)
+{
+	qcvm_t	*oldvm;
+
+	PR_PushQCVM (&sv.qcvm, &oldvm);
+	SV_PredictMove (&sv_predicts[index]);
+	PR_PopQCVM (oldvm);
+}
+
+/*
+============
+SV_PredictTossMoves
+
+Works out the moves SV_Physics_Toss is about to make, the same way it does,
+and traces them in parallel
+============
+*/
+static void SV_PredictTossMoves (int entity_cap)
+{
+	int				i, j, count;
+	edict_t			*ent;
+	vec3_t			velocity;
+	float			ent_gravity;
+	eval_t			*val;
+	movepredict_t	*mp;
+
+	sv_numpredicts = 0;
+	if (!sv_parallelphysics.value || Jobs_NumWorkers () <= 0)
+		return;
+
+	for (i = svs.maxclients + 1, count = 0; i < entity_cap; i++)
+	{
+		ent = EDICT_NUM (i);
+		if (!ent->free && (ent->v.movetype == MOVETYPE_TOSS || ent->v.movetype == MOVETYPE_GIB ||
+			ent->v.movetype == MOVETYPE_BOUNCE || ent->v.movetype == MOVETYPE_FLY || ent->v.movetype == MOVETYPE_FLYMISSILE))
+			count++;
+	}
+	if (count < MIN_PARALLEL_MOVES)
+		return;
+
+	if (count > sv_maxpredicts)
+	{
+		sv_maxpredicts = count;
+		sv_predicts = (movepredict_t *) realloc (sv_predicts, sizeof (*sv_predicts) * count);
+		sv_predictents = (edict_t **) realloc (sv_predictents, sizeof (*sv_predictents) * count);
+		if (!sv_predicts || !sv_predictents)
+			Sys_Error ("SV_PredictTossMoves: out of memory (%d moves)", count);
+	}
+
+	for (i = svs.maxclients + 1; i < entity_cap; i++)
+	{
+		ent = EDICT_NUM (i);
+		if (ent->free)
+			continue;
+		if (ent->v.movetype != MOVETYPE_TOSS && ent->v.movetype != MOVETYPE_GIB && ent->v.movetype != MOVETYPE_BOUNCE &&
+			ent->v.movetype != MOVETYPE_FLY && ent->v.movetype != MOVETYPE_FLYMISSILE)
+			continue;
+		if ((int)ent->v.flags & FL_ONGROUND)
+			continue;
+		if (ent->v.nextthink > 0 && ent->v.nextthink <= qcvm->time + host_frametime)
+			continue;	// QC gets to run before the move
+
+	// same velocity as SV_CheckVelocity and SV_AddGravity will give
+		for (j = 0; j < 3; j++)
+		{
+			if (IS_NAN (ent->v.velocity[j]) || IS_NAN (ent->v.origin[j]))
+				break;
+			velocity[j] = ent->v.velocity[j];
+			if (velocity[j] > sv_maxvelocity.value)
+				velocity[j] = sv_maxvelocity.value;
+			else if (velocity[j] < -sv_maxvelocity.value)
+				velocity[j] = -sv_maxvelocity.value;
+		}
+		if (j < 3)
+			continue;
+		if (ent->v.movetype != MOVETYPE_FLY && ent->v.movetype != MOVETYPE_FLYMISSILE)
+		{
+			val = GetEdictFieldValueByName (ent, "gravity");
+			if (val && val->_float)
+				ent_gravity = val->_float;
+			else
+				ent_gravity = 1.0;
+			velocity[2] -= ent_gravity * sv_gravity.value * host_frametime;
+		}
+
+		mp = &sv_predicts[sv_numpredicts];
+		sv_predictents[sv_numpredicts++] = ent;
+		VectorCopy (ent->v.origin, mp->start);
+		VectorCopy (ent->v.mins, mp->mins);
+		VectorCopy (ent->v.maxs, mp->maxs);
+		VectorScale (velocity, host_frametime, mp->end);
+		VectorAdd (mp->start, mp->end, mp->end);
+		mp->type = SV_PushMoveType (ent);
+		mp->passedict = ent;
+		mp->valid = false;
+	}
+
+	if (sv_numpredicts < MIN_PARALLEL_MOVES)
+	{
+		sv_numpredicts = 0;
+		return;
+	}
+
+	Jobs_ParallelFor (SV_PredictPushJob, NULL, sv_numpredicts, 4);
+}
+
+/*
+============
+SV_PredictedPush
+
+Returns true and sets trace if ent's move was traced ahead of time
+============
+*/
+static qboolean SV_PredictedPush (edict_t *ent, vec3_t end, int type, trace_t *trace)
+{
+	int				lo, hi, mid;
+	movepredict_t	*mp;
+	trace_t			check;
+
+	// sv_predictents is in edict order
+	lo = 0;
+	hi = sv_numpredicts - 1;
+	while (lo <= hi)
+	{
+		mid = (lo + hi) / 2;
+		if (sv_predictents[mid] == ent)
+			break;
+		if (sv_predictents[mid] < ent)
+			lo = mid + 1;
+		else
+			hi = mid - 1;
+	}
+	if (lo > hi)
+		return false;
+
+	mp = &sv_predicts[mid];
+	if (!SV_MovePredicted (mp, ent->v.origin, ent->v.mins, ent->v.maxs, end, type, ent, trace))
+		return false;
+	mp->valid = false;	// one move per frame
+
+	if (sv_parallelphysics.value >= 2)
+	{
+		check = SV_Move (ent->v.origin, ent->v.mins, ent->v.maxs, end, type, ent);
+		if (!SV_TracesEqual (trace, &check))
+		{
+			Con_Printf ("SV_PredictedPush: mismatch on edict %i (%s)\n", NUM_FOR_EDICT (ent), PR_GetString (ent->v.classname));
+			*trace = check;
+		}
+	}
+
+	return true;
+}
+
+
 /*
 ============
 SV_PushEntity
@@ -404,16 +601,13 @@ trace_t SV_PushEntity (edict_t *ent, vec3_t push)
 {
 	trace_t	trace;
 	vec3_t	end;
+	int		type;
 
 	VectorAdd (ent->v.origin, push, end);
 
-	if (ent->v.movetype == MOVETYPE_FLYMISSILE)
-		trace = SV_Move (ent->v.origin, ent->v.mins, ent->v.maxs, end, MOVE_MISSILE, ent);
-	else if (ent->v.solid == SOLID_TRIGGER || ent->v.solid == SOLID_NOT)
-	// only clip against bmodels
-		trace = SV_Move (ent->v.origin, ent->v.mins, ent->v.maxs, end, MOVE_NOMONSTERS, ent);
-	else
-		trace = SV_Move (ent->v.origin, ent->v.mins, ent->v.maxs, end, MOVE_NORMAL, ent);
+	type = SV_PushMoveType (ent);
+	if (!SV_PredictedPush (ent, end, type, &trace))
+		trace = SV_Move (ent->v.origin, ent->v.mins, ent->v.maxs, end, type, ent);
 
 	VectorCopy (trace.endpos, ent->v.origin);
 	SV_LinkEdict (ent, true);
@@ -1209,6 +1403,8 @@ void SV_Physics (void)
 	else
 	  entity_cap = qcvm->num_edicts;
 
+	SV_PredictTossMoves (entity_cap);
+
 	//for (i=0 ; i<sv.num_edicts ; i++, ent = NEXT_EDICT(ent))
 	for (i=0 ; i<entity_cap ; i++, ent = NEXT_EDICT(ent))
 	{
@@ -1252,6 +1448,8 @@ void SV_Physics (void)
 	//johnfitz
 	}
 
+	sv_numpredicts = 0;
+
 	if (pr_global_struct->force_retouch)
 		pr_global_struct->force_retouch--;
 
@@ -106,6 +106,10 @@ int Sys_FileType (const char *path);
 /* returns an FS entity type, i.e. FS_ENT_FILE or FS_ENT_DIRECTORY.
  * returns FS_ENT_NONE (0) if no such file or directory is present. */
 
+// maps the whole file read-only into memory, returns NULL on failure
+const void *Sys_MapFile (const char *path, size_t *size);
+void Sys_UnmapFile (const void *data, size_t size);
+
 qboolean Sys_IsDebuggerPresent (void);
 
 //
@@ -33,6 +33,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #endif
 #include <sys/stat.h>
 #include <sys/time.h>
+#include <sys/mman.h>
 #include <fcntl.h>
 #include <time.h>
 #include <dirent.h>
@@ -50,6 +51,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 
 qboolean		isDedicated;
+qboolean		isHeadless;
 
 #define	MAX_HANDLES		32	/* johnfitz -- was 10 */
 static FILE		*sys_handles[MAX_HANDLES];
@@ -224,6 +226,37 @@ qboolean Sys_GetFileTime (const char *path, time_t *out)
 	return true;
 }
 
+const void *Sys_MapFile (const char *path, size_t *size)
+{
+	struct stat	st;
+	void		*data;
+	int			fd;
+
+	fd = open (path, O_RDONLY);
+	if (fd == -1)
+		return NULL;
+
+	if (fstat (fd, &st) != 0 || st.st_size <= 0 || (uint64_t) st.st_size > SIZE_MAX)
+	{
+		close (fd);
+		return NULL;
+	}
+
+	data = mmap (NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close (fd); // the mapping keeps its own reference to the file
+	if (data == MAP_FAILED)
+		return NULL;
+
+	*size = (size_t) st.st_size;
+	return data;
+}
+
+void Sys_UnmapFile (const void *data, size_t size)
+{
+	if (data)
+		munmap ((void *) data, size);
+}
+
 #if defined(__linux__) || defined(__sun) || defined(sun) || defined(_AIX)
 static int Sys_NumCPUs (void)
 {
@@ -758,7 +791,7 @@ void Sys_ReportError (const char *error, ...)
 	fputs (errortxt2, stderr);
 	fputs (text, stderr);
 	fputs ("\n\n", stderr);
-	if (!isDedicated)
+	if (!isDedicated && !isHeadless)
 		PL_ErrorDialog(text);
 
 	exit (1);
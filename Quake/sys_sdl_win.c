@@ -63,6 +63,7 @@ __declspec(dllexport) DWORD NvOptimusEnablement = 1;
 __declspec(dllexport) int AmdPowerXpressRequestHighPerformance = 1;
 
 qboolean		isDedicated;
+qboolean		isHeadless;
 
 static HANDLE		hinput, houtput;
 
@@ -274,6 +275,40 @@ qboolean Sys_FileExists (const char *path)
 	return attr != INVALID_FILE_ATTRIBUTES && !(attr & (FILE_ATTRIBUTE_DIRECTORY|FILE_ATTRIBUTE_DEVICE));
 }
 
+const void *Sys_MapFile (const char *path, size_t *size)
+{
+	wchar_t			wpath[MAX_PATH];
+	HANDLE			file, mapping;
+	LARGE_INTEGER	filesize;
+	const void		*data = NULL;
+
+	UTF8ToWideString (path, wpath, countof (wpath));
+	file = CreateFileW (wpath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return NULL;
+
+	if (GetFileSizeEx (file, &filesize) && filesize.QuadPart > 0 && (uint64_t) filesize.QuadPart <= SIZE_MAX)
+	{
+		mapping = CreateFileMappingW (file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mapping)
+		{
+			data = MapViewOfFile (mapping, FILE_MAP_READ, 0, 0, 0);
+			CloseHandle (mapping); // the view keeps its own reference to the mapping
+			if (data)
+				*size = (size_t) filesize.QuadPart;
+		}
+	}
+
+	CloseHandle (file);
+	return data;
+}
+
+void Sys_UnmapFile (const void *data, size_t size)
+{
+	if (data)
+		UnmapViewOfFile (data);
+}
+
 qboolean Sys_GetFileTime (const char *path, time_t *out)
 {
 	wchar_t		wpath[MAX_PATH];
@@ -905,15 +940,15 @@ void Sys_ReportError (const char *error, ...)
 	fputws (errortxt2, stderr);
 	fputws (wtext, stderr);
 	fputws (L"\n\n", stderr);
-	if (!isDedicated)
-		PL_ErrorDialog (text);
-	else
+	if (isDedicated)
 	{
 		WriteConsoleW (houtput, errortxt2, wcslen(errortxt2), NULL, NULL);
 		WriteConsoleW (houtput, wtext,     wcslen(wtext),     NULL, NULL);
 		WriteConsoleW (houtput, L"\r\n",   2,		          NULL, NULL);
 		SDL_Delay (3000);	/* show the console 3 more seconds */
 	}
+	else if (!isHeadless)
+		PL_ErrorDialog (text);
 
 	exit (1);
 }
@@ -545,7 +545,7 @@ V_PolyBlend -- johnfitz -- moved here from gl_rmain.c
 */
 void V_PolyBlend (void)
 {
-	if (!gl_polyblend.value || !v_blend[3])
+	if (!gl_polyblend.value || !v_blend[3] || isHeadless)
 		return;
 
 	if (softemu)
@@ -56,9 +56,10 @@ HULL BOXES
 */
 
 
-static	hull_t		box_hull;
-static	mclipnode_t	box_clipnodes[6]; //johnfitz -- was dclipnode_t
-static	mplane_t	box_planes[6];
+// per thread, so that moves can be traced in parallel
+static	THREAD_LOCAL hull_t			box_hull;
+static	THREAD_LOCAL mclipnode_t	box_clipnodes[6]; //johnfitz -- was dclipnode_t
+static	THREAD_LOCAL mplane_t		box_planes[6];
 
 /*
 ===================
@@ -107,6 +108,9 @@ BSP trees instead of being compared directly.
 */
 hull_t	*SV_HullForBox (vec3_t mins, vec3_t maxs)
 {
+	if (!box_hull.clipnodes)
+		SV_InitBoxHull ();
+
 	box_planes[0].dist = maxs[0];
 	box_planes[1].dist = mins[0];
 	box_planes[2].dist = maxs[1];
@@ -198,6 +202,32 @@ typedef struct areanode_s
 
 static	areanode_t	sv_areanodes[AREA_NODES];
 static	int			sv_numareanodes;
+static	uint64_t	sv_areaseq;		// link order within the areanode lists
+
+/*
+Linked edicts are also kept in a loose 2D grid, hashed by the cell that holds
+the center of their box, so that radius and box queries only have to look at
+nearby edicts. Edicts wider than the loose margin go to a separate list that
+every query checks.
+*/
+#define GRID_CELL_SIZE		128.f
+#define GRID_LOOSE_MARGIN	128.f	// max half-size of an edict stored in a cell
+#define GRID_MAX_COORD		1048576.f
+#define GRID_BUCKETS		4096		// power of two
+
+static	link_t		sv_gridbuckets[GRID_BUCKETS];
+static	link_t		sv_gridoversize;
+static	int			sv_gridstamps[GRID_BUCKETS];
+static	int			sv_gridstamp;
+
+// 0 = linear scans, 1 = grid with the original result order, 2 = grid, any order (also used for touch links)
+// Off by default: the grid only knows where edicts were last linked, while findradius
+// looks at their current origin, so QC that moves or creates solid edicts without
+// calling setorigin can get different results than with the linear scan.
+cvar_t	sv_spatialhash = {"sv_spatialhash", "0", CVAR_NONE};
+
+static void SV_ClearGrid (void);
+static void SV_BVHClear (void);
 
 /*
 ===============
@@ -257,243 +287,1054 @@ void SV_ClearWorld (void)
 	memset (sv_areanodes, 0, sizeof(sv_areanodes));
 	sv_numareanodes = 0;
 	SV_CreateAreaNode (0, sv.worldmodel->mins, sv.worldmodel->maxs);
-}
 
+	SV_ClearGrid ();
+	SV_BVHClear ();
+	sv_areaseq = 0;
+}
 
 /*
 ===============
-SV_UnlinkEdict
-
+SV_ClearGrid
 ===============
 */
-void SV_UnlinkEdict (edict_t *ent)
+static void SV_ClearGrid (void)
 {
-	if (!ent->area.prev)
-		return;		// not linked in anywhere
-	RemoveLink (&ent->area);
-	ent->area.prev = ent->area.next = NULL;
+	int i;
+
+	for (i = 0; i < GRID_BUCKETS; i++)
+		ClearLink (&sv_gridbuckets[i]);
+	ClearLink (&sv_gridoversize);
+	memset (sv_gridstamps, 0, sizeof (sv_gridstamps));
+	sv_gridstamp = 0;
 }
 
+/*
+===============
+SV_GridCell
+===============
+*/
+static int SV_GridCell (float x)
+{
+	if (!(x > -GRID_MAX_COORD))	// also catches NaNs
+		x = -GRID_MAX_COORD;
+	else if (x > GRID_MAX_COORD)
+		x = GRID_MAX_COORD;
+	return (int) floor (x / GRID_CELL_SIZE);
+}
 
 /*
-====================
-SV_AreaTriggerEdicts
+===============
+SV_GridBucket
+===============
+*/
+static int SV_GridBucket (int cx, int cy)
+{
+	return (int) (((unsigned int) cx * 73856093u ^ (unsigned int) cy * 19349663u) & (GRID_BUCKETS - 1));
+}
 
-Spike -- just builds a list of entities within the area, rather than walking
-them and risking the list getting corrupt.
-====================
+/*
+===============
+SV_GridLinkEdict
+===============
 */
-static void
-SV_AreaTriggerEdicts ( edict_t *ent, areanode_t *node, edict_t **list, int *listcount, const int listspace )
+static void SV_GridLinkEdict (edict_t *ent)
 {
-	link_t		*l, *next;
-	edict_t		*touch;
+	float	cx, cy;
 
-// touch linked edicts
-	for (l = node->trigger_edicts.next ; l != &node->trigger_edicts ; l = next)
+	if (ent->v.absmax[0] - ent->v.absmin[0] > 2.f * GRID_LOOSE_MARGIN ||
+		ent->v.absmax[1] - ent->v.absmin[1] > 2.f * GRID_LOOSE_MARGIN)
 	{
-		next = l->next;
-		touch = EDICT_FROM_AREA(l);
-		if (touch == ent)
-			continue;
-		if (!touch->v.touch || touch->v.solid != SOLID_TRIGGER)
-			continue;
-		if (ent->v.absmin[0] > touch->v.absmax[0]
-		|| ent->v.absmin[1] > touch->v.absmax[1]
-		|| ent->v.absmin[2] > touch->v.absmax[2]
-		|| ent->v.absmax[0] < touch->v.absmin[0]
-		|| ent->v.absmax[1] < touch->v.absmin[1]
-		|| ent->v.absmax[2] < touch->v.absmin[2] )
-			continue;
+		InsertLinkBefore (&ent->gridlink, &sv_gridoversize);
+		return;
+	}
 
-		if (*listcount == listspace)
-			return; // should never happen
+	cx = 0.5f * (ent->v.absmin[0] + ent->v.absmax[0]);
+	cy = 0.5f * (ent->v.absmin[1] + ent->v.absmax[1]);
+	InsertLinkBefore (&ent->gridlink, &sv_gridbuckets[SV_GridBucket (SV_GridCell (cx), SV_GridCell (cy))]);
+}
 
-		list[*listcount] = touch;
-		(*listcount)++;
-	}
+/*
+===============
+SV_GridCollect
+===============
+*/
+static int SV_GridCollect (link_t *head, edict_t **list, int count, int maxlist)
+{
+	link_t	*l;
 
-// recurse down both sides
-	if (node->axis == -1)
-		return;
+	for (l = head->next; l != head && count < maxlist; l = l->next)
+		list[count++] = STRUCT_FROM_LINK (l, edict_t, gridlink);
 
-	if ( ent->v.absmax[node->axis] > node->dist )
-		SV_AreaTriggerEdicts ( ent, node->children[0], list, listcount, listspace );
-	if ( ent->v.absmin[node->axis] < node->dist )
-		SV_AreaTriggerEdicts ( ent, node->children[1], list, listcount, listspace );
+	return count;
 }
 
 /*
-====================
-SV_TouchLinks
+===============
+SV_GridEdicts
 
-ericw -- copy the touching edicts to an array so we can avoid
-iteating the trigger_edicts linked list while calling PR_ExecuteProgram
-which could potentially corrupt the list while it's being iterated.
-Based on code from Spike.
-====================
+Collects the linked, non-SOLID_NOT edicts that may touch the given box, in
+no particular order. With centers set, the box only has to contain the
+center of the edicts. Callers still have to test each edict.
+===============
 */
-void SV_TouchLinks (edict_t *ent)
+int SV_GridEdicts (const vec3_t mins, const vec3_t maxs, qboolean centers, edict_t **list, int maxlist)
 {
-	edict_t		**list;
-	edict_t		*touch;
-	int		old_self, old_other;
-	int		i, listcount;
-	int		mark;
-
-	mark = Hunk_LowMark ();
-	list = (edict_t **) Hunk_AllocNoFill (qcvm->num_edicts*sizeof(edict_t *));
+	float	margin = centers ? 0.f : GRID_LOOSE_MARGIN;
+	float	w, h;
+	int		x, y, x0, y0, x1, y1, b, count;
 
-	listcount = 0;
-	SV_AreaTriggerEdicts (ent, sv_areanodes, list, &listcount, qcvm->num_edicts);
+	count = SV_GridCollect (&sv_gridoversize, list, 0, maxlist);
 
-	for (i = 0; i < listcount; i++)
+	w = (maxs[0] - mins[0] + 2.f * margin) / GRID_CELL_SIZE + 2.f;
+	h = (maxs[1] - mins[1] + 2.f * margin) / GRID_CELL_SIZE + 2.f;
+	if (!(w * h < GRID_BUCKETS))
 	{
-		touch = list[i];
-	// re-validate in case of PR_ExecuteProgram having side effects that make
-	// edicts later in the list no longer touch
-		if (touch == ent)
-			continue;
-		if (!touch->v.touch || touch->v.solid != SOLID_TRIGGER)
-			continue;
-		if (ent->v.absmin[0] > touch->v.absmax[0]
-		|| ent->v.absmin[1] > touch->v.absmax[1]
-		|| ent->v.absmin[2] > touch->v.absmax[2]
-		|| ent->v.absmax[0] < touch->v.absmin[0]
-		|| ent->v.absmax[1] < touch->v.absmin[1]
-		|| ent->v.absmax[2] < touch->v.absmin[2] )
-			continue;
-		old_self = pr_global_struct->self;
-		old_other = pr_global_struct->other;
+		// covers more cells than there are buckets, just take everything
+		for (b = 0; b < GRID_BUCKETS; b++)
+			count = SV_GridCollect (&sv_gridbuckets[b], list, count, maxlist);
+		return count;
+	}
 
-		pr_global_struct->self = EDICT_TO_PROG(touch);
-		pr_global_struct->other = EDICT_TO_PROG(ent);
-		pr_global_struct->time = qcvm->time;
-		PR_ExecuteProgram (touch->v.touch);
+	x0 = SV_GridCell (mins[0] - margin);
+	y0 = SV_GridCell (mins[1] - margin);
+	x1 = SV_GridCell (maxs[0] + margin);
+	y1 = SV_GridCell (maxs[1] + margin);
 
-		pr_global_struct->self = old_self;
-		pr_global_struct->other = old_other;
+	// several cells can share a bucket, only visit each one once
+	if (++sv_gridstamp == 0)
+	{
+		memset (sv_gridstamps, 0, sizeof (sv_gridstamps));
+		sv_gridstamp = 1;
+	}
+	for (y = y0; y <= y1; y++)
+	{
+		for (x = x0; x <= x1; x++)
+		{
+			b = SV_GridBucket (x, y);
+			if (sv_gridstamps[b] == sv_gridstamp)
+				continue;
+			sv_gridstamps[b] = sv_gridstamp;
+			count = SV_GridCollect (&sv_gridbuckets[b], list, count, maxlist);
+		}
 	}
 
-// free hunk-allocated edicts array
-	Hunk_FreeToLowMark (mark);
+	return count;
 }
 
+/*
+===============
+SV_CompareEdicts
+===============
+*/
+static int SV_CompareEdicts (const void *a, const void *b)
+{
+	const edict_t *e1 = *(const edict_t **) a;
+	const edict_t *e2 = *(const edict_t **) b;
+	return (e1 > e2) - (e1 < e2);
+}
 
 /*
 ===============
-SV_FindTouchedLeafs
+SV_SortEdicts
 
+Sorts a list of edicts by number
 ===============
 */
-void SV_FindTouchedLeafs (edict_t *ent, mnode_t *node)
+void SV_SortEdicts (edict_t **list, int count)
 {
-	mplane_t	*splitplane;
-	mleaf_t		*leaf;
-	int			sides;
-	int			leafnum;
+	qsort (list, count, sizeof (*list), SV_CompareEdicts);
+}
 
-	if (node->contents == CONTENTS_SOLID)
-		return;
+/*
+Linked edicts can also be kept in a dynamic AABB tree, one per areanode list,
+when sv_broadphase is set. Leaves hold the edict box grown by BVH_FAT_MARGIN,
+so that small moves only have to be checked against the leaf instead of being
+reinserted, and the tree is kept balanced with rotations. Query results are
+sorted back into the order of the areanode walk, so traces and touches come
+out exactly the same as with the areanodes.
+*/
+#define AREA_SOLID			0
+#define AREA_TRIGGER		1
+#define AREA_SEQ_BITS		56			// areakey: node index above, link order below
 
-	if (ent->num_leafs == MAX_ENT_LEAFS)
-		return;
+#define BVH_NULL			-1
+#define BVH_FAT_MARGIN		16.f
+#define BVH_STACK			256
+#define BVH_MAX_RESULTS		256			// per SV_Move, the areanodes are used beyond that
 
-// add an efrag if the node is a leaf
+typedef struct bvhnode_s
+{
+	vec3_t		mins, maxs;
+	int			parent;			// next free node if unused
+	int			children[2];	// BVH_NULL for leaves
+	int			height;			// 0 for leaves, -1 if unused
+	edict_t		*ent;			// leaves only
+} bvhnode_t;
 
-	if ( node->contents < 0)
-	{
-		leaf = (mleaf_t *)node;
-		leafnum = leaf - sv.worldmodel->leafs - 1;
+typedef struct
+{
+	bvhnode_t	*nodes;
+	int			numnodes;
+	int			maxnodes;
+	int			freelist;
+	int			root;
+} bvhtree_t;
 
-		ent->leafnums[ent->num_leafs] = leafnum;
-		ent->num_leafs++;
-		return;
+static	bvhtree_t	sv_bvh[2];		// indexed by arealist
+static	qboolean	sv_bvhbuilt;	// only kept up to date while sv_broadphase is on
+
+// 0 = areanodes, 1 = dynamic AABB tree
+cvar_t	sv_broadphase = {"sv_broadphase", "0", CVAR_NONE};
+
+/*
+===============
+SV_BVHClear
+===============
+*/
+static void SV_BVHClear (void)
+{
+	int i;
+
+	for (i = 0; i < countof (sv_bvh); i++)
+	{
+		free (sv_bvh[i].nodes);
+		memset (&sv_bvh[i], 0, sizeof (sv_bvh[i]));
+		sv_bvh[i].freelist = BVH_NULL;
+		sv_bvh[i].root = BVH_NULL;
 	}
+	sv_bvhbuilt = false;
+}
 
-// NODE_MIXED
+/*
+===============
+SV_BVHAllocNode
+===============
+*/
+static int SV_BVHAllocNode (bvhtree_t *tree)
+{
+	bvhnode_t	*node;
+	int			i;
 
-	splitplane = node->plane;
-	sides = BOX_ON_PLANE_SIDE(ent->v.absmin, ent->v.absmax, splitplane);
+	if (tree->freelist == BVH_NULL)
+	{
+		int newmax = q_max (tree->maxnodes * 2, 256);
+		tree->nodes = (bvhnode_t *) realloc (tree->nodes, sizeof (*tree->nodes) * newmax);
+		if (!tree->nodes)
+			Sys_Error ("SV_BVHAllocNode: out of memory on %d nodes", newmax);
+		for (i = tree->maxnodes; i < newmax; i++)
+		{
+			tree->nodes[i].parent = i + 1 < newmax ? i + 1 : BVH_NULL;
+			tree->nodes[i].height = -1;
+		}
+		tree->freelist = tree->maxnodes;
+		tree->maxnodes = newmax;
+	}
 
-// recurse down the contacted sides
-	if (sides & 1)
-		SV_FindTouchedLeafs (ent, node->children[0]);
+	i = tree->freelist;
+	node = &tree->nodes[i];
+	tree->freelist = node->parent;
+	node->parent = BVH_NULL;
+	node->children[0] = node->children[1] = BVH_NULL;
+	node->height = 0;
+	node->ent = NULL;
+	tree->numnodes++;
 
-	if (sides & 2)
-		SV_FindTouchedLeafs (ent, node->children[1]);
+	return i;
 }
 
 /*
 ===============
-SV_BoxInPVS
+SV_BVHFreeNode
 ===============
 */
-qboolean SV_BoxInPVS (vec3_t mins, vec3_t maxs, byte *pvs, mnode_t *node)
+static void SV_BVHFreeNode (bvhtree_t *tree, int i)
 {
-	mplane_t	*splitplane;
-	mleaf_t		*leaf;
-	int			sides;
-	int			leafnum;
+	tree->nodes[i].parent = tree->freelist;
+	tree->nodes[i].height = -1;
+	tree->freelist = i;
+	tree->numnodes--;
+}
 
-	if (node->contents == CONTENTS_SOLID)
-		return false;
+/*
+===============
+SV_BVHUnion
+===============
+*/
+static void SV_BVHUnion (bvhnode_t *out, const bvhnode_t *a, const bvhnode_t *b)
+{
+	int i;
 
-	if (node->contents < 0)
+	for (i = 0; i < 3; i++)
 	{
-		leaf = (mleaf_t *)node;
-		leafnum = leaf - sv.worldmodel->leafs - 1;
-		return pvs[leafnum >> 3] & (1 << (leafnum & 7));
+		out->mins[i] = q_min (a->mins[i], b->mins[i]);
+		out->maxs[i] = q_max (a->maxs[i], b->maxs[i]);
 	}
+}
 
-	splitplane = node->plane;
-	sides = BOX_ON_PLANE_SIDE(mins, maxs, splitplane);
-
-	if (sides & 1 && SV_BoxInPVS (mins, maxs, pvs, node->children[0]))
-		return true;
+/*
+===============
+SV_BVHArea
 
-	if (sides & 2 && SV_BoxInPVS (mins, maxs, pvs, node->children[1]))
-		return true;
+Half the surface area of the box
+===============
+*/
+static float SV_BVHArea (const vec3_t mins, const vec3_t maxs)
+{
+	float dx = maxs[0] - mins[0];
+	float dy = maxs[1] - mins[1];
+	float dz = maxs[2] - mins[2];
+	return dx * dy + dy * dz + dz * dx;
+}
 
-	return false;
+/*
+===============
+SV_BVHUnionArea
+===============
+*/
+static float SV_BVHUnionArea (const bvhnode_t *a, const bvhnode_t *b)
+{
+	bvhnode_t u;
+	SV_BVHUnion (&u, a, b);
+	return SV_BVHArea (u.mins, u.maxs);
 }
 
 /*
 ===============
-SV_LinkEdict
+SV_BVHRefit
+===============
+*/
+static void SV_BVHRefit (bvhtree_t *tree, int i)
+{
+	bvhnode_t *node = &tree->nodes[i];
+	bvhnode_t *c0 = &tree->nodes[node->children[0]];
+	bvhnode_t *c1 = &tree->nodes[node->children[1]];
+
+	node->height = 1 + q_max (c0->height, c1->height);
+	SV_BVHUnion (node, c0, c1);
+}
 
+/*
+===============
+SV_BVHReplaceChild
 ===============
 */
-void SV_LinkEdict (edict_t *ent, qboolean touch_triggers)
+static void SV_BVHReplaceChild (bvhtree_t *tree, int parent, int oldchild, int newchild)
 {
-	areanode_t	*node;
+	if (parent == BVH_NULL)
+		tree->root = newchild;
+	else if (tree->nodes[parent].children[0] == oldchild)
+		tree->nodes[parent].children[0] = newchild;
+	else
+		tree->nodes[parent].children[1] = newchild;
+}
 
-	if (ent->area.prev)
-		SV_UnlinkEdict (ent);	// unlink from old position
+/*
+===============
+SV_BVHBalance
 
-	if (ent == qcvm->edicts)
-		return;		// don't add the world
+Rotates the taller grandchild up if node a is unbalanced,
+returns the node that took its place
+===============
+*/
+static int SV_BVHBalance (bvhtree_t *tree, int ia)
+{
+	bvhnode_t	*n = tree->nodes;
+	bvhnode_t	*a = &n[ia];
+	int			ib, ic, side, balance;
 
-	if (ent->free)
-		return;
+	if (a->children[0] == BVH_NULL || a->height < 2)
+		return ia;
 
-// set the abs box
-	VectorAdd (ent->v.origin, ent->v.mins, ent->v.absmin);
-	VectorAdd (ent->v.origin, ent->v.maxs, ent->v.absmax);
+	ib = a->children[0];
+	ic = a->children[1];
+	balance = n[ic].height - n[ib].height;
+	if (balance >= -1 && balance <= 1)
+		return ia;
 
-//
-// to make items easier to pick up and allow them to be grabbed off
-// of shelves, the abs sizes are expanded
-//
-	if ((int)ent->v.flags & FL_ITEM)
+	// rotate the taller child (c) up, a keeps the shorter one (b)
+	side = balance > 1 ? 1 : 0;
+	if (!side)
 	{
-		ent->v.absmin[0] -= 15;
-		ent->v.absmin[1] -= 15;
-		ent->v.absmax[0] += 15;
-		ent->v.absmax[1] += 15;
+		ib = a->children[1];
+		ic = a->children[0];
 	}
-	else
-	{	// because movement is clipped an epsilon away from an actual edge,
+
+	{
+		bvhnode_t	*c = &n[ic];
+		int			i0 = c->children[0];
+		int			i1 = c->children[1];
+		int			keep, give;
+
+		c->children[0] = ia;
+		c->parent = a->parent;
+		a->parent = ic;
+		SV_BVHReplaceChild (tree, c->parent, ia, ic);
+
+		// c keeps its taller child, the other one moves to a
+		if (n[i0].height > n[i1].height)
+		{
+			keep = i0;
+			give = i1;
+		}
+		else
+		{
+			keep = i1;
+			give = i0;
+		}
+		c->children[1] = keep;
+		a->children[side] = give;
+		n[give].parent = ia;
+
+		SV_BVHRefit (tree, ia);
+		SV_BVHRefit (tree, ic);
+	}
+
+	return ic;
+}
+
+/*
+===============
+SV_BVHFixUpwards
+===============
+*/
+static void SV_BVHFixUpwards (bvhtree_t *tree, int i)
+{
+	while (i != BVH_NULL)
+	{
+		i = SV_BVHBalance (tree, i);
+		SV_BVHRefit (tree, i);
+		i = tree->nodes[i].parent;
+	}
+}
+
+/*
+===============
+SV_BVHInsertLeaf
+
+Picks the sibling that adds the least surface area to the tree
+===============
+*/
+static void SV_BVHInsertLeaf (bvhtree_t *tree, int leaf)
+{
+	bvhnode_t	*n, *node;
+	int			i, sibling, oldparent, newparent;
+	float		area, combined, cost, inherit, childcost[2];
+
+	if (tree->root == BVH_NULL)
+	{
+		tree->root = leaf;
+		tree->nodes[leaf].parent = BVH_NULL;
+		return;
+	}
+
+	newparent = SV_BVHAllocNode (tree);	// may move the nodes
+	n = tree->nodes;
+
+	sibling = tree->root;
+	while (n[sibling].children[0] != BVH_NULL)
+	{
+		node = &n[sibling];
+		area = SV_BVHArea (node->mins, node->maxs);
+		combined = SV_BVHUnionArea (node, &n[leaf]);
+		cost = 2.f * combined;			// new parent for this node and the leaf
+		inherit = 2.f * (combined - area);	// growth pushed onto the ancestors
+
+		for (i = 0; i < 2; i++)
+		{
+			bvhnode_t *child = &n[node->children[i]];
+			childcost[i] = SV_BVHUnionArea (child, &n[leaf]) + inherit;
+			if (child->children[0] != BVH_NULL)
+				childcost[i] -= SV_BVHArea (child->mins, child->maxs);
+		}
+
+		if (cost < childcost[0] && cost < childcost[1])
+			break;
+		sibling = node->children[childcost[1] < childcost[0] ? 1 : 0];
+	}
+
+	oldparent = n[sibling].parent;
+	node = &n[newparent];
+	node->parent = oldparent;
+	node->children[0] = sibling;
+	node->children[1] = leaf;
+	node->height = n[sibling].height + 1;
+	SV_BVHUnion (node, &n[sibling], &n[leaf]);
+	SV_BVHReplaceChild (tree, oldparent, sibling, newparent);
+	n[sibling].parent = newparent;
+	n[leaf].parent = newparent;
+
+	SV_BVHFixUpwards (tree, oldparent);
+}
+
+/*
+===============
+SV_BVHRemoveLeaf
+===============
+*/
+static void SV_BVHRemoveLeaf (bvhtree_t *tree, int leaf)
+{
+	bvhnode_t	*n = tree->nodes;
+	int			parent, grandparent, sibling;
+
+	if (leaf == tree->root)
+	{
+		tree->root = BVH_NULL;
+		return;
+	}
+
+	parent = n[leaf].parent;
+	grandparent = n[parent].parent;
+	sibling = n[parent].children[n[parent].children[0] == leaf ? 1 : 0];
+
+	SV_BVHReplaceChild (tree, grandparent, parent, sibling);
+	n[sibling].parent = grandparent;
+	SV_BVHFreeNode (tree, parent);
+
+	SV_BVHFixUpwards (tree, grandparent);
+}
+
+/*
+===============
+SV_BVHUnlinkEdict
+===============
+*/
+static void SV_BVHUnlinkEdict (edict_t *ent)
+{
+	bvhtree_t *tree;
+
+	if (!sv_bvhbuilt || !ent->bvhleaf)
+		return;
+
+	tree = &sv_bvh[ent->bvhtree];
+	SV_BVHRemoveLeaf (tree, ent->bvhleaf - 1);
+	SV_BVHFreeNode (tree, ent->bvhleaf - 1);
+	ent->bvhleaf = 0;
+}
+
+/*
+===============
+SV_BVHLinkEdict
+
+Leaves the edict where it is if its box still fits in the fattened leaf
+===============
+*/
+static void SV_BVHLinkEdict (edict_t *ent)
+{
+	bvhtree_t	*tree;
+	bvhnode_t	*node;
+	int			i, leaf;
+
+	if (ent->bvhleaf)
+	{
+		node = &sv_bvh[ent->bvhtree].nodes[ent->bvhleaf - 1];
+		if (ent->bvhtree == ent->arealist &&
+			ent->v.absmin[0] >= node->mins[0] && ent->v.absmax[0] <= node->maxs[0] &&
+			ent->v.absmin[1] >= node->mins[1] && ent->v.absmax[1] <= node->maxs[1] &&
+			ent->v.absmin[2] >= node->mins[2] && ent->v.absmax[2] <= node->maxs[2])
+			return;
+		SV_BVHUnlinkEdict (ent);
+	}
+
+	tree = &sv_bvh[ent->arealist];
+	leaf = SV_BVHAllocNode (tree);
+	node = &tree->nodes[leaf];
+	node->ent = ent;
+	for (i = 0; i < 3; i++)
+	{
+		// a NaN box is never rejected by the areanode checks, so it has to cover everything here
+		node->mins[i] = IS_NAN (ent->v.absmin[i]) ? -INFINITY : ent->v.absmin[i] - BVH_FAT_MARGIN;
+		node->maxs[i] = IS_NAN (ent->v.absmax[i]) ? INFINITY : ent->v.absmax[i] + BVH_FAT_MARGIN;
+	}
+	SV_BVHInsertLeaf (tree, leaf);
+
+	ent->bvhleaf = leaf + 1;
+	ent->bvhtree = ent->arealist;
+}
+
+/*
+===============
+SV_BVHBuild
+===============
+*/
+static void SV_BVHBuild (void)
+{
+	edict_t	*ent;
+	int		i;
+
+	SV_BVHClear ();
+	sv_bvhbuilt = true;
+
+	ent = NEXT_EDICT (qcvm->edicts);
+	for (i = 1; i < qcvm->num_edicts; i++, ent = NEXT_EDICT (ent))
+	{
+		ent->bvhleaf = 0;
+		if (!ent->free && ent->area.prev)
+			SV_BVHLinkEdict (ent);
+	}
+}
+
+/*
+===============
+SV_BVHQuery
+
+Collects the edicts in the tree whose box touches the given one, in no
+particular order. Returns -1 if the list or the stack runs out.
+===============
+*/
+static int SV_BVHQuery (int arealist, const vec3_t mins, const vec3_t maxs, edict_t **list, int maxlist)
+{
+	const bvhtree_t	*tree;
+	const bvhnode_t	*node;
+	const edict_t	*ent;
+	int				stack[BVH_STACK];
+	int				sp, count;
+
+	if (!sv_bvhbuilt)
+		SV_BVHBuild ();
+
+	tree = &sv_bvh[arealist];
+	if (tree->root == BVH_NULL)
+		return 0;
+
+	count = 0;
+	sp = 0;
+	stack[sp++] = tree->root;
+	while (sp > 0)
+	{
+		node = &tree->nodes[stack[--sp]];
+		if (mins[0] > node->maxs[0] || mins[1] > node->maxs[1] || mins[2] > node->maxs[2] ||
+			maxs[0] < node->mins[0] || maxs[1] < node->mins[1] || maxs[2] < node->mins[2])
+			continue;
+
+		if (node->children[0] != BVH_NULL)
+		{
+			if (sp + 2 > BVH_STACK)
+				return -1;
+			stack[sp++] = node->children[1];
+			stack[sp++] = node->children[0];
+			continue;
+		}
+
+		// same test as the areanode walk
+		ent = node->ent;
+		if (mins[0] > ent->v.absmax[0]
+		|| mins[1] > ent->v.absmax[1]
+		|| mins[2] > ent->v.absmax[2]
+		|| maxs[0] < ent->v.absmin[0]
+		|| maxs[1] < ent->v.absmin[1]
+		|| maxs[2] < ent->v.absmin[2] )
+			continue;
+
+		if (count == maxlist)
+			return -1;
+		list[count++] = node->ent;
+	}
+
+	return count;
+}
+
+/*
+===============
+SV_CompareAreaKeys
+===============
+*/
+static int SV_CompareAreaKeys (const void *a, const void *b)
+{
+	const edict_t *e1 = *(const edict_t **) a;
+	const edict_t *e2 = *(const edict_t **) b;
+	return (e1->areakey > e2->areakey) - (e1->areakey < e2->areakey);
+}
+
+/*
+===============
+SV_SortAreaOrder
+
+Sorts a list of edicts into the order the areanode walk would visit them in
+===============
+*/
+static void SV_SortAreaOrder (edict_t **list, int count)
+{
+	int i, j;
+
+	if (count > 32)
+	{
+		qsort (list, count, sizeof (*list), SV_CompareAreaKeys);
+		return;
+	}
+
+	for (i = 1; i < count; i++)
+	{
+		edict_t *ent = list[i];
+		for (j = i; j > 0 && list[j - 1]->areakey > ent->areakey; j--)
+			list[j] = list[j - 1];
+		list[j] = ent;
+	}
+}
+
+/*
+===============
+SV_BoxHasNaN
+
+The areanode walk only looks at the top node for these, the tree would look everywhere
+===============
+*/
+static qboolean SV_BoxHasNaN (const vec3_t mins, const vec3_t maxs)
+{
+	int i;
+
+	for (i = 0; i < 3; i++)
+		if (IS_NAN (mins[i]) || IS_NAN (maxs[i]))
+			return true;
+
+	return false;
+}
+
+/*
+===============
+SV_UnlinkArea
+
+Leaves the broadphase tree alone, SV_LinkEdict updates it in place
+===============
+*/
+static void SV_UnlinkArea (edict_t *ent)
+{
+	RemoveLink (&ent->area);
+	ent->area.prev = ent->area.next = NULL;
+
+	if (ent->gridlink.prev)
+	{
+		RemoveLink (&ent->gridlink);
+		ent->gridlink.prev = ent->gridlink.next = NULL;
+	}
+}
+
+/*
+===============
+SV_UnlinkEdict
+
+===============
+*/
+void SV_UnlinkEdict (edict_t *ent)
+{
+	if (!ent->area.prev)
+		return;		// not linked in anywhere
+	SV_UnlinkArea (ent);
+	SV_BVHUnlinkEdict (ent);
+}
+
+
+/*
+====================
+SV_AreaTriggerEdicts
+
+Spike -- just builds a list of entities within the area, rather than walking
+them and risking the list getting corrupt.
+====================
+*/
+static void
+SV_AreaTriggerEdicts ( edict_t *ent, areanode_t *node, edict_t **list, int *listcount, const int listspace )
+{
+	link_t		*l, *next;
+	edict_t		*touch;
+
+// touch linked edicts
+	for (l = node->trigger_edicts.next ; l != &node->trigger_edicts ; l = next)
+	{
+		next = l->next;
+		touch = EDICT_FROM_AREA(l);
+		if (touch == ent)
+			continue;
+		if (!touch->v.touch || touch->v.solid != SOLID_TRIGGER)
+			continue;
+		if (ent->v.absmin[0] > touch->v.absmax[0]
+		|| ent->v.absmin[1] > touch->v.absmax[1]
+		|| ent->v.absmin[2] > touch->v.absmax[2]
+		|| ent->v.absmax[0] < touch->v.absmin[0]
+		|| ent->v.absmax[1] < touch->v.absmin[1]
+		|| ent->v.absmax[2] < touch->v.absmin[2] )
+			continue;
+
+		if (*listcount == listspace)
+			return; // should never happen
+
+		list[*listcount] = touch;
+		(*listcount)++;
+	}
+
+// recurse down both sides
+	if (node->axis == -1)
+		return;
+
+	if ( ent->v.absmax[node->axis] > node->dist )
+		SV_AreaTriggerEdicts ( ent, node->children[0], list, listcount, listspace );
+	if ( ent->v.absmin[node->axis] < node->dist )
+		SV_AreaTriggerEdicts ( ent, node->children[1], list, listcount, listspace );
+}
+
+/*
+====================
+SV_BVHTriggerEdicts
+
+Same list as SV_AreaTriggerEdicts, from the broadphase tree
+====================
+*/
+static qboolean SV_BVHTriggerEdicts (edict_t *ent, edict_t **list, int *listcount, const int listspace)
+{
+	edict_t		*touch;
+	int			i, count;
+
+	if (SV_BoxHasNaN (ent->v.absmin, ent->v.absmax))
+		return false;
+	count = SV_BVHQuery (AREA_TRIGGER, ent->v.absmin, ent->v.absmax, list, listspace);
+	if (count < 0)
+		return false;
+
+	*listcount = 0;
+	for (i = 0; i < count; i++)
+	{
+		touch = list[i];
+		if (touch == ent)
+			continue;
+		if (!touch->v.touch || touch->v.solid != SOLID_TRIGGER)
+			continue;
+		list[(*listcount)++] = touch;
+	}
+	SV_SortAreaOrder (list, *listcount);
+
+	return true;
+}
+
+/*
+====================
+SV_TouchLinks
+
+ericw -- copy the touching edicts to an array so we can avoid
+iteating the trigger_edicts linked list while calling PR_ExecuteProgram
+which could potentially corrupt the list while it's being iterated.
+Based on code from Spike.
+====================
+*/
+void SV_TouchLinks (edict_t *ent)
+{
+	edict_t		**list;
+	edict_t		*touch;
+	int		old_self, old_other;
+	int		i, listcount;
+	int		mark;
+
+	mark = Hunk_LowMark ();
+	list = (edict_t **) Hunk_AllocNoFill (qcvm->num_edicts*sizeof(edict_t *));
+
+	listcount = 0;
+	if (sv_broadphase.value && SV_BVHTriggerEdicts (ent, list, &listcount, qcvm->num_edicts))
+	{
+		// already in areanode order
+	}
+	else if (sv_spatialhash.value >= 2.f)
+	{
+		int count = SV_GridEdicts (ent->v.absmin, ent->v.absmax, false, list, qcvm->num_edicts);
+		for (i = 0; i < count; i++)
+		{
+			touch = list[i];
+			if (touch == ent || !touch->v.touch || touch->v.solid != SOLID_TRIGGER)
+				continue;
+			if (ent->v.absmin[0] > touch->v.absmax[0]
+			|| ent->v.absmin[1] > touch->v.absmax[1]
+			|| ent->v.absmin[2] > touch->v.absmax[2]
+			|| ent->v.absmax[0] < touch->v.absmin[0]
+			|| ent->v.absmax[1] < touch->v.absmin[1]
+			|| ent->v.absmax[2] < touch->v.absmin[2] )
+				continue;
+			list[listcount++] = touch;
+		}
+		SV_SortEdicts (list, listcount);
+	}
+	else
+		SV_AreaTriggerEdicts (ent, sv_areanodes, list, &listcount, qcvm->num_edicts);
+
+	for (i = 0; i < listcount; i++)
+	{
+		touch = list[i];
+	// re-validate in case of PR_ExecuteProgram having side effects that make
+	// edicts later in the list no longer touch
+		if (touch == ent)
+			continue;
+		if (!touch->v.touch || touch->v.solid != SOLID_TRIGGER)
+			continue;
+		if (ent->v.absmin[0] > touch->v.absmax[0]
+		|| ent->v.absmin[1] > touch->v.absmax[1]
+		|| ent->v.absmin[2] > touch->v.absmax[2]
+		|| ent->v.absmax[0] < touch->v.absmin[0]
+		|| ent->v.absmax[1] < touch->v.absmin[1]
+		|| ent->v.absmax[2] < touch->v.absmin[2] )
+			continue;
+		old_self = pr_global_struct->self;
+		old_other = pr_global_struct->other;
+
+		pr_global_struct->self = EDICT_TO_PROG(touch);
+		pr_global_struct->other = EDICT_TO_PROG(ent);
+		pr_global_struct->time = qcvm->time;
+		PR_ExecuteProgram (touch->v.touch);
+
+		pr_global_struct->self = old_self;
+		pr_global_struct->other = old_other;
+	}
+
+// free hunk-allocated edicts array
+	Hunk_FreeToLowMark (mark);
+}
+
+
+/*
+===============
+SV_FindTouchedLeafs
+
+===============
+*/
+void SV_FindTouchedLeafs (edict_t *ent, mnode_t *node)
+{
+	mplane_t	*splitplane;
+	mleaf_t		*leaf;
+	int			sides;
+	int			leafnum;
+
+	if (node->contents == CONTENTS_SOLID)
+		return;
+
+	if (ent->num_leafs == MAX_ENT_LEAFS)
+		return;
+
+// add an efrag if the node is a leaf
+
+	if ( node->contents < 0)
+	{
+		leaf = (mleaf_t *)node;
+		leafnum = leaf - sv.worldmodel->leafs - 1;
+
+		ent->leafnums[ent->num_leafs] = leafnum;
+		ent->num_leafs++;
+		return;
+	}
+
+// NODE_MIXED
+
+	splitplane = node->plane;
+	sides = BOX_ON_PLANE_SIDE(ent->v.absmin, ent->v.absmax, splitplane);
+
+// recurse down the contacted sides
+	if (sides & 1)
+		SV_FindTouchedLeafs (ent, node->children[0]);
+
+	if (sides & 2)
+		SV_FindTouchedLeafs (ent, node->children[1]);
+}
+
+/*
+===============
+SV_BuildLeafMasks
+
+Groups the touched leafs by pvs word, so that visibility checks can test
+several leafs at once
+===============
+*/
+static void SV_BuildLeafMasks (edict_t *ent)
+{
+	int		i, j, word, leafnum;
+	byte	bits[4];
+
+	ent->num_leafwords = 0;
+	for (i = 0; i < ent->num_leafs; i++)
+	{
+		leafnum = ent->leafnums[i];
+		word = leafnum >> 5;
+		for (j = 0; j < ent->num_leafwords; j++)
+			if (ent->leafwords[j] == word)
+				break;
+		if (j == ent->num_leafwords)
+		{
+			ent->leafwords[j] = word;
+			ent->leafmasks[j] = 0;
+			ent->num_leafwords++;
+		}
+
+		// the pvs is a byte array, so build the mask in memory order
+		memcpy (bits, &ent->leafmasks[j], 4);
+		bits[(leafnum >> 3) & 3] |= 1 << (leafnum & 7);
+		memcpy (&ent->leafmasks[j], bits, 4);
+	}
+}
+
+/*
+===============
+SV_BoxInPVS
+===============
+*/
+qboolean SV_BoxInPVS (vec3_t mins, vec3_t maxs, byte *pvs, mnode_t *node)
+{
+	mplane_t	*splitplane;
+	mleaf_t		*leaf;
+	int			sides;
+	int			leafnum;
+
+	if (node->contents == CONTENTS_SOLID)
+		return false;
+
+	if (node->contents < 0)
+	{
+		leaf = (mleaf_t *)node;
+		leafnum = leaf - sv.worldmodel->leafs - 1;
+		return pvs[leafnum >> 3] & (1 << (leafnum & 7));
+	}
+
+	splitplane = node->plane;
+	sides = BOX_ON_PLANE_SIDE(mins, maxs, splitplane);
+
+	if (sides & 1 && SV_BoxInPVS (mins, maxs, pvs, node->children[0]))
+		return true;
+
+	if (sides & 2 && SV_BoxInPVS (mins, maxs, pvs, node->children[1]))
+		return true;
+
+	return false;
+}
+
+/*
+===============
+SV_LinkEdict
+
+===============
+*/
+void SV_LinkEdict (edict_t *ent, qboolean touch_triggers)
+{
+	areanode_t	*node;
+
+	if (ent->area.prev)
+		SV_UnlinkArea (ent);	// unlink from old position
+
+	if (ent == qcvm->edicts || ent->free)
+	{
+		SV_BVHUnlinkEdict (ent);
+		return;		// don't add the world
+	}
+
+// set the abs box
+	VectorAdd (ent->v.origin, ent->v.mins, ent->v.absmin);
+	VectorAdd (ent->v.origin, ent->v.maxs, ent->v.absmax);
+
+//
+// to make items easier to pick up and allow them to be grabbed off
+// of shelves, the abs sizes are expanded
+//
+	if ((int)ent->v.flags & FL_ITEM)
+	{
+		ent->v.absmin[0] -= 15;
+		ent->v.absmin[1] -= 15;
+		ent->v.absmax[0] += 15;
+		ent->v.absmax[1] += 15;
+	}
+	else
+	{	// because movement is clipped an epsilon away from an actual edge,
 		// we must fully check even when bounding boxes don't quite touch
 		ent->v.absmin[0] -= 1;
 		ent->v.absmin[1] -= 1;
@@ -507,9 +1348,13 @@ void SV_LinkEdict (edict_t *ent, qboolean touch_triggers)
 	ent->num_leafs = 0;
 	if (ent->v.modelindex)
 		SV_FindTouchedLeafs (ent, sv.worldmodel->nodes);
+	SV_BuildLeafMasks (ent);
 
 	if (ent->v.solid == SOLID_NOT)
+	{
+		SV_BVHUnlinkEdict (ent);
 		return;
+	}
 
 // find the first node that the ent's box crosses
 	node = sv_areanodes;
@@ -528,9 +1373,26 @@ void SV_LinkEdict (edict_t *ent, qboolean touch_triggers)
 // link it in
 
 	if (ent->v.solid == SOLID_TRIGGER)
+	{
 		InsertLinkBefore (&ent->area, &node->trigger_edicts);
+		ent->arealist = AREA_TRIGGER;
+	}
 	else
+	{
 		InsertLinkBefore (&ent->area, &node->solid_edicts);
+		ent->arealist = AREA_SOLID;
+	}
+	ent->areakey = ((uint64_t) (node - sv_areanodes) << AREA_SEQ_BITS) | ++sv_areaseq;
+
+	SV_GridLinkEdict (ent);
+
+	if (sv_broadphase.value)
+	{
+		if (sv_bvhbuilt)
+			SV_BVHLinkEdict (ent);
+	}
+	else if (sv_bvhbuilt)
+		SV_BVHClear ();
 
 // if touch_triggers, touch all entities at this node and decend for more
 	if (touch_triggers)
@@ -771,6 +1633,269 @@ qboolean SV_RecursiveHullCheck (hull_t *hull, int num, float p1f, float p2f, vec
 }
 
 
+/*
+===============================================================================
+
+BATCHED LINE TESTING IN HULLS
+
+With SSE2, lines and points are walked through the hull four at a time.
+Lanes that stay on one side of a plane move down together, and a line that
+crosses a plane is finished by SV_RecursiveHullCheck from that node, which
+is exactly where the one-at-a-time walk would be by then, so the results are
+bit-identical. This only pays off for lines that are close together, which
+is what the tracelines builtin is for. sv_hullbatch 0 turns the SSE2 path
+off, and the hullbatchtest command compares both.
+
+===============================================================================
+*/
+
+#define	HULL_BATCH	4
+
+cvar_t	sv_hullbatch = {"sv_hullbatch", "1", CVAR_NONE};
+
+static	int		sv_hullbatchforce = -1;	// set by hullbatchtest, overrides sv_hullbatch
+
+/*
+==================
+SV_UseHullBatch
+==================
+*/
+static qboolean SV_UseHullBatch (void)
+{
+#ifdef USE_SSE2
+	static int hassse2 = -1;
+
+	if (hassse2 < 0)
+		hassse2 = SDL_HasSSE2 ();
+	if (sv_hullbatchforce >= 0)
+		return sv_hullbatchforce && hassse2;
+	return sv_hullbatch.value && hassse2;
+#else
+	return false;
+#endif
+}
+
+#ifdef USE_SSE2
+typedef struct
+{
+	float	p1[3][HULL_BATCH];	// start, by axis then lane
+	float	p2[3][HULL_BATCH];	// end, same as start for points
+	float	*start[HULL_BATCH];
+	float	*end[HULL_BATCH];
+} hullbatch_t;
+
+/*
+==================
+SV_LoadHullBatch
+
+Fills the unused lanes with copies of the first one
+==================
+*/
+static void SV_LoadHullBatch (hullbatch_t *b, int count, vec3_t *starts, vec3_t *ends)
+{
+	int lane, axis, src;
+
+	for (lane = 0; lane < HULL_BATCH; lane++)
+	{
+		src = lane < count ? lane : 0;
+		b->start[lane] = starts[src];
+		b->end[lane] = ends ? ends[src] : starts[src];
+		for (axis = 0; axis < 3; axis++)
+		{
+			b->p1[axis][lane] = b->start[lane][axis];
+			b->p2[axis][lane] = b->end[lane][axis];
+		}
+	}
+}
+
+/*
+==================
+SV_HullBatchDist
+
+Plane distances of four points, with the same arithmetic as SV_RecursiveHullCheck
+==================
+*/
+static inline __m128 SV_HullBatchDist (const mplane_t *plane, const float (*p)[HULL_BATCH])
+{
+	__m128	x, y, z;
+	__m128d	lo, hi, n, dist;
+
+	if (plane->type < 3)
+		return _mm_sub_ps (_mm_loadu_ps (p[plane->type]), _mm_set1_ps (plane->dist));
+
+	// DoublePrecisionDotProduct, rounded to float before the sign test
+	x = _mm_loadu_ps (p[0]);
+	y = _mm_loadu_ps (p[1]);
+	z = _mm_loadu_ps (p[2]);
+	n = _mm_set1_pd (plane->normal[0]);
+	lo = _mm_mul_pd (_mm_cvtps_pd (x), n);
+	hi = _mm_mul_pd (_mm_cvtps_pd (_mm_movehl_ps (x, x)), n);
+	n = _mm_set1_pd (plane->normal[1]);
+	lo = _mm_add_pd (lo, _mm_mul_pd (_mm_cvtps_pd (y), n));
+	hi = _mm_add_pd (hi, _mm_mul_pd (_mm_cvtps_pd (_mm_movehl_ps (y, y)), n));
+	n = _mm_set1_pd (plane->normal[2]);
+	lo = _mm_add_pd (lo, _mm_mul_pd (_mm_cvtps_pd (z), n));
+	hi = _mm_add_pd (hi, _mm_mul_pd (_mm_cvtps_pd (_mm_movehl_ps (z, z)), n));
+	dist = _mm_set1_pd (plane->dist);
+	lo = _mm_sub_pd (lo, dist);
+	hi = _mm_sub_pd (hi, dist);
+
+	return _mm_movelh_ps (_mm_cvtpd_ps (lo), _mm_cvtpd_ps (hi));
+}
+
+/*
+==================
+SV_HullBatchNode
+==================
+*/
+static inline mclipnode_t *SV_HullBatchNode (hull_t *hull, int num)
+{
+	if (num < hull->firstclipnode || num > hull->lastclipnode)
+		Sys_Error ("SV_HullBatchNode: bad node number");
+	return hull->clipnodes + num;
+}
+
+/*
+==================
+SV_HullCheckLanes
+==================
+*/
+static void SV_HullCheckLanes (hull_t *hull, int num, const hullbatch_t *b, int mask, trace_t *traces)
+{
+	mclipnode_t	*node;
+	mplane_t	*plane;
+	__m128		zero = _mm_setzero_ps ();
+	__m128		t1, t2;
+	int			lane, front, back, cross;
+
+	while (num >= 0)
+	{
+		node = SV_HullBatchNode (hull, num);
+		plane = hull->planes + node->planenum;
+		t1 = SV_HullBatchDist (plane, b->p1);
+		t2 = SV_HullBatchDist (plane, b->p2);
+		front = mask & _mm_movemask_ps (_mm_and_ps (_mm_cmpge_ps (t1, zero), _mm_cmpge_ps (t2, zero)));
+		back = mask & _mm_movemask_ps (_mm_and_ps (_mm_cmplt_ps (t1, zero), _mm_cmplt_ps (t2, zero)));
+
+		cross = mask & ~(front | back);
+		for (lane = 0; cross; lane++, cross >>= 1)
+			if (cross & 1)
+				SV_RecursiveHullCheck (hull, num, 0, 1, b->start[lane], b->end[lane], &traces[lane]);
+
+		if (front && back)
+			SV_HullCheckLanes (hull, node->children[1], b, back, traces);
+		else if (back)
+		{
+			num = node->children[1];
+			mask = back;
+			continue;
+		}
+		if (!front)
+			return;
+		num = node->children[0];
+		mask = front;
+	}
+
+	for (lane = 0; mask; lane++, mask >>= 1)
+		if (mask & 1)
+			SV_RecursiveHullCheck (hull, num, 0, 1, b->start[lane], b->end[lane], &traces[lane]);
+}
+
+/*
+==================
+SV_HullPointContentsLanes
+==================
+*/
+static void SV_HullPointContentsLanes (hull_t *hull, int num, const hullbatch_t *b, int mask, int *contents)
+{
+	mclipnode_t	*node;
+	int			lane, front, back;
+
+	while (num >= 0)
+	{
+		node = SV_HullBatchNode (hull, num);
+		back = mask & _mm_movemask_ps (_mm_cmplt_ps (SV_HullBatchDist (hull->planes + node->planenum, b->p1), _mm_setzero_ps ()));
+		front = mask & ~back;	// NaNs go to the front like in SV_HullPointContents
+
+		if (front && back)
+			SV_HullPointContentsLanes (hull, node->children[1], b, back, contents);
+		else if (back)
+		{
+			num = node->children[1];
+			mask = back;
+			continue;
+		}
+		num = node->children[0];
+		mask = front;
+	}
+
+	for (lane = 0; mask; lane++, mask >>= 1)
+		if (mask & 1)
+			contents[lane] = num;
+}
+#endif	// USE_SSE2
+
+/*
+==================
+SV_HullCheckBatch
+
+Same as calling SV_RecursiveHullCheck (hull, num, 0, 1, starts[i], ends[i], &traces[i])
+for each line, the traces have to be set up the same way too
+==================
+*/
+void SV_HullCheckBatch (hull_t *hull, int num, int count, vec3_t *starts, vec3_t *ends, trace_t *traces)
+{
+	int i;
+
+#ifdef USE_SSE2
+	if (SV_UseHullBatch ())
+	{
+		hullbatch_t	b;
+		int			n;
+		for (i = 0; i < count; i += n)
+		{
+			n = q_min (count - i, HULL_BATCH);
+			SV_LoadHullBatch (&b, n, starts + i, ends + i);
+			SV_HullCheckLanes (hull, num, &b, (1 << n) - 1, traces + i);
+		}
+		return;
+	}
+#endif
+
+	for (i = 0; i < count; i++)
+		SV_RecursiveHullCheck (hull, num, 0, 1, starts[i], ends[i], &traces[i]);
+}
+
+/*
+==================
+SV_HullPointContentsBatch
+
+Same as SV_HullPointContents for each point
+==================
+*/
+void SV_HullPointContentsBatch (hull_t *hull, int num, int count, vec3_t *points, int *contents)
+{
+	int i;
+
+#ifdef USE_SSE2
+	if (SV_UseHullBatch ())
+	{
+		hullbatch_t	b;
+		int			n;
+		for (i = 0; i < count; i += n)
+		{
+			n = q_min (count - i, HULL_BATCH);
+			SV_LoadHullBatch (&b, n, points + i, NULL);
+			SV_HullPointContentsLanes (hull, num, &b, (1 << n) - 1, contents + i);
+		}
+		return;
+	}
+#endif
+
+	for (i = 0; i < count; i++)
+		contents[i] = SV_HullPointContents (hull, num, points[i]);
+}
+
 /*
 ==================
 SV_ClipMoveToEntity
@@ -812,76 +1937,137 @@ trace_t SV_ClipMoveToEntity (edict_t *ent, vec3_t start, vec3_t mins, vec3_t max
 	return trace;
 }
 
+/*
+==================
+SV_ClipMoveToEntityBatch
+
+SV_ClipMoveToEntity for several moves of the same size
+==================
+*/
+static void SV_ClipMoveToEntityBatch (edict_t *ent, int count, vec3_t *starts, vec3_t mins, vec3_t maxs, vec3_t *ends, trace_t *traces)
+{
+	vec3_t		offset;
+	vec3_t		starts_l[HULL_BATCH], ends_l[HULL_BATCH];
+	hull_t		*hull;
+	int			i, j, n;
+
+// get the clipping hull
+	hull = SV_HullForEntity (ent, mins, maxs, offset);
+
+	for (i = 0; i < count; i += n)
+	{
+		n = q_min (count - i, HULL_BATCH);
+
+	// fill in default traces
+		for (j = 0; j < n; j++)
+		{
+			trace_t *trace = &traces[i + j];
+			memset (trace, 0, sizeof (*trace));
+			trace->fraction = 1;
+			trace->allsolid = true;
+			VectorCopy (ends[i + j], trace->endpos);
+			VectorSubtract (starts[i + j], offset, starts_l[j]);
+			VectorSubtract (ends[i + j], offset, ends_l[j]);
+		}
+
+		SV_HullCheckBatch (hull, hull->firstclipnode, n, starts_l, ends_l, traces + i);
+
+	// fix traces up by the offset
+		for (j = 0; j < n; j++)
+		{
+			trace_t *trace = &traces[i + j];
+			if (trace->fraction != 1)
+				VectorAdd (trace->endpos, offset, trace->endpos);
+			if (trace->fraction < 1 || trace->startsolid)
+				trace->ent = ent;
+		}
+	}
+}
+
 //===========================================================================
 
 /*
 ====================
-SV_ClipToLinks
+SV_ClipToEdict
 
-Mins and maxs enclose the entire area swept by the move
+Returns false once the trace is all solid and nothing else can change it
 ====================
 */
-void SV_ClipToLinks ( areanode_t *node, moveclip_t *clip )
+static qboolean SV_ClipToEdict (edict_t *touch, moveclip_t *clip)
 {
-	link_t		*l, *next;
-	edict_t		*touch;
 	trace_t		trace;
 
-// touch linked edicts
-	for (l = node->solid_edicts.next ; l != &node->solid_edicts ; l = next)
+	if (touch->v.solid == SOLID_NOT)
+		return true;
+	if (touch == clip->passedict)
+		return true;
+	if (touch->v.solid == SOLID_TRIGGER)
+		Sys_Error ("Trigger in clipping list");
+
+	if (clip->type == MOVE_NOMONSTERS && touch->v.solid != SOLID_BSP)
+		return true;
+
+	if (clip->boxmins[0] > touch->v.absmax[0]
+	|| clip->boxmins[1] > touch->v.absmax[1]
+	|| clip->boxmins[2] > touch->v.absmax[2]
+	|| clip->boxmaxs[0] < touch->v.absmin[0]
+	|| clip->boxmaxs[1] < touch->v.absmin[1]
+	|| clip->boxmaxs[2] < touch->v.absmin[2] )
+		return true;
+
+	if (clip->passedict && clip->passedict->v.size[0] && !touch->v.size[0])
+		return true;	// points never interact
+
+// might intersect, so do an exact clip
+	if (clip->trace.allsolid)
+		return false;
+	if (clip->passedict)
 	{
-		next = l->next;
-		touch = EDICT_FROM_AREA(l);
-		if (touch->v.solid == SOLID_NOT)
-			continue;
-		if (touch == clip->passedict)
-			continue;
-		if (touch->v.solid == SOLID_TRIGGER)
-			Sys_Error ("Trigger in clipping list");
+	 	if (PROG_TO_EDICT(touch->v.owner) == clip->passedict)
+			return true;	// don't clip against own missiles
+		if (PROG_TO_EDICT(clip->passedict->v.owner) == touch)
+			return true;	// don't clip against owner
+	}
 
-		if (clip->type == MOVE_NOMONSTERS && touch->v.solid != SOLID_BSP)
-			continue;
+	if ((int)touch->v.flags & FL_MONSTER)
+		trace = SV_ClipMoveToEntity (touch, clip->start, clip->mins2, clip->maxs2, clip->end);
+	else
+		trace = SV_ClipMoveToEntity (touch, clip->start, clip->mins, clip->maxs, clip->end);
+	if (trace.allsolid || trace.startsolid ||
+	trace.fraction < clip->trace.fraction)
+	{
+		trace.ent = touch;
+	 	if (clip->trace.startsolid)
+		{
+			clip->trace = trace;
+			clip->trace.startsolid = true;
+		}
+		else
+			clip->trace = trace;
+	}
+	else if (trace.startsolid)
+		clip->trace.startsolid = true;
 
-		if (clip->boxmins[0] > touch->v.absmax[0]
-		|| clip->boxmins[1] > touch->v.absmax[1]
-		|| clip->boxmins[2] > touch->v.absmax[2]
-		|| clip->boxmaxs[0] < touch->v.absmin[0]
-		|| clip->boxmaxs[1] < touch->v.absmin[1]
-		|| clip->boxmaxs[2] < touch->v.absmin[2] )
-			continue;
+	return true;
+}
+
+/*
+====================
+SV_ClipToLinks
 
-		if (clip->passedict && clip->passedict->v.size[0] && !touch->v.size[0])
-			continue;	// points never interact
+Mins and maxs enclose the entire area swept by the move
+====================
+*/
+void SV_ClipToLinks ( areanode_t *node, moveclip_t *clip )
+{
+	link_t		*l, *next;
 
-	// might intersect, so do an exact clip
-		if (clip->trace.allsolid)
+// touch linked edicts
+	for (l = node->solid_edicts.next ; l != &node->solid_edicts ; l = next)
+	{
+		next = l->next;
+		if (!SV_ClipToEdict (EDICT_FROM_AREA(l), clip))
 			return;
-		if (clip->passedict)
-		{
-		 	if (PROG_TO_EDICT(touch->v.owner) == clip->passedict)
-				continue;	// don't clip against own missiles
-			if (PROG_TO_EDICT(clip->passedict->v.owner) == touch)
-				continue;	// don't clip against owner
-		}
-
-		if ((int)touch->v.flags & FL_MONSTER)
-			trace = SV_ClipMoveToEntity (touch, clip->start, clip->mins2, clip->maxs2, clip->end);
-		else
-			trace = SV_ClipMoveToEntity (touch, clip->start, clip->mins, clip->maxs, clip->end);
-		if (trace.allsolid || trace.startsolid ||
-		trace.fraction < clip->trace.fraction)
-		{
-			trace.ent = touch;
-		 	if (clip->trace.startsolid)
-			{
-				clip->trace = trace;
-				clip->trace.startsolid = true;
-			}
-			else
-				clip->trace = trace;
-		}
-		else if (trace.startsolid)
-			clip->trace.startsolid = true;
 	}
 
 // recurse down both sides
@@ -894,6 +2080,33 @@ void SV_ClipToLinks ( areanode_t *node, moveclip_t *clip )
 		SV_ClipToLinks ( node->children[1], clip );
 }
 
+/*
+====================
+SV_ClipToBVH
+
+Same as SV_ClipToLinks from the root, returns false if the
+areanodes have to be used instead
+====================
+*/
+static qboolean SV_ClipToBVH (moveclip_t *clip)
+{
+	edict_t		*list[BVH_MAX_RESULTS];
+	int			i, count;
+
+	if (SV_BoxHasNaN (clip->boxmins, clip->boxmaxs))
+		return false;
+	count = SV_BVHQuery (AREA_SOLID, clip->boxmins, clip->boxmaxs, list, countof (list));
+	if (count < 0)
+		return false;
+
+	SV_SortAreaOrder (list, count);
+	for (i = 0; i < count; i++)
+		if (!SV_ClipToEdict (list[i], clip))
+			break;
+
+	return true;
+}
+
 
 /*
 ==================
@@ -927,18 +2140,19 @@ boxmaxs[0] = boxmaxs[1] = boxmaxs[2] = 9999;
 
 /*
 ==================
-SV_Move
+SV_ClipMoveToEdicts
+
+Continues a move that has been clipped to the world
 ==================
 */
-trace_t SV_Move (vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, int type, edict_t *passedict)
+static trace_t SV_ClipMoveToEdicts (const trace_t *worldtrace, vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, int type, edict_t *passedict, qboolean bvh)
 {
 	moveclip_t	clip;
 	int			i;
 
 	memset ( &clip, 0, sizeof ( moveclip_t ) );
 
-// clip to world
-	clip.trace = SV_ClipMoveToEntity ( qcvm->edicts, start, mins, maxs, end );
+	clip.trace = *worldtrace;
 
 	clip.start = start;
 	clip.end = end;
@@ -965,8 +2179,479 @@ trace_t SV_Move (vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, int type, e
 	SV_MoveBounds ( start, clip.mins2, clip.maxs2, end, clip.boxmins, clip.boxmaxs );
 
 // clip to entities
-	SV_ClipToLinks ( sv_areanodes, &clip );
+	if (!bvh || !SV_ClipToBVH (&clip))
+		SV_ClipToLinks ( sv_areanodes, &clip );
 
 	return clip.trace;
 }
 
+/*
+==================
+SV_MoveWithBroadphase
+==================
+*/
+static trace_t SV_MoveWithBroadphase (vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, int type, edict_t *passedict, qboolean bvh)
+{
+	trace_t		trace;
+
+// clip to world
+	trace = SV_ClipMoveToEntity ( qcvm->edicts, start, mins, maxs, end );
+
+	return SV_ClipMoveToEdicts (&trace, start, mins, maxs, end, type, passedict, bvh);
+}
+
+// SV_Move calls recorded for sv_tracebench
+typedef struct
+{
+	vec3_t	start, mins, maxs, end;
+	int		type;
+	int		passedict;	// edict number, -1 for none
+} tracerecord_t;
+
+static	tracerecord_t	*sv_tracerecords;
+static	int				sv_numtracerecords;
+static	int				sv_maxtracerecords;	// still recording while below this
+
+/*
+==================
+SV_RecordMove
+==================
+*/
+static void SV_RecordMove (vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, int type, edict_t *passedict)
+{
+	tracerecord_t *rec = &sv_tracerecords[sv_numtracerecords++];
+
+	VectorCopy (start, rec->start);
+	VectorCopy (mins, rec->mins);
+	VectorCopy (maxs, rec->maxs);
+	VectorCopy (end, rec->end);
+	rec->type = type;
+	rec->passedict = passedict ? NUM_FOR_EDICT (passedict) : -1;
+}
+
+/*
+==================
+SV_Move
+==================
+*/
+trace_t SV_Move (vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, int type, edict_t *passedict)
+{
+	if (sv_numtracerecords < sv_maxtracerecords)
+		SV_RecordMove (start, mins, maxs, end, type, passedict);
+
+	return SV_MoveWithBroadphase (start, mins, maxs, end, type, passedict, sv_broadphase.value != 0.f);
+}
+
+/*
+==================
+SV_MoveBatch
+
+Same as calling SV_Move for each start and end, with the world
+part of the moves traced together
+==================
+*/
+void SV_MoveBatch (int count, vec3_t *starts, vec3_t mins, vec3_t maxs, vec3_t *ends, int type, edict_t *passedict, trace_t *traces)
+{
+	int i;
+
+	for (i = 0; i < count && sv_numtracerecords < sv_maxtracerecords; i++)
+		SV_RecordMove (starts[i], mins, maxs, ends[i], type, passedict);
+
+// clip to world
+	SV_ClipMoveToEntityBatch (qcvm->edicts, count, starts, mins, maxs, ends, traces);
+
+	for (i = 0; i < count; i++)
+		traces[i] = SV_ClipMoveToEdicts (&traces[i], starts[i], mins, maxs, ends[i], type, passedict, sv_broadphase.value != 0.f);
+}
+
+/*
+===============================================================================
+
+MOVE PREDICTION
+
+A move can be traced ahead of time, on any thread, as long as nothing else
+changes the world. The edicts whose boxes touch the move are recorded along
+with every field the trace looks at. Later, when the move is actually made,
+the prediction is used only if the inputs match exactly and collecting the
+edicts again gives the same list with the same fields. That way the result
+is always exactly what SV_Move would return.
+
+===============================================================================
+*/
+
+/*
+==================
+SV_AddMoveDep
+==================
+*/
+static qboolean SV_AddMoveDep (movepredict_t *mp, edict_t *ent)
+{
+	movedep_t *dep;
+
+	if (mp->numdeps == MAX_MOVE_DEPS)
+		return false;
+
+	dep = &mp->deps[mp->numdeps++];
+	memset (dep, 0, sizeof (*dep));
+	dep->ent = ent;
+	dep->solid = ent->v.solid;
+	dep->movetype = ent->v.movetype;
+	dep->modelindex = ent->v.modelindex;
+	dep->flags = ent->v.flags;
+	dep->owner = ent->v.owner;
+	VectorCopy (ent->v.origin, dep->origin);
+	VectorCopy (ent->v.mins, dep->mins);
+	VectorCopy (ent->v.maxs, dep->maxs);
+	VectorCopy (ent->v.absmin, dep->absmin);
+	VectorCopy (ent->v.absmax, dep->absmax);
+	VectorCopy (ent->v.size, dep->size);
+
+	// anything that would make SV_Move raise an error has to be left to SV_Move
+	if (ent->v.solid == SOLID_BSP)
+	{
+		qmodel_t *model;
+		if (ent->v.movetype != MOVETYPE_PUSH || !(ent->v.modelindex >= 0 && ent->v.modelindex < MAX_MODELS))
+			return false;
+		model = sv.models[(int)ent->v.modelindex];
+		if (!model || model->type != mod_brush)
+			return false;
+	}
+
+	return true;
+}
+
+/*
+==================
+SV_CollectMoveDeps
+
+Same walk and box test as SV_ClipToLinks
+==================
+*/
+static qboolean SV_CollectMoveDeps (areanode_t *node, const vec3_t boxmins, const vec3_t boxmaxs, movepredict_t *mp)
+{
+	link_t		*l;
+	edict_t		*touch;
+
+	for (l = node->solid_edicts.next ; l != &node->solid_edicts ; l = l->next)
+	{
+		touch = EDICT_FROM_AREA(l);
+		if (boxmins[0] > touch->v.absmax[0]
+		|| boxmins[1] > touch->v.absmax[1]
+		|| boxmins[2] > touch->v.absmax[2]
+		|| boxmaxs[0] < touch->v.absmin[0]
+		|| boxmaxs[1] < touch->v.absmin[1]
+		|| boxmaxs[2] < touch->v.absmin[2] )
+			continue;
+		if (touch->v.solid == SOLID_TRIGGER)
+			return false;	// SV_Move errors out on this
+		if (!SV_AddMoveDep (mp, touch))
+			return false;
+	}
+
+	if (node->axis == -1)
+		return true;
+
+	if ( boxmaxs[node->axis] > node->dist && !SV_CollectMoveDeps ( node->children[0], boxmins, boxmaxs, mp ) )
+		return false;
+	if ( boxmins[node->axis] < node->dist && !SV_CollectMoveDeps ( node->children[1], boxmins, boxmaxs, mp ) )
+		return false;
+
+	return true;
+}
+
+/*
+==================
+SV_GetMoveDeps
+==================
+*/
+static qboolean SV_GetMoveDeps (movepredict_t *mp)
+{
+	vec3_t		mins2, maxs2, boxmins, boxmaxs;
+	int			i;
+
+	mp->numdeps = 0;
+	if (!SV_AddMoveDep (mp, qcvm->edicts))
+		return false;
+	if (mp->passedict && !SV_AddMoveDep (mp, mp->passedict))
+		return false;
+
+	for (i = 0; i < 3; i++)
+	{
+		mins2[i] = mp->type == MOVE_MISSILE ? -15 : mp->mins[i];
+		maxs2[i] = mp->type == MOVE_MISSILE ? 15 : mp->maxs[i];
+	}
+	SV_MoveBounds (mp->start, mins2, maxs2, mp->end, boxmins, boxmaxs);
+
+	return SV_CollectMoveDeps (sv_areanodes, boxmins, boxmaxs, mp);
+}
+
+/*
+==================
+SV_PredictMove
+
+Traces the move set up in mp, only reads from the world so
+several of these can run at the same time
+==================
+*/
+void SV_PredictMove (movepredict_t *mp)
+{
+	mp->valid = false;
+	if (!SV_GetMoveDeps (mp))
+		return;
+
+	mp->trace = SV_MoveWithBroadphase (mp->start, mp->mins, mp->maxs, mp->end, mp->type, mp->passedict, false);
+	mp->valid = true;
+}
+
+/*
+==================
+SV_MovePredicted
+
+Returns true and sets trace if mp is still exactly what
+SV_Move would return for these arguments
+==================
+*/
+qboolean SV_MovePredicted (movepredict_t *mp, vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, int type, edict_t *passedict, trace_t *trace)
+{
+	movepredict_t	check;
+
+	if (!mp->valid || sv_numtracerecords < sv_maxtracerecords)
+		return false;
+	if (type != mp->type || passedict != mp->passedict ||
+		memcmp (start, mp->start, sizeof (vec3_t)) || memcmp (end, mp->end, sizeof (vec3_t)) ||
+		memcmp (mins, mp->mins, sizeof (vec3_t)) || memcmp (maxs, mp->maxs, sizeof (vec3_t)))
+		return false;
+
+	memcpy (&check, mp, offsetof (movepredict_t, numdeps));
+	if (!SV_GetMoveDeps (&check) || check.numdeps != mp->numdeps ||
+		memcmp (check.deps, mp->deps, sizeof (mp->deps[0]) * mp->numdeps))
+		return false;
+
+	*trace = mp->trace;
+	return true;
+}
+
+/*
+==================
+SV_TracesEqual
+==================
+*/
+qboolean SV_TracesEqual (const trace_t *a, const trace_t *b)
+{
+	return a->allsolid == b->allsolid && a->startsolid == b->startsolid &&
+		a->inopen == b->inopen && a->inwater == b->inwater && a->ent == b->ent &&
+		!memcmp (&a->fraction, &b->fraction, sizeof (a->fraction)) &&
+		!memcmp (a->endpos, b->endpos, sizeof (a->endpos)) &&
+		!memcmp (&a->plane, &b->plane, sizeof (a->plane));
+}
+
+/*
+==================
+SV_TraceBench_f
+
+"sv_tracebench record [count]" records the next SV_Move calls,
+"sv_tracebench [iterations]" replays them with the areanodes and with the
+broadphase tree, and checks that both give the same traces
+==================
+*/
+void SV_TraceBench_f (void)
+{
+	trace_t		*results;
+	qcvm_t		*oldvm;
+	int			iterations, pass, iter, i, mismatches;
+	double		start, times[2];
+
+	if (Cmd_Argc () > 1 && !q_strcasecmp (Cmd_Argv (1), "record"))
+	{
+		int count = Cmd_Argc () > 2 ? q_max (atoi (Cmd_Argv (2)), 1) : 10000;
+		free (sv_tracerecords);
+		sv_numtracerecords = sv_maxtracerecords = 0;
+		sv_tracerecords = (tracerecord_t *) malloc (sizeof (*sv_tracerecords) * count);
+		if (!sv_tracerecords)
+		{
+			Con_Printf ("Out of memory.\n");
+			return;
+		}
+		sv_maxtracerecords = count;
+		Con_Printf ("Recording the next %d traces.\n", count);
+		return;
+	}
+
+	if (!sv.active)
+	{
+		Con_Printf ("Not running a local server.\n");
+		return;
+	}
+	if (!sv_numtracerecords)
+	{
+		Con_Printf ("No traces recorded, use \"sv_tracebench record\" first.\n");
+		return;
+	}
+	sv_maxtracerecords = sv_numtracerecords;	// stop recording
+
+	iterations = Cmd_Argc () > 1 ? q_max (atoi (Cmd_Argv (1)), 1) : 20;
+	results = (trace_t *) malloc (sizeof (*results) * 2 * sv_numtracerecords);
+	if (!results)
+	{
+		Con_Printf ("Out of memory.\n");
+		return;
+	}
+
+	PR_PushQCVM (&sv.qcvm, &oldvm);
+	if (!sv_bvhbuilt)
+		SV_BVHBuild ();
+
+	for (pass = 0; pass < 2; pass++)
+	{
+		trace_t *out = results + pass * sv_numtracerecords;
+
+		start = Sys_DoubleTime ();
+		for (iter = 0; iter < iterations; iter++)
+		{
+			for (i = 0; i < sv_numtracerecords; i++)
+			{
+				tracerecord_t	*rec = &sv_tracerecords[i];
+				edict_t			*passent = NULL;
+
+				if (rec->passedict >= 0 && rec->passedict < qcvm->num_edicts)
+					passent = EDICT_NUM (rec->passedict);
+				out[i] = SV_MoveWithBroadphase (rec->start, rec->mins, rec->maxs, rec->end, rec->type, passent, pass == 1);
+			}
+		}
+		times[pass] = (Sys_DoubleTime () - start) * 1000.0 / iterations;
+	}
+
+	mismatches = 0;
+	for (i = 0; i < sv_numtracerecords; i++)
+		if (!SV_TracesEqual (&results[i], &results[sv_numtracerecords + i]))
+			mismatches++;
+
+	Con_Printf ("%d traces, %d iterations\n", sv_numtracerecords, iterations);
+	Con_Printf ("areanodes     %8.3f ms\n", times[0]);
+	Con_Printf ("dynamic tree  %8.3f ms  (%d solid + %d trigger nodes, height %d)\n", times[1],
+		sv_bvh[AREA_SOLID].numnodes, sv_bvh[AREA_TRIGGER].numnodes,
+		sv_bvh[AREA_SOLID].root != BVH_NULL ? sv_bvh[AREA_SOLID].nodes[sv_bvh[AREA_SOLID].root].height : 0);
+	if (mismatches)
+		Con_Printf ("%d traces differ!\n", mismatches);
+	else
+		Con_Printf ("identical results\n");
+
+	PR_PopQCVM (oldvm);
+	free (results);
+}
+
+/*
+==================
+SV_HullBatchTest_f
+
+Traces random groups of four nearby lines and points through the world
+hulls one at a time and batched, and reports any results that differ
+==================
+*/
+void SV_HullBatchTest_f (void)
+{
+	qmodel_t	*model;
+	hull_t		*hull;
+	vec3_t		*starts, *ends;
+	trace_t		*traces;
+	int			*contents;
+	int			count, h, i, j, pass, numlinediffs, numpointdiffs;
+	double		start, times[2][2];
+
+	if (!sv.active)
+	{
+		Con_Printf ("Not running a local server.\n");
+		return;
+	}
+	sv_hullbatchforce = 1;
+	if (!SV_UseHullBatch ())
+	{
+		sv_hullbatchforce = -1;
+		Con_Printf ("SSE2 is not available.\n");
+		return;
+	}
+	sv_hullbatchforce = -1;
+
+	count = Cmd_Argc () > 1 ? q_max (atoi (Cmd_Argv (1)), 1) : 100000;
+	starts = (vec3_t *) malloc (sizeof (*starts) * count);
+	ends = (vec3_t *) malloc (sizeof (*ends) * count);
+	traces = (trace_t *) malloc (sizeof (*traces) * 2 * count);
+	contents = (int *) malloc (sizeof (*contents) * 2 * count);
+	if (!starts || !ends || !traces || !contents)
+	{
+		Con_Printf ("Out of memory.\n");
+		goto done;
+	}
+
+	// groups of four lines up to 32 units apart, each group moving the same way
+	model = sv.worldmodel;
+	for (i = 0; i < count; i++)
+	{
+		for (j = 0; j < 3; j++)
+		{
+			if (i & 3)
+			{
+				starts[i][j] = starts[i - 1][j] + (j < 2 ? 32.f * (rand () & 0x7fff) / 32768.f : 0.f);
+				ends[i][j] = starts[i][j] + ends[i - 1][j] - starts[i - 1][j];
+			}
+			else
+			{
+				starts[i][j] = model->mins[j] + (model->maxs[j] - model->mins[j]) * (rand () & 0x7fff) / 32768.f;
+				ends[i][j] = starts[i][j] + ((rand () & 0x7fff) - 16384) / 64.f;
+			}
+		}
+	}
+
+	Con_Printf ("%d lines and points per hull\n", count);
+	Con_Printf ("hull  lines ms: scalar     SSE2  points ms: scalar     SSE2\n");
+	for (h = 0; h < 3; h++)
+	{
+		hull = &model->hulls[h];
+		if (!hull->clipnodes || hull->firstclipnode > hull->lastclipnode)
+			continue;
+
+		for (pass = 0; pass < 2; pass++)
+		{
+			trace_t	*out = traces + pass * count;
+			int		*cont = contents + pass * count;
+
+			for (i = 0; i < count; i++)
+			{
+				memset (&out[i], 0, sizeof (out[i]));
+				out[i].fraction = 1;
+				out[i].allsolid = true;
+				VectorCopy (ends[i], out[i].endpos);
+			}
+
+			sv_hullbatchforce = pass;
+
+			start = Sys_DoubleTime ();
+			SV_HullCheckBatch (hull, hull->firstclipnode, count, starts, ends, out);
+			times[0][pass] = (Sys_DoubleTime () - start) * 1000.0;
+
+			start = Sys_DoubleTime ();
+			SV_HullPointContentsBatch (hull, hull->firstclipnode, count, starts, cont);
+			times[1][pass] = (Sys_DoubleTime () - start) * 1000.0;
+		}
+		sv_hullbatchforce = -1;
+
+		numlinediffs = numpointdiffs = 0;
+		for (i = 0; i < count; i++)
+		{
+			if (!SV_TracesEqual (&traces[i], &traces[count + i]))
+				numlinediffs++;
+			if (contents[i] != contents[count + i])
+				numpointdiffs++;
+		}
+
+		Con_Printf ("%4d  %16.3f %8.3f  %17.3f %8.3f\n", h, times[0][0], times[0][1], times[1][0], times[1][1]);
+		if (numlinediffs || numpointdiffs)
+			Con_Printf ("      %d lines and %d points differ!\n", numlinediffs, numpointdiffs);
+	}
+
+done:
+	free (starts);
+	free (ends);
+	free (traces);
+	free (contents);
+}
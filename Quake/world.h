@@ -60,6 +60,21 @@ void SV_LinkEdict (edict_t *ent, qboolean touch_triggers);
 // sets ent->v.absmin and ent->v.absmax
 // if touchtriggers, calls prog functions for the intersected triggers
 
+int SV_GridEdicts (const vec3_t mins, const vec3_t maxs, qboolean centers, edict_t **list, int maxlist);
+// collects the linked edicts (other than SOLID_NOT) that may touch the box, in no particular order
+// if centers is set, only the center of their box has to be inside
+// callers still have to test each returned edict
+void SV_SortEdicts (edict_t **list, int count);
+// sorts by edict number
+
+extern cvar_t sv_spatialhash;
+extern cvar_t sv_broadphase;
+// 0 = areanodes, 1 = dynamic AABB tree, both give the same results
+extern cvar_t sv_hullbatch;
+// 0 = trace lines through hulls one at a time even when SSE2 is available
+
+void SV_TraceBench_f (void);
+
 int SV_PointContents (vec3_t p);
 int SV_TruePointContents (vec3_t p);
 // returns the CONTENTS_* value from the world at the given point.
@@ -81,7 +96,49 @@ trace_t SV_Move (vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, int type, e
 
 // passedict is explicitly excluded from clipping checks (normally NULL)
 
+void SV_MoveBatch (int count, vec3_t *starts, vec3_t mins, vec3_t maxs, vec3_t *ends, int type, edict_t *passedict, trace_t *traces);
+// same as SV_Move for each start/end pair, the world part of the moves is traced together
+
+#define MAX_MOVE_DEPS	32
+
+typedef struct
+{
+	edict_t		*ent;
+	float		solid, movetype, modelindex, flags;
+	int			owner;
+	vec3_t		origin, mins, maxs, absmin, absmax, size;
+} movedep_t;
+
+typedef struct
+{
+	// set up by the caller
+	vec3_t		start, mins, maxs, end;
+	int			type;
+	edict_t		*passedict;
+
+	// the world, passedict and the edicts near the move, as they were when traced
+	int			numdeps;
+	movedep_t	deps[MAX_MOVE_DEPS];
+	trace_t		trace;
+	qboolean	valid;
+} movepredict_t;
+
+void SV_PredictMove (movepredict_t *mp);
+// traces the move ahead of time, only reads the world so it can run on any thread
+qboolean SV_MovePredicted (movepredict_t *mp, vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, int type, edict_t *passedict, trace_t *trace);
+// returns true and sets trace if nothing the prediction depends on has changed,
+// the result is then identical to calling SV_Move
+
+qboolean SV_TracesEqual (const trace_t *a, const trace_t *b);
+
 qboolean SV_RecursiveHullCheck (hull_t *hull, int num, float p1f, float p2f, vec3_t p1, vec3_t p2, trace_t *trace);
 
+void SV_HullCheckBatch (hull_t *hull, int num, int count, vec3_t *starts, vec3_t *ends, trace_t *traces);
+void SV_HullPointContentsBatch (hull_t *hull, int num, int count, vec3_t *points, int *contents);
+// bit-identical to SV_RecursiveHullCheck from 0 to 1 and SV_HullPointContents,
+// for many lines or points in the same hull
+
+void SV_HullBatchTest_f (void);
+
 #endif	/* _QUAKE_WORLD_H */
 